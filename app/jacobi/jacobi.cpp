@@ -75,6 +75,9 @@ namespace prime { namespace app
 		prime::api::app::knob_disc_t iters_knob;
 		prime::api::app::knob_disc_t prec_knob;
 		prime::api::app::knob_disc_t dev_knob;
+		std::shared_ptr<const prime::api::app::knob_disc_slot_t> iters_slot;
+		std::shared_ptr<const prime::api::app::knob_disc_slot_t> prec_slot;
+		std::shared_ptr<const prime::api::app::knob_disc_slot_t> dev_slot;
 
 		prime::api::app::mon_cont_t error_mon;
 		prime::api::app::mon_cont_t throughput_mon;
@@ -85,6 +88,7 @@ namespace prime { namespace app
 		void ui_stop(pid_t proc_id_ui);
 		void reg_rtm(pid_t proc_id_ui);
 		void dereg_rtm(pid_t proc_id_ui);
+		prime::api::disc_t knob_val(prime::api::app::knob_disc_t knob, const std::shared_ptr<const prime::api::app::knob_disc_slot_t>& slot);
 
 		void ui_mon_disc_min_handler(unsigned int id, prime::api::disc_t min);
 		void ui_mon_disc_max_handler(unsigned int id, prime::api::disc_t max);
@@ -236,6 +240,11 @@ namespace prime { namespace app
             dev_knob = rtm_api.knob_disc_reg(prime::api::app::PRIME_DEV_SEL, 0, 0, 0);
         }
 
+        // Have the RTM push knob changes so each iteration reads them locally
+        iters_slot = rtm_api.knob_disc_push(iters_knob);
+        prec_slot = rtm_api.knob_disc_push(prec_knob);
+        dev_slot = rtm_api.knob_disc_push(dev_knob);
+
         // Set up application monitor for observing error. Required bound is (PRIME_CONT_MIN, CONVERGENCE_THRESHOLD]
 		error_mon = rtm_api.mon_cont_reg(prime::api::app::PRIME_ERR, prime::api::PRIME_CONT_MIN, CONVERGENCE_THRESHOLD, 1.0);
         app_cont_mons.push_back(&error_mon);
@@ -276,6 +285,14 @@ namespace prime { namespace app
 		ui_app_dereg_cv.notify_one();
 	}
 
+	// A plain load once the RTM has accepted push mode; until then, or if it never does, ask it.
+	prime::api::disc_t jacobi::knob_val(prime::api::app::knob_disc_t knob, const std::shared_ptr<const prime::api::app::knob_disc_slot_t>& slot)
+	{
+		if(slot && slot->is_pushed())
+			return slot->get();
+		return rtm_api.knob_disc_get(knob);
+	}
+
 	void jacobi::jacobi_setup(void)
 	{
         cl_platform_id* platforms;
@@ -413,10 +430,10 @@ namespace prime { namespace app
 			std::cout << "APP: Time to set up data: " << (double)(end - start)/1000000 << " s" << std::endl;
 #endif
 
-            // Fetch RTM's desired knob values
-            iters_knob.val = rtm_api.knob_disc_get(iters_knob);
-            prec_knob.val = rtm_api.knob_disc_get(prec_knob);
-            dev_knob.val = rtm_api.knob_disc_get(dev_knob);
+            // Latest RTM knob values, read locally once the RTM pushes them
+            iters_knob.val = knob_val(iters_knob, iters_slot);
+            prec_knob.val = knob_val(prec_knob, prec_slot);
+            dev_knob.val = knob_val(dev_knob, dev_slot);
 #ifdef KOCL_EN
 			// If KOCL enabled and model building, force use of FPGA and exercise both kernels
 			if(!KOCL_built(kocl) && kocl_mons.empty()) {
@@ -30,11 +30,14 @@
 #include <csignal>
 #include <algorithm>
 #include <iterator>
+#include <mutex>
 
 #include "uds.h"
 #include "util.h"
 #include "prime_api_dev.h"
 #include "sched.h"
+#include "pmbus.h"
+#include "sampler.h"
 #include "args/args.hxx"
 
 #define CREATE_JSON_ROOT(type) \
@@ -64,6 +67,14 @@
 #define POW_MIN			0
 #define POW_MAX			0
 
+// LTC2978 power managers on the HPS I2C bus
+#define PMBUS_I2C_DEV		"/dev/i2c-0"
+#define PMBUS_ADDR_HPS		0x5C
+#define PMBUS_ADDR_FPGA		0x5E
+
+// Power monitors read within this long of each other share one pass over the rails.
+#define RAIL_SAMPLE_PERIOD_MS	50
+
 namespace prime { namespace dev
 {
 	class c5soc
@@ -81,6 +92,15 @@ namespace prime { namespace dev
 		
 		bool logger_en;
 		bool log_power;
+
+		prime::dev::pmbus::i2c_bus_t pmbus_i2c;
+		prime::dev::pmbus::rails_t rails;
+		std::vector<unsigned int> hps_rails, fpga_rails;
+		std::mutex rail_sample_m;
+		std::chrono::steady_clock::time_point rail_sample_ts;
+		bool rail_sampled = false;
+		// Total power at a fixed rate, for the energy and windowed power monitors
+		prime::dev::sampler::power_sampler_t power_sampler;
 		
 		//Handler functions
 		void ui_dev_stop_handler(void);
@@ -93,8 +113,11 @@ namespace prime { namespace dev
 		//Driver functions
 		//void set_gov(std::string gov);
 		//void set_freq(unsigned int freq);
+		void add_rails(void);
+		void sample_rails(bool force = false);
+		double soc_power(void);
 		void set_volt(std::string rail, prime::api::cont_t volt);
-		prime::api::cont_t get_pow(std::string rail);
+		prime::api::dev::mon_cont_ret_t get_pow(std::string rail);
 	};
 
 	c5soc::c5soc(prime::uds::socket_addrs_t *dev_rtm_addrs, prime::uds::socket_addrs_t *dev_ui_addrs, prime::api::dev::dev_args_t* dev_args) :
@@ -103,11 +126,19 @@ namespace prime { namespace dev
 		ui_socket(prime::uds::socket_layer_t::UI, dev_ui_addrs),
 		logger_socket(prime::uds::socket_layer_t::LOGGER, dev_rtm_addrs),	//TODO: deal with this better: uses same socket as API
 		logger_en(dev_rtm_addrs->logger_en),
-		log_power(dev_args->power)
+		log_power(dev_args->power),
+		pmbus_i2c(PMBUS_I2C_DEV),
+		rails(pmbus_i2c),
+		power_sampler(boost::bind(&c5soc::soc_power, this))
 	{
 		//set_gov(std::string("userspace"));
+		add_rails();
+		// A pass over all seven rails takes several ms of bus time; a shorter
+		// period than that just runs the sampler back to back.
+		power_sampler.start(dev_args->power_sample_us);
 		add_dev_knobs();
 		add_dev_mons();
+		power_sampler.add_to(rtm_api, rtm_api.get_architecture(), "global_monitors");
 		//ui_api.return_ui_dev_start();
 		
 		loop_thread = boost::thread(&c5soc::loop, this);
@@ -116,6 +147,7 @@ namespace prime { namespace dev
 
 	c5soc::~c5soc()
 	{
+		rtm_api.stop();
 		//set_gov(std::string("interactive"));
 		//ui_api.return_ui_dev_stop();
 	}
@@ -284,52 +316,91 @@ namespace prime { namespace dev
 		stream.close();
 	}*/
 	
+	void c5soc::add_rails(void)
+	{
+		if(!pmbus_i2c.is_open())
+			std::cerr << "ERROR: Unable to open " << PMBUS_I2C_DEV << " for PMBus access" << std::endl;
+
+		// Each rail is a page of its manager, with its current sense on the next page.
+		// The 1.5V rails' sense amplifiers read three times the current.
+		hps_rails.push_back(rails.add("HPS_1_1", PMBUS_ADDR_HPS, 0));
+		hps_rails.push_back(rails.add("HPS_1_5", PMBUS_ADDR_HPS, 2, 3));
+		hps_rails.push_back(rails.add("HPS_2_5", PMBUS_ADDR_HPS, 4));
+		hps_rails.push_back(rails.add("HPS_3_3", PMBUS_ADDR_HPS, 6));
+		fpga_rails.push_back(rails.add("FPGA_2_5", PMBUS_ADDR_FPGA, 0));
+		fpga_rails.push_back(rails.add("FPGA_1_5", PMBUS_ADDR_FPGA, 2, 3));
+		fpga_rails.push_back(rails.add("FPGA_1_1", PMBUS_ADDR_FPGA, 4));
+	}
+
+	void c5soc::sample_rails(bool force)
+	{
+		rail_sample_m.lock();
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if(force || !rail_sampled || now - rail_sample_ts >= std::chrono::milliseconds(RAIL_SAMPLE_PERIOD_MS)) {
+			rail_sampled = rails.sample();
+			rail_sample_ts = now;
+		}
+		rail_sample_m.unlock();
+	}
+
+	// Read by the power sampler, which needs a fresh pass every period. The
+	// power monitors then share that pass.
+	double c5soc::soc_power(void)
+	{
+		double total = 0;
+		sample_rails(true);
+		for(auto idx : hps_rails)
+			total += rails.watts(idx);
+		for(auto idx : fpga_rails)
+			total += rails.watts(idx);
+		return total;
+	}
+
 	void c5soc::set_volt(std::string rail, prime::api::cont_t volt)
 	{
-		std::system((std::string("../build/volreg ") + rail + std::string(" ") + std::to_string((float)volt)).c_str());
+		int idx = rails.find(rail);
+		if(idx < 0 || !rails.set_volts(idx, volt))
+			std::cerr << "ERROR: Unable to set " << rail << " to " << volt << "V" << std::endl;
 	}
 	
 	prime::api::dev::mon_cont_ret_t c5soc::get_pow(std::string rail)
 	{
 		prime::api::dev::mon_cont_ret_t ret;
 		
+		sample_rails();
+		ret.val = 0;
 		if(rail == std::string("soc"))
 		{
-			ret.val = get_pow(std::string("cpu")) + get_pow(std::string("fpga"));
+			for(auto idx : hps_rails)
+				ret.val += rails.watts(idx);
+			for(auto idx : fpga_rails)
+				ret.val += rails.watts(idx);
 			ret.min = SOC_POW_MIN;
 			ret.max = SOC_POW_MAX;
-			return ret;
 		}
 		else if(rail == std::string("cpu"))
 		{
-			ret.val = get_pow(std::string("HPS_1_1")) + get_pow(std::string("HPS_1_5")) + get_pow(std::string("HPS_2_5")) + get_pow(std::string("HPS_3_3"));
+			for(auto idx : hps_rails)
+				ret.val += rails.watts(idx);
 			ret.min = CPU_POW_MIN;
 			ret.max = CPU_POW_MAX;
-			return ret;
 		}
 		else if(rail == std::string("fpga"))
 		{
-			ret.val = get_pow(std::string("FPGA_1_1")) + get_pow(std::string("FPGA_1_5")) + get_pow(std::string("FPGA_2_5"));
+			for(auto idx : fpga_rails)
+				ret.val += rails.watts(idx);
 			ret.min = FPGA_POW_MIN;
 			ret.max = FPGA_POW_MAX;
-			return ret;
 		}
 		else
 		{
-			FILE* handle = popen((std::string("../build/volreg ") + rail).c_str(), "r");
-			char c_line[128];
-			fgets(c_line, 128, handle);
-			pclose(handle);
-			
-			std::string line(c_line);
-			line.resize(line.length() - 3);					// Chop off " W\n"
-			line = line.substr(line.rfind(" ") + 1);		// Get everything after last " "
-			
-			ret.val = (prime::api::cont_t)atof(line.c_str());
+			int idx = rails.find(rail);
+			if(idx >= 0)
+				ret.val = rails.watts(idx);
 			ret.min = POW_MIN;
 			ret.max = POW_MAX;
-			return ret;
 		}
+		return ret;
 	}
 
 } }
@@ -0,0 +1,800 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech & Graeme Bragg
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/utsname.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "uds.h"
+#include "util.h"
+#include "prime_api_dev.h"
+#include "sysfs.h"
+#include "perf.h"
+#include "args/args.hxx"
+
+//#define DEBUG
+
+#define TEMP_MIN	0
+#define TEMP_MAX	100
+
+// Programmable counters exposed per core, as on the odroid A7 cores
+#define LINUX_PMCS	4
+
+// Energy counters are differenced over at least this long, so back-to-back
+// reads do not turn counter granularity into noise.
+#define ENERGY_WINDOW_MS	10
+
+/* Generic Linux device.
+ *
+ * Instead of a fixed architecture file, the device walks sysfs at start-up
+ * and generates the functional_units tree from what the machine exposes:
+ *
+ *   cpu_policyN		a cpufreq policy: freq and governor knobs, one sub-unit
+ *						per core with cycle and PMC monitors (perf_event) and
+ *						an online knob where the core can be hot-plugged
+ *   thermal			every thermal zone as a temperature monitor
+ *   hwmon_<name>		temperature and power inputs of each hwmon device
+ *   powercap			power of every powercap (RAPL) zone, from its energy counter
+ *   global_monitors	total power of the top-level powercap zones or hwmon inputs
+ *
+ * The tree is written to a file for RTMs to read through dev_arch_get(), and
+ * every knob and monitor in it is registered with the ids it was given.
+ * The sysfs root can be moved so the device can be run against a fake tree.
+ */
+
+namespace prime { namespace dev
+{
+	class linux_dev
+	{
+	public:
+		struct linux_args_t {
+			std::string sysfs_root = "";
+			std::string arch_filename = "/tmp/dev.architecture.json";
+		};
+
+		linux_dev(prime::uds::socket_addrs_t *dev_rtm_addrs, prime::uds::socket_addrs_t *dev_ui_addrs, linux_args_t *linux_args);
+		~linux_dev();
+
+		static int parse_cli(prime::uds::socket_addrs_t* api_addrs, prime::uds::socket_addrs_t* ui_addrs, linux_args_t* linux_args, int argc, const char * argv[]);
+
+	private:
+		struct knob_entry_t {
+			unsigned int id;
+			prime::api::dev::knob_type_t type;
+			prime::api::disc_t min, max, init;
+			boost::function<void(prime::api::disc_t)> handler;
+		};
+
+		struct mon_disc_entry_t {
+			unsigned int id;
+			prime::api::dev::mon_type_t type;
+			boost::function<prime::api::dev::mon_disc_ret_t(void)> handler;
+		};
+
+		struct mon_cont_entry_t {
+			unsigned int id;
+			prime::api::dev::mon_type_t type;
+			prime::api::cont_t min, max;
+			boost::function<prime::api::dev::mon_cont_ret_t(void)> handler;
+		};
+
+		struct policy_t {
+			std::string path;
+			std::vector<unsigned int> cpus;
+			std::vector<unsigned long> freqs;		// kHz, ascending
+			std::vector<std::string> governors;		// Indexed by governor knob value
+			std::string saved_governor;
+			std::string saved_max_freq;
+			bool userspace;
+		};
+
+		// A sysfs input read as a number and scaled to the monitor's unit
+		struct sensor_t {
+			prime::dev::sysfs::node_t node;
+			double scale;
+		};
+
+		// Power from a cumulative energy counter in uJ
+		struct energy_t {
+			prime::dev::sysfs::node_t node;
+			double max_range;
+			double last_uj;
+			std::chrono::steady_clock::time_point last_t;
+			bool primed = false;
+			double power = 0;
+		};
+
+		std::string root;
+		std::string arch_filename;
+
+		// Discovered before the interface exists, registered once it does
+		boost::property_tree::ptree architecture;
+		std::vector<knob_entry_t> knobs;
+		std::vector<mon_disc_entry_t> mons_disc;
+		std::vector<mon_cont_entry_t> mons_cont;
+
+		std::vector<policy_t> policies;
+		std::vector<std::unique_ptr<sensor_t>> sensors;
+		std::vector<std::unique_ptr<energy_t>> energy;
+		std::vector<unsigned int> total_energy;		// Indices into energy
+		std::vector<unsigned int> total_sensors;	// Indices into sensors, without energy
+		std::mutex energy_m;
+		unsigned int num_cpus;
+		std::unique_ptr<prime::dev::perf::pmc_t> perf_counters;
+
+		prime::api::dev::rtm_interface rtm_api;
+		prime::api::dev::ui_interface ui_api;
+		boost::thread control_loop_thread;
+
+		//Handler functions
+		void ui_dev_stop_handler(void);
+		void cpu_freq_handler(unsigned int policy, prime::api::disc_t val);
+		void cpu_governor_handler(unsigned int policy, prime::api::disc_t val);
+		void cpu_online_handler(unsigned int cpu, prime::api::disc_t val);
+		void pmc_control_handler(unsigned int cpu, unsigned int pmc, prime::api::disc_t event);
+		prime::api::dev::mon_disc_ret_t cycle_count_handler(unsigned int cpu);
+		prime::api::dev::mon_disc_ret_t pmc_handler(unsigned int cpu, unsigned int pmc);
+		prime::api::dev::mon_cont_ret_t sensor_handler(unsigned int sensor);
+		prime::api::dev::mon_cont_ret_t energy_power_handler(unsigned int zone);
+		prime::api::dev::mon_cont_ret_t total_power_handler(void);
+
+		//Device functions
+		std::string discover(void);
+		unsigned int discover_cpufreq(unsigned int fu_id, boost::property_tree::ptree &units);
+		unsigned int discover_thermal(unsigned int fu_id, boost::property_tree::ptree &units);
+		unsigned int discover_hwmon(unsigned int fu_id, boost::property_tree::ptree &units);
+		unsigned int discover_powercap(unsigned int fu_id, boost::property_tree::ptree &units);
+		void add_cores(unsigned int policy, unsigned int fu_id, unsigned int su_id, boost::property_tree::ptree &unit);
+		void add_knob(boost::property_tree::ptree &node, std::string name, unsigned int id, prime::api::dev::knob_type_t type,
+			prime::api::disc_t min, prime::api::disc_t max, prime::api::disc_t init, boost::function<void(prime::api::disc_t)> handler);
+		void add_mon(boost::property_tree::ptree &node, std::string name, unsigned int id, prime::api::dev::mon_type_t type,
+			boost::function<prime::api::dev::mon_disc_ret_t(void)> handler);
+		void add_mon(boost::property_tree::ptree &node, std::string name, unsigned int id, prime::api::dev::mon_type_t type,
+			prime::api::cont_t min, prime::api::cont_t max, boost::function<prime::api::dev::mon_cont_ret_t(void)> handler);
+		void control_loop(void);
+
+		//Driver functions
+		void write_node(std::string path, std::string val);
+		double read_energy_power(energy_t &zone);
+	};
+
+	static const char *knob_type_names[] = {"PRIME_VOLT", "PRIME_FREQ", "PRIME_EN", "PRIME_PMC_CNT", "PRIME_GOVERNOR", "PRIME_FREQ_EN"};
+	static const char *mon_type_names[] = {"PRIME_POW", "PRIME_TEMP", "PRIME_CYCLES", "PRIME_PMC"};
+
+	// Same order as the odroid governor knob, schedutil added at the end.
+	static const char *governor_names[] = {"userspace", "powersave", "conservative", "ondemand", "interactive", "performance", "schedutil"};
+	#define NUM_GOVERNORS	(sizeof(governor_names) / sizeof(governor_names[0]))
+
+	/* ---------------------------------------- Sysfs helpers ---------------------------------------- */
+	static bool read_line(const std::string &path, std::string &line)
+	{
+		std::ifstream ifs(path);
+		if(!ifs.is_open() || !std::getline(ifs, line))
+			return false;
+		while(!line.empty() && (line.back() == '\n' || line.back() == ' '))
+			line.pop_back();
+		return true;
+	}
+
+	static bool exists(const std::string &path)
+	{
+		std::ifstream ifs(path);
+		return ifs.is_open();
+	}
+
+	// Trailing number of a name, e.g. 12 for "thermal_zone12".
+	static unsigned int name_index(const std::string &name)
+	{
+		std::size_t pos = name.find_last_not_of("0123456789");
+		if(pos == std::string::npos || pos + 1 == name.size())
+			return 0;
+		return std::stoul(name.substr(pos + 1));
+	}
+
+	// Entries of a directory starting with prefix, in numerical order.
+	static std::vector<std::string> list_dir(const std::string &path, const std::string &prefix)
+	{
+		std::vector<std::string> names;
+		DIR *dir = opendir(path.c_str());
+		if(!dir)
+			return names;
+		while(struct dirent *ent = readdir(dir)) {
+			std::string name(ent->d_name);
+			if(!name.compare(0, prefix.size(), prefix) && name.size() > prefix.size())
+				names.push_back(name);
+		}
+		closedir(dir);
+
+		std::sort(names.begin(), names.end(), [](const std::string &a, const std::string &b) {
+			return (a.size() != b.size()) ? a.size() < b.size() : a < b;
+		});
+		return names;
+	}
+
+	// Keys of the architecture tree must not contain the path separator.
+	static std::string sanitise(std::string name)
+	{
+		for(auto &c : name) {
+			if(!isalnum(c))
+				c = '_';
+		}
+		return name;
+	}
+
+	// CPU lists are either "0 1 2 3" (related_cpus) or "0-3,6" (online).
+	static std::vector<unsigned int> parse_cpus(const std::string &list)
+	{
+		std::vector<unsigned int> cpus;
+		std::string item;
+		std::string tmp(list);
+		std::replace(tmp.begin(), tmp.end(), ',', ' ');
+		std::istringstream iss(tmp);
+		while(iss >> item) {
+			std::size_t dash = item.find('-');
+			unsigned int first = std::stoul(item.substr(0, dash));
+			unsigned int last = (dash == std::string::npos) ? first : std::stoul(item.substr(dash + 1));
+			for(unsigned int cpu = first; cpu <= last; cpu++)
+				cpus.push_back(cpu);
+		}
+		return cpus;
+	}
+
+	/* ---------------------------------------- Device ---------------------------------------- */
+	linux_dev::linux_dev(prime::uds::socket_addrs_t *dev_rtm_addrs, prime::uds::socket_addrs_t *dev_ui_addrs, linux_args_t *linux_args) :
+		root(linux_args->sysfs_root),
+		arch_filename(linux_args->arch_filename),
+		num_cpus(0),
+		rtm_api(discover(), dev_rtm_addrs),
+		ui_api(boost::bind(&linux_dev::ui_dev_stop_handler, this), dev_ui_addrs)
+	{
+#ifdef DEBUG
+		std::cout << "Init Device:" << std::endl;
+		std::cout << "\tAdd Knobs & Monitors" << std::endl;
+#endif
+		for(auto &knob : knobs)
+			rtm_api.add_knob_disc(knob.id, knob.type, knob.min, knob.max, knob.init, knob.init, knob.handler);
+		for(auto &mon : mons_disc)
+			rtm_api.add_mon_disc(mon.id, mon.type, 0, 0, 0, mon.handler);
+		for(auto &mon : mons_cont)
+			rtm_api.add_mon_cont(mon.id, mon.type, 0, mon.min, mon.max, mon.handler);
+
+#ifdef DEBUG
+		rtm_api.print_architecture();
+		std::cout << "\tDone" << std::endl;
+#endif
+		ui_api.return_ui_dev_start();
+
+		control_loop_thread = boost::thread(&linux_dev::control_loop, this);
+		control_loop_thread.join();
+	}
+
+	linux_dev::~linux_dev()
+	{
+		rtm_api.stop();
+		for(auto &policy : policies) {
+			if(!policy.saved_governor.empty())
+				write_node(policy.path + "scaling_governor", policy.saved_governor);
+			// The frequency knob caps scaling_max_freq when there is no userspace governor.
+			if(!policy.saved_max_freq.empty())
+				write_node(policy.path + "scaling_max_freq", policy.saved_max_freq);
+		}
+		ui_api.return_ui_dev_stop();
+	}
+
+	void linux_dev::ui_dev_stop_handler(void)
+	{
+		control_loop_thread.interrupt();
+	}
+
+	void linux_dev::control_loop()
+	{
+		while(1) {
+			try {
+				boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+			}
+			catch (boost::thread_interrupted&) {
+				return;
+			}
+		}
+	}
+
+	/* ---------------------------------------- Discovery ---------------------------------------- */
+	// Build the architecture tree and write it out. Returns the file for rtm_interface to load.
+	std::string linux_dev::discover(void)
+	{
+		boost::property_tree::ptree units;
+		unsigned int fu_id = 1;		// 0 is global_monitors
+
+		fu_id = discover_cpufreq(fu_id, units);
+		fu_id = discover_thermal(fu_id, units);
+		fu_id = discover_hwmon(fu_id, units);
+		fu_id = discover_powercap(fu_id, units);
+
+		if(!total_energy.empty() || !total_sensors.empty()) {
+			boost::property_tree::ptree global, mons;
+			global.put("id", 0);
+			mons.put("id", 0);
+			add_mon(mons, "power", prime::util::set_id(0, 0, 0, 0), prime::api::dev::PRIME_POW, 0, 0,
+				boost::bind(&linux_dev::total_power_handler, this));
+			global.add_child("mons", mons);
+			units.push_front(std::make_pair("global_monitors", global));
+		}
+
+		struct utsname uts;
+		std::string machine = uname(&uts) ? "unknown" : uts.machine;
+		architecture.put("device.descriptor", "generic linux " + machine);
+		architecture.put_child("device.functional_units", units);
+
+		boost::property_tree::write_json(arch_filename, architecture);
+		return arch_filename;
+	}
+
+	// One functional unit per cpufreq policy, or a single one for all cores without cpufreq.
+	unsigned int linux_dev::discover_cpufreq(unsigned int fu_id, boost::property_tree::ptree &units)
+	{
+		std::string cpu_path = root + "/sys/devices/system/cpu/";
+		std::string line;
+
+		for(auto &name : list_dir(cpu_path, "cpu")) {
+			if(isdigit(name[3]))
+				num_cpus = std::max(num_cpus, name_index(name) + 1);
+		}
+
+		for(auto &name : list_dir(cpu_path + "cpufreq/", "policy")) {
+			policy_t policy;
+			policy.path = cpu_path + "cpufreq/" + name + "/";
+			if(!read_line(policy.path + "related_cpus", line) && !read_line(policy.path + "affected_cpus", line))
+				continue;
+			policy.cpus = parse_cpus(line);
+
+			// Without a table (e.g. intel_pstate), offer 100MHz steps between the limits.
+			if(read_line(policy.path + "scaling_available_frequencies", line)) {
+				std::istringstream iss(line);
+				unsigned long freq;
+				while(iss >> freq)
+					policy.freqs.push_back(freq);
+			} else {
+				std::string min_line, max_line;
+				if(read_line(policy.path + "cpuinfo_min_freq", min_line) && read_line(policy.path + "cpuinfo_max_freq", max_line)) {
+					unsigned long min_freq = std::stoul(min_line), max_freq = std::stoul(max_line);
+					for(unsigned long freq = min_freq; freq < max_freq; freq += 100000)
+						policy.freqs.push_back(freq);
+					policy.freqs.push_back(max_freq);
+				}
+			}
+			std::sort(policy.freqs.begin(), policy.freqs.end());
+			policy.freqs.erase(std::unique(policy.freqs.begin(), policy.freqs.end()), policy.freqs.end());
+
+			std::string available;
+			read_line(policy.path + "scaling_available_governors", available);
+			std::istringstream gov_iss(available);
+			std::vector<std::string> present((std::istream_iterator<std::string>(gov_iss)), std::istream_iterator<std::string>());
+			for(unsigned int gov = 0; gov < NUM_GOVERNORS; gov++)
+				policy.governors.push_back(std::find(present.begin(), present.end(), governor_names[gov]) != present.end() ? governor_names[gov] : "");
+			policy.userspace = !policy.governors[0].empty() && exists(policy.path + "scaling_setspeed");
+			read_line(policy.path + "scaling_governor", policy.saved_governor);
+			read_line(policy.path + "scaling_max_freq", policy.saved_max_freq);
+
+			policies.push_back(policy);
+		}
+
+		if(policies.empty() && num_cpus) {
+			policy_t policy;
+			for(unsigned int cpu = 0; cpu < num_cpus; cpu++)
+				policy.cpus.push_back(cpu);
+			policy.userspace = false;
+			policies.push_back(policy);
+		}
+
+		// Counters on every core, if the kernel lets us. Not worth registering otherwise.
+		perf_counters.reset(new prime::dev::perf::pmc_t(num_cpus, LINUX_PMCS));
+		perf_counters->open();
+
+		for(unsigned int idx = 0; idx < policies.size(); idx++) {
+			policy_t &policy = policies[idx];
+			boost::property_tree::ptree unit, unit_knobs, unit_mons;
+			unit.put("id", fu_id);
+
+			if(!policy.freqs.empty()) {
+				unit_knobs.put("id", 0);
+				prime::api::disc_t max = policy.freqs.size() - 1;
+				add_knob(unit_knobs, "freq", prime::util::set_id(fu_id, 0, 0, 0), prime::api::dev::PRIME_FREQ, 0, max, max,
+					boost::bind(&linux_dev::cpu_freq_handler, this, idx, _1));
+				add_knob(unit_knobs, "governor", prime::util::set_id(fu_id, 0, 0, 1), prime::api::dev::PRIME_GOVERNOR, 0, NUM_GOVERNORS - 1, 5,
+					boost::bind(&linux_dev::cpu_governor_handler, this, idx, _1));
+				unit.add_child("knobs", unit_knobs);
+			}
+
+			add_cores(idx, fu_id, 2, unit);
+			units.push_back(std::make_pair(policy.path.empty() ? std::string("cpu") : "cpu_policy" + std::to_string(name_index(policy.path.substr(0, policy.path.size() - 1))), unit));
+			fu_id++;
+		}
+		return fu_id;
+	}
+
+	void linux_dev::add_cores(unsigned int policy, unsigned int fu_id, unsigned int su_id, boost::property_tree::ptree &unit)
+	{
+		for(auto cpu : policies[policy].cpus) {
+			boost::property_tree::ptree core, core_knobs, core_mons;
+			core.put("id", su_id);
+			core.put("mapping", cpu);
+
+			// Counter ids as on the odroid: pmc_N and pmc_control_N are N, cycles follow.
+			if(perf_counters->is_open()) {
+				for(unsigned int pmc = 0; pmc < LINUX_PMCS; pmc++) {
+					add_knob(core_knobs, "pmc_control_" + std::to_string(pmc), prime::util::set_id(fu_id, su_id, 0, pmc),
+						prime::api::dev::PRIME_PMC_CNT, 0, 255, 0,
+						boost::bind(&linux_dev::pmc_control_handler, this, cpu, pmc, _1));
+					add_mon(core_mons, "pmc_" + std::to_string(pmc), prime::util::set_id(fu_id, su_id, 0, pmc), prime::api::dev::PRIME_PMC,
+						boost::bind(&linux_dev::pmc_handler, this, cpu, pmc));
+				}
+				add_mon(core_mons, "cycle_count", prime::util::set_id(fu_id, su_id, 0, LINUX_PMCS), prime::api::dev::PRIME_CYCLES,
+					boost::bind(&linux_dev::cycle_count_handler, this, cpu));
+			}
+			if(exists(root + "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/online")) {
+				add_knob(core_knobs, "online", prime::util::set_id(fu_id, su_id, 0, LINUX_PMCS), prime::api::dev::PRIME_EN, 0, 1, 1,
+					boost::bind(&linux_dev::cpu_online_handler, this, cpu, _1));
+			}
+
+			if(!core_knobs.empty())
+				core.add_child("knobs", core_knobs);
+			if(!core_mons.empty())
+				core.add_child("mons", core_mons);
+			unit.push_back(std::make_pair("cpu" + std::to_string(cpu), core));
+			su_id++;
+		}
+	}
+
+	unsigned int linux_dev::discover_thermal(unsigned int fu_id, boost::property_tree::ptree &units)
+	{
+		std::string thermal_path = root + "/sys/class/thermal/";
+		boost::property_tree::ptree unit, unit_mons;
+		unsigned int mon_id = 0;
+
+		unit_mons.put("id", 1);
+		for(auto &name : list_dir(thermal_path, "thermal_zone")) {
+			std::string type;
+			read_line(thermal_path + name + "/type", type);
+			std::unique_ptr<sensor_t> sensor(new sensor_t);
+			if(!sensor->node.open(thermal_path + name + "/temp"))
+				continue;
+			sensor->scale = 0.001;		// millidegrees
+			sensors.push_back(std::move(sensor));
+
+			add_mon(unit_mons, sanitise(type) + "_" + std::to_string(name_index(name)), prime::util::set_id(fu_id, 1, 0, mon_id++),
+				prime::api::dev::PRIME_TEMP, TEMP_MIN, TEMP_MAX,
+				boost::bind(&linux_dev::sensor_handler, this, sensors.size() - 1));
+		}
+		if(!mon_id)
+			return fu_id;
+
+		unit.put("id", fu_id);
+		unit.add_child("mons", unit_mons);
+		units.push_back(std::make_pair("thermal", unit));
+		return fu_id + 1;
+	}
+
+	unsigned int linux_dev::discover_hwmon(unsigned int fu_id, boost::property_tree::ptree &units)
+	{
+		std::string hwmon_path = root + "/sys/class/hwmon/";
+
+		for(auto &name : list_dir(hwmon_path, "hwmon")) {
+			std::string dev_path = hwmon_path + name + "/";
+			std::string dev_name = name;
+			read_line(dev_path + "name", dev_name);
+
+			boost::property_tree::ptree unit, unit_mons;
+			unsigned int mon_id = 0;
+			unit_mons.put("id", 1);
+
+			for(auto &input : list_dir(dev_path, "temp")) {
+				if(input.size() < 6 || input.compare(input.size() - 6, 6, "_input"))
+					continue;
+				std::unique_ptr<sensor_t> sensor(new sensor_t);
+				if(!sensor->node.open(dev_path + input))
+					continue;
+				sensor->scale = 0.001;		// millidegrees
+				sensors.push_back(std::move(sensor));
+				add_mon(unit_mons, input.substr(0, input.size() - 6), prime::util::set_id(fu_id, 1, 0, mon_id++),
+					prime::api::dev::PRIME_TEMP, TEMP_MIN, TEMP_MAX,
+					boost::bind(&linux_dev::sensor_handler, this, sensors.size() - 1));
+			}
+
+			for(auto &input : list_dir(dev_path, "power")) {
+				std::size_t sep = input.find('_');
+				if(sep == std::string::npos || (input.compare(sep, std::string::npos, "_input") && input.compare(sep, std::string::npos, "_average")))
+					continue;
+				// Some drivers have both, prefer the instantaneous reading.
+				if(!input.compare(sep, std::string::npos, "_average") && exists(dev_path + input.substr(0, sep) + "_input"))
+					continue;
+				std::unique_ptr<sensor_t> sensor(new sensor_t);
+				if(!sensor->node.open(dev_path + input))
+					continue;
+				sensor->scale = 0.000001;	// microwatts
+				sensors.push_back(std::move(sensor));
+				total_sensors.push_back(sensors.size() - 1);
+				add_mon(unit_mons, input.substr(0, sep), prime::util::set_id(fu_id, 1, 0, mon_id++),
+					prime::api::dev::PRIME_POW, 0, 0,
+					boost::bind(&linux_dev::sensor_handler, this, sensors.size() - 1));
+			}
+
+			if(!mon_id)
+				continue;
+			unit.put("id", fu_id);
+			unit.add_child("mons", unit_mons);
+			units.push_back(std::make_pair("hwmon_" + sanitise(dev_name) + "_" + std::to_string(name_index(name)), unit));
+			fu_id++;
+		}
+		return fu_id;
+	}
+
+	unsigned int linux_dev::discover_powercap(unsigned int fu_id, boost::property_tree::ptree &units)
+	{
+		std::string powercap_path = root + "/sys/class/powercap/";
+		boost::property_tree::ptree unit, unit_mons;
+		unsigned int mon_id = 0;
+
+		unit_mons.put("id", 1);
+		for(auto &name : list_dir(powercap_path, "")) {
+			std::string zone_path = powercap_path + name + "/";
+			std::string zone_name = name, range;
+			if(name[0] == '.' || !read_line(zone_path + "max_energy_range_uj", range))
+				continue;		// Not a zone, e.g. the control type directory
+			read_line(zone_path + "name", zone_name);
+
+			std::unique_ptr<energy_t> zone(new energy_t);
+			if(!zone->node.open(zone_path + "energy_uj"))
+				continue;
+			zone->max_range = std::stod(range);
+			energy.push_back(std::move(zone));
+
+			// Top-level zones (e.g. intel-rapl:0) contain their sub-zones (intel-rapl:0:0).
+			if(std::count(name.begin(), name.end(), ':') < 2)
+				total_energy.push_back(energy.size() - 1);
+
+			add_mon(unit_mons, sanitise(zone_name) + "_" + sanitise(name), prime::util::set_id(fu_id, 1, 0, mon_id++),
+				prime::api::dev::PRIME_POW, 0, 0,
+				boost::bind(&linux_dev::energy_power_handler, this, energy.size() - 1));
+		}
+		if(!mon_id)
+			return fu_id;
+
+		// Energy counters already cover every power input hwmon might also report.
+		total_sensors.clear();
+
+		unit.put("id", fu_id);
+		unit.add_child("mons", unit_mons);
+		units.push_back(std::make_pair("powercap", unit));
+		return fu_id + 1;
+	}
+
+	void linux_dev::add_knob(boost::property_tree::ptree &node, std::string name, unsigned int id, prime::api::dev::knob_type_t type,
+		prime::api::disc_t min, prime::api::disc_t max, prime::api::disc_t init, boost::function<void(prime::api::disc_t)> handler)
+	{
+		boost::property_tree::ptree knob;
+		knob.put("id", id & 0xFF);
+		knob.put("type", knob_type_names[type]);
+		node.push_back(std::make_pair(name, knob));
+
+		knob_entry_t entry = {id, type, min, max, init, handler};
+		knobs.push_back(entry);
+	}
+
+	void linux_dev::add_mon(boost::property_tree::ptree &node, std::string name, unsigned int id, prime::api::dev::mon_type_t type,
+		boost::function<prime::api::dev::mon_disc_ret_t(void)> handler)
+	{
+		boost::property_tree::ptree mon;
+		mon.put("id", id & 0xFF);
+		mon.put("type", mon_type_names[type]);
+		node.push_back(std::make_pair(name, mon));
+
+		mon_disc_entry_t entry = {id, type, handler};
+		mons_disc.push_back(entry);
+	}
+
+	void linux_dev::add_mon(boost::property_tree::ptree &node, std::string name, unsigned int id, prime::api::dev::mon_type_t type,
+		prime::api::cont_t min, prime::api::cont_t max, boost::function<prime::api::dev::mon_cont_ret_t(void)> handler)
+	{
+		boost::property_tree::ptree mon;
+		mon.put("id", id & 0xFF);
+		mon.put("type", mon_type_names[type]);
+		node.push_back(std::make_pair(name, mon));
+
+		mon_cont_entry_t entry = {id, type, min, max, handler};
+		mons_cont.push_back(entry);
+	}
+
+	/* ---------------------------------------- Handlers ---------------------------------------- */
+	// Event handler to set the frequency of a policy by index into its frequency table
+	void linux_dev::cpu_freq_handler(unsigned int policy, prime::api::disc_t val)
+	{
+		policy_t &p = policies[policy];
+		if(val < 0 || val >= (prime::api::disc_t)p.freqs.size())
+			return;
+
+		// Without the userspace governor, cap the frequency the governor may pick.
+		write_node(p.path + (p.userspace ? "scaling_setspeed" : "scaling_max_freq"), std::to_string(p.freqs[val]));
+	}
+
+	// Event handler to set the governor of a policy, ignored if the kernel does not have it
+	void linux_dev::cpu_governor_handler(unsigned int policy, prime::api::disc_t val)
+	{
+		policy_t &p = policies[policy];
+		if(val < 0 || val >= (prime::api::disc_t)p.governors.size() || p.governors[val].empty())
+			return;
+		write_node(p.path + "scaling_governor", p.governors[val]);
+	}
+
+	void linux_dev::cpu_online_handler(unsigned int cpu, prime::api::disc_t val)
+	{
+		write_node(root + "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/online", val ? "1" : "0");
+	}
+
+	void linux_dev::pmc_control_handler(unsigned int cpu, unsigned int pmc, prime::api::disc_t event)
+	{
+		perf_counters->set_event(cpu, pmc, event);
+	}
+
+	// Cycles since the last call.
+	prime::api::dev::mon_disc_ret_t linux_dev::cycle_count_handler(unsigned int cpu)
+	{
+		prime::api::dev::mon_disc_ret_t ret;
+		uint64_t cycles = perf_counters->read_cycles(cpu);
+		ret.val = (cycles < INT_MAX) ? cycles : INT_MAX;
+		ret.min = ret.max = 0;
+		return ret;
+	}
+
+	// Events since the last call.
+	prime::api::dev::mon_disc_ret_t linux_dev::pmc_handler(unsigned int cpu, unsigned int pmc)
+	{
+		prime::api::dev::mon_disc_ret_t ret;
+		uint64_t count = perf_counters->read_counter(cpu, pmc);
+		ret.val = (count < INT_MAX) ? count : INT_MAX;
+		ret.min = ret.max = 0;
+		return ret;
+	}
+
+	prime::api::dev::mon_cont_ret_t linux_dev::sensor_handler(unsigned int sensor)
+	{
+		prime::api::dev::mon_cont_ret_t ret;
+		double val;
+		ret.val = sensors[sensor]->node.read_number(val) ? val * sensors[sensor]->scale : 0;
+		return ret;
+	}
+
+	prime::api::dev::mon_cont_ret_t linux_dev::energy_power_handler(unsigned int zone)
+	{
+		prime::api::dev::mon_cont_ret_t ret;
+		energy_m.lock();
+		ret.val = read_energy_power(*energy[zone]);
+		energy_m.unlock();
+		return ret;
+	}
+
+	prime::api::dev::mon_cont_ret_t linux_dev::total_power_handler(void)
+	{
+		prime::api::dev::mon_cont_ret_t ret;
+		double total = 0, val;
+
+		energy_m.lock();
+		for(auto zone : total_energy)
+			total += read_energy_power(*energy[zone]);
+		energy_m.unlock();
+		for(auto sensor : total_sensors) {
+			if(sensors[sensor]->node.read_number(val))
+				total += val * sensors[sensor]->scale;
+		}
+		ret.val = total;
+		return ret;
+	}
+
+	/* ---------------------------------------- Driver ---------------------------------------- */
+	void linux_dev::write_node(std::string path, std::string val)
+	{
+		std::ofstream ofs(path);
+		ofs << val;
+		ofs.close();
+	}
+
+	// Average power since the previous reading of the zone, in W. Called with energy_m held.
+	double linux_dev::read_energy_power(energy_t &zone)
+	{
+		double uj;
+		if(!zone.node.read_number(uj))
+			return zone.power;
+
+		auto now = std::chrono::steady_clock::now();
+		if(zone.primed) {
+			double secs = std::chrono::duration<double>(now - zone.last_t).count();
+			if(secs * 1000 < ENERGY_WINDOW_MS)
+				return zone.power;
+			double delta = uj - zone.last_uj;
+			if(delta < 0)
+				delta += zone.max_range;		// Counter wrapped
+			zone.power = delta / 1e6 / secs;
+		}
+		zone.last_uj = uj;
+		zone.last_t = now;
+		zone.primed = true;
+		return zone.power;
+	}
+
+	int linux_dev::parse_cli(prime::uds::socket_addrs_t* api_addrs, prime::uds::socket_addrs_t* ui_addrs, linux_args_t* linux_args, int argc, const char * argv[])
+	{
+		args::ArgumentParser parser("Generic Linux Device.","PRiME Project\n");
+		args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+
+		args::Group optional(parser, "All of these arguments are optional:", args::Group::Validators::DontCare);
+		args::ValueFlag<std::string> arg_root(optional, "sysfs_root", "Directory to find sys/ in instead of /, e.g. a fake tree for testing", {'r', "sysfs_root"});
+		args::ValueFlag<std::string> arg_arch(optional, "arch", "Where to write the generated architecture file (default /tmp/dev.architecture.json)", {'a', "arch"});
+
+		UTIL_ARGS_LOGGER_PARAMS();
+
+		try {
+			parser.ParseCLI(argc, argv);
+		} catch (args::Help) {
+			std::cout << parser;
+			return -1;
+		} catch (args::ParseError e) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+			return -1;
+		} catch (args::ValidationError e) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+			return -1;
+		}
+
+		UTIL_ARGS_LOGGER_PROC();
+
+		if(arg_root)
+			linux_args->sysfs_root = args::get(arg_root);
+		if(arg_arch)
+			linux_args->arch_filename = args::get(arg_arch);
+
+		return 0;
+	}
+} }
+
+int main(int argc, const char * argv[])
+{
+	prime::uds::socket_addrs_t dev_rtm_addrs, dev_ui_addrs;
+	prime::dev::linux_dev::linux_args_t linux_args;
+	if(prime::dev::linux_dev::parse_cli(&dev_rtm_addrs, &dev_ui_addrs, &linux_args, argc, argv)) {
+		return -1;
+	}
+
+	prime::dev::linux_dev dev(&dev_rtm_addrs, &dev_ui_addrs, &linux_args);
+	return 0;
+}
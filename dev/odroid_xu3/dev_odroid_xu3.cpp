@@ -33,6 +33,9 @@
 #include "uds.h"
 #include "util.h"
 #include "prime_api_dev.h"
+#include "sysfs.h"
+#include "perf.h"
+#include "sampler.h"
 #include "args/args.hxx"
 
 //#define DEBUG
@@ -82,6 +85,29 @@ namespace prime { namespace dev
 		std::string power_node_mem = "/sys/bus/i2c/drivers/INA231/3-0041/";
 		std::string power_node_gpu = "/sys/bus/i2c/drivers/INA231/3-0044/";
 		std::string temp_node = "/sys/devices/10060000.tmu/temp";
+		std::string gpu_clock_node = "/sys/class/misc/mali0/device/clock";
+
+		// Sensor nodes, opened once at start-up
+		prime::dev::sysfs::group_t power_sensors;
+		unsigned int power_a7, power_a15, power_mem, power_gpu;
+		prime::dev::sysfs::node_t temp_sensors;
+		// Total power at a fixed rate, for the energy and windowed power monitors
+		prime::dev::sampler::power_sampler_t power_sampler;
+
+		// Cores that share a clock, from cpufreq's related_cpus. Writes go once
+		// per domain and are skipped when the value has not changed.
+		struct freq_domain_t {
+			std::vector<unsigned int> cpus;
+			prime::dev::sysfs::setting_t setspeed;
+			prime::dev::sysfs::setting_t governor;
+		};
+		std::vector<std::unique_ptr<freq_domain_t>> freq_domains;
+		std::vector<int> cpu_domain;
+		prime::dev::sysfs::setting_t gpu_clock;		// Frequency, or DVFS on/off
+
+		// Cycle and event counters of every core, read without migrating when
+		// the kernel exposes them. Otherwise the CP15 registers are used directly.
+		prime::dev::perf::pmc_t perf_counters;
 
 		//Handler functions
 		void ui_dev_stop_handler(void);
@@ -101,12 +127,14 @@ namespace prime { namespace dev
 		void control_loop(void);
 
 		//Driver functions
+		void init_freq_domains(void);
+		freq_domain_t* freq_domain(unsigned int core);
 		void set_governor(std::string governor, unsigned int idx);
 		void set_affinity(unsigned int cpu);
 		unsigned int read_cycle_count();
 		unsigned long int pmc_get_supported_events(void);
 		void enable_power(std::string filename);
-		double read_power(std::string filename);
+		double read_power(unsigned int sensor);
 		prime::api::dev::mon_cont_ret_t  total_power(void);
 		prime::api::dev::mon_cont_ret_t  a15_power(void);
 		prime::api::dev::mon_cont_ret_t  a7_power(void);
@@ -131,7 +159,9 @@ namespace prime { namespace dev
 		log_power(dev_args->power),
 		rtm_api("../build/architecture_dev.json", dev_rtm_addrs), //provide device architecture to interface
 		ui_api(boost::bind(&odroid::ui_dev_stop_handler, this), dev_ui_addrs),
-		logger_socket(prime::uds::socket_layer_t::LOGGER, dev_rtm_addrs)	//TODO: deal with this better: uses same socket as API
+		logger_socket(prime::uds::socket_layer_t::LOGGER, dev_rtm_addrs),	//TODO: deal with this better: uses same socket as API
+		power_sampler(boost::bind(&prime::dev::sysfs::group_t::sum, &power_sensors)),
+		perf_counters({4, 4, 4, 4, 6, 6, 6, 6})	// A7 cores (cpu0-3) have four counters, A15 cores (cpu4-7) six
 	{
 #ifdef DEBUG
 		std::cout << "Init Device:" << std::endl;
@@ -147,6 +177,24 @@ namespace prime { namespace dev
 		enable_power(power_node_a15);
 		enable_power(power_node_mem);
 		enable_power(power_node_gpu);
+		power_a7 = power_sensors.add(power_node_a7 + "sensor_W");
+		power_a15 = power_sensors.add(power_node_a15 + "sensor_W");
+		power_mem = power_sensors.add(power_node_mem + "sensor_W");
+		power_gpu = power_sensors.add(power_node_gpu + "sensor_W");
+		temp_sensors.open(temp_node);
+		power_sampler.start(dev_args->power_sample_us);
+
+#ifdef DEBUG
+		std::cout << "\tOpen Frequency Domains" << std::endl;
+#endif
+		init_freq_domains();
+		gpu_clock.open(gpu_clock_node);
+
+#ifdef DEBUG
+		std::cout << "\tOpen Performance Counters" << std::endl;
+#endif
+		if(!perf_counters.open())
+			std::cout << "Performance counters unavailable through perf_event, using CP15 counters" << std::endl;
 
 #ifdef DEBUG
 		std::cout << "\tAdd Knobs" << std::endl;
@@ -156,6 +204,7 @@ namespace prime { namespace dev
 		std::cout << "\tAdd Monitors" << std::endl;
 #endif			
 		add_dev_mons();
+		power_sampler.add_to(rtm_api, rtm_api.get_architecture(), "global_monitors");
 		//rtm_api.print_architecture();
 
 		auto mons_cont = rtm_api.get_cont_mons();
@@ -176,7 +225,8 @@ namespace prime { namespace dev
 
 	odroid::~odroid()
 	{
-		set_governor(a7_governor, 4);
+		rtm_api.stop();
+		set_governor(a7_governor, 0);
 		set_governor(a15_governor, 4);
 		gpu_freq_en_handler(1);
 		ui_api.return_ui_dev_stop();
@@ -578,7 +628,8 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, soc_power_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_POW, 0, 0, 0,
-			boost::bind(&odroid::total_power, this)
+			boost::bind(&odroid::total_power, this),
+			soc_power_mon.get<unsigned int>("update_us", 0)
 		);
 
 
@@ -589,7 +640,8 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, a7_power_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_POW, 0, 0, 0,
-			boost::bind(&odroid::a7_power, this)
+			boost::bind(&odroid::a7_power, this),
+			a7_power_mon.get<unsigned int>("update_us", 0)
 		);
 
 		/* ---------------------- Core 0 ---------------------- */
@@ -751,7 +803,8 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, a15_power_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_POW, 0, 0, 0,
-			boost::bind(&odroid::a15_power, this)
+			boost::bind(&odroid::a15_power, this),
+			a15_power_mon.get<unsigned int>("update_us", 0)
 		);
 
 		/* ---------------------- Core 4 ---------------------- */
@@ -809,7 +862,8 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, cpu4_temp_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_TEMP, 0, CPU_TEMP_MIN, CPU_TEMP_MAX,
-			boost::bind(&odroid::read_temp_a15_handler, this, 4)
+			boost::bind(&odroid::read_temp_a15_handler, this, 4),
+			cpu4_temp_mon.get<unsigned int>("update_us", 0)
 		);
 
 		/* ---------------------- Core 5 ---------------------- */
@@ -860,7 +914,8 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, cpu5_temp_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_TEMP, 0, CPU_TEMP_MIN, CPU_TEMP_MAX,
-			boost::bind(&odroid::read_temp_a15_handler, this, 5)
+			boost::bind(&odroid::read_temp_a15_handler, this, 5),
+			cpu5_temp_mon.get<unsigned int>("update_us", 0)
 		);
 
 		/* ---------------------- Core 6 ---------------------- */
@@ -911,7 +966,8 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, cpu6_temp_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_TEMP, 0, CPU_TEMP_MIN, CPU_TEMP_MAX,
-			boost::bind(&odroid::read_temp_a15_handler, this, 6)
+			boost::bind(&odroid::read_temp_a15_handler, this, 6),
+			cpu6_temp_mon.get<unsigned int>("update_us", 0)
 		);
 
 		/* ---------------------- Core 7 ---------------------- */
@@ -962,7 +1018,8 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, cpu7_temp_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_TEMP, 0, CPU_TEMP_MIN, CPU_TEMP_MAX,
-			boost::bind(&odroid::read_temp_a15_handler, this, 7)
+			boost::bind(&odroid::read_temp_a15_handler, this, 7),
+			cpu7_temp_mon.get<unsigned int>("update_us", 0)
 		);
 
 
@@ -974,14 +1031,16 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, gpu_power_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_POW, 0, 0, 0,
-			boost::bind(&odroid::gpu_power, this)
+			boost::bind(&odroid::gpu_power, this),
+			gpu_power_mon.get<unsigned int>("update_us", 0)
 		);
 
 		boost::property_tree::ptree gpu_temp_mon = architecture.get_child("device.functional_units.gpu.mons.temp");
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, gpu_temp_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_TEMP, 0, GPU_TEMP_MIN, GPU_TEMP_MAX,
-			boost::bind(&odroid::read_temp_gpu_handler, this)
+			boost::bind(&odroid::read_temp_gpu_handler, this),
+			gpu_temp_mon.get<unsigned int>("update_us", 0)
 		);
 
 
@@ -992,7 +1051,8 @@ namespace prime { namespace dev
 		rtm_api.add_mon_cont(
 			prime::util::set_id(fu_id, su_id, 0, mem_power_mon.get<unsigned int>("id")),
 			prime::api::dev::PRIME_POW, 0, 0, 0,
-			boost::bind(&odroid::mem_power, this)
+			boost::bind(&odroid::mem_power, this),
+			mem_power_mon.get<unsigned int>("update_us", 0)
 		);
 	}
 
@@ -1013,25 +1073,59 @@ namespace prime { namespace dev
 		}
 	}
 
+	// Utility function to group the cores into frequency domains
+	void odroid::init_freq_domains(void)
+	{
+		cpu_domain.assign(8, -1);
+
+		for(unsigned int cpu = 0; cpu < 8; cpu++) {
+			if(cpu_domain[cpu] >= 0)
+				continue;
+
+			std::unique_ptr<freq_domain_t> domain(new freq_domain_t);
+			std::ifstream ifs("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/related_cpus");
+			unsigned int related;
+			while(ifs >> related) {
+				if(related < 8 && cpu_domain[related] < 0)
+					domain->cpus.push_back(related);
+			}
+			if(domain->cpus.empty()) {
+				// Core offline or no cpufreq: fall back to the A7 and A15 clusters.
+				for(unsigned int core = (cpu < 4) ? 0 : 4; core < ((cpu < 4) ? 4 : 8); core++) {
+					if(cpu_domain[core] < 0)
+						domain->cpus.push_back(core);
+				}
+			}
+
+			std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/";
+			domain->setspeed.open(path + "scaling_setspeed");
+			domain->governor.open(path + "scaling_governor");
+			for(auto core : domain->cpus)
+				cpu_domain[core] = freq_domains.size();
+			freq_domains.push_back(std::move(domain));
+		}
+	}
+
+	// Utility function to get the frequency domain of a core
+	odroid::freq_domain_t* odroid::freq_domain(unsigned int core)
+	{
+		if(core >= cpu_domain.size() || cpu_domain[core] < 0)
+			return NULL;
+		return freq_domains[cpu_domain[core]].get();
+	}
+
 	// Utility function to set CPU Governor
 	void odroid::set_governor(std::string governor, unsigned int idx)
 	{
-		std::string path;
-
-		if ((idx >= 0) && (idx <= 3)) {
-			// A7
-			path = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor";
-		} else if ((idx >= 4) && (idx <= 7)) {
-			// A15
-			path = "/sys/devices/system/cpu/cpu4/cpufreq/scaling_governor";
-		} else {
-			// out of range
+		freq_domain_t *domain = freq_domain(idx);
+		if(!domain || governor.empty())
 			return;
-		}
 
-		std::ofstream ofs(path);
-		ofs << governor;
-		ofs.close();
+		if(domain->governor.holds(governor))
+			return;
+		domain->governor.set(governor);
+		// The new governor may have moved the frequency away from the last one set.
+		domain->setspeed.invalidate();
 	}
 
 	// Utility function to get CPU Governor
@@ -1070,11 +1164,10 @@ namespace prime { namespace dev
 			return;
 		}
 
-		std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(core) + "/cpufreq/scaling_setspeed";
-		//std::cout << path << "   " << freq << std::endl;
-		std::ofstream ofs(path);
-		ofs << freq;
-		ofs.close();
+		// One write for every core in the domain, none if it already runs at freq.
+		freq_domain_t *domain = freq_domain(core);
+		if(domain)
+			domain->setspeed.set(std::to_string(freq));
 	}
 
 	// Event handler to set the CPU governor
@@ -1124,26 +1217,20 @@ namespace prime { namespace dev
 			default: freq = 600;
 		}
 
-		std::string path = "/sys/class/misc/mali0/device/clock";
-		std::ofstream ofs(path);
-		ofs << freq;
-		ofs.close();
+		gpu_clock.set(std::to_string(freq));
 	}
 
 	// Event handler to enable/disable GPU frequency control.
 	void odroid::gpu_freq_en_handler(prime::api::disc_t val)
 	{
 		// 0 = manual control. 1 (or any other value) = automatic DVFS.
-		std::string path = "/sys/class/misc/mali0/device/clock";
-		std::ofstream ofs(path);
 		if(val) {
 			// Set automatic control
-			ofs << "1";
+			gpu_clock.set("1");
 		} else {
 			// Set manual control
-			ofs << "0";
+			gpu_clock.set("0");
 		}
-		ofs.close();
 	}
 
 	// Utility function to set cpu affinity
@@ -1163,6 +1250,12 @@ namespace prime { namespace dev
 		prime::api::dev::mon_disc_ret_t ret;
 		ccount = 0;
 
+		if(perf_counters.is_open()) {
+			ret.val = perf_counters.read_cycles(core);
+			ret.min = ret.max = 0;
+			return ret;
+		}
+
 		set_affinity(core);		// Make sure we are on the correct core.
 
 		// Get cycle count from PMC
@@ -1181,6 +1274,12 @@ namespace prime { namespace dev
 		prime::api::dev::mon_disc_ret_t ret;
 		pcount = 0;
 
+		if(perf_counters.is_open()) {
+			ret.val = perf_counters.read_counter(core, pmc);
+			ret.min = ret.max = 0;
+			return ret;
+		}
+
 		set_affinity(core);		// Make sure we are on the correct core.
 
 		// Select the correct PMC in PMSELR
@@ -1198,6 +1297,11 @@ namespace prime { namespace dev
 	// Event handler when RTM sets PMC control knob
 	void odroid::pmc_control_handler(unsigned int core, unsigned int pmc, unsigned int event)
 	{
+		if(perf_counters.is_open()) {
+			perf_counters.set_event(core, pmc, event);
+			return;
+		}
+
 		set_affinity(core);		// Make sure we are on the correct core.
 
 		// Select the correct PMC in PMSELR
@@ -1236,20 +1340,16 @@ namespace prime { namespace dev
 	}
 
 	// Utility function to read power sensors
-	double odroid::read_power(std::string filename)
+	double odroid::read_power(unsigned int sensor)
 	{
-		std::ifstream ifs(filename + "sensor_W");
-		double power;
-		ifs >> power;
-		ifs.close();
-		return power;
+		return power_sensors.read(sensor);
 	}
 
 	// Utility function to read power sensors
 	prime::api::dev::mon_cont_ret_t odroid::total_power()
 	{
 		prime::api::dev::mon_cont_ret_t ret;
-		ret.val = read_power(power_node_a7) + read_power(power_node_a15) + read_power(power_node_mem) + read_power(power_node_gpu);
+		ret.val = power_sensors.sum();
 		return ret;
 	}
 
@@ -1257,14 +1357,14 @@ namespace prime { namespace dev
 	prime::api::dev::mon_cont_ret_t  odroid::a15_power()
 	{
 		prime::api::dev::mon_cont_ret_t ret;
-		ret.val = read_power(power_node_a15);
+		ret.val = read_power(power_a15);
 		return ret;
 	}
 	// Utility function to read power sensors
 	prime::api::dev::mon_cont_ret_t  odroid::a7_power()
 	{
 		prime::api::dev::mon_cont_ret_t ret;
-		ret.val = read_power(power_node_a7);
+		ret.val = read_power(power_a7);
 		return ret;
 	}
 
@@ -1272,7 +1372,7 @@ namespace prime { namespace dev
 	prime::api::dev::mon_cont_ret_t  odroid::gpu_power()
 	{
 		prime::api::dev::mon_cont_ret_t ret;
-		ret.val = read_power(power_node_gpu);
+		ret.val = read_power(power_gpu);
 		return ret;
 	}
 
@@ -1280,7 +1380,7 @@ namespace prime { namespace dev
 	prime::api::dev::mon_cont_ret_t  odroid::mem_power()
 	{
 		prime::api::dev::mon_cont_ret_t ret;
-		ret.val = read_power(power_node_mem);
+		ret.val = read_power(power_mem);
 		return ret;
 	}
 
@@ -1295,16 +1395,12 @@ namespace prime { namespace dev
 			ret.val = ret.min = ret.max = 0;
 			return ret;
 		} else {
-			core = core - 3;
-			std::ifstream ifs(temp_node);
-			std::string name, tmp, temperature;
-			for(int i=0;i<core;i++){
-				ifs >> name;
-				ifs >> tmp;
-				ifs >> temperature;
-			}
-			ifs.close();
-			ret.val = stof(temperature)/1000;
+			// One line per sensor: four A15 cores, then the GPU
+			double temps[5];
+			if(temp_sensors.read_numbers(temps, 5) < (unsigned int)(core - 3))
+				ret.val = 0;
+			else
+				ret.val = temps[core - 4]/1000;
 			ret.min = CPU_TEMP_MIN;
 			ret.max = CPU_TEMP_MAX;
 			
@@ -1317,15 +1413,11 @@ namespace prime { namespace dev
 	{
 		prime::api::dev::mon_cont_ret_t ret;
 		
-		std::ifstream ifs(temp_node);
-		std::string name, tmp, temperature;
-		for(int i=0;i<5;i++){
-			ifs >> name;
-			ifs >> tmp;
-			ifs >> temperature;
-		}
-		ifs.close();
-		ret.val = stof(temperature)/1000;
+		double temps[5];
+		if(temp_sensors.read_numbers(temps, 5) < 5)
+			ret.val = 0;
+		else
+			ret.val = temps[4]/1000;
 		ret.min = GPU_TEMP_MIN;
 		ret.max = GPU_TEMP_MAX;
 		
@@ -0,0 +1,709 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech & Graeme Bragg
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cmath>
+#include <climits>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "uds.h"
+#include "util.h"
+#include "prime_api_dev.h"
+#include "sampler.h"
+#include "args/args.hxx"
+
+//#define DEBUG
+
+#define CPU_TEMP_MIN	0
+#define CPU_TEMP_MAX	100
+
+// Host load is re-sampled at most this often, in real time
+#define HOST_LOAD_PERIOD_MS	100
+
+/* Simulated device.
+ *
+ * Exposes every knob and monitor of an architecture file, as the real
+ * device for that architecture would, with the readings produced by
+ * analytical models instead of hardware. Each functional unit is a DVFS
+ * domain whose cores are the sub-units with a "mapping":
+ *
+ *   power        P = C * V^2 * f * util + leak * V * (1 + leak_temp * (T - ambient))
+ *   temperature  first-order RC: T -> ambient + P * r_th with time constant r_th * c_th
+ *   cycles       f * util per core
+ *   PMCs         cycles * the rate the model gives the programmed event
+ *
+ * util is the load of the host CPU a core is mapped to, or a fixed value.
+ * Units without cores run at a fixed activity factor. Model parameters come
+ * from a JSON file, per unit name with defaults for anything not given.
+ *
+ * Time is simulated in fixed steps and can run faster than real time, so
+ * RTM control loops can be exercised without the hardware. The energy and
+ * power statistics monitors sample the simulated total power in real time,
+ * so at a speed other than 1 they are per real second.
+ */
+
+namespace prime { namespace dev
+{
+	class test
+	{
+	public:
+		struct sim_args_t {
+			std::string arch_filename = "../build/architecture_dev.json";
+			std::string model_filename = "../build/model_dev.json";
+			double speed = 1;		// Simulated seconds per real second, 0 for unthrottled
+			unsigned int power_sample_us = 10000;
+		};
+
+		test(prime::uds::socket_addrs_t *dev_rtm_addrs, prime::uds::socket_addrs_t *dev_ui_addrs, sim_args_t *sim_args);
+		~test();
+
+		static int parse_cli(prime::uds::socket_addrs_t* api_addrs, prime::uds::socket_addrs_t* ui_addrs, sim_args_t* sim_args, int argc, const char * argv[]);
+
+	private:
+		struct core_t {
+			unsigned int host_cpu;
+			double util = 0;
+			double cycles = 0;					// Since the last cycle count read
+			std::vector<unsigned int> events;	// Programmed event of each PMC
+			std::vector<double> counts;			// Since the last read of each PMC
+		};
+
+		struct unit_t {
+			std::string name;
+			bool total = false;		// Reports the sum of every other unit
+
+			// Model parameters
+			std::vector<double> freqs;		// MHz
+			std::vector<double> volts;
+			double cap, leak, leak_temp, r_th, c_th, activity;
+			std::map<unsigned int, double> event_rates;		// Events per cycle
+
+			// Knob state
+			prime::api::disc_t freq_idx;
+			prime::api::disc_t governor = 5;
+			bool freq_auto = true;
+			bool enabled = true;
+			double volt = -1;		// Set through a PRIME_VOLT knob, otherwise from the OPP
+
+			// Model state
+			double power = 0;
+			double temp;
+			std::vector<core_t> cores;
+		};
+
+		prime::api::dev::rtm_interface rtm_api;
+		prime::api::dev::ui_interface ui_api;
+
+		boost::property_tree::ptree model;
+		double step;			// Seconds
+		double speed;
+		double ambient;
+		double fixed_load;		// Negative to follow the host
+		std::vector<unit_t> units;
+		double sim_power = 0;	// Sum over the units, last step
+		std::mutex sim_m;
+		// Total power at a fixed rate, for the energy and windowed power monitors
+		prime::dev::sampler::power_sampler_t power_sampler;
+
+		std::vector<unsigned long long> host_busy, host_total;
+		std::vector<double> host_util;
+		std::chrono::steady_clock::time_point host_sampled;
+
+		boost::thread sim_loop_thread;
+
+		//Handler functions
+		void ui_dev_stop_handler(void);
+		void knob_disc_handler(unsigned int unit, prime::api::dev::knob_type_t type, prime::api::disc_t val);
+		void knob_cont_handler(unsigned int unit, prime::api::dev::knob_type_t type, prime::api::cont_t val);
+		void pmc_control_handler(unsigned int unit, unsigned int core, unsigned int pmc, prime::api::disc_t event);
+		prime::api::dev::mon_cont_ret_t power_handler(unsigned int unit);
+		double total_power(void);
+		prime::api::dev::mon_cont_ret_t temp_handler(unsigned int unit);
+		prime::api::dev::mon_disc_ret_t cycle_count_handler(unsigned int unit, unsigned int core);
+		prime::api::dev::mon_disc_ret_t pmc_handler(unsigned int unit, unsigned int core, unsigned int pmc);
+
+		//Device functions
+		void load_model(void);
+		void add_unit(std::string name, boost::property_tree::ptree &unit_node);
+		void add_knobs(unsigned int unit, unsigned int fu_id, unsigned int su_id, int core, boost::property_tree::ptree &knobs_node);
+		void add_mons(unsigned int unit, unsigned int fu_id, unsigned int su_id, int core, boost::property_tree::ptree &mons_node);
+		void sim_loop(void);
+		void sim_step(double dt);
+
+		//Model functions
+		double param(boost::property_tree::ptree &unit_cfg, std::string key, double def);
+		std::vector<double> param_list(boost::property_tree::ptree &unit_cfg, std::string key);
+		unsigned int opp(unit_t &unit);
+		void sample_host_load(void);
+		static unsigned int trailing_index(const std::string &name);
+	};
+
+	static bool knob_type(const std::string &str, prime::api::dev::knob_type_t &type)
+	{
+		if(str == "PRIME_VOLT")				type = prime::api::dev::PRIME_VOLT;
+		else if(str == "PRIME_FREQ")		type = prime::api::dev::PRIME_FREQ;
+		else if(str == "PRIME_EN")			type = prime::api::dev::PRIME_EN;
+		else if(str == "PRIME_PMC_CNT")		type = prime::api::dev::PRIME_PMC_CNT;
+		else if(str == "PRIME_GOVERNOR")	type = prime::api::dev::PRIME_GOVERNOR;
+		else if(str == "PRIME_FREQ_EN")		type = prime::api::dev::PRIME_FREQ_EN;
+		else return false;
+		return true;
+	}
+
+	static bool mon_type(const std::string &str, prime::api::dev::mon_type_t &type)
+	{
+		if(str == "PRIME_POW")				type = prime::api::dev::PRIME_POW;
+		else if(str == "PRIME_TEMP")		type = prime::api::dev::PRIME_TEMP;
+		else if(str == "PRIME_CYCLES")		type = prime::api::dev::PRIME_CYCLES;
+		else if(str == "PRIME_PMC")			type = prime::api::dev::PRIME_PMC;
+		else return false;
+		return true;
+	}
+
+	test::test(prime::uds::socket_addrs_t *dev_rtm_addrs, prime::uds::socket_addrs_t *dev_ui_addrs, sim_args_t *sim_args) :
+		rtm_api(sim_args->arch_filename, dev_rtm_addrs),
+		ui_api(boost::bind(&test::ui_dev_stop_handler, this), dev_ui_addrs),
+		speed(sim_args->speed),
+		power_sampler(boost::bind(&test::total_power, this))
+	{
+#ifdef DEBUG
+		std::cout << "Init Device:" << std::endl;
+		std::cout << "\tLoad Model" << std::endl;
+#endif
+		boost::property_tree::read_json(sim_args->model_filename, model);
+		load_model();
+
+#ifdef DEBUG
+		std::cout << "\tAdd Knobs & Monitors" << std::endl;
+#endif
+		boost::property_tree::ptree architecture = rtm_api.get_architecture();
+		for(auto &fu : architecture.get_child("device.functional_units"))
+			add_unit(fu.first, fu.second);
+
+		sample_host_load();
+		power_sampler.start(sim_args->power_sample_us);
+		for(auto &fu : architecture.get_child("device.functional_units"))
+			power_sampler.add_to(rtm_api, architecture, fu.first);
+
+#ifdef DEBUG
+		std::cout << "\tDone" << std::endl;
+#endif
+		ui_api.return_ui_dev_start();
+
+		sim_loop_thread = boost::thread(&test::sim_loop, this);
+		sim_loop_thread.join();
+	}
+
+	test::~test()
+	{
+		rtm_api.stop();
+		power_sampler.stop();
+		ui_api.return_ui_dev_stop();
+	}
+
+	void test::ui_dev_stop_handler(void)
+	{
+		sim_loop_thread.interrupt();
+	}
+
+	/* ---------------------------------------- Setup ---------------------------------------- */
+	void test::load_model(void)
+	{
+		step = model.get<double>("model.step_ms", 10) / 1000;
+		ambient = model.get<double>("model.ambient", 25);
+		std::string load = model.get<std::string>("model.load", "host");
+		fixed_load = (load == "host") ? -1 : std::stod(load);
+	}
+
+	double test::param(boost::property_tree::ptree &unit_cfg, std::string key, double def)
+	{
+		boost::optional<double> val = unit_cfg.get_optional<double>(key);
+		if(val)
+			return *val;
+		return model.get<double>("model.default." + key, def);
+	}
+
+	std::vector<double> test::param_list(boost::property_tree::ptree &unit_cfg, std::string key)
+	{
+		std::vector<double> vals;
+		boost::optional<boost::property_tree::ptree&> list = unit_cfg.get_child_optional(key);
+		if(!list)
+			list = model.get_child_optional("model.default." + key);
+		if(list) {
+			for(auto &item : *list)
+				vals.push_back(item.second.get_value<double>());
+		}
+		return vals;
+	}
+
+	// Index at the end of a knob or monitor name, e.g. 2 for "pmc_control_2".
+	unsigned int test::trailing_index(const std::string &name)
+	{
+		std::size_t pos = name.find_last_of('_');
+		if(pos == std::string::npos)
+			return 0;
+		try {
+			return std::stoul(name.substr(pos + 1));
+		} catch(std::exception &e) {
+			return 0;
+		}
+	}
+
+	void test::add_unit(std::string name, boost::property_tree::ptree &unit_node)
+	{
+		boost::property_tree::ptree empty;
+		boost::optional<boost::property_tree::ptree&> unit_cfg_opt = model.get_child_optional("model.units." + name);
+		boost::property_tree::ptree &unit_cfg = unit_cfg_opt ? *unit_cfg_opt : empty;
+
+		unit_t unit;
+		unit.name = name;
+		unit.total = unit_cfg.get<bool>("total", false);
+		unit.freqs = param_list(unit_cfg, "freqs");
+		unit.volts = param_list(unit_cfg, "volts");
+		if(unit.freqs.empty())
+			unit.freqs.push_back(1000);
+		unit.volts.resize(unit.freqs.size(), unit.volts.empty() ? 1.0 : unit.volts.back());
+		unit.cap = param(unit_cfg, "cap", 0.2e-9);
+		unit.leak = param(unit_cfg, "leak", 0.05);
+		unit.leak_temp = param(unit_cfg, "leak_temp", 0.015);
+		unit.r_th = param(unit_cfg, "r_th", 4);
+		unit.c_th = param(unit_cfg, "c_th", 2);
+		unit.activity = param(unit_cfg, "activity", 0.5);
+		unit.freq_idx = unit.freqs.size() - 1;
+		unit.temp = ambient;
+
+		boost::optional<boost::property_tree::ptree&> events = unit_cfg.get_child_optional("events");
+		if(!events)
+			events = model.get_child_optional("model.default.events");
+		if(events) {
+			for(auto &event : *events)
+				unit.event_rates[std::stoul(event.first)] = event.second.get_value<double>();
+		}
+
+		units.push_back(unit);
+		unsigned int unit_idx = units.size() - 1;
+		unsigned int fu_id = unit_node.get<unsigned int>("id");
+
+		for(auto &child : unit_node) {
+			if(child.first == "knobs") {
+				add_knobs(unit_idx, fu_id, child.second.get<unsigned int>("id", 0), -1, child.second);
+			} else if(child.first == "mons") {
+				add_mons(unit_idx, fu_id, child.second.get<unsigned int>("id", 0), -1, child.second);
+			} else if(child.second.count("mapping")) {
+				// A core: knobs and monitors are addressed by the core's own id
+				core_t core;
+				core.host_cpu = child.second.get<unsigned int>("mapping");
+				units[unit_idx].cores.push_back(core);
+				int core_idx = units[unit_idx].cores.size() - 1;
+				unsigned int su_id = child.second.get<unsigned int>("id");
+
+				boost::optional<boost::property_tree::ptree&> knobs = child.second.get_child_optional("knobs");
+				if(knobs)
+					add_knobs(unit_idx, fu_id, su_id, core_idx, *knobs);
+				boost::optional<boost::property_tree::ptree&> mons = child.second.get_child_optional("mons");
+				if(mons)
+					add_mons(unit_idx, fu_id, su_id, core_idx, *mons);
+			}
+		}
+	}
+
+	void test::add_knobs(unsigned int unit, unsigned int fu_id, unsigned int su_id, int core, boost::property_tree::ptree &knobs_node)
+	{
+		unit_t &u = units[unit];
+		prime::api::disc_t max_opp = u.freqs.size() - 1;
+
+		for(auto &knob : knobs_node) {
+			prime::api::dev::knob_type_t type;
+			if(!knob_type(knob.second.get<std::string>("type", ""), type))
+				continue;
+			unsigned int id = prime::util::set_id(fu_id, su_id, 0, knob.second.get<unsigned int>("id"));
+
+			switch(type) {
+			case prime::api::dev::PRIME_VOLT:
+				rtm_api.add_knob_cont(id, type, u.volts.front(), u.volts.back(), u.volts.back(), u.volts.back(),
+					boost::bind(&test::knob_cont_handler, this, unit, type, _1));
+				break;
+			case prime::api::dev::PRIME_FREQ:
+				rtm_api.add_knob_disc(id, type, 0, max_opp, max_opp, max_opp,
+					boost::bind(&test::knob_disc_handler, this, unit, type, _1));
+				break;
+			case prime::api::dev::PRIME_GOVERNOR:
+				rtm_api.add_knob_disc(id, type, 0, 5, 5, 5,
+					boost::bind(&test::knob_disc_handler, this, unit, type, _1));
+				break;
+			case prime::api::dev::PRIME_EN:
+			case prime::api::dev::PRIME_FREQ_EN:
+				rtm_api.add_knob_disc(id, type, 0, 1, 1, 1,
+					boost::bind(&test::knob_disc_handler, this, unit, type, _1));
+				break;
+			case prime::api::dev::PRIME_PMC_CNT:
+				if(core < 0)
+					break;
+				{
+					unsigned int pmc = trailing_index(knob.first);
+					core_t &c = u.cores[core];
+					if(c.events.size() <= pmc) {
+						c.events.resize(pmc + 1, 0);
+						c.counts.resize(pmc + 1, 0);
+					}
+					rtm_api.add_knob_disc(id, type, 0, 255, 0, 0,
+						boost::bind(&test::pmc_control_handler, this, unit, core, pmc, _1));
+				}
+				break;
+			case prime::api::dev::PRIME_WINDOW:
+			case prime::api::dev::PRIME_PERCENTILE:
+			case prime::api::dev::PRIME_MARKER:
+				break;		// Registered by the power sampler
+			}
+		}
+	}
+
+	void test::add_mons(unsigned int unit, unsigned int fu_id, unsigned int su_id, int core, boost::property_tree::ptree &mons_node)
+	{
+		for(auto &mon : mons_node) {
+			prime::api::dev::mon_type_t type;
+			if(!mon_type(mon.second.get<std::string>("type", ""), type))
+				continue;
+			unsigned int id = prime::util::set_id(fu_id, su_id, 0, mon.second.get<unsigned int>("id"));
+			unsigned int update_us = mon.second.get<unsigned int>("update_us", 0);
+
+			switch(type) {
+			case prime::api::dev::PRIME_POW:
+				rtm_api.add_mon_cont(id, type, 0, 0, 0, boost::bind(&test::power_handler, this, unit), update_us);
+				break;
+			case prime::api::dev::PRIME_TEMP:
+				rtm_api.add_mon_cont(id, type, 0, CPU_TEMP_MIN, CPU_TEMP_MAX, boost::bind(&test::temp_handler, this, unit), update_us);
+				break;
+			case prime::api::dev::PRIME_CYCLES:
+				if(core >= 0)
+					rtm_api.add_mon_disc(id, type, 0, 0, 0, boost::bind(&test::cycle_count_handler, this, unit, core), update_us);
+				break;
+			case prime::api::dev::PRIME_PMC:
+				if(core >= 0) {
+					unsigned int pmc = trailing_index(mon.first);
+					core_t &c = units[unit].cores[core];
+					if(c.events.size() <= pmc) {
+						c.events.resize(pmc + 1, 0);
+						c.counts.resize(pmc + 1, 0);
+					}
+					rtm_api.add_mon_disc(id, type, 0, 0, 0, boost::bind(&test::pmc_handler, this, unit, core, pmc), update_us);
+				}
+				break;
+			case prime::api::dev::PRIME_ENERGY:
+			case prime::api::dev::PRIME_ENERGY_SINCE:
+			case prime::api::dev::PRIME_POW_MEAN:
+			case prime::api::dev::PRIME_POW_MIN:
+			case prime::api::dev::PRIME_POW_MAX:
+			case prime::api::dev::PRIME_POW_PCTL:
+				break;		// Registered by the power sampler
+			}
+		}
+	}
+
+	/* ---------------------------------------- Handlers ---------------------------------------- */
+	void test::knob_disc_handler(unsigned int unit, prime::api::dev::knob_type_t type, prime::api::disc_t val)
+	{
+		sim_m.lock();
+		unit_t &u = units[unit];
+		switch(type) {
+		case prime::api::dev::PRIME_FREQ:
+			if(val >= 0 && val < (prime::api::disc_t)u.freqs.size())
+				u.freq_idx = val;
+			break;
+		case prime::api::dev::PRIME_GOVERNOR:
+			u.governor = val;
+			break;
+		case prime::api::dev::PRIME_FREQ_EN:
+			u.freq_auto = val;
+			break;
+		case prime::api::dev::PRIME_EN:
+			u.enabled = val;
+			break;
+		default:
+			break;
+		}
+		sim_m.unlock();
+	}
+
+	// Every PRIME_VOLT knob of a unit sets the voltage of its one supply.
+	void test::knob_cont_handler(unsigned int unit, prime::api::dev::knob_type_t type, prime::api::cont_t val)
+	{
+		if(type != prime::api::dev::PRIME_VOLT)
+			return;
+		sim_m.lock();
+		units[unit].volt = val;
+		sim_m.unlock();
+	}
+
+	void test::pmc_control_handler(unsigned int unit, unsigned int core, unsigned int pmc, prime::api::disc_t event)
+	{
+		sim_m.lock();
+		core_t &c = units[unit].cores[core];
+		c.events[pmc] = event;
+		c.counts[pmc] = 0;
+		sim_m.unlock();
+	}
+
+	prime::api::dev::mon_cont_ret_t test::power_handler(unsigned int unit)
+	{
+		prime::api::dev::mon_cont_ret_t ret;
+		sim_m.lock();
+		ret.val = units[unit].power;
+		sim_m.unlock();
+		return ret;
+	}
+
+	double test::total_power(void)
+	{
+		sim_m.lock();
+		double power = sim_power;
+		sim_m.unlock();
+		return power;
+	}
+
+	prime::api::dev::mon_cont_ret_t test::temp_handler(unsigned int unit)
+	{
+		prime::api::dev::mon_cont_ret_t ret;
+		sim_m.lock();
+		ret.val = units[unit].temp;
+		sim_m.unlock();
+		ret.min = CPU_TEMP_MIN;
+		ret.max = CPU_TEMP_MAX;
+		return ret;
+	}
+
+	// Cycles since the last call, as the hardware counter with reset-on-read.
+	prime::api::dev::mon_disc_ret_t test::cycle_count_handler(unsigned int unit, unsigned int core)
+	{
+		prime::api::dev::mon_disc_ret_t ret;
+		sim_m.lock();
+		core_t &c = units[unit].cores[core];
+		ret.val = (c.cycles < INT_MAX) ? c.cycles : INT_MAX;
+		c.cycles = 0;
+		sim_m.unlock();
+		ret.min = ret.max = 0;
+		return ret;
+	}
+
+	prime::api::dev::mon_disc_ret_t test::pmc_handler(unsigned int unit, unsigned int core, unsigned int pmc)
+	{
+		prime::api::dev::mon_disc_ret_t ret;
+		sim_m.lock();
+		core_t &c = units[unit].cores[core];
+		ret.val = (c.counts[pmc] < INT_MAX) ? c.counts[pmc] : INT_MAX;
+		c.counts[pmc] = 0;
+		sim_m.unlock();
+		ret.min = ret.max = 0;
+		return ret;
+	}
+
+	/* ---------------------------------------- Model ---------------------------------------- */
+	// Operating point the unit runs at. As on the Odroid, PRIME_FREQ_EN 0 is
+	// manual control and the frequency knob applies; otherwise the governor
+	// decides, settling where it would under full load.
+	unsigned int test::opp(unit_t &unit)
+	{
+		if(!unit.freq_auto)
+			return unit.freq_idx;
+		switch(unit.governor) {
+		case 0:	return unit.freq_idx;		// userspace
+		case 1:	return 0;					// powersave
+		default: return unit.freqs.size() - 1;
+		}
+	}
+
+	void test::sample_host_load(void)
+	{
+		std::ifstream ifs("/proc/stat");
+		std::string line;
+		std::vector<unsigned long long> busy, total;
+
+		while(std::getline(ifs, line)) {
+			// Per-CPU lines only: "cpuN user nice system idle iowait irq softirq steal"
+			if(line.compare(0, 3, "cpu") || line.size() < 4 || line[3] < '0' || line[3] > '9')
+				continue;
+			std::istringstream iss(line.substr(line.find(' ')));
+			unsigned long long val, sum = 0, idle = 0;
+			for(unsigned int field = 0; field < 8 && (iss >> val); field++) {
+				sum += val;
+				if(field == 3 || field == 4)
+					idle += val;
+			}
+			busy.push_back(sum - idle);
+			total.push_back(sum);
+		}
+
+		host_util.resize(busy.size(), 0);
+		if(host_busy.size() == busy.size()) {
+			for(std::size_t cpu = 0; cpu < busy.size(); cpu++) {
+				unsigned long long d_total = total[cpu] - host_total[cpu];
+				if(d_total)
+					host_util[cpu] = (double)(busy[cpu] - host_busy[cpu]) / d_total;
+			}
+		}
+		host_busy = busy;
+		host_total = total;
+		host_sampled = std::chrono::steady_clock::now();
+	}
+
+	void test::sim_step(double dt)
+	{
+		double total_power = 0;
+
+		for(auto &unit : units) {
+			if(unit.total)
+				continue;
+
+			unsigned int idx = opp(unit);
+			double freq = unit.freqs[idx] * 1e6;
+			double volt = (unit.volt >= 0) ? unit.volt : unit.volts[idx];
+			double dynamic = 0, leakage = 0;
+
+			if(unit.enabled) {
+				if(unit.cores.empty()) {
+					dynamic = unit.cap * volt * volt * freq * unit.activity;
+				}
+				for(auto &core : unit.cores) {
+					if(fixed_load >= 0)
+						core.util = fixed_load;
+					else if(!host_util.empty())
+						core.util = host_util[core.host_cpu % host_util.size()];
+
+					double cycles = freq * core.util * dt;
+					dynamic += unit.cap * volt * volt * freq * core.util;
+					core.cycles += cycles;
+					for(std::size_t pmc = 0; pmc < core.events.size(); pmc++) {
+						auto rate = unit.event_rates.find(core.events[pmc]);
+						if(rate != unit.event_rates.end())
+							core.counts[pmc] += cycles * rate->second;
+					}
+				}
+				leakage = unit.leak * volt * (1 + unit.leak_temp * (unit.temp - ambient));
+				if(leakage < 0)
+					leakage = 0;
+			}
+
+			unit.power = dynamic + leakage;
+			double steady = ambient + unit.power * unit.r_th;
+			unit.temp += (steady - unit.temp) * (1 - std::exp(-dt / (unit.r_th * unit.c_th)));
+			total_power += unit.power;
+		}
+
+		for(auto &unit : units) {
+			if(unit.total) {
+				unit.power = total_power;
+				unit.temp = ambient;
+			}
+		}
+		sim_power = total_power;
+	}
+
+	void test::sim_loop(void)
+	{
+		auto next = std::chrono::steady_clock::now();
+
+		while(1) {
+			if(fixed_load < 0 && std::chrono::steady_clock::now() - host_sampled > std::chrono::milliseconds(HOST_LOAD_PERIOD_MS))
+				sample_host_load();
+
+			sim_m.lock();
+			sim_step(step);
+			sim_m.unlock();
+
+			try {
+				if(speed > 0) {
+					next += std::chrono::microseconds((long long)(step * 1e6 / speed));
+					auto now = std::chrono::steady_clock::now();
+					if(next > now)
+						boost::this_thread::sleep(boost::posix_time::microseconds(std::chrono::duration_cast<std::chrono::microseconds>(next - now).count()));
+					else
+						boost::this_thread::interruption_point();
+				} else {
+					boost::this_thread::interruption_point();
+					boost::this_thread::yield();
+				}
+			}
+			catch (boost::thread_interrupted&) {
+				return;
+			}
+		}
+	}
+
+	int test::parse_cli(prime::uds::socket_addrs_t* api_addrs, prime::uds::socket_addrs_t* ui_addrs, sim_args_t* sim_args, int argc, const char * argv[])
+	{
+		args::ArgumentParser parser("Simulated Test Device.","PRiME Project\n");
+		args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+
+		args::Group optional(parser, "All of these arguments are optional:", args::Group::Validators::DontCare);
+		args::ValueFlag<std::string> arg_arch(optional, "arch", "Architecture file of the device to simulate", {'a', "arch"});
+		args::ValueFlag<std::string> arg_model(optional, "model", "Model parameter file", {'m', "model"});
+		args::ValueFlag<double> arg_speed(optional, "speed", "Simulated time per real time, e.g. 10 runs ten times faster. 0 runs unthrottled (default 1).", {'s', "speed"});
+		args::ValueFlag<unsigned int> arg_power_sample(optional, "power_sample", "Sample power every this many microseconds for the energy & power statistics monitors (default 10000).", {"ps", "power_sample"});
+
+		UTIL_ARGS_LOGGER_PARAMS();
+
+		try {
+			parser.ParseCLI(argc, argv);
+		} catch (args::Help) {
+			std::cout << parser;
+			return -1;
+		} catch (args::ParseError e) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+			return -1;
+		} catch (args::ValidationError e) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+			return -1;
+		}
+
+		UTIL_ARGS_LOGGER_PROC();
+
+		if(arg_arch)
+			sim_args->arch_filename = args::get(arg_arch);
+		if(arg_model)
+			sim_args->model_filename = args::get(arg_model);
+		if(arg_speed)
+			sim_args->speed = args::get(arg_speed);
+		if(arg_power_sample)
+			sim_args->power_sample_us = args::get(arg_power_sample);
+
+		return 0;
+	}
+} }
+
+int main(int argc, const char * argv[])
+{
+	prime::uds::socket_addrs_t dev_rtm_addrs, dev_ui_addrs;
+	prime::dev::test::sim_args_t sim_args;
+	if(prime::dev::test::parse_cli(&dev_rtm_addrs, &dev_ui_addrs, &sim_args, argc, argv)) {
+		return -1;
+	}
+
+	prime::dev::test dev(&dev_rtm_addrs, &dev_ui_addrs, &sim_args);
+	return 0;
+}
@@ -0,0 +1,92 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech & Graeme Bragg
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace prime { namespace dev { namespace perf
+{
+	/* Per-core cycle and event counters through the kernel's perf_event interface.
+	 *
+	 * Each core has one counter group, opened once with the cycle counter as its
+	 * leader and one member per programmable counter. A single read() of the
+	 * group returns every counter of that core, from whichever core the caller
+	 * happens to run on, so no thread has to migrate to sample a core.
+	 *
+	 * Events are numbered as in the ARMv7 PMU (0x08 instructions, 0x17 L2 refills,
+	 * ...), the values the PRIME_PMC_CNT knobs carry. On ARM they are passed to
+	 * the kernel as raw events; elsewhere the common ones are mapped onto the
+	 * generic perf events so the same knobs work on other Linux machines.
+	 *
+	 * Reads return the count since the previous read of the same counter,
+	 * matching the reset-on-read behaviour of the CP15 counters.
+	 */
+	class pmc_t
+	{
+	public:
+		pmc_t(unsigned int num_cores, unsigned int num_counters);
+		// Cores whose PMUs differ, e.g. big.LITTLE: num_counters[core] counters on each.
+		pmc_t(const std::vector<unsigned int> &num_counters);
+		~pmc_t();
+
+		pmc_t(const pmc_t&) = delete;
+		pmc_t& operator=(const pmc_t&) = delete;
+
+		// Open the cycle counter on every core. False if any core cannot be
+		// counted, e.g. without a kernel PMU driver or permission.
+		bool open(void);
+		void close(void);
+		bool is_open(void) const { return opened; }
+
+		// Count the given event on one counter of a core from now on.
+		bool set_event(unsigned int core, unsigned int counter, unsigned int event);
+
+		uint64_t read_cycles(unsigned int core);
+		uint64_t read_counter(unsigned int core, unsigned int counter);
+
+	private:
+		struct counter_t {
+			int fd = -1;
+			unsigned int event = 0;
+			bool programmed = false;
+			uint64_t base = 0;		// Counted by earlier opens of this counter
+			uint64_t last = 0;		// Value at the previous read
+		};
+
+		struct core_t {
+			counter_t cycles;
+			std::vector<counter_t> counters;
+			std::vector<uint64_t> buf, vals;	// Group read scratch, sized once
+		};
+
+		std::vector<core_t> cores;
+		std::mutex pmc_m;
+		bool opened;
+
+		bool open_core(unsigned int core);
+		bool open_counter(unsigned int core, counter_t &counter);
+		bool read_core(unsigned int core);
+		void sample_core(unsigned int core);
+		uint64_t delta(counter_t &counter, uint64_t val);
+	};
+} } }
+
+#endif
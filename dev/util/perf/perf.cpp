@@ -0,0 +1,296 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech & Graeme Bragg
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+// ARMv7 PMU event numbers with a generic perf equivalent
+#define ARMV7_L1I_CACHE_REFILL	0x01
+#define ARMV7_L1D_CACHE_REFILL	0x03
+#define ARMV7_L1D_CACHE			0x04
+#define ARMV7_INST_RETIRED		0x08
+#define ARMV7_BR_MIS_PRED		0x10
+#define ARMV7_CPU_CYCLES		0x11
+#define ARMV7_BR_PRED			0x12
+#define ARMV7_L2D_CACHE			0x16
+#define ARMV7_L2D_CACHE_REFILL	0x17
+
+namespace prime { namespace dev { namespace perf
+{
+	static inline uint64_t hw_cache(unsigned int cache, unsigned int result)
+	{
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+	}
+
+	static void set_event_attr(struct perf_event_attr &attr, unsigned int event)
+	{
+#if defined(__arm__) || defined(__aarch64__)
+		attr.type = PERF_TYPE_RAW;
+		attr.config = event;
+#else
+		attr.type = PERF_TYPE_HARDWARE;
+		switch(event) {
+		case ARMV7_INST_RETIRED:
+			attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+			break;
+		case ARMV7_CPU_CYCLES:
+			attr.config = PERF_COUNT_HW_CPU_CYCLES;
+			break;
+		case ARMV7_BR_MIS_PRED:
+			attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+			break;
+		case ARMV7_BR_PRED:
+			attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+			break;
+		case ARMV7_L2D_CACHE:
+			attr.config = PERF_COUNT_HW_CACHE_REFERENCES;
+			break;
+		case ARMV7_L2D_CACHE_REFILL:
+			attr.config = PERF_COUNT_HW_CACHE_MISSES;
+			break;
+		case ARMV7_L1D_CACHE:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = hw_cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+			break;
+		case ARMV7_L1D_CACHE_REFILL:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = hw_cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS);
+			break;
+		case ARMV7_L1I_CACHE_REFILL:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = hw_cache(PERF_COUNT_HW_CACHE_L1I, PERF_COUNT_HW_CACHE_RESULT_MISS);
+			break;
+		default:
+			attr.type = PERF_TYPE_RAW;
+			attr.config = event;
+			break;
+		}
+#endif
+	}
+
+	// Count on one core for every process. Without the privilege to count
+	// kernel time as well, fall back to user time only.
+	static int open_event(struct perf_event_attr &attr, unsigned int core, int group_fd)
+	{
+		attr.size = sizeof(attr);
+		attr.read_format = PERF_FORMAT_GROUP;
+		int fd = syscall(__NR_perf_event_open, &attr, -1, core, group_fd, 0);
+		if(fd < 0 && (errno == EACCES || errno == EPERM)) {
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			fd = syscall(__NR_perf_event_open, &attr, -1, core, group_fd, 0);
+		}
+		// PERF_FLAG_FD_CLOEXEC is newer than the 3.10 kernels the boards run
+		if(fd >= 0)
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+		return fd;
+	}
+
+	pmc_t::pmc_t(unsigned int num_cores, unsigned int num_counters) :
+		pmc_t(std::vector<unsigned int>(num_cores, num_counters))
+	{
+	}
+
+	pmc_t::pmc_t(const std::vector<unsigned int> &num_counters) :
+		cores(num_counters.size()),
+		opened(false)
+	{
+		for(std::size_t core = 0; core < cores.size(); core++) {
+			cores[core].counters.resize(num_counters[core]);
+			cores[core].buf.resize(2 + num_counters[core]);
+			cores[core].vals.resize(1 + num_counters[core]);
+		}
+	}
+
+	pmc_t::~pmc_t()
+	{
+		close();
+	}
+
+	bool pmc_t::open(void)
+	{
+		pmc_m.lock();
+		opened = true;
+		for(unsigned int core = 0; core < cores.size(); core++) {
+			if(!open_core(core))
+				opened = false;
+		}
+		pmc_m.unlock();
+		if(!opened)
+			close();
+		return opened;
+	}
+
+	void pmc_t::close(void)
+	{
+		pmc_m.lock();
+		for(auto &core : cores) {
+			for(auto &counter : core.counters) {
+				if(counter.fd >= 0)
+					::close(counter.fd);
+				counter.fd = -1;
+			}
+			if(core.cycles.fd >= 0)
+				::close(core.cycles.fd);
+			core.cycles.fd = -1;
+		}
+		opened = false;
+		pmc_m.unlock();
+	}
+
+	bool pmc_t::open_core(unsigned int core)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+
+		counter_t &cycles = cores[core].cycles;
+		cycles.fd = open_event(attr, core, -1);
+		if(cycles.fd < 0)
+			return false;
+		cycles.base = cycles.last = 0;
+
+		for(auto &counter : cores[core].counters) {
+			if(counter.programmed)
+				open_counter(core, counter);
+		}
+		return true;
+	}
+
+	bool pmc_t::open_counter(unsigned int core, counter_t &counter)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		set_event_attr(attr, counter.event);
+		counter.fd = open_event(attr, core, cores[core].cycles.fd);
+		return counter.fd >= 0;
+	}
+
+	// Raw values of the whole group into vals: cycles first, then each counter
+	// in order. Counters that are not open read as 0.
+	bool pmc_t::read_core(unsigned int core)
+	{
+		core_t &c = cores[core];
+		std::vector<uint64_t> &buf = c.buf;
+		std::vector<uint64_t> &vals = c.vals;
+
+		// The group lists the leader, then every open member in the order it was opened.
+		ssize_t len = ::read(c.cycles.fd, buf.data(), buf.size() * sizeof(uint64_t));
+		if(len < (ssize_t)(2 * sizeof(uint64_t)))
+			return false;
+
+		unsigned int nr = buf[0];
+		unsigned int idx = 1;
+		vals[0] = buf[idx++];
+		for(std::size_t i = 0; i < c.counters.size(); i++) {
+			if(c.counters[i].fd >= 0 && idx <= nr)
+				vals[i + 1] = buf[idx++];
+			else
+				vals[i + 1] = 0;
+		}
+		return true;
+	}
+
+	// Fold what each counter has counted so far into its base, ready for the
+	// group members to be reopened from zero.
+	void pmc_t::sample_core(unsigned int core)
+	{
+		core_t &c = cores[core];
+		if(!read_core(core))
+			return;
+		for(std::size_t i = 0; i < c.counters.size(); i++) {
+			if(c.counters[i].fd >= 0)
+				c.counters[i].base += c.vals[i + 1];
+		}
+	}
+
+	uint64_t pmc_t::delta(counter_t &counter, uint64_t val)
+	{
+		uint64_t total = counter.base + val;
+		uint64_t ret = total - counter.last;
+		counter.last = total;
+		return ret;
+	}
+
+	bool pmc_t::set_event(unsigned int core, unsigned int counter, unsigned int event)
+	{
+		if(core >= cores.size() || counter >= cores[core].counters.size())
+			return false;
+
+		pmc_m.lock();
+		core_t &c = cores[core];
+		counter_t &target = c.counters[counter];
+		target.event = event;
+		target.programmed = true;
+		if(!opened) {
+			pmc_m.unlock();
+			return false;
+		}
+
+		// A member cannot be reprogrammed in place. Reopen all of them so the
+		// group keeps them in counter order, carrying over what the others counted.
+		sample_core(core);
+		for(auto &member : c.counters) {
+			if(member.fd >= 0)
+				::close(member.fd);
+			member.fd = -1;
+		}
+		target.base = target.last = 0;
+
+		bool ret = true;
+		for(auto &member : c.counters) {
+			if(member.programmed && !open_counter(core, member) && &member == &target)
+				ret = false;
+		}
+		pmc_m.unlock();
+		return ret;
+	}
+
+	uint64_t pmc_t::read_cycles(unsigned int core)
+	{
+		if(core >= cores.size())
+			return 0;
+
+		pmc_m.lock();
+		core_t &c = cores[core];
+		uint64_t ret = 0;
+		if(opened && read_core(core))
+			ret = delta(c.cycles, c.vals[0]);
+		pmc_m.unlock();
+		return ret;
+	}
+
+	uint64_t pmc_t::read_counter(unsigned int core, unsigned int counter)
+	{
+		if(core >= cores.size() || counter >= cores[core].counters.size())
+			return 0;
+
+		pmc_m.lock();
+		core_t &c = cores[core];
+		uint64_t ret = 0;
+		if(opened && c.counters[counter].fd >= 0 && read_core(core))
+			ret = delta(c.counters[counter], c.vals[counter + 1]);
+		pmc_m.unlock();
+		return ret;
+	}
+} } }
@@ -0,0 +1,135 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by James Davis & Graeme Bragg
+ */
+
+#ifndef PMBUS_H
+#define PMBUS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// PMBus commands used on the power managers
+#define PMBUS_PAGE					0x00
+#define PMBUS_VOUT_COMMAND			0x21
+#define PMBUS_VOUT_UV_FAULT_LIMIT	0x44
+#define PMBUS_READ_VOUT				0x8B
+
+namespace prime { namespace dev { namespace pmbus
+{
+	// One I2C message of a combined transfer: a write, or a read after a repeated start.
+	struct msg_t {
+		uint8_t addr;
+		bool read;
+		uint8_t *buf;
+		uint16_t len;
+	};
+
+	/* Access to an I2C bus, one combined transfer at a time.
+	 *
+	 * The regulator code only talks to this interface, so it can be run
+	 * against a simulated bus in place of the real adapter.
+	 */
+	class bus_t
+	{
+	public:
+		virtual ~bus_t() {}
+		// Every message in order, without releasing the bus in between.
+		virtual bool transfer(msg_t *msgs, std::size_t count) = 0;
+	};
+
+	// An adapter under /dev/i2c-N, opened once. Transfers go through I2C_RDWR.
+	class i2c_bus_t : public bus_t
+	{
+	public:
+		explicit i2c_bus_t(const std::string &path);
+		~i2c_bus_t();
+
+		i2c_bus_t(const i2c_bus_t&) = delete;
+		i2c_bus_t& operator=(const i2c_bus_t&) = delete;
+
+		bool is_open(void) const { return fd >= 0; }
+		bool transfer(msg_t *msgs, std::size_t count);
+
+	private:
+		int fd;
+	};
+
+	/* Voltage rails of LTC2978-style power managers.
+	 *
+	 * Each rail is a page of a manager: READ_VOUT on the page is the rail
+	 * voltage, and READ_VOUT on the following page is the output of its current
+	 * sense amplifier, in amps once divided by the rail's current divisor.
+	 *
+	 * sample() reads every rail, voltage and current, in one combined transfer
+	 * and keeps the result; the read accessors return the last sample, so any
+	 * number of monitors can be served from one pass over the bus.
+	 */
+	class rails_t
+	{
+	public:
+		explicit rails_t(bus_t &bus);
+
+		// Returns the rail's index.
+		unsigned int add(const std::string &name, uint8_t addr, uint8_t page, float current_div = 1);
+		// Index of the named rail, or -1.
+		int find(const std::string &name) const;
+		std::size_t size(void) const { return rails.size(); }
+
+		// Read every rail. False if the transfer failed, leaving the previous sample.
+		bool sample(void);
+
+		float volts(unsigned int idx);
+		float amps(unsigned int idx);
+		float watts(unsigned int idx);
+
+		// Program a rail's output voltage. The undervoltage fault limit is lowered
+		// first if the new voltage is below it, so the manager does not shut the rail down.
+		bool set_volts(unsigned int idx, float volts);
+
+	private:
+		struct rail_t {
+			std::string name;
+			uint8_t addr;
+			uint8_t page;
+			float current_div;
+			float volts;
+			float amps;
+		};
+
+		bus_t &bus;
+		std::vector<rail_t> rails;
+		std::mutex rails_m;
+
+		// Combined sample transfer, built once per rail added.
+		std::vector<msg_t> sample_msgs;
+		std::vector<uint8_t> sample_buf;
+		void build_sample(void);
+
+		bool read_word(uint8_t addr, uint8_t page, uint8_t cmd, uint16_t &val);
+		bool write_word(uint8_t addr, uint8_t page, uint8_t cmd, uint16_t val);
+	};
+
+	// VOUT_MODE of the managers: unsigned with a fixed exponent of -13.
+	float linear16_to_float(uint16_t val);
+	uint16_t float_to_linear16(float val);
+	// Five-bit signed exponent, eleven-bit signed mantissa.
+	float linear11_to_float(uint16_t val);
+} } }
+
+#endif
@@ -0,0 +1,223 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by James Davis & Graeme Bragg
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "pmbus.h"
+
+// Bytes of one reading in the sample transfer: PAGE write, command write, word read.
+#define SAMPLE_READING_BYTES	5
+#define SAMPLE_READING_MSGS		3
+
+namespace prime { namespace dev { namespace pmbus
+{
+	float linear16_to_float(uint16_t val)
+	{
+		return val / 8192.0f;
+	}
+
+	uint16_t float_to_linear16(float val)
+	{
+		if(val <= 0)
+			return 0;
+		return (uint16_t)std::min(val * 8192.0f, 65535.0f);
+	}
+
+	float linear11_to_float(uint16_t val)
+	{
+		int exponent = (val >> 11) & 0x1F;
+		int mantissa = val & 0x7FF;
+		if(exponent & 0x10)
+			exponent -= 32;
+		if(mantissa & 0x400)
+			mantissa -= 2048;
+		return std::ldexp((float)mantissa, exponent);
+	}
+
+	/* -------------------------------------- I2C Bus -------------------------------------- */
+	i2c_bus_t::i2c_bus_t(const std::string &path)
+	{
+		fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+	}
+
+	i2c_bus_t::~i2c_bus_t()
+	{
+		if(fd >= 0)
+			::close(fd);
+	}
+
+	bool i2c_bus_t::transfer(msg_t *msgs, std::size_t count)
+	{
+		struct i2c_msg i2c_msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+		struct i2c_rdwr_ioctl_data data;
+
+		if(fd < 0)
+			return false;
+
+		// The kernel takes a bounded number of messages per ioctl.
+		for(std::size_t first = 0; first < count; first += I2C_RDWR_IOCTL_MAX_MSGS) {
+			std::size_t num = std::min<std::size_t>(count - first, I2C_RDWR_IOCTL_MAX_MSGS);
+			for(std::size_t i = 0; i < num; i++) {
+				i2c_msgs[i].addr = msgs[first + i].addr;
+				i2c_msgs[i].flags = msgs[first + i].read ? I2C_M_RD : 0;
+				i2c_msgs[i].len = msgs[first + i].len;
+				i2c_msgs[i].buf = msgs[first + i].buf;
+			}
+			data.msgs = i2c_msgs;
+			data.nmsgs = num;
+			if(ioctl(fd, I2C_RDWR, &data) != (int)num)
+				return false;
+		}
+		return true;
+	}
+
+	/* --------------------------------------- Rails --------------------------------------- */
+	rails_t::rails_t(bus_t &bus) : bus(bus)
+	{
+	}
+
+	unsigned int rails_t::add(const std::string &name, uint8_t addr, uint8_t page, float current_div)
+	{
+		rails_m.lock();
+		rail_t rail = {name, addr, page, current_div, 0, 0};
+		rails.push_back(rail);
+		build_sample();
+		unsigned int idx = rails.size() - 1;
+		rails_m.unlock();
+		return idx;
+	}
+
+	int rails_t::find(const std::string &name) const
+	{
+		for(std::size_t i = 0; i < rails.size(); i++) {
+			if(rails[i].name == name)
+				return i;
+		}
+		return -1;
+	}
+
+	void rails_t::build_sample(void)
+	{
+		// Two readings per rail: its voltage, then its current sense on the next page.
+		std::size_t readings = rails.size() * 2;
+		sample_buf.assign(readings * SAMPLE_READING_BYTES, 0);
+		sample_msgs.resize(readings * SAMPLE_READING_MSGS);
+
+		for(std::size_t i = 0; i < readings; i++) {
+			const rail_t &rail = rails[i / 2];
+			uint8_t *buf = &sample_buf[i * SAMPLE_READING_BYTES];
+			msg_t *msg = &sample_msgs[i * SAMPLE_READING_MSGS];
+
+			buf[0] = PMBUS_PAGE;
+			buf[1] = rail.page + (i % 2);
+			buf[2] = PMBUS_READ_VOUT;
+			msg[0] = {rail.addr, false, &buf[0], 2};
+			msg[1] = {rail.addr, false, &buf[2], 1};
+			msg[2] = {rail.addr, true, &buf[3], 2};
+		}
+	}
+
+	bool rails_t::sample(void)
+	{
+		rails_m.lock();
+		bool ret = bus.transfer(sample_msgs.data(), sample_msgs.size());
+		if(ret) {
+			for(std::size_t i = 0; i < rails.size(); i++) {
+				const uint8_t *volt_buf = &sample_buf[(2 * i) * SAMPLE_READING_BYTES];
+				const uint8_t *curr_buf = &sample_buf[(2 * i + 1) * SAMPLE_READING_BYTES];
+				rails[i].volts = linear16_to_float(volt_buf[3] | (volt_buf[4] << 8));
+				rails[i].amps = linear11_to_float(curr_buf[3] | (curr_buf[4] << 8)) / rails[i].current_div;
+			}
+		}
+		rails_m.unlock();
+		return ret;
+	}
+
+	float rails_t::volts(unsigned int idx)
+	{
+		rails_m.lock();
+		float val = (idx < rails.size()) ? rails[idx].volts : 0;
+		rails_m.unlock();
+		return val;
+	}
+
+	float rails_t::amps(unsigned int idx)
+	{
+		rails_m.lock();
+		float val = (idx < rails.size()) ? rails[idx].amps : 0;
+		rails_m.unlock();
+		return val;
+	}
+
+	float rails_t::watts(unsigned int idx)
+	{
+		rails_m.lock();
+		float val = (idx < rails.size()) ? rails[idx].volts * rails[idx].amps : 0;
+		rails_m.unlock();
+		return val;
+	}
+
+	bool rails_t::set_volts(unsigned int idx, float volts)
+	{
+		uint16_t uv_limit;
+		bool ret = false;
+
+		rails_m.lock();
+		if(idx < rails.size()) {
+			const rail_t &rail = rails[idx];
+			uint16_t vout = float_to_linear16(volts);
+			ret = read_word(rail.addr, rail.page, PMBUS_VOUT_UV_FAULT_LIMIT, uv_limit);
+			if(ret && vout < uv_limit)
+				ret = write_word(rail.addr, rail.page, PMBUS_VOUT_UV_FAULT_LIMIT, vout);
+			if(ret)
+				ret = write_word(rail.addr, rail.page, PMBUS_VOUT_COMMAND, vout);
+		}
+		rails_m.unlock();
+		return ret;
+	}
+
+	bool rails_t::read_word(uint8_t addr, uint8_t page, uint8_t cmd, uint16_t &val)
+	{
+		uint8_t page_buf[2] = {PMBUS_PAGE, page};
+		uint8_t val_buf[2];
+		msg_t msgs[3] = {
+			{addr, false, page_buf, 2},
+			{addr, false, &cmd, 1},
+			{addr, true, val_buf, 2}
+		};
+		if(!bus.transfer(msgs, 3))
+			return false;
+		val = val_buf[0] | (val_buf[1] << 8);
+		return true;
+	}
+
+	bool rails_t::write_word(uint8_t addr, uint8_t page, uint8_t cmd, uint16_t val)
+	{
+		uint8_t page_buf[2] = {PMBUS_PAGE, page};
+		uint8_t cmd_buf[3] = {cmd, (uint8_t)(val & 0xFF), (uint8_t)(val >> 8)};
+		msg_t msgs[2] = {
+			{addr, false, page_buf, 2},
+			{addr, false, cmd_buf, 3}
+		};
+		return bus.transfer(msgs, 2);
+	}
+} } }
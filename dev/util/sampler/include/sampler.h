@@ -0,0 +1,131 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech & Graeme Bragg
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include "prime_api_dev.h"
+
+// Samples kept, a power of two. 4096 is 40 s of history at 10 ms.
+#define SAMPLER_CAPACITY		4096
+
+// Defaults for the statistics knobs
+#define SAMPLER_WINDOW_MS		1000
+#define SAMPLER_PERCENTILE		95
+
+namespace prime { namespace dev { namespace sampler
+{
+	/* Device power sampled on its own thread at a fixed rate.
+	 *
+	 * Each sample holds the power reading and the energy used since the
+	 * sampler started, integrated over the samples. Samples go into a ring
+	 * written only by the sampling thread; readers copy what they need out of
+	 * it without taking a lock and drop anything overwritten while they read,
+	 * so monitor gets never wait for, or delay, a reading.
+	 *
+	 * add_to() registers the derived monitors, and the knobs that configure
+	 * them, for the entries a functional unit's architecture lists:
+	 *	knobs:	PRIME_WINDOW		statistics window in ms
+	 *			PRIME_PERCENTILE	percentile reported by PRIME_POW_PCTL
+	 *			PRIME_MARKER		start a new energy interval, on every set; the value is ignored
+	 *	mons:	PRIME_ENERGY		J since the sampler started
+	 *			PRIME_ENERGY_SINCE	J since the last marker
+	 *			PRIME_POW_MEAN, PRIME_POW_MIN, PRIME_POW_MAX, PRIME_POW_PCTL
+	 *								W over the window
+	 */
+	class power_sampler_t
+	{
+	public:
+		struct stats_t {
+			double mean = 0;
+			double min = 0;
+			double max = 0;
+			double percentile = 0;
+			std::size_t count = 0;
+		};
+
+		explicit power_sampler_t(boost::function<double(void)> read_power);
+		~power_sampler_t();
+
+		power_sampler_t(const power_sampler_t&) = delete;
+		power_sampler_t& operator=(const power_sampler_t&) = delete;
+
+		void start(unsigned int period_us);
+		void stop(void);
+
+		double energy(void);
+		double energy_since_mark(void);
+		void mark(void);
+		// Over the samples of the last window_us.
+		stats_t window_stats(unsigned int window_us, double percentile);
+
+		// After start(): the longest window is however much the ring holds at the sample period.
+		void add_to(
+			prime::api::dev::rtm_interface &rtm_api,
+			const boost::property_tree::ptree &architecture,
+			std::string func_unit
+		);
+
+	private:
+		struct slot_t {
+			std::atomic<uint64_t> ts_us;
+			std::atomic<double> watts;
+			std::atomic<double> joules;		// Since start, up to this sample
+		};
+
+		struct sample_t {
+			uint64_t ts_us;
+			double watts;
+			double joules;
+		};
+
+		boost::function<double(void)> read_power;
+		std::unique_ptr<slot_t[]> ring;
+		std::atomic<uint64_t> head;			// Samples written
+		std::atomic<double> mark_joules;
+		unsigned int period_us;
+		boost::thread sample_thread;
+
+		// Statistics knobs
+		std::atomic<unsigned int> window_ms;
+		std::atomic<unsigned int> percentile;
+
+		void sample_loop(void);
+		// Most recent samples, oldest first, at most max of them.
+		std::size_t read_samples(std::vector<sample_t> &samples, std::size_t max);
+		bool latest(sample_t &sample);
+		static uint64_t now_us(void);
+
+		// Knob & monitor handlers
+		void window_handler(prime::api::disc_t val);
+		void percentile_handler(prime::api::disc_t val);
+		void marker_handler(prime::api::disc_t val);
+		prime::api::dev::mon_cont_ret_t energy_handler(void);
+		prime::api::dev::mon_cont_ret_t energy_since_handler(void);
+		prime::api::dev::mon_cont_ret_t stats_handler(prime::api::dev::mon_type_t type);
+	};
+} } }
+
+#endif
@@ -0,0 +1,303 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech & Graeme Bragg
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <boost/bind.hpp>
+#include "util.h"
+#include "sampler.h"
+
+namespace prime { namespace dev { namespace sampler
+{
+	power_sampler_t::power_sampler_t(boost::function<double(void)> read_power) :
+		read_power(read_power),
+		ring(new slot_t[SAMPLER_CAPACITY]),
+		head(0),
+		mark_joules(0),
+		period_us(0),
+		window_ms(SAMPLER_WINDOW_MS),
+		percentile(SAMPLER_PERCENTILE)
+	{
+	}
+
+	power_sampler_t::~power_sampler_t()
+	{
+		stop();
+	}
+
+	void power_sampler_t::start(unsigned int period_us)
+	{
+		stop();
+		this->period_us = period_us ? period_us : 1;
+		sample_thread = boost::thread(&power_sampler_t::sample_loop, this);
+	}
+
+	void power_sampler_t::stop(void)
+	{
+		if(sample_thread.joinable()) {
+			sample_thread.interrupt();
+			sample_thread.join();
+		}
+	}
+
+	uint64_t power_sampler_t::now_us(void)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void power_sampler_t::sample_loop(void)
+	{
+		sample_t last;
+		bool first = (head.load() == 0);
+		if(!first)
+			latest(last);
+
+		// Deadlines advance by whole periods, so the rate does not drift with the read time.
+		std::chrono::steady_clock::time_point next_sample = std::chrono::steady_clock::now();
+		try {
+			while(1) {
+				sample_t sample;
+				sample.watts = read_power();
+				sample.ts_us = now_us();
+				// Trapezoidal, so a step in power costs half a period of error, not a whole one.
+				sample.joules = first ? 0 : last.joules + (last.watts + sample.watts) / 2 * (sample.ts_us - last.ts_us) / 1e6;
+				first = false;
+
+				uint64_t idx = head.load(std::memory_order_relaxed);
+				slot_t &slot = ring[idx % SAMPLER_CAPACITY];
+				slot.ts_us.store(sample.ts_us, std::memory_order_relaxed);
+				slot.watts.store(sample.watts, std::memory_order_relaxed);
+				slot.joules.store(sample.joules, std::memory_order_relaxed);
+				head.store(idx + 1, std::memory_order_release);
+				last = sample;
+
+				next_sample += std::chrono::microseconds(period_us);
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				if(next_sample < now)
+					next_sample = now;		// Overran, don't burst to catch up
+				boost::this_thread::sleep(boost::posix_time::microseconds(
+					std::chrono::duration_cast<std::chrono::microseconds>(next_sample - now).count()));
+			}
+		}
+		catch(boost::thread_interrupted&) {
+		}
+	}
+
+	std::size_t power_sampler_t::read_samples(std::vector<sample_t> &samples, std::size_t max)
+	{
+		uint64_t end = head.load(std::memory_order_acquire);
+		max = std::min<std::size_t>(max, SAMPLER_CAPACITY - 1);
+		uint64_t begin = (end > max) ? end - max : 0;
+
+		samples.resize(end - begin);
+		for(uint64_t idx = begin; idx < end; idx++) {
+			slot_t &slot = ring[idx % SAMPLER_CAPACITY];
+			sample_t &sample = samples[idx - begin];
+			sample.ts_us = slot.ts_us.load(std::memory_order_relaxed);
+			sample.watts = slot.watts.load(std::memory_order_relaxed);
+			sample.joules = slot.joules.load(std::memory_order_relaxed);
+		}
+
+		// Slots the sampler reached while we copied may be torn; drop them.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t written = head.load(std::memory_order_relaxed);
+		uint64_t valid = (written + 1 > SAMPLER_CAPACITY) ? written + 1 - SAMPLER_CAPACITY : 0;
+		if(valid > begin) {
+			std::size_t drop = std::min<uint64_t>(valid - begin, samples.size());
+			samples.erase(samples.begin(), samples.begin() + drop);
+		}
+		return samples.size();
+	}
+
+	bool power_sampler_t::latest(sample_t &sample)
+	{
+		std::vector<sample_t> samples;
+		if(!read_samples(samples, 1))
+			return false;
+		sample = samples.back();
+		return true;
+	}
+
+	double power_sampler_t::energy(void)
+	{
+		sample_t sample;
+		return latest(sample) ? sample.joules : 0;
+	}
+
+	void power_sampler_t::mark(void)
+	{
+		// Energy now, carried forward from the last sample at its power.
+		sample_t sample;
+		double joules = 0;
+		if(latest(sample))
+			joules = sample.joules + sample.watts * (now_us() - sample.ts_us) / 1e6;
+		mark_joules.store(joules);
+	}
+
+	double power_sampler_t::energy_since_mark(void)
+	{
+		// The mark can be ahead of the last sample by up to a period.
+		return std::max(energy() - mark_joules.load(), 0.0);
+	}
+
+	power_sampler_t::stats_t power_sampler_t::window_stats(unsigned int window_us, double pct)
+	{
+		stats_t stats;
+		std::vector<sample_t> samples;
+		std::size_t max = period_us ? window_us / period_us + 1 : SAMPLER_CAPACITY;
+		if(!read_samples(samples, max))
+			return stats;
+
+		uint64_t from = now_us() - window_us;
+		auto first = std::find_if(samples.begin(), samples.end(), [from](const sample_t &s){ return s.ts_us >= from; });
+		if(first == samples.end())
+			first = samples.end() - 1;		// Nothing that recent, report the last sample
+
+		std::vector<double> watts;
+		watts.reserve(samples.end() - first);
+		for(auto it = first; it != samples.end(); it++)
+			watts.push_back(it->watts);
+
+		stats.count = watts.size();
+		stats.min = *std::min_element(watts.begin(), watts.end());
+		stats.max = *std::max_element(watts.begin(), watts.end());
+		// Mean over time rather than over samples, so late or missed samples do not bias it.
+		uint64_t span = samples.back().ts_us - first->ts_us;
+		stats.mean = span ? (samples.back().joules - first->joules) * 1e6 / span : samples.back().watts;
+
+		// Nearest rank
+		std::size_t rank = (std::size_t)std::ceil(std::min(std::max(pct, 0.0), 100.0) / 100 * watts.size());
+		rank = rank ? rank - 1 : 0;
+		std::nth_element(watts.begin(), watts.begin() + rank, watts.end());
+		stats.percentile = watts[rank];
+		return stats;
+	}
+
+	/* ---------------------------------- Knobs & Monitors --------------------------------- */
+	void power_sampler_t::add_to(
+		prime::api::dev::rtm_interface &rtm_api,
+		const boost::property_tree::ptree &architecture,
+		std::string func_unit
+	)
+	{
+		auto unit = architecture.get_child_optional("device.functional_units." + func_unit);
+		if(!unit)
+			return;
+		unsigned int fu_id = unit->get<unsigned int>("id");
+		unsigned int max_window_ms = (uint64_t)(SAMPLER_CAPACITY - 1) * period_us / 1000;
+
+		auto knobs = unit->get_child_optional("knobs");
+		if(knobs) {
+			unsigned int su_id = knobs->get<unsigned int>("id");
+			for(auto &knob : *knobs) {
+				std::string type = knob.second.get<std::string>("type", "");
+				unsigned int id = prime::util::set_id(fu_id, su_id, 0, knob.second.get<unsigned int>("id", 0));
+				if(type == "PRIME_WINDOW") {
+					rtm_api.add_knob_disc(id, prime::api::dev::PRIME_WINDOW, 1, std::max(max_window_ms, 1u),
+						window_ms, SAMPLER_WINDOW_MS, boost::bind(&power_sampler_t::window_handler, this, _1));
+				} else if(type == "PRIME_PERCENTILE") {
+					rtm_api.add_knob_disc(id, prime::api::dev::PRIME_PERCENTILE, 0, 100,
+						percentile, SAMPLER_PERCENTILE, boost::bind(&power_sampler_t::percentile_handler, this, _1));
+				} else if(type == "PRIME_MARKER") {
+					rtm_api.add_knob_disc(id, prime::api::dev::PRIME_MARKER, 0, INT_MAX,
+						0, 0, boost::bind(&power_sampler_t::marker_handler, this, _1));
+				}
+			}
+		}
+
+		auto mons = unit->get_child_optional("mons");
+		if(mons) {
+			unsigned int su_id = mons->get<unsigned int>("id");
+			for(auto &mon : *mons) {
+				std::string type = mon.second.get<std::string>("type", "");
+				unsigned int id = prime::util::set_id(fu_id, su_id, 0, mon.second.get<unsigned int>("id", 0));
+				if(type == "PRIME_ENERGY") {
+					rtm_api.add_mon_cont(id, prime::api::dev::PRIME_ENERGY, 0, 0, 0,
+						boost::bind(&power_sampler_t::energy_handler, this));
+				} else if(type == "PRIME_ENERGY_SINCE") {
+					rtm_api.add_mon_cont(id, prime::api::dev::PRIME_ENERGY_SINCE, 0, 0, 0,
+						boost::bind(&power_sampler_t::energy_since_handler, this));
+				} else if(type == "PRIME_POW_MEAN" || type == "PRIME_POW_MIN" || type == "PRIME_POW_MAX" || type == "PRIME_POW_PCTL") {
+					prime::api::dev::mon_type_t stat = prime::api::dev::PRIME_POW_MEAN;
+					if(type == "PRIME_POW_MIN")
+						stat = prime::api::dev::PRIME_POW_MIN;
+					else if(type == "PRIME_POW_MAX")
+						stat = prime::api::dev::PRIME_POW_MAX;
+					else if(type == "PRIME_POW_PCTL")
+						stat = prime::api::dev::PRIME_POW_PCTL;
+					rtm_api.add_mon_cont(id, stat, 0, 0, 0,
+						boost::bind(&power_sampler_t::stats_handler, this, stat));
+				}
+			}
+		}
+	}
+
+	void power_sampler_t::window_handler(prime::api::disc_t val)
+	{
+		window_ms = std::max(val, 1);
+	}
+
+	void power_sampler_t::percentile_handler(prime::api::disc_t val)
+	{
+		percentile = std::min(std::max(val, 0), 100);
+	}
+
+	void power_sampler_t::marker_handler(prime::api::disc_t /*val*/)
+	{
+		mark();
+	}
+
+	prime::api::dev::mon_cont_ret_t power_sampler_t::energy_handler(void)
+	{
+		prime::api::dev::mon_cont_ret_t ret;
+		ret.val = energy();
+		return ret;
+	}
+
+	prime::api::dev::mon_cont_ret_t power_sampler_t::energy_since_handler(void)
+	{
+		prime::api::dev::mon_cont_ret_t ret;
+		ret.val = energy_since_mark();
+		return ret;
+	}
+
+	prime::api::dev::mon_cont_ret_t power_sampler_t::stats_handler(prime::api::dev::mon_type_t type)
+	{
+		prime::api::dev::mon_cont_ret_t ret;
+		stats_t stats = window_stats(window_ms * 1000, percentile);
+		ret.min = stats.min;
+		ret.max = stats.max;
+		switch(type) {
+			case prime::api::dev::PRIME_POW_MIN:
+				ret.val = stats.min;
+				break;
+			case prime::api::dev::PRIME_POW_MAX:
+				ret.val = stats.max;
+				break;
+			case prime::api::dev::PRIME_POW_PCTL:
+				ret.val = stats.percentile;
+				break;
+			default:
+				ret.val = stats.mean;
+				break;
+		}
+		return ret;
+	}
+} } }
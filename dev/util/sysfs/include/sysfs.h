@@ -0,0 +1,114 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech & Graeme Bragg
+ */
+
+#ifndef SYSFS_H
+#define SYSFS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+#include <sys/types.h>
+
+// Largest sysfs node read in one go. Sensor nodes are a few lines at most.
+#define SYSFS_READ_MAX 512
+
+namespace prime { namespace dev { namespace sysfs
+{
+	// Parse a decimal number ("-12", "3.25", "46000") starting at p, without allocating.
+	// Leading whitespace is skipped. On success p is left after the number.
+	bool parse_number(const char *&p, const char *end, double &val);
+
+	/* A sysfs attribute held open for repeated reads.
+	 *
+	 * Each read is a single pread() from offset 0 into a buffer on the caller's
+	 * stack, so reads need no seek, no allocation and are safe from any thread.
+	 */
+	class node_t
+	{
+	public:
+		node_t();
+		explicit node_t(const std::string &path);
+		~node_t();
+
+		node_t(const node_t&) = delete;
+		node_t& operator=(const node_t&) = delete;
+
+		bool open(const std::string &path, bool writable = false);
+		void close(void);
+		bool is_open(void) const { return fd >= 0; }
+
+		// Whole contents, NUL-terminated. Returns the length, or -1 on error.
+		ssize_t read(char *buf, std::size_t size) const;
+		// Replace the contents, for nodes opened writable.
+		bool write(const std::string &val) const;
+		// First number in the node.
+		bool read_number(double &val) const;
+		// Every number in the node, in order, skipping labels (e.g. "sensor0 : 46000").
+		std::size_t read_numbers(double *vals, std::size_t max) const;
+
+	private:
+		int fd;
+	};
+
+	/* A writable attribute that remembers what was last written to it.
+	 *
+	 * Writing the value it already holds is skipped, so a controller that
+	 * repeats the same decision costs nothing. Call invalidate() when
+	 * something else may have changed the attribute, e.g. a governor change
+	 * resetting the frequency.
+	 */
+	class setting_t
+	{
+	public:
+		bool open(const std::string &path);
+		bool is_open(void) const { return node.is_open(); }
+
+		// False if the write failed. A skipped write counts as success.
+		bool set(const std::string &val);
+		// Whether val is known to be the current value.
+		bool holds(const std::string &val);
+		void invalidate(void);
+
+	private:
+		node_t node;
+		std::string last;
+		bool valid = false;
+		std::mutex setting_m;
+	};
+
+	// Sensors that are always read together, e.g. every power rail.
+	class group_t
+	{
+	public:
+		// Returns the sensor's index in the group.
+		unsigned int add(const std::string &path);
+		std::size_t size(void) const { return nodes.size(); }
+
+		// First number of one sensor, or 0 if it cannot be read.
+		double read(unsigned int idx) const;
+		// Every sensor in one pass, by index. Unreadable sensors read as 0.
+		void read(double *vals) const;
+		double sum(void) const;
+
+	private:
+		std::vector<std::unique_ptr<node_t>> nodes;
+	};
+} } }
+
+#endif
@@ -0,0 +1,224 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech & Graeme Bragg
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "sysfs.h"
+
+namespace prime { namespace dev { namespace sysfs
+{
+	static inline bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	bool parse_number(const char *&p, const char *end, double &val)
+	{
+		const char *s = p;
+		bool negative = false;
+		bool digits = false;
+		double num = 0;
+
+		while(s < end && is_space(*s))
+			s++;
+		if(s < end && (*s == '-' || *s == '+')) {
+			negative = (*s == '-');
+			s++;
+		}
+		while(s < end && *s >= '0' && *s <= '9') {
+			num = num * 10 + (*s - '0');
+			digits = true;
+			s++;
+		}
+		if(s < end && *s == '.') {
+			double scale = 0.1;
+			s++;
+			while(s < end && *s >= '0' && *s <= '9') {
+				num += (*s - '0') * scale;
+				scale *= 0.1;
+				digits = true;
+				s++;
+			}
+		}
+		if(!digits)
+			return false;
+
+		val = negative ? -num : num;
+		p = s;
+		return true;
+	}
+
+	/* ---------------------------------------- Node ---------------------------------------- */
+	node_t::node_t() : fd(-1)
+	{
+	}
+
+	node_t::node_t(const std::string &path) : fd(-1)
+	{
+		open(path);
+	}
+
+	node_t::~node_t()
+	{
+		close();
+	}
+
+	bool node_t::open(const std::string &path, bool writable)
+	{
+		close();
+		fd = ::open(path.c_str(), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+		return fd >= 0;
+	}
+
+	void node_t::close(void)
+	{
+		if(fd >= 0) {
+			::close(fd);
+			fd = -1;
+		}
+	}
+
+	ssize_t node_t::read(char *buf, std::size_t size) const
+	{
+		if(fd < 0 || size == 0)
+			return -1;
+
+		// sysfs regenerates the attribute on every read from offset 0.
+		ssize_t len = ::pread(fd, buf, size - 1, 0);
+		if(len < 0)
+			return -1;
+		buf[len] = '\0';
+		return len;
+	}
+
+	bool node_t::write(const std::string &val) const
+	{
+		if(fd < 0)
+			return false;
+
+		// Each write is a separate store to the attribute, from offset 0 as for reads.
+		return ::pwrite(fd, val.c_str(), val.size(), 0) == (ssize_t)val.size();
+	}
+
+	bool node_t::read_number(double &val) const
+	{
+		char buf[SYSFS_READ_MAX];
+		ssize_t len = read(buf, sizeof(buf));
+		if(len <= 0)
+			return false;
+		const char *p = buf;
+		return parse_number(p, buf + len, val);
+	}
+
+	std::size_t node_t::read_numbers(double *vals, std::size_t max) const
+	{
+		char buf[SYSFS_READ_MAX];
+		std::size_t count = 0;
+		ssize_t len = read(buf, sizeof(buf));
+		if(len <= 0)
+			return 0;
+
+		const char *p = buf;
+		const char *end = buf + len;
+		while(p < end && count < max) {
+			while(p < end && is_space(*p))
+				p++;
+			const char *token = p;
+			while(p < end && !is_space(*p))
+				p++;
+
+			// Only tokens that are a number and nothing else count.
+			const char *num_end = token;
+			double val;
+			if(parse_number(num_end, p, val) && num_end == p)
+				vals[count++] = val;
+		}
+		return count;
+	}
+
+	/* --------------------------------------- Setting -------------------------------------- */
+	bool setting_t::open(const std::string &path)
+	{
+		setting_m.lock();
+		valid = false;
+		bool ret = node.open(path, true);
+		setting_m.unlock();
+		return ret;
+	}
+
+	bool setting_t::set(const std::string &val)
+	{
+		bool ret = true;
+		setting_m.lock();
+		if(!valid || val != last) {
+			ret = node.write(val);
+			// A failed write leaves the attribute unknown.
+			valid = ret;
+			last = val;
+		}
+		setting_m.unlock();
+		return ret;
+	}
+
+	bool setting_t::holds(const std::string &val)
+	{
+		setting_m.lock();
+		bool ret = valid && val == last;
+		setting_m.unlock();
+		return ret;
+	}
+
+	void setting_t::invalidate(void)
+	{
+		setting_m.lock();
+		valid = false;
+		setting_m.unlock();
+	}
+
+	/* ---------------------------------------- Group --------------------------------------- */
+	unsigned int group_t::add(const std::string &path)
+	{
+		nodes.push_back(std::unique_ptr<node_t>(new node_t(path)));
+		return nodes.size() - 1;
+	}
+
+	double group_t::read(unsigned int idx) const
+	{
+		double val;
+		if(idx >= nodes.size() || !nodes[idx]->read_number(val))
+			return 0;
+		return val;
+	}
+
+	void group_t::read(double *vals) const
+	{
+		for(std::size_t i = 0; i < nodes.size(); i++) {
+			if(!nodes[i]->read_number(vals[i]))
+				vals[i] = 0;
+		}
+	}
+
+	double group_t::sum(void) const
+	{
+		double total = 0, val;
+		for(auto &node : nodes) {
+			if(node->read_number(val))
+				total += val;
+		}
+		return total;
+	}
+} } }
@@ -23,13 +23,37 @@
 #include <string>
 #include <vector>
 #include <mutex>
+#include <memory>
+#include <atomic>
 #include <condition_variable>
 #include "prime_api_t.h"
 #include "prime_api_app_t.h"
+#include "prime_api_pending.h"
+#include "prime_api_registry.h"
 #include "uds.h"
 
 namespace prime { namespace api { namespace app
 {
+	// Latest value of a knob in push mode, kept current by the RTM. Reading it is one atomic load.
+	// Until the first push arrives it holds the last value a get returned, or the registration
+	// value; an RTM without push support never sends one.
+	template<typename T>
+	class knob_slot_t
+	{
+	public:
+		knob_slot_t(T val, boost::function<void(T)> handler) : val(val), pushed(false), handler(handler) {}
+		T get(void) const { return val.load(std::memory_order_acquire); }
+		bool is_pushed(void) const { return pushed.load(std::memory_order_acquire); }
+
+	private:
+		friend class rtm_interface;
+		std::atomic<T> val;
+		std::atomic<bool> pushed;
+		boost::function<void(T)> handler;
+	};
+	typedef knob_slot_t<prime::api::disc_t> knob_disc_slot_t;
+	typedef knob_slot_t<prime::api::cont_t> knob_cont_slot_t;
+
 	class rtm_interface
 	{
 	public:
@@ -121,7 +145,7 @@ namespace prime { namespace api { namespace app
 		
 		~rtm_interface();
 
-		void message_handler(std::vector<char> message);
+		void message_handler(const prime::uds::message_t& message);
 
 		void reg(pid_t proc_id, unsigned long int ur_id);
 		void dereg(pid_t proc_id);
@@ -136,6 +160,17 @@ namespace prime { namespace api { namespace app
 
 		prime::api::disc_t knob_disc_get(knob_disc_t knob);
 		prime::api::cont_t knob_cont_get(knob_cont_t knob);
+		// Non-blocking gets: the handler is called with the value on the socket's thread, so it must
+		// not make a blocking get itself. Any number of gets may be in flight.
+		void knob_disc_get(knob_disc_t knob, boost::function<void(prime::api::disc_t)> handler);
+		void knob_cont_get(knob_cont_t knob, boost::function<void(prime::api::cont_t)> handler);
+
+		// Push mode: the RTM sends every change of the knob, which lands in the returned slot.
+		// Once the first push has arrived, knob_*_get reads the slot instead of asking the RTM.
+		// The handler, if given, is called with each pushed value on the socket's thread. An RTM
+		// that does not support push is not asked, and gets keep going to it.
+		std::shared_ptr<const knob_disc_slot_t> knob_disc_push(knob_disc_t knob, boost::function<void(prime::api::disc_t)> handler = NULL);
+		std::shared_ptr<const knob_cont_slot_t> knob_cont_push(knob_cont_t knob, boost::function<void(prime::api::cont_t)> handler = NULL);
 
 		void knob_disc_dereg(knob_disc_t knob);
 		void knob_cont_dereg(knob_cont_t knob);
@@ -161,6 +196,7 @@ namespace prime { namespace api { namespace app
 		pid_t proc_id;
 		bool default_addrs;
 		bool logger_en;
+		unsigned int proto_version = 0;		// Fast-lane framing agreed with the RTM at registration, 0 = text
 		prime::uds socket;
 		prime::uds ui_socket;
 		prime::uds logger_socket;
@@ -174,10 +210,14 @@ namespace prime { namespace api { namespace app
 		std::mutex mons_cont_m;
 		std::vector<mon_cont_t> mons_cont;
 
-		std::mutex disc_return_m;
-		prime::api::disc_t disc_return;
-		std::mutex cont_return_m;
-		prime::api::cont_t cont_return;
+		prime::api::pending_gets_t<void(prime::api::disc_t)> knob_disc_gets;
+		prime::api::pending_gets_t<void(prime::api::cont_t)> knob_cont_gets;
+
+		// Knobs in push mode, by id. Guarded by knobs_*_m.
+		prime::api::registry_t<unsigned int, std::shared_ptr<knob_disc_slot_t>> knob_disc_slots;
+		prime::api::registry_t<unsigned int, std::shared_ptr<knob_cont_slot_t>> knob_cont_slots;
+		void knob_disc_pushed(unsigned int id, prime::api::disc_t val);
+		void knob_cont_pushed(unsigned int id, prime::api::cont_t val);
 
 		std::mutex knob_disc_return_m;
 		knob_disc_t knob_disc_return;
@@ -197,12 +237,6 @@ namespace prime { namespace api { namespace app
 		std::condition_variable knob_disc_reg_cv;
 		std::mutex knob_cont_reg_m;
 		std::condition_variable knob_cont_reg_cv;
-		std::mutex knob_disc_get_m;
-		std::condition_variable knob_disc_get_cv;
-		bool knob_disc_get_flag;
-		std::mutex knob_cont_get_m;
-		std::condition_variable knob_cont_get_cv;
-		bool knob_cont_get_flag;
 		std::mutex mon_disc_reg_m;
 		std::condition_variable mon_disc_reg_cv;
 		std::mutex mon_cont_reg_m;
@@ -279,7 +313,7 @@ namespace prime { namespace api { namespace app
 		
 		~ui_interface();
 
-		void message_handler(std::vector<char> message);
+		void message_handler(const prime::uds::message_t& message);
 
 		void return_ui_app_start(void);
 		void return_ui_app_stop(void);
@@ -0,0 +1,259 @@
+/* This file is part of the PRiME Framework.
+ *
+ * The PRiME Framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The PRiME Framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the PRiME Framework.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech, Graeme Bragg & James Bantock
+ */
+
+#ifndef PRIME_API_BIN_H
+#define PRIME_API_BIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "prime_api_t.h"
+
+/* Binary fast-lane framing.
+ *
+ * Every binary message is a packed msg_hdr_t followed by one fixed-layout
+ * payload struct. The first byte is PRIME_API_BIN_MAGIC, which can never be
+ * the first byte of a json ('{') or text ('0'-'q', 'A'-'B') message, so receivers can
+ * accept all three formats on the same socket. Binary is only ever sent to a
+ * peer that advertised "proto" >= PRIME_API_BIN_V1 at registration.
+ * Version 2 appends a sequence number to get requests, which the reply echoes,
+ * so several gets can be in flight at once. Version 3 adds monitor snapshots,
+ * the only messages with a variable-length payload, version 4 adds
+ * snapshots published by the device for a monitor subscription, version 5
+ * adds the device's report of each knob set it has applied, version 6 marks
+ * an RTM that pushes knob changes to applications that ask for them, and
+ * version 7 stamps each snapshot reading with when it was taken.
+ * Fields are in host byte order; every supported board is little-endian.
+ */
+namespace prime { namespace api { namespace bin
+{
+	#define PRIME_API_BIN_MAGIC		0xB1
+	#define PRIME_API_BIN_V1		1		// Fixed-layout fast lane
+	#define PRIME_API_BIN_V2		2		// Sequence-tagged gets
+	#define PRIME_API_BIN_V3		3		// Monitor snapshots
+	#define PRIME_API_BIN_V4		4		// Monitor subscriptions
+	#define PRIME_API_BIN_V5		5		// Knob actuation reports
+	#define PRIME_API_BIN_V6		6		// Knob push
+	#define PRIME_API_BIN_V7		7		// Per-reading snapshot timestamps
+	#define PRIME_API_BIN_VERSION	PRIME_API_BIN_V7
+
+	// Most monitors in one snapshot, keeping a return within one datagram at 24 bytes a
+	// V7 record.
+	#define PRIME_API_BIN_SNAPSHOT_MAX	2700
+
+	struct __attribute__((packed)) msg_hdr_t {
+		uint8_t magic;
+		uint8_t version;
+		char type;					// rtm_app_msg_t, app_rtm_msg_t, rtm_dev_msg_t or dev_rtm_msg_t
+		uint8_t reserved;
+		uint64_t ts;
+	};
+
+	/* ---------------------------------- App <-> RTM payloads --------------------------------- */
+	// Knob/monitor min, max, weight & set (APP > RTM) and knob get return & push (RTM > APP)
+	struct __attribute__((packed)) app_disc_msg_t {
+		uint32_t id;
+		int32_t proc_id;
+		prime::api::disc_t val;
+	};
+
+	struct __attribute__((packed)) app_cont_msg_t {
+		uint32_t id;
+		int32_t proc_id;
+		prime::api::cont_t val;
+	};
+
+	// Knob get request (APP > RTM)
+	struct __attribute__((packed)) app_get_msg_t {
+		uint32_t id;
+		int32_t proc_id;
+	};
+
+	/* ---------------------------------- RTM <-> Dev payloads --------------------------------- */
+	// Knob set (RTM > DEV)
+	struct __attribute__((packed)) dev_knob_disc_msg_t {
+		uint32_t id;
+		prime::api::disc_t val;
+	};
+
+	struct __attribute__((packed)) dev_knob_cont_msg_t {
+		uint32_t id;
+		prime::api::cont_t val;
+	};
+
+	// Monitor get request (RTM > DEV)
+	struct __attribute__((packed)) dev_get_msg_t {
+		uint32_t id;
+	};
+
+	// Monitor get return (DEV > RTM)
+	struct __attribute__((packed)) dev_mon_disc_msg_t {
+		uint32_t id;
+		prime::api::disc_t val;
+		prime::api::disc_t min;
+		prime::api::disc_t max;
+	};
+
+	struct __attribute__((packed)) dev_mon_cont_msg_t {
+		uint32_t id;
+		prime::api::cont_t val;
+		prime::api::cont_t min;
+		prime::api::cont_t max;
+	};
+
+	// Monitor snapshot request (RTM > DEV) and return (DEV > RTM). Followed by disc_count
+	// then cont_count records: uint32_t monitor ids in a request, dev_mon_*_msg_t in a return.
+	// A return lists the monitors in request order, leaving out any the device does not have.
+	// A subscription publish (DEV > RTM) has the same layout, with the subscription id as seq.
+	// From V7 each returned record is a ts_msg_t, and the header ts is the oldest of them.
+	struct __attribute__((packed)) dev_snapshot_msg_t {
+		uint32_t seq;
+		uint16_t disc_count;
+		uint16_t cont_count;
+	};
+
+	// Knob set applied (DEV > RTM): the value the set handler was given, microseconds from
+	// that value reaching the device to the handler returning, and how many earlier sets of
+	// the knob were still queued and so were never applied.
+	struct __attribute__((packed)) dev_knob_disc_applied_msg_t {
+		uint32_t id;
+		prime::api::disc_t val;
+		uint32_t latency_us;
+		uint32_t collapsed;
+	};
+
+	struct __attribute__((packed)) dev_knob_cont_applied_msg_t {
+		uint32_t id;
+		prime::api::cont_t val;
+		uint32_t latency_us;
+		uint32_t collapsed;
+	};
+	/* ---------------------------------------------------------------------------------------- */
+
+	// V2 get request or return: the V1 payload followed by the requester's sequence number.
+	// The payload comes first so V1 decoders (e.g. the logger) still read it unchanged.
+	template<typename T>
+	struct __attribute__((packed)) seq_msg_t {
+		T msg;
+		uint32_t seq;
+	};
+
+	// V7 snapshot record: the V3 record followed by when the device read it.
+	template<typename T>
+	struct __attribute__((packed)) ts_msg_t {
+		T msg;
+		uint64_t ts;
+	};
+
+	// Received messages are prime::uds::message_t views; anything with data() and size() works.
+	template<typename M>
+	inline bool is_bin(const M& message)
+	{
+		return message.size() >= sizeof(msg_hdr_t) && (uint8_t)message[0] == PRIME_API_BIN_MAGIC;
+	}
+
+	template<typename M>
+	inline char get_type(const M& message)
+	{
+		return message[offsetof(msg_hdr_t, type)];
+	}
+
+	// Frame a payload behind a header stamped with the version agreed with the peer.
+	// Returns a datagram ready for uds::send_message.
+	template<typename T>
+	inline std::vector<char> encode(char type, const T& payload, uint64_t ts, unsigned int version)
+	{
+		msg_hdr_t hdr;
+		hdr.magic = PRIME_API_BIN_MAGIC;
+		hdr.version = version;
+		hdr.type = type;
+		hdr.reserved = 0;
+		hdr.ts = ts;
+
+		std::vector<char> message(sizeof(msg_hdr_t) + sizeof(T));
+		memcpy(message.data(), &hdr, sizeof(msg_hdr_t));
+		memcpy(message.data() + sizeof(msg_hdr_t), &payload, sizeof(T));
+		return message;
+	}
+
+	// Extract the payload of a framed message. Returns false if the message is too short.
+	template<typename M, typename T>
+	inline bool decode(const M& message, T& payload)
+	{
+		if(message.size() < sizeof(msg_hdr_t) + sizeof(T))
+			return false;
+		memcpy(&payload, message.data() + sizeof(msg_hdr_t), sizeof(T));
+		return true;
+	}
+
+	// Frame a snapshot header and its two record arrays.
+	template<typename D, typename C>
+	inline std::vector<char> encode_snapshot(char type, uint32_t seq, const std::vector<D>& disc, const std::vector<C>& cont, uint64_t ts, unsigned int version)
+	{
+		dev_snapshot_msg_t payload = {seq, (uint16_t)disc.size(), (uint16_t)cont.size()};
+		std::vector<char> message = encode(type, payload, ts, version);
+		std::size_t offset = message.size();
+
+		message.resize(offset + disc.size() * sizeof(D) + cont.size() * sizeof(C));
+		if(!disc.empty())
+			memcpy(message.data() + offset, disc.data(), disc.size() * sizeof(D));
+		if(!cont.empty())
+			memcpy(message.data() + offset + disc.size() * sizeof(D), cont.data(), cont.size() * sizeof(C));
+		return message;
+	}
+
+	// Extract a snapshot header and its records. Returns false if the message is too short.
+	template<typename M, typename D, typename C>
+	inline bool decode_snapshot(const M& message, uint32_t& seq, std::vector<D>& disc, std::vector<C>& cont)
+	{
+		dev_snapshot_msg_t payload;
+		if(!decode(message, payload))
+			return false;
+
+		std::size_t offset = sizeof(msg_hdr_t) + sizeof(dev_snapshot_msg_t);
+		if(message.size() < offset + payload.disc_count * sizeof(D) + payload.cont_count * sizeof(C))
+			return false;
+
+		seq = payload.seq;
+		disc.resize(payload.disc_count);
+		cont.resize(payload.cont_count);
+		if(!disc.empty())
+			memcpy(disc.data(), message.data() + offset, disc.size() * sizeof(D));
+		if(!cont.empty())
+			memcpy(cont.data(), message.data() + offset + disc.size() * sizeof(D), cont.size() * sizeof(C));
+		return true;
+	}
+
+	template<typename M>
+	inline uint64_t get_ts(const M& message)
+	{
+		msg_hdr_t hdr;
+		memcpy(&hdr, message.data(), sizeof(msg_hdr_t));
+		return hdr.ts;
+	}
+
+	// Version both ends can speak, given what the peer advertised at registration.
+	inline unsigned int negotiate(unsigned int peer_version)
+	{
+		return (peer_version < PRIME_API_BIN_VERSION) ? peer_version : PRIME_API_BIN_VERSION;
+	}
+} } }
+
+#endif
@@ -23,10 +23,19 @@
 #include <string>
 #include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <boost/thread.hpp>
 #include "prime_api_t.h"
 #include "prime_api_dev_t.h"
 #include "uds.h"
 #include "util.h"
+#include "prime_api_bin.h"
+#include "prime_api_registry.h"
 #include <boost/property_tree/ptree.hpp>
 #include "args/args.hxx"
 
@@ -147,13 +156,16 @@ namespace prime { namespace api { namespace dev
 		);
 		void remove_knob_cont(unsigned int id);
 
+		// A monitor with an update_us is read from its sensor at most once per update_us. Gets
+		// in between return that reading, stamped with when it was taken.
 		void add_mon_disc(
 			unsigned int id,
 			mon_type_t type,
 			prime::api::disc_t val,
 			prime::api::disc_t min,
 			prime::api::disc_t max,
-			boost::function<prime::api::dev::mon_disc_ret_t(void)> get_handler
+			boost::function<prime::api::dev::mon_disc_ret_t(void)> get_handler,
+			unsigned int update_us = 0
 		);
 		void remove_mon_disc(unsigned int id);
 
@@ -163,22 +175,32 @@ namespace prime { namespace api { namespace dev
 			prime::api::cont_t val,
 			prime::api::cont_t min,
 			prime::api::cont_t max,
-			boost::function<prime::api::dev::mon_cont_ret_t(void)> get_handler
+			boost::function<prime::api::dev::mon_cont_ret_t(void)> get_handler,
+			unsigned int update_us = 0
 		);
 		void remove_mon_cont(unsigned int id);
 
+		// Drop any queued knob sets and wait out one being applied, so a late set cannot undo
+		// a device restoring its own settings on exit.
+		void stop_actuation(void);
+		// Stop actuation and every monitor subscription, and refuse new subscriptions. Both
+		// call the device's handlers from their own threads, so device destructors call this
+		// first, before any member a handler uses is destroyed.
+		void stop(void);
+
 		boost::property_tree::ptree get_architecture(void){ return architecture; }
 		void print_architecture(void);
 
-		std::vector<std::pair<knob_disc_t, boost::function<void(prime::api::disc_t)>>> get_disc_knobs(void){ return knobs_disc; }
-		std::vector<std::pair<knob_cont_t, boost::function<void(prime::api::cont_t)>>> get_cont_knobs(void){ return knobs_cont; }
-		std::vector<std::pair<mon_disc_t, boost::function<prime::api::dev::mon_disc_ret_t(void)>>> get_disc_mons(void){ return mons_disc; }
-		std::vector<std::pair<mon_cont_t, boost::function<prime::api::dev::mon_cont_ret_t(void)>>> get_cont_mons(void){ return mons_cont; }
+		// Knob values are the latest set, including one still queued for its handler.
+		std::vector<std::pair<knob_disc_t, boost::function<void(prime::api::disc_t)>>> get_disc_knobs(void);
+		std::vector<std::pair<knob_cont_t, boost::function<void(prime::api::cont_t)>>> get_cont_knobs(void);
+		std::vector<std::pair<mon_disc_t, boost::function<prime::api::dev::mon_disc_ret_t(void)>>> get_disc_mons(void){ return mons_disc.values(); }
+		std::vector<std::pair<mon_cont_t, boost::function<prime::api::dev::mon_cont_ret_t(void)>>> get_cont_mons(void){ return mons_cont.values(); }
 
 	private:
 		static bool check_addrs(prime::uds::socket_addrs_t *socket_addrs);
 		bool default_addrs;
-		void message_handler(std::vector<char> message);
+		void message_handler(const prime::uds::message_t& message);
 
 		void knob_disc_set(unsigned int id, prime::api::disc_t val);
 		void knob_cont_set(unsigned int id, prime::api::cont_t val);
@@ -198,25 +220,83 @@ namespace prime { namespace api { namespace dev
 		void return_mon_disc_reg(void);
 		void return_mon_cont_reg(void);
 
-		void return_mon_disc_get(unsigned int id);
-		void return_mon_cont_get(unsigned int id);
+		void return_mon_disc_get(unsigned int id, uint32_t seq = 0);
+		void return_mon_cont_get(unsigned int id, uint32_t seq = 0);
+		void return_mon_snapshot(uint32_t seq, std::vector<uint32_t>& disc_ids, std::vector<uint32_t>& cont_ids);
+		// Returns when the oldest of the readings was taken.
+		unsigned long long read_mon_snapshot(
+			std::vector<uint32_t>& disc_ids,
+			std::vector<uint32_t>& cont_ids,
+			std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+			std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals
+		);
+		std::vector<char> encode_mon_snapshot(
+			char type,
+			uint32_t seq,
+			const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+			const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals,
+			unsigned long long ts
+		);
+
+		// Monitor subscriptions: each samples its monitor set on its own thread and publishes
+		// a snapshot every period, or only when a reading moves by more than the threshold.
+		struct mon_sub_t {
+			std::vector<uint32_t> disc_ids;
+			std::vector<uint32_t> cont_ids;
+			unsigned int period_us;
+			prime::api::cont_t threshold;
+			int cpu;
+			boost::thread thread;
+		};
+		std::mutex mon_subs_m;
+		std::map<unsigned int, std::unique_ptr<mon_sub_t>> mon_subs;
+		bool mon_subs_stopped = false;
+
+		void mon_subscribe(unsigned int sub_id, std::unique_ptr<mon_sub_t> sub);
+		void mon_unsubscribe(unsigned int sub_id);
+		void mon_sub_loop(unsigned int sub_id, mon_sub_t *sub);
+
+		// Knob actuation: sets are queued and applied in arrival order by their own thread, so
+		// a slow set handler (a regulator, a governor change) never holds up monitor gets.
+		// A set for a knob that is still queued replaces the queued value in place. The knob's
+		// value is updated when the set is queued, under actuation_m then the knob mutex.
+		// PRIME_MARKER sets skip the queue and are applied on arrival, under the same locks.
+		struct actuation_t {
+			bool cont;
+			unsigned int id;
+			prime::api::disc_t disc_val;
+			prime::api::cont_t cont_val;
+			std::chrono::steady_clock::time_point queued;
+			unsigned int collapsed;
+		};
+		std::mutex actuation_m;
+		std::condition_variable actuation_cv;
+		std::deque<uint64_t> actuation_order;
+		std::unordered_map<uint64_t, actuation_t> actuation_pending;
+		bool actuation_stopped = false;
+		boost::thread actuation_thread;
+
+		void actuation_queue(actuation_t actuation);
+		void actuation_loop(void);
+		void actuation_report(const actuation_t& actuation, unsigned int latency_us);
 
 		void return_arch_get(void);
 		std::string archfilename;
 		bool logger_en;
+		unsigned int proto_version = 0;		// Fast-lane framing agreed with the RTM at registration, 0 = text
 		boost::property_tree::ptree architecture;
 
 		prime::uds socket;
 		prime::uds logger_socket;
 
 		std::mutex knobs_disc_m;
-		std::vector<std::pair<knob_disc_t, boost::function<void(prime::api::disc_t)>>> knobs_disc;
+		prime::api::registry_t<unsigned int, std::pair<knob_disc_t, boost::function<void(prime::api::disc_t)>>> knobs_disc;
 		std::mutex knobs_cont_m;
-		std::vector<std::pair<knob_cont_t, boost::function<void(prime::api::cont_t)>>> knobs_cont;
+		prime::api::registry_t<unsigned int, std::pair<knob_cont_t, boost::function<void(prime::api::cont_t)>>> knobs_cont;
 		std::mutex mons_disc_m;
-		std::vector<std::pair<mon_disc_t, boost::function<prime::api::dev::mon_disc_ret_t(void)>>> mons_disc;
+		prime::api::registry_t<unsigned int, std::pair<mon_disc_t, boost::function<prime::api::dev::mon_disc_ret_t(void)>>> mons_disc;
 		std::mutex mons_cont_m;
-		std::vector<std::pair<mon_cont_t, boost::function<prime::api::dev::mon_cont_ret_t(void)>>> mons_cont;
+		prime::api::registry_t<unsigned int, std::pair<mon_cont_t, boost::function<prime::api::dev::mon_cont_ret_t(void)>>> mons_cont;
 	};
 
 	class ui_interface
@@ -248,7 +328,7 @@ namespace prime { namespace api { namespace dev
 		
 		~ui_interface();
 
-		void message_handler(std::vector<char> message);
+		void message_handler(const prime::uds::message_t& message);
 
 		void return_ui_dev_start(void); //Signal to the UI that the device started cleanly
 		void return_ui_dev_stop(void); //Signal to the UI that the device stopped cleanly
@@ -29,6 +29,7 @@ namespace prime { namespace api { namespace dev
 	struct dev_args_t {
 			bool power = false;
 			bool temp = false;
+			unsigned int power_sample_us = 10000;
 		};
 
 	// Available types of device-level knob
@@ -37,14 +38,23 @@ namespace prime { namespace api { namespace dev
 						PRIME_EN,
 						PRIME_PMC_CNT,
 						PRIME_GOVERNOR,
-						PRIME_FREQ_EN
+						PRIME_FREQ_EN,
+						PRIME_WINDOW,		// Power statistics window, ms
+						PRIME_PERCENTILE,	// Percentile reported by PRIME_POW_PCTL
+						PRIME_MARKER		// Start of a PRIME_ENERGY_SINCE interval
 					};
 
 	// Available types of device-level monitor
 	enum mon_type_t {PRIME_POW,
 						PRIME_TEMP,
 						PRIME_CYCLES,
-						PRIME_PMC
+						PRIME_PMC,
+						PRIME_ENERGY,		// J since the device started sampling power
+						PRIME_ENERGY_SINCE,	// J since the last PRIME_MARKER set
+						PRIME_POW_MEAN,		// W over the PRIME_WINDOW
+						PRIME_POW_MIN,
+						PRIME_POW_MAX,
+						PRIME_POW_PCTL
 					};
 
 	// Device-level discrete knob container
@@ -74,6 +84,8 @@ namespace prime { namespace api { namespace dev
 		prime::api::disc_t min;
 		prime::api::disc_t max;
 		prime::api::disc_t val;
+		unsigned int update_us = 0;		// How often the sensor itself updates, 0 if unknown
+		unsigned long long ts = 0;		// When val was read from the sensor
 	} mon_disc_t;
 
 	// Device-level continuous monitor container
@@ -83,6 +95,8 @@ namespace prime { namespace api { namespace dev
 		prime::api::cont_t min;
 		prime::api::cont_t max;
 		prime::api::cont_t val;
+		unsigned int update_us = 0;		// How often the sensor itself updates, 0 if unknown
+		unsigned long long ts = 0;		// When val was read from the sensor
 	} mon_cont_t;
 	
 	// Monitor return types
@@ -0,0 +1,99 @@
+/* This file is part of the PRiME Framework.
+ *
+ * The PRiME Framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The PRiME Framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the PRiME Framework.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech, Graeme Bragg & James Bantock
+ */
+
+#ifndef PRIME_API_PENDING_H
+#define PRIME_API_PENDING_H
+
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <boost/function.hpp>
+
+namespace prime { namespace api
+{
+	/* Get requests awaiting a reply.
+	 *
+	 * Each request is tagged with a sequence number that a V2 peer echoes in its
+	 * reply. Replies from older peers carry no sequence number (0) and are matched
+	 * to the oldest outstanding request for the same knob or monitor id, which is
+	 * correct because a peer answers its requests in order.
+	 */
+	template<typename S>
+	class pending_gets_t
+	{
+	public:
+		pending_gets_t() : next_seq(0) {}
+
+		// Register a request and return the sequence number to send with it. Never 0.
+		uint32_t add(unsigned int id, boost::function<S> handler)
+		{
+			uint32_t seq;
+			gets_m.lock();
+			if(++next_seq == 0) {
+				next_seq = 1;
+			}
+			seq = next_seq;
+			gets.push_back(get_t{seq, id, handler});
+			gets_m.unlock();
+			return seq;
+		}
+
+		// Remove the request a reply belongs to and return its handler, or an empty handler if none.
+		boost::function<S> take(unsigned int id, uint32_t seq)
+		{
+			boost::function<S> handler;
+			gets_m.lock();
+			for(auto get = gets.begin(); get != gets.end(); get++) {
+				if(seq ? (get->seq == seq) : (get->id == id)) {
+					handler = get->handler;
+					gets.erase(get);
+					break;
+				}
+			}
+			gets_m.unlock();
+			return handler;
+		}
+
+		// Json replies carry no id; they can only belong to the oldest request.
+		boost::function<S> take_oldest(void)
+		{
+			boost::function<S> handler;
+			gets_m.lock();
+			if(!gets.empty()) {
+				handler = gets.front().handler;
+				gets.pop_front();
+			}
+			gets_m.unlock();
+			return handler;
+		}
+
+	private:
+		struct get_t {
+			uint32_t seq;
+			unsigned int id;
+			boost::function<S> handler;
+		};
+
+		std::mutex gets_m;
+		std::list<get_t> gets;
+		uint32_t next_seq;
+	};
+} }
+
+#endif
@@ -0,0 +1,128 @@
+/* This file is part of the PRiME Framework.
+ *
+ * The PRiME Framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The PRiME Framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the PRiME Framework.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech, Graeme Bragg & James Bantock
+ */
+
+#ifndef PRIME_API_REGISTRY_H
+#define PRIME_API_REGISTRY_H
+
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace prime { namespace api
+{
+	/* Registered knobs, monitors or endpoints, indexed by id.
+	 *
+	 * Lookups are a hash probe instead of a scan, so the cost of handling a
+	 * message does not grow with the number of registered entries. Iteration is
+	 * in registration order, as with the vectors this replaces.
+	 *
+	 * The pointer returned by insert() or find() is a handle to the entry: it
+	 * stays valid until that entry is erased, whatever else is added or removed.
+	 * The registry does no locking of its own; callers keep their existing mutex.
+	 */
+	template<typename K, typename T>
+	class registry_t
+	{
+		typedef std::list<std::pair<K, T>> entries_t;
+
+	public:
+		class iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef T value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef T* pointer;
+			typedef T& reference;
+
+			iterator(typename entries_t::iterator it) : it(it) {}
+			T& operator*() const { return it->second; }
+			T* operator->() const { return &it->second; }
+			iterator& operator++() { ++it; return *this; }
+			bool operator==(const iterator& other) const { return it == other.it; }
+			bool operator!=(const iterator& other) const { return it != other.it; }
+			const K& key(void) const { return it->first; }
+
+		private:
+			typename entries_t::iterator it;
+		};
+
+		// Add an entry, or replace the one already registered under the key in place.
+		T* insert(const K& key, const T& val)
+		{
+			auto found = index.find(key);
+			if(found != index.end()) {
+				found->second->second = val;
+				return &found->second->second;
+			}
+			entries.push_back(std::make_pair(key, val));
+			auto entry = std::prev(entries.end());
+			index[key] = entry;
+			return &entry->second;
+		}
+
+		// The entry registered under the key, or NULL.
+		T* find(const K& key)
+		{
+			auto found = index.find(key);
+			return (found == index.end()) ? NULL : &found->second->second;
+		}
+
+		bool erase(const K& key)
+		{
+			auto found = index.find(key);
+			if(found == index.end()) {
+				return false;
+			}
+			entries.erase(found->second);
+			index.erase(found);
+			return true;
+		}
+
+		void clear(void)
+		{
+			index.clear();
+			entries.clear();
+		}
+
+		std::size_t size(void) const { return index.size(); }
+		bool empty(void) const { return index.empty(); }
+		iterator begin(void) { return iterator(entries.begin()); }
+		iterator end(void) { return iterator(entries.end()); }
+
+		// Copy of every entry, in registration order.
+		std::vector<T> values(void) const
+		{
+			std::vector<T> vals;
+			vals.reserve(entries.size());
+			for(auto& entry : entries) {
+				vals.push_back(entry.second);
+			}
+			return vals;
+		}
+
+	private:
+		entries_t entries;
+		std::unordered_map<K, typename entries_t::iterator> index;
+	};
+} }
+
+#endif
@@ -23,12 +23,17 @@
 #include <string>
 #include <memory>
 #include <mutex>
+#include <map>
+#include <set>
 #include <condition_variable>
 #include <boost/property_tree/ptree.hpp>
 #include "uds.h"
 #include "prime_api_t.h"
 #include "prime_api_app_t.h"
 #include "prime_api_dev_t.h"
+#include "prime_api_pending.h"
+#include "prime_api_registry.h"
+#include "prime_api_bin.h"
 
 namespace prime { namespace api { namespace rtm
 {
@@ -341,7 +346,7 @@ namespace prime { namespace api { namespace rtm
 		unsigned int get_unique_mon_id(void);
 
 
-		void message_handler(std::vector<char> message);
+		void message_handler(const prime::uds::message_t& message);
 
 	private:
 		static bool check_addrs(prime::uds::socket_addrs_t *socket_addrs);
@@ -353,8 +358,13 @@ namespace prime { namespace api { namespace rtm
 		void return_mon_disc_reg(prime::api::app::mon_disc_t mon);
 		void return_mon_cont_reg(prime::api::app::mon_cont_t mon);
 
-		void return_knob_disc_get(pid_t proc_id, unsigned int id);
-		void return_knob_cont_get(pid_t proc_id, unsigned int id);
+		void return_knob_disc_get(pid_t proc_id, unsigned int id, uint32_t seq = 0);
+		void return_knob_cont_get(pid_t proc_id, unsigned int id, uint32_t seq = 0);
+		void send_knob_disc(char type, pid_t proc_id, unsigned int id, prime::api::disc_t val, uint32_t seq = 0);
+		void send_knob_cont(char type, pid_t proc_id, unsigned int id, prime::api::cont_t val, uint32_t seq = 0);
+
+		unsigned int app_proto(pid_t proc_id);
+		std::shared_ptr<prime::uds> app_socket(pid_t proc_id);
 
 		boost::function<void(pid_t, unsigned long int)> app_reg_handler;
 		boost::function<void(pid_t)> app_dereg_handler;
@@ -380,20 +390,27 @@ namespace prime { namespace api { namespace rtm
 		boost::function<void(pid_t, unsigned int, prime::api::cont_t)> mon_cont_weight_change_handler;
 		boost::function<void(pid_t, unsigned int, prime::api::cont_t)> mon_cont_val_change_handler;
 
-		std::vector<prime::api::app::knob_disc_t> knobs_disc;
+		// Knob ids are unique across applications, so the id alone is the key.
+		prime::api::registry_t<unsigned int, prime::api::app::knob_disc_t> knobs_disc;
+		std::set<unsigned int> knobs_disc_push;		// Knobs whose app asked for every change
 		std::mutex knobs_disc_m;
-		std::vector<prime::api::app::knob_cont_t> knobs_cont;
+		prime::api::registry_t<unsigned int, prime::api::app::knob_cont_t> knobs_cont;
+		std::set<unsigned int> knobs_cont_push;
 		std::mutex knobs_cont_m;
 		std::vector<prime::api::app::mon_disc_t> mons_disc;
 		std::mutex mons_disc_m;
 		std::vector<prime::api::app::mon_cont_t> mons_cont;
 		std::mutex mons_cont_m;
 
-		std::vector<std::pair<pid_t, std::shared_ptr<prime::uds>>> app_sockets;
+		prime::api::registry_t<pid_t, std::shared_ptr<prime::uds>> app_sockets;
+		prime::api::registry_t<pid_t, unsigned int> app_protos;		// Fast-lane framing agreed with each app, 0 = text
 		std::mutex app_sockets_m;
 
 		bool default_addrs;
 		bool logger_en;
+		bool shm_api = false;				// Offer per-app sockets a shared-memory lane
+		bool shm_busy_poll = false;
+		unsigned int shm_send_timeout_us;
 
 		prime::uds socket;
 		prime::uds logger_socket;
@@ -486,7 +503,7 @@ namespace prime { namespace api { namespace rtm
 
 		~dev_interface();
 
-		void message_handler(std::vector<char> message);
+		void message_handler(const prime::uds::message_t& message);
 
 		unsigned int knob_disc_size(void);
 		unsigned int knob_cont_size(void);
@@ -520,16 +537,60 @@ namespace prime { namespace api { namespace rtm
 
 		prime::api::disc_t mon_disc_get(prime::api::dev::mon_disc_t& mon);
 		prime::api::cont_t mon_cont_get(prime::api::dev::mon_cont_t& mon);
+		// Non-blocking gets: the handler is called with the updated monitor on the socket's thread,
+		// so it must not make a blocking get itself. Any number of gets may be in flight.
+		void mon_disc_get(prime::api::dev::mon_disc_t mon, boost::function<void(prime::api::dev::mon_disc_t)> handler);
+		void mon_cont_get(prime::api::dev::mon_cont_t mon, boost::function<void(prime::api::dev::mon_cont_t)> handler);
+
+		// Read several monitors in one round trip. Values, mins, maxes and timestamps are updated
+		// in place; the returned timestamp is the oldest reading. Devices before binary lane V7
+		// stamp every reading with that one. For a functional or sub unit, pass the monitors of
+		// a prime::util::arch_index_t span, e.g. disc_mons_func_unit(id).to_vector().
+		unsigned long long mon_snapshot_get(std::vector<prime::api::dev::mon_disc_t>& mons_disc, std::vector<prime::api::dev::mon_cont_t>& mons_cont);
+		unsigned long long mon_snapshot_get(std::vector<prime::api::dev::mon_disc_t>& mons_disc);
+		unsigned long long mon_snapshot_get(std::vector<prime::api::dev::mon_cont_t>& mons_cont);
+		void mon_snapshot_get(
+			std::vector<prime::api::dev::mon_disc_t> mons_disc,
+			std::vector<prime::api::dev::mon_cont_t> mons_cont,
+			boost::function<void(std::vector<prime::api::dev::mon_disc_t>, std::vector<prime::api::dev::mon_cont_t>, unsigned long long)> handler
+		);
+
+		// Subscribe to a monitor set. The device samples it every period_us on its own clock, on
+		// cpu if >= 0, and publishes a snapshot each time, or only when a reading moves by more
+		// than threshold. The handler runs on the socket's thread. Devices without subscription
+		// support are polled by the RTM instead. Returns the id to unsubscribe with, or 0 if
+		// period_us is 0.
+		unsigned int mon_subscribe(
+			std::vector<prime::api::dev::mon_disc_t> mons_disc,
+			std::vector<prime::api::dev::mon_cont_t> mons_cont,
+			unsigned int period_us,
+			boost::function<void(std::vector<prime::api::dev::mon_disc_t>, std::vector<prime::api::dev::mon_cont_t>, unsigned long long)> handler,
+			prime::api::cont_t threshold = 0,
+			int cpu = -1
+		);
+		void mon_unsubscribe(unsigned int sub_id);
 
 		void mon_disc_dereg(std::vector<prime::api::dev::mon_disc_t>& mons);
 		void mon_cont_dereg(std::vector<prime::api::dev::mon_cont_t>& mons);
 
 		boost::property_tree::ptree dev_arch_get(void);
 
+		// Called on the socket's thread when the device reports a knob set applied, with the
+		// knob id, the value applied, microseconds from the set reaching the device until it was
+		// applied, and how many earlier sets of the knob were superseded while queued.
+		// Only devices on binary lane V5 or later report.
+		void knob_disc_applied(boost::function<void(unsigned int, prime::api::disc_t, unsigned int, unsigned int)> handler);
+		void knob_cont_applied(boost::function<void(unsigned int, prime::api::cont_t, unsigned int, unsigned int)> handler);
+
 	private:
 		static bool check_addrs(prime::uds::socket_addrs_t *socket_addrs);
 		bool default_addrs;
 		bool logger_en;
+		unsigned int proto_version = 0;		// Fast-lane framing agreed with the device at registration, 0 = text
+
+		std::mutex knob_applied_m;
+		boost::function<void(unsigned int, prime::api::disc_t, unsigned int, unsigned int)> knob_disc_applied_handler;
+		boost::function<void(unsigned int, prime::api::cont_t, unsigned int, unsigned int)> knob_cont_applied_handler;
 
 		std::vector<prime::api::dev::knob_disc_t> knobs_disc;
 		std::mutex knobs_disc_m;
@@ -545,14 +606,48 @@ namespace prime { namespace api { namespace rtm
 
 		boost::property_tree::ptree dev_architecture;
 
-		std::mutex disc_return_m;
-		prime::api::disc_t disc_return;
-		prime::api::disc_t disc_min;
-		prime::api::disc_t disc_max;
-		std::mutex cont_return_m;
-		prime::api::cont_t cont_return;
-		prime::api::cont_t cont_min;
-		prime::api::cont_t cont_max;
+		// Handlers take the returned value, min & max, and when the device read it.
+		prime::api::pending_gets_t<void(prime::api::disc_t, prime::api::disc_t, prime::api::disc_t, unsigned long long)> mon_disc_gets;
+		prime::api::pending_gets_t<void(prime::api::cont_t, prime::api::cont_t, prime::api::cont_t, unsigned long long)> mon_cont_gets;
+		// Snapshots are matched by sequence number only.
+		prime::api::pending_gets_t<void(
+			const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>&,
+			const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>&,
+			unsigned long long)> mon_snapshot_gets;
+
+		// Snapshot records with the time of each reading, whichever version the device sent.
+		bool decode_mon_snapshot(
+			const prime::uds::message_t& message,
+			uint32_t& seq,
+			std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+			std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals
+		);
+		static void apply_mon_snapshot(
+			std::vector<prime::api::dev::mon_disc_t>& mons_disc,
+			std::vector<prime::api::dev::mon_cont_t>& mons_cont,
+			const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+			const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals
+		);
+
+		struct mon_sub_t {
+			std::vector<prime::api::dev::mon_disc_t> mons_disc;
+			std::vector<prime::api::dev::mon_cont_t> mons_cont;
+			boost::function<void(std::vector<prime::api::dev::mon_disc_t>, std::vector<prime::api::dev::mon_cont_t>, unsigned long long)> handler;
+			unsigned int period_us;
+			prime::api::cont_t threshold;
+			boost::thread poll_thread;		// Only for devices without subscription support
+		};
+		std::mutex mon_subs_m;
+		std::map<unsigned int, std::shared_ptr<mon_sub_t>> mon_subs;
+		unsigned int next_sub_id = 0;
+
+		void mon_sub_poll(std::shared_ptr<mon_sub_t> sub);
+
+		void mon_snapshot_fallback(
+			std::vector<prime::api::dev::mon_disc_t> mons_disc,
+			std::vector<prime::api::dev::mon_cont_t> mons_cont,
+			boost::function<void(std::vector<prime::api::dev::mon_disc_t>, std::vector<prime::api::dev::mon_cont_t>, unsigned long long)> handler
+		);
 		std::mutex unsigned_int_return_m;
 		unsigned int unsigned_int_return;
 
@@ -573,13 +668,6 @@ namespace prime { namespace api { namespace rtm
 		std::mutex mon_cont_reg_m;
 		std::condition_variable mon_cont_reg_cv;
 
-		std::mutex mon_disc_get_m;
-		std::condition_variable mon_disc_get_cv;
-		bool mon_disc_get_flag;
-		std::mutex mon_cont_get_m;
-		std::condition_variable mon_cont_get_cv;
-		bool mon_cont_get_flag;
-
 		std::mutex dev_arch_return_m;
 		std::mutex dev_arch_get_m;
 		std::condition_variable dev_arch_get_cv;
@@ -619,7 +707,7 @@ namespace prime { namespace api { namespace rtm
 
 		~ui_interface();
 
-		void message_handler(std::vector<char> message);
+		void message_handler(const prime::uds::message_t& message);
 
 		void return_ui_rtm_start(void); //Signal to the UI that the RTM started cleanly
 		void return_ui_rtm_stop(void); //Signal to the UI that the RTM stopped cleanly
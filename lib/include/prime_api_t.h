@@ -62,7 +62,9 @@ namespace prime { namespace api
 
 	enum rtm_app_msg_t{
 		PRIME_API_APP_RETURN_KNOB_DISC_GET = '0',
-		PRIME_API_APP_RETURN_KNOB_CONT_GET = '1'
+		PRIME_API_APP_RETURN_KNOB_CONT_GET = '1',
+		PRIME_API_APP_KNOB_DISC_PUSH = 'A',		// Below 'g', as for every app message
+		PRIME_API_APP_KNOB_CONT_PUSH = 'B'
 	};
 
 	enum app_rtm_msg_t{
@@ -86,12 +88,17 @@ namespace prime { namespace api
 		PRIME_API_DEV_KNOB_DISC_SET = 'g',
 		PRIME_API_DEV_KNOB_CONT_SET = 'h',
 		PRIME_API_DEV_MON_DISC_GET = 'i',
-		PRIME_API_DEV_MON_CONT_GET = 'j'
+		PRIME_API_DEV_MON_CONT_GET = 'j',
+		PRIME_API_DEV_MON_SNAPSHOT_GET = 'm'		// Binary lane only
 	};
 
 	enum dev_rtm_msg_t{
 		PRIME_API_DEV_RETURN_MON_DISC_GET = 'k',
-		PRIME_API_DEV_RETURN_MON_CONT_GET = 'l'
+		PRIME_API_DEV_RETURN_MON_CONT_GET = 'l',
+		PRIME_API_DEV_RETURN_MON_SNAPSHOT = 'n',		// Binary lane only
+		PRIME_API_DEV_MON_PUBLISH = 'o',				// Binary lane only
+		PRIME_API_DEV_KNOB_DISC_APPLIED = 'p',		// Binary lane only
+		PRIME_API_DEV_KNOB_CONT_APPLIED = 'q'		// Binary lane only
 	};
 
 
@@ -0,0 +1,114 @@
+/* This file is part of the PRiME Framework.
+ *
+ * The PRiME Framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The PRiME Framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the PRiME Framework.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech, Graeme Bragg & James Bantock
+ */
+
+#ifndef RTM_EXECUTOR_H
+#define RTM_EXECUTOR_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace prime { namespace api { namespace rtm
+{
+	/* Runs an RTM's policy off the API receive threads.
+	 *
+	 * API handlers record what changed and post the work here instead of
+	 * running it, so a policy that makes device round trips never holds up the
+	 * socket it was called from. Work runs on the executor's own threads:
+	 *	post()			in posting order.
+	 *	post_latest()	keyed; a post for a key that has not run yet replaces
+	 *					the waiting task, keeping its place in the queue, so a
+	 *					burst of monitor updates runs the policy once, on the
+	 *					last of them.
+	 *	every()			periodically, with deadlines kept on the executor's
+	 *					clock. A run that overruns skips the missed periods
+	 *					rather than running them back to back.
+	 * Due periodic work runs before queued work. No key, and no periodic task,
+	 * ever runs on two threads at once; anything else may when there is more
+	 * than one thread, so the policy still locks its own state.
+	 */
+	class executor_t
+	{
+	public:
+		typedef boost::function<void(void)> task_t;
+
+		executor_t();
+		~executor_t();
+
+		executor_t(const executor_t&) = delete;
+		executor_t& operator=(const executor_t&) = delete;
+
+		void start(unsigned int num_threads = 1);
+		// Waits for running tasks to finish and drops the ones still queued.
+		void stop(void);
+
+		void post(task_t task);
+		void post_latest(uint64_t key, task_t task);
+		// Periodic tasks run until stop().
+		void every(unsigned int period_us, task_t task);
+
+		// Key for the updates of one application monitor.
+		static uint64_t mon_key(pid_t proc_id, unsigned int id);
+
+	private:
+		typedef std::chrono::steady_clock steady_t;
+
+		struct item_t {
+			bool keyed;
+			uint64_t key;
+			task_t task;
+		};
+
+		struct latest_t {
+			task_t task;
+			bool queued = false;	// Has an item in the queue
+			bool running = false;
+			bool again = false;		// Came up while running; requeue when done
+		};
+
+		struct periodic_t {
+			steady_t::time_point due;
+			std::chrono::microseconds period;
+			task_t task;
+			bool running;
+		};
+
+		std::mutex exec_m;
+		std::condition_variable exec_cv;
+		bool stopping;
+		std::deque<item_t> queue;
+		std::unordered_map<uint64_t, latest_t> latest;
+		std::list<periodic_t> timers;
+		std::vector<boost::thread> threads;
+
+		void run(void);
+		bool run_timer(std::unique_lock<std::mutex> &lock);
+		void run_item(std::unique_lock<std::mutex> &lock);
+	};
+} } }
+
+#endif
@@ -0,0 +1,97 @@
+/* This file is part of the PRiME Framework.
+ *
+ * The PRiME Framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The PRiME Framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the PRiME Framework.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Graeme Bragg & James Bantock
+ */
+
+#ifndef _SHM_RING_H
+#define _SHM_RING_H
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include <pthread.h>
+#include <boost/function.hpp>
+
+// Ring capacity in bytes, must be a power of two.
+#define SHM_RING_CAPACITY	(1 << 20)
+
+namespace prime
+{
+	/* Single-consumer message ring in POSIX shared memory.
+	 *
+	 * The receiving process creates the ring for one of its UDS endpoint paths
+	 * and is its only consumer. Senders attach to it by the same path. Producers
+	 * are serialised by a robust mutex in the ring itself, so a ring is safe even
+	 * if two threads or processes send to the same endpoint, and a producer that
+	 * dies holding it does not block the others; the common case is one sender.
+	 * An idle consumer sleeps on a futex in the ring header.
+	 */
+	class shm_ring
+	{
+	public:
+		shm_ring();
+		~shm_ring();
+
+		// Consumer: create the ring for a local endpoint path, replacing any stale one.
+		bool create(std::string endpoint);
+		// Producer: attach to the ring of a remote endpoint path, if its owner created one.
+		bool open(std::string endpoint);
+		// Detach. The owner also marks the ring closed and removes its name.
+		void close(void);
+
+		bool is_open(void) { return hdr != NULL; }
+		// Producer: the owner has closed the ring and will never read it again.
+		bool is_closed(void);
+		// Producer: the owner is still running. A ring whose owner died is never read.
+		bool is_owner_alive(void);
+
+		// Producer: copy one message in. Returns false if it does not fit, so the caller can fall back.
+		bool push(const char *data, std::size_t size);
+
+		// Consumer: hand every pending message to the handler in place, NUL-terminated.
+		// Each message is released once the handler returns. Returns the number handled.
+		std::size_t consume(const boost::function<void(const char*, std::size_t)> &handler);
+		// Consumer: sleep until a message is pushed or timeout_us passes.
+		void wait(unsigned int timeout_us);
+		// Consumer: wake a thread blocked in wait(), e.g. for shutdown.
+		void wake(void);
+
+	private:
+		struct ring_hdr_t
+		{
+			uint32_t magic;
+			uint32_t capacity;
+			int32_t owner_pid;
+			std::atomic<uint32_t> closed;
+			pthread_mutex_t producer_lock;
+			alignas(64) std::atomic<uint64_t> head;			// Written by producers
+			alignas(64) std::atomic<uint64_t> tail;			// Written by the consumer
+			alignas(64) std::atomic<uint32_t> wake_seq;		// Futex word
+			std::atomic<uint32_t> consumer_waiting;
+		};
+
+		static std::string shm_name(std::string endpoint);
+
+		bool owner;
+		std::string name;
+		std::size_t map_size;
+		ring_hdr_t *hdr;
+		char *ring;
+	};
+}
+
+#endif
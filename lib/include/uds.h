@@ -24,11 +24,26 @@
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <queue>
+#include <deque>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
 #include "args/args.hxx"
+#include "shm_ring.h"
+
+// Largest datagram accepted, matching the IP stack.
+#define UDS_MAX_DATAGRAM	65535
+// Largest coalesced logger datagram: the most a UDP datagram can carry over IPv4.
+#define UDS_MAX_BATCH		65507
+// Receive slabs allocated up front per socket. The pool only grows if every slab is held by a consumer.
+#define UDS_RX_SLABS		4
+// First byte of a coalesced logger datagram, followed by [uint32_t length][message] records.
+#define UDS_BATCH_MAGIC		0xB2
 
 namespace prime
 {
@@ -54,6 +69,7 @@ namespace prime
 			std::string logger_local_address;	// Local UDS filename.
 			std::string logger_remote_address;	// Remote UDS filename or remote IP address.
 			unsigned int logger_port;			// Remote logger port.
+			unsigned int logger_batch_us = 1000;	// Coalesce logger messages for at most this long, 0 = off.
 			bool api_addr = false;				// Is the API address present?
 			bool remote_api = false;			// Is the API address remote?
 			std::string api_local_address;		// Local UDS filename.
@@ -64,12 +80,30 @@ namespace prime
 			std::string ui_local_address;		// Local UDS filename.
 			std::string ui_remote_address;		// Remote UDS filename or remote IP address.
 			unsigned int ui_port;				// API port.
+			bool shm_api = false;				// Use shared-memory rings to a co-located API peer?
+			bool shm_busy_poll = false;			// Spin on the receive ring instead of sleeping.
+			unsigned int shm_send_timeout_us = 20000;	// Longest wait for a peer to drain a full ring.
+		};
+
+		// A received datagram. Points into a pooled receive slab that is only valid until the
+		// handler returns. The data is always NUL-terminated at size() so text can be parsed in place.
+		class message_t
+		{
+		public:
+			message_t(const char *data, std::size_t size) : message_data(data), message_size(size) {}
+			const char* data(void) const { return message_data; }
+			std::size_t size(void) const { return message_size; }
+			const char& operator[](std::size_t i) const { return message_data[i]; }
+
+		private:
+			const char *message_data;
+			std::size_t message_size;
 		};
 		
 		uds(
 			prime::uds::socket_layer_t socket_layer,
 			prime::uds::socket_addrs_t *socket_addrs, 
-			boost::function<void(std::vector<char>)> handler = NULL
+			boost::function<void(const prime::uds::message_t&)> handler = NULL
 		);
 		
 		uds(std::string local_filename, std::string remote_filename);
@@ -77,7 +111,10 @@ namespace prime
 		uds(
 			std::string local_filename,
 			std::string remote_filename,
-			boost::function<void(std::vector<char>)> handler
+			boost::function<void(const prime::uds::message_t&)> handler,
+			bool shm = false,
+			bool shm_busy_poll = false,
+			unsigned int shm_send_timeout_us = 20000
 		);
 		
 		uds(
@@ -88,7 +125,7 @@ namespace prime
 		uds(
 			std::string remote_address,
 			unsigned int remote_port,
-			boost::function<void(std::vector<char>)> handler
+			boost::function<void(const prime::uds::message_t&)> handler
 		);
 		
 		uds(
@@ -97,13 +134,20 @@ namespace prime
 		
 		uds(
 			unsigned int local_port,
-			boost::function<void(std::vector<char>)> handler
+			boost::function<void(const prime::uds::message_t&)> handler
 		);
 		
 		~uds();
+
+		// Size the process-wide pool that serves every socket's I/O and handlers, optionally
+		// pinning worker i to cpus[i % cpus.size()]. The pool starts with this many workers and
+		// adds one whenever all of them are blocked in handlers. Only effective before the first
+		// socket is created; returns false once the pool is running.
+		static bool set_io_threads(unsigned int threads, std::vector<unsigned int> cpus = std::vector<unsigned int>());
 		
 		void set_remote_endpoint(std::string remote_filename);
 		void send_message(std::vector<char> &message);
+		void send_message(const char *data, std::size_t size);
 		void send_message_blocking(std::vector<char> &message);
 		bool get_message(std::vector<char> &message);
 		std::string get_endpoints(void);
@@ -114,12 +158,18 @@ namespace prime
 		bool server;
 		char layer;
 		
-		boost::function<void(std::vector<char>)> handler;
+		boost::function<void(const prime::uds::message_t&)> handler;
 
-		std::queue<std::vector<char>> read_queue;
+		std::queue<std::pair<char*, std::size_t>> read_queue;		// Received slab and datagram length
 		std::mutex read_queue_mutex;
 
-		boost::asio::io_service io_service;
+		std::vector<std::unique_ptr<char[]>> rx_slabs;
+		std::vector<char*> rx_free_slabs;
+		std::mutex rx_slabs_m;
+
+		boost::asio::io_service &io_service;					// Shared by every socket in the process
+		boost::asio::io_service::strand strand;				// Serialises this socket's handlers on the pool
+		boost::asio::deadline_timer batch_timer;			// Closes a logger batch, see tx_batch
 		boost::asio::local::datagram_protocol::endpoint local_endpoint;
 		boost::asio::local::datagram_protocol::endpoint remote_endpoint;
 		boost::asio::local::datagram_protocol::endpoint sender_endpoint;
@@ -129,28 +179,74 @@ namespace prime
 		boost::asio::ip::udp::resolver::query udp_query;
 		boost::asio::ip::udp::endpoint udp_local_endpoint;
 		boost::asio::ip::udp::endpoint udp_remote_endpoint;
+		boost::asio::ip::udp::endpoint udp_sender_endpoint;
 		boost::asio::ip::udp::socket udp_socket;
-		
 
-		std::vector<char> receive_buffer;
+		// Outstanding operations on the shared pool that refer to this socket.
+		std::atomic<bool> closing{false};
+		unsigned int pending_ops = 0;
+		std::mutex pending_m;
+		std::condition_variable pending_cv;
 
-		boost::thread io_service_thread;
+		static boost::asio::io_service& get_io_service(void);
+		void op_begin(void);
+		void op_end(void);
+
+		// Shared-memory lane. Local API sockets only; the datagram socket stays open alongside.
+		bool shm = false;
+		bool shm_busy_poll = false;
+		unsigned int shm_send_timeout_us = 20000;
+		bool shm_tx_failed = false;							// Peer stopped draining; socket only from then on
+		std::unique_ptr<prime::shm_ring> shm_rx;			// Created for our local endpoint
+		std::unique_ptr<prime::shm_ring> shm_tx;			// Attached to the peer's endpoint
+		std::mutex shm_tx_m;
+		std::chrono::steady_clock::time_point shm_tx_retry;
+		std::atomic<bool> shm_running{false};
+		boost::thread shm_rx_thread;
+		std::mutex handler_m;								// Handlers are called from both lanes
+
+		void shm_init(void);
+		void shm_open_tx(void);
+		bool shm_send(const char *data, std::size_t size);
+		void shm_rx_loop(void);
+		void shm_deliver(const char *data, std::size_t size);
+
+		char* acquire_slab(void);
+		void release_slab(char *slab);
 
 		void async_receive();
 		void handle_receive(
+			char *slab,
 			const boost::system::error_code& error,
 			std::size_t bytes_transferred
 		);
 		void async_receive_int();
 		void handle_receive_int(
+			char *slab,
 			const boost::system::error_code& error,
 			std::size_t bytes_transferred
 		);
-		void async_write(std::vector<char> packet);
-		void handle_write(
-			const boost::system::error_code& error,
-			std::size_t bytes_transferred
-		);
+		// Outgoing datagrams, flushed together by one strand handler per burst.
+		std::vector<std::vector<char>> tx_queue;
+		std::mutex tx_m;
+		bool tx_flush_pending = false;
+		// Logger coalescing: records accumulate in tx_batch until it fills or batch_timer fires.
+		unsigned int batch_us = 0;
+		std::vector<char> tx_batch;
+		unsigned int tx_batch_count = 0;
+		bool batch_timer_armed = false;
+
+		void queue_batch(void);
+		void handle_batch_timer(const boost::system::error_code& error);
+		void handle_flush(void);
+		// Datagrams the kernel could not take yet, oldest first; later flushes queue behind them.
+		std::deque<std::vector<char>> tx_backlog;
+		bool tx_backlog_waiting = false;
+
+		void write_queue(std::vector<std::vector<char>> &queue);
+		std::size_t send_backlog(void);
+		void handle_writable(const boost::system::error_code& error);
+		void drain_backlog(unsigned int timeout_ms);
 		void sync_write(std::vector<char> packet);
 	};
 }
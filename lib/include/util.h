@@ -32,13 +32,23 @@ extern "C"
 #define UTIL_ARGS_LOGGER_PARAMS() \
 		args::Flag logger_off(optional, "logger_off", "Disable logging of API messages and logger output.", {"lo", "logger_off"}); \
 		args::ValueFlag<std::string> logger_address(optional, "logger_address", "The remote address of the logger", {"la", "logger_address"}); \
-		args::ValueFlag<int> logger_port(optional, "logger_port", "The remote port for the logger", {"lp", "logger_port"}); 
+		args::ValueFlag<int> logger_port(optional, "logger_port", "The remote port for the logger", {"lp", "logger_port"}); \
+		args::ValueFlag<unsigned int> logger_batch(optional, "logger_batch", "Coalesce logger messages for up to this many microseconds, 0 to disable (default 1000).", {"lb", "logger_batch"}); \
+		args::Flag shm(optional, "shm", "Exchange API messages with local peers through shared memory.", {"shm"}); \
+		args::Flag shm_poll(optional, "shm_poll", "Busy-poll the shared-memory ring instead of sleeping (implies --shm).", {"shm_poll"}); \
+		args::ValueFlag<unsigned int> shm_timeout(optional, "shm_timeout", "Wait at most this many microseconds for a peer to drain a full shared-memory ring, then use the socket (default 20000).", {"shm_timeout"}); \
+		args::ValueFlag<unsigned int> io_threads(optional, "io_threads", "Number of threads serving all sockets to start with; more are added if handlers block (default: one per CPU, at least two).", {"io_threads"}); \
+		args::ValueFlagList<unsigned int> io_cpus(optional, "io_cpu", "Pin socket threads to this CPU. Repeat to pin threads round-robin over several.", {"io_cpu"});
 
 #define UTIL_ARGS_LOGGER_PROC() \
 		if(logger_off) { \
 			api_addrs->logger_en = false; \
 			ui_addrs->logger_en = false; \
 		} \
+		if(logger_batch) { \
+			api_addrs->logger_batch_us = args::get(logger_batch); \
+			ui_addrs->logger_batch_us = args::get(logger_batch); \
+		} \
 		if(logger_address) { \
 			api_addrs->logger_addr = true; \
 			api_addrs->remote_logger = true; \
@@ -49,6 +59,16 @@ extern "C"
 			ui_addrs->remote_logger = true; \
 			ui_addrs->logger_remote_address = args::get(logger_address); \
 			ui_addrs->logger_port = args::get(logger_port); \
+		} \
+		if(shm || shm_poll) { \
+			api_addrs->shm_api = true; \
+			api_addrs->shm_busy_poll = shm_poll; \
+		} \
+		if(shm_timeout) { \
+			api_addrs->shm_send_timeout_us = args::get(shm_timeout); \
+		} \
+		if(io_threads || io_cpus) { \
+			prime::uds::set_io_threads(args::get(io_threads), args::get(io_cpus)); \
 		}
 
 
@@ -58,6 +78,11 @@ extern "C"
 			dev_addrs->logger_en = false; \
 			ui_addrs->logger_en = false; \
 		} \
+		if(logger_batch) { \
+			app_addrs->logger_batch_us = args::get(logger_batch); \
+			dev_addrs->logger_batch_us = args::get(logger_batch); \
+			ui_addrs->logger_batch_us = args::get(logger_batch); \
+		} \
 		if(logger_address) { \
 			app_addrs->logger_addr = true; \
 			app_addrs->remote_logger = true; \
@@ -73,11 +98,24 @@ extern "C"
 			ui_addrs->remote_logger = true; \
 			ui_addrs->logger_remote_address = args::get(logger_address); \
 			ui_addrs->logger_port = args::get(logger_port);	\
+		} \
+		if(shm || shm_poll) { \
+			app_addrs->shm_api = true; \
+			app_addrs->shm_busy_poll = shm_poll; \
+			dev_addrs->shm_api = true; \
+			dev_addrs->shm_busy_poll = shm_poll; \
+		} \
+		if(shm_timeout) { \
+			app_addrs->shm_send_timeout_us = args::get(shm_timeout); \
+			dev_addrs->shm_send_timeout_us = args::get(shm_timeout); \
+		} \
+		if(io_threads || io_cpus) { \
+			prime::uds::set_io_threads(args::get(io_threads), args::get(io_cpus)); \
 		}
 
 namespace prime { namespace util
 {    
-    void send_message(prime::uds& sock, std::string message);
+    void send_message(prime::uds& sock, const std::string &message);
     unsigned long long get_timestamp();
    	unsigned int set_id(unsigned int fu_id, unsigned int level1_id, unsigned int level2_id, unsigned int knob_mon_id);
     void get_id(unsigned int full_id, unsigned int& fu_id, unsigned int& level1_id, unsigned int& level2_id, unsigned int& knob_mon_id);
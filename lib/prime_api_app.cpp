@@ -18,11 +18,13 @@
  */
 
 #include "prime_api_app.h"
+#include "prime_api_bin.h"
 #include "uds.h"
 #include "util.h"
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <chrono>
+#include <future>
 #include <vector>
 #include <iostream>
 #include <sstream>
@@ -58,6 +60,11 @@
     prime::util::send_message(socket, json_string); \
     if(logger_en) {	prime::util::send_message(logger_socket, json_string); } }
 
+#define SEND_BIN(type, payload) \
+    { std::vector<char> bin_message = prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version); \
+    socket.send_message(bin_message); \
+    if(logger_en) {	logger_socket.send_message(bin_message); } }
+
 namespace prime { namespace api { namespace app
 {
 	bool rtm_interface::check_addrs(prime::uds::socket_addrs_t *socket_addrs, pid_t proc_id)
@@ -310,13 +317,66 @@ namespace prime { namespace api { namespace app
 	{
 	}
 
-	void rtm_interface::message_handler(std::vector<char> message)
+	void rtm_interface::message_handler(const prime::uds::message_t& message)
 	{
-		if(message[0] != '{') { // Not json, process quickly
+		if(prime::api::bin::is_bin(message)) { // Binary, fixed layout
+			prime::api::bin::seq_msg_t<prime::api::bin::app_disc_msg_t> disc_payload;
+			prime::api::bin::seq_msg_t<prime::api::bin::app_cont_msg_t> cont_payload;
+			boost::function<void(prime::api::disc_t)> disc_handler;
+			boost::function<void(prime::api::cont_t)> cont_handler;
+
+			switch((prime::api::rtm_app_msg_t)prime::api::bin::get_type(message)) {
+
+				case PRIME_API_APP_RETURN_KNOB_DISC_GET:
+					if(!prime::api::bin::decode(message, disc_payload)) {
+						// V1 return, no sequence number.
+						if(!prime::api::bin::decode(message, disc_payload.msg))
+							break;
+						disc_payload.seq = 0;
+					}
+
+					disc_handler = knob_disc_gets.take(disc_payload.msg.id, disc_payload.seq);
+					if(disc_handler)
+						disc_handler(disc_payload.msg.val);
+					break;
+
+				case PRIME_API_APP_RETURN_KNOB_CONT_GET:
+					if(!prime::api::bin::decode(message, cont_payload)) {
+						// V1 return, no sequence number.
+						if(!prime::api::bin::decode(message, cont_payload.msg))
+							break;
+						cont_payload.seq = 0;
+					}
+
+					cont_handler = knob_cont_gets.take(cont_payload.msg.id, cont_payload.seq);
+					if(cont_handler)
+						cont_handler(cont_payload.msg.val);
+					break;
+
+				case PRIME_API_APP_KNOB_DISC_PUSH:
+					if(prime::api::bin::decode(message, disc_payload.msg))
+						knob_disc_pushed(disc_payload.msg.id, disc_payload.msg.val);
+					break;
+
+				case PRIME_API_APP_KNOB_CONT_PUSH:
+					if(prime::api::bin::decode(message, cont_payload.msg))
+						knob_cont_pushed(cont_payload.msg.id, cont_payload.msg.val);
+					break;
+
+				default:
+#ifdef DEBUG
+					std::cout << "Error: unknown binary message type: " << prime::api::bin::get_type(message) << std::endl;
+#endif
+					break;
+			}
+
+		} else if(message[0] != '{') { // Not json, process quickly
 			std::string delim = API_DELIMINATOR;
 			size_t position;
-			std::string val;
-			std::string message_string( (reinterpret_cast<char*>(message.data())) + 1 + delim.length());
+			std::string id, val;
+			std::string message_string( (message.data()) + 1 + delim.length());
+			boost::function<void(prime::api::disc_t)> disc_handler;
+			boost::function<void(prime::api::cont_t)> cont_handler;
 
 #ifdef DEBUG
 			std::cout << "Message String: " << message[0] << API_DELIMINATOR << message_string << std::endl;
@@ -324,34 +384,50 @@ namespace prime { namespace api { namespace app
 			switch((prime::api::rtm_app_msg_t)message[0]) {
 
 				case PRIME_API_APP_RETURN_KNOB_DISC_GET:
-					// 4 fields, only care about the 3rd (val) field, 1st field already discarded.
+					// 4 fields, only care about the 2nd (id) and 3rd (val) fields, 1st field already discarded.
 					position = message_string.find(delim);
+					id = message_string.substr(0, position);
 					message_string.erase(0, position+delim.length());
 					position = message_string.find(delim);
 					val = message_string.substr(0, position);
 
-					disc_return_m.lock();
-					disc_return = std::stoul(val);
-					disc_return_m.unlock();
+					disc_handler = knob_disc_gets.take(std::stoul(id), 0);
+					if(disc_handler)
+						disc_handler(std::stoul(val));
+					break;
 
-					knob_disc_get_flag = true;
-					knob_disc_get_cv.notify_one();
+				case PRIME_API_APP_RETURN_KNOB_CONT_GET:
+					// 4 fields, only care about the 2nd (id) and 3rd (val) fields, 1st field already discarded.
+					position = message_string.find(delim);
+					id = message_string.substr(0, position);
+					message_string.erase(0, position+delim.length());
+					position = message_string.find(delim);
+					val = message_string.substr(0, position);
 
+					cont_handler = knob_cont_gets.take(std::stoul(id), 0);
+					if(cont_handler)
+						cont_handler(std::stof(val));
 					break;
 
-				case PRIME_API_APP_RETURN_KNOB_CONT_GET:
-					// 4 fields, only care about the 3rd (val) field, 1st field already discarded.
+				case PRIME_API_APP_KNOB_DISC_PUSH:
+					// Same fields as a get return.
 					position = message_string.find(delim);
+					id = message_string.substr(0, position);
 					message_string.erase(0, position+delim.length());
 					position = message_string.find(delim);
 					val = message_string.substr(0, position);
 
-					cont_return_m.lock();
-					cont_return = std::stof(val);
-					cont_return_m.unlock();
+					knob_disc_pushed(std::stoul(id), std::stoi(val));
+					break;
 
-					knob_cont_get_flag = true;
-					knob_cont_get_cv.notify_one();
+				case PRIME_API_APP_KNOB_CONT_PUSH:
+					position = message_string.find(delim);
+					id = message_string.substr(0, position);
+					message_string.erase(0, position+delim.length());
+					position = message_string.find(delim);
+					val = message_string.substr(0, position);
+
+					knob_cont_pushed(std::stoul(id), std::stof(val));
 					break;
 
 				default:
@@ -362,7 +438,7 @@ namespace prime { namespace api { namespace app
 			}
 
 		} else {	// This is json, send it to the slow lane.
-			std::string message_string(reinterpret_cast<char*>(message.data()));		// This is 4ms+ faster than the two lines below!
+			std::string message_string(message.data());		// This is 4ms+ faster than the two lines below!
 			//std::string message_string(message.begin(), message.end());
 			//boost::trim_right_if(message_string, boost::is_any_of(std::string("\0", 1)));
 			std::stringstream ss;
@@ -374,12 +450,19 @@ namespace prime { namespace api { namespace app
 			boost::property_tree::ptree data = root.get_child("data");
 
 			if(!message_type.compare("PRIME_API_APP_RETURN_APP_REG")) {
+				// RTMs without binary support do not return a protocol version.
+				proto_version = prime::api::bin::negotiate(data.get<unsigned int>("proto", 0));
 				socket.set_remote_endpoint(std::string("/tmp/rtm.app.") + std::to_string(proc_id) + std::string(".uds"));
+				app_reg_m.lock();
 				app_reg_cv.notify_one();
+				app_reg_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_APP_RETURN_APP_DEREG")) {
+				proto_version = 0;
 				socket.set_remote_endpoint(std::string("/tmp/rtm.app.uds"));
+				app_dereg_m.lock();
 				app_dereg_cv.notify_one();
+				app_dereg_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_APP_RETURN_KNOB_DISC_REG")) {
 				knob_disc_return_m.lock();
@@ -391,7 +474,9 @@ namespace prime { namespace api { namespace app
 				knob_disc_return.max = ((knob_node.get<std::string>("max") == "inf") ? prime::api::PRIME_DISC_MAX : knob_node.get<prime::api::disc_t>("max"));
 				knob_disc_return.val = knob_node.get<prime::api::disc_t>("val");
 				knob_disc_return_m.unlock();
+				knob_disc_reg_m.lock();
 				knob_disc_reg_cv.notify_one();
+				knob_disc_reg_m.unlock();
 				}
 			else if(!message_type.compare("PRIME_API_APP_RETURN_KNOB_CONT_REG")) {
 				knob_cont_return_m.lock();
@@ -403,19 +488,19 @@ namespace prime { namespace api { namespace app
 				knob_cont_return.max = ((knob_node.get<std::string>("max") == "inf") ? prime::api::PRIME_CONT_MAX : knob_node.get<prime::api::cont_t>("max"));
 				knob_cont_return.val = knob_node.get<prime::api::cont_t>("val");
 				knob_cont_return_m.unlock();
+				knob_cont_reg_m.lock();
 				knob_cont_reg_cv.notify_one();
+				knob_cont_reg_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_APP_RETURN_KNOB_DISC_GET")) {
-				disc_return_m.lock();
-				disc_return = data.get<prime::api::disc_t>("");
-				disc_return_m.unlock();
-				knob_disc_get_cv.notify_one();
+				boost::function<void(prime::api::disc_t)> disc_handler = knob_disc_gets.take_oldest();
+				if(disc_handler)
+					disc_handler(data.get<prime::api::disc_t>(""));
 			}
 			else if(!message_type.compare("PRIME_API_APP_RETURN_KNOB_CONT_GET")) {
-				cont_return_m.lock();
-				cont_return = data.get<prime::api::cont_t>("");
-				cont_return_m.unlock();
-				knob_cont_get_cv.notify_one();
+				boost::function<void(prime::api::cont_t)> cont_handler = knob_cont_gets.take_oldest();
+				if(cont_handler)
+					cont_handler(data.get<prime::api::cont_t>(""));
 			}
 			else if(!message_type.compare("PRIME_API_APP_RETURN_MON_DISC_REG")) {
 				mon_disc_return_m.lock();
@@ -428,7 +513,9 @@ namespace prime { namespace api { namespace app
 				mon_disc_return.val = mon_node.get<prime::api::disc_t>("val");
 				mon_disc_return.weight = mon_node.get<prime::api::cont_t>("weight");
 				mon_disc_return_m.unlock();
+				mon_disc_reg_m.lock();
 				mon_disc_reg_cv.notify_one();
+				mon_disc_reg_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_APP_RETURN_MON_CONT_REG")) {
 				mon_cont_return_m.lock();
@@ -441,7 +528,9 @@ namespace prime { namespace api { namespace app
 				mon_cont_return.val = mon_node.get<prime::api::cont_t>("val");
 				mon_cont_return.weight = mon_node.get<prime::api::cont_t>("weight");
 				mon_cont_return_m.unlock();
+				mon_cont_reg_m.lock();
 				mon_cont_reg_cv.notify_one();
+				mon_cont_reg_m.unlock();
 			}
 			else {
 				std::cout << "UNKNOWN MESSAGE TYPE" << std::endl;
@@ -454,10 +543,12 @@ namespace prime { namespace api { namespace app
 		CREATE_JSON_ROOT("PRIME_API_APP_REG");
 		ADD_JSON_DATA("proc_id", proc_id);
 		ADD_JSON_DATA("ur_id", ur_id);
+		ADD_JSON_DATA("proto", PRIME_API_BIN_VERSION);
+		// Held from before the request goes out; the reply handler needs it to notify, so it cannot notify early.
+		std::unique_lock<std::mutex> lock(app_reg_m);
 		SEND_JSON();
 		prime::util::send_message(ui_socket, json_string);
 
-		std::unique_lock<std::mutex> lock(app_reg_m);
 		app_reg_cv.wait(lock);
 	}
 
@@ -465,10 +556,10 @@ namespace prime { namespace api { namespace app
 	{
 		CREATE_JSON_ROOT("PRIME_API_APP_DEREG");
 		ADD_JSON_DATA("proc_id", proc_id);
+		std::unique_lock<std::mutex> lock(app_dereg_m);
 		SEND_JSON();
 		prime::util::send_message(ui_socket, json_string);
 
-		std::unique_lock<std::mutex> lock(app_dereg_m);
 		app_dereg_cv.wait(lock);
 	}
 
@@ -480,9 +571,9 @@ namespace prime { namespace api { namespace app
 		ADD_JSON_DATA("min", min);
 		ADD_JSON_DATA("max", max);
 		ADD_JSON_DATA("val", val);
+		std::unique_lock<std::mutex> lock(knob_disc_reg_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(knob_disc_reg_m);
 		knob_disc_reg_cv.wait(lock);
 
 		knob_disc_return_m.lock();
@@ -500,9 +591,9 @@ namespace prime { namespace api { namespace app
 		ADD_JSON_DATA("min", min);
 		ADD_JSON_DATA("max", max);
 		ADD_JSON_DATA("val", val);
+		std::unique_lock<std::mutex> lock(knob_cont_reg_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(knob_cont_reg_m);
 		knob_cont_reg_cv.wait(lock);
 
 		knob_cont_return_m.lock();
@@ -517,6 +608,12 @@ namespace prime { namespace api { namespace app
 		// Five fields: Type, ID, Val, PID, TS
 		char type = PRIME_API_APP_KNOB_DISC_MIN;
 
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::app_disc_msg_t payload = {knob.id, knob.proc_id, min};
+			SEND_BIN(type, payload);
+			return;
+		}
+
 		std::stringstream ss;
 
 		ss << type << API_DELIMINATOR << std::to_string((unsigned int)knob.id) << API_DELIMINATOR << std::to_string((unsigned int)min) << API_DELIMINATOR << std::to_string((unsigned int)knob.proc_id) << API_DELIMINATOR << prime::util::get_timestamp();
@@ -535,6 +632,12 @@ namespace prime { namespace api { namespace app
 		// Five fields: Type, ID, Val, PID, TS
 		char type = PRIME_API_APP_KNOB_DISC_MAX;
 
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::app_disc_msg_t payload = {knob.id, knob.proc_id, max};
+			SEND_BIN(type, payload);
+			return;
+		}
+
 		std::stringstream ss;
 
 		ss << type << API_DELIMINATOR << std::to_string((unsigned int)knob.id) << API_DELIMINATOR << std::to_string((unsigned int)max) << API_DELIMINATOR << std::to_string((unsigned int)knob.proc_id) << API_DELIMINATOR << prime::util::get_timestamp();
@@ -553,6 +656,12 @@ namespace prime { namespace api { namespace app
 		// Five fields: Type, ID, Val, PID, TS
 		char type = PRIME_API_APP_KNOB_CONT_MIN;
 
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::app_cont_msg_t payload = {knob.id, knob.proc_id, min};
+			SEND_BIN(type, payload);
+			return;
+		}
+
 		std::stringstream ss;
 
 		ss << type << API_DELIMINATOR << std::to_string((unsigned int)knob.id) << API_DELIMINATOR << std::to_string((float)min) << API_DELIMINATOR << std::to_string((unsigned int)knob.proc_id) << API_DELIMINATOR << prime::util::get_timestamp();
@@ -571,6 +680,12 @@ namespace prime { namespace api { namespace app
 		// Five fields: Type, ID, Val, PID, TS
 		char type = PRIME_API_APP_KNOB_CONT_MAX;
 
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::app_cont_msg_t payload = {knob.id, knob.proc_id, max};
+			SEND_BIN(type, payload);
+			return;
+		}
+
 		std::stringstream ss;
 
 		ss << type << API_DELIMINATOR << std::to_string((unsigned int)knob.id) << API_DELIMINATOR << std::to_string((float)max) << API_DELIMINATOR << std::to_string((unsigned int)knob.proc_id) << API_DELIMINATOR << prime::util::get_timestamp();
@@ -586,62 +701,156 @@ namespace prime { namespace api { namespace app
 
 	prime::api::disc_t rtm_interface::knob_disc_get(knob_disc_t knob)
 	{
-		// Four fields: Type, ID, PID, TS
-		char type = PRIME_API_APP_KNOB_DISC_GET;
+		std::promise<prime::api::disc_t> result;
+		std::future<prime::api::disc_t> value = result.get_future();
+		knob_disc_get(knob, [&result](prime::api::disc_t val) { result.set_value(val); });
+		return value.get();
+	}
 
-		std::stringstream ss;
+	void rtm_interface::knob_disc_get(knob_disc_t knob, boost::function<void(prime::api::disc_t)> handler)
+	{
+		std::shared_ptr<knob_disc_slot_t> slot;
+		knobs_disc_m.lock();
+		auto slot_it = knob_disc_slots.find(knob.id);
+		if(slot_it)
+			slot = *slot_it;
+		knobs_disc_m.unlock();
+
+		// Pushed knobs are always current locally. Until then, a get also refreshes the slot.
+		if(slot && slot->is_pushed()) {
+			handler(slot->get());
+			return;
+		}
+		if(slot) {
+			boost::function<void(prime::api::disc_t)> get_handler = handler;
+			handler = [slot, get_handler](prime::api::disc_t val) {
+				if(!slot->is_pushed())
+					slot->val.store(val, std::memory_order_release);
+				get_handler(val);
+			};
+		}
 
-		ss << type << API_DELIMINATOR << knob.id << API_DELIMINATOR << knob.proc_id << API_DELIMINATOR << prime::util::get_timestamp();
-		std::string json_string = ss.str();
 
-		knob_disc_get_flag = false;
-		prime::util::send_message(socket, json_string);
-		if(logger_en) {
-			prime::util::send_message(logger_socket, json_string);
-		}
+		// Four fields: Type, ID, PID, TS
+		char type = PRIME_API_APP_KNOB_DISC_GET;
 
-		std::unique_lock<std::mutex> lock(knob_disc_get_m);
-		while(!knob_disc_get_flag){
-			knob_disc_get_cv.wait(lock);
-		}
+		uint32_t seq = knob_disc_gets.add(knob.id, handler);
+		if(proto_version >= PRIME_API_BIN_V2) {
+			prime::api::bin::seq_msg_t<prime::api::bin::app_get_msg_t> payload = {{knob.id, knob.proc_id}, seq};
+			SEND_BIN(type, payload);
+		} else if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::app_get_msg_t payload = {knob.id, knob.proc_id};
+			SEND_BIN(type, payload);
+		} else {
+			std::stringstream ss;
 
-		disc_return_m.lock();
-		auto result = disc_return;
-		disc_return_m.unlock();
+			ss << type << API_DELIMINATOR << knob.id << API_DELIMINATOR << knob.proc_id << API_DELIMINATOR << prime::util::get_timestamp();
+			std::string json_string = ss.str();
 
-		return result;
+			prime::util::send_message(socket, json_string);
+			if(logger_en) {
+				prime::util::send_message(logger_socket, json_string);
+			}
+		}
 	}
 
 	prime::api::cont_t rtm_interface::knob_cont_get(knob_cont_t knob)
 	{
+		std::promise<prime::api::cont_t> result;
+		std::future<prime::api::cont_t> value = result.get_future();
+		knob_cont_get(knob, [&result](prime::api::cont_t val) { result.set_value(val); });
+		return value.get();
+	}
+
+	void rtm_interface::knob_cont_get(knob_cont_t knob, boost::function<void(prime::api::cont_t)> handler)
+	{
+		std::shared_ptr<knob_cont_slot_t> slot;
+		knobs_cont_m.lock();
+		auto slot_it = knob_cont_slots.find(knob.id);
+		if(slot_it)
+			slot = *slot_it;
+		knobs_cont_m.unlock();
+
+		// Pushed knobs are always current locally. Until then, a get also refreshes the slot.
+		if(slot && slot->is_pushed()) {
+			handler(slot->get());
+			return;
+		}
+		if(slot) {
+			boost::function<void(prime::api::cont_t)> get_handler = handler;
+			handler = [slot, get_handler](prime::api::cont_t val) {
+				if(!slot->is_pushed())
+					slot->val.store(val, std::memory_order_release);
+				get_handler(val);
+			};
+		}
+
+
 		// Four fields: Type, ID, PID, TS
 		char type = PRIME_API_APP_KNOB_CONT_GET;
 
-		std::stringstream ss;
+		uint32_t seq = knob_cont_gets.add(knob.id, handler);
+		if(proto_version >= PRIME_API_BIN_V2) {
+			prime::api::bin::seq_msg_t<prime::api::bin::app_get_msg_t> payload = {{knob.id, knob.proc_id}, seq};
+			SEND_BIN(type, payload);
+		} else if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::app_get_msg_t payload = {knob.id, knob.proc_id};
+			SEND_BIN(type, payload);
+		} else {
+			std::stringstream ss;
 
-		ss << type << API_DELIMINATOR << knob.id << API_DELIMINATOR << knob.proc_id << API_DELIMINATOR << prime::util::get_timestamp();
-		std::string json_string = ss.str();
+			ss << type << API_DELIMINATOR << knob.id << API_DELIMINATOR << knob.proc_id << API_DELIMINATOR << prime::util::get_timestamp();
+			std::string json_string = ss.str();
 
-		knob_cont_get_flag = false;
-		prime::util::send_message(socket, json_string);
-		if(logger_en) {
-			prime::util::send_message(logger_socket, json_string);
+			prime::util::send_message(socket, json_string);
+			if(logger_en) {
+				prime::util::send_message(logger_socket, json_string);
+			}
 		}
+	}
 
-		std::unique_lock<std::mutex> lock(knob_cont_get_m);
-		while(!knob_cont_get_flag){
-			knob_cont_get_cv.wait(lock);
+	std::shared_ptr<const knob_disc_slot_t> rtm_interface::knob_disc_push(knob_disc_t knob, boost::function<void(prime::api::disc_t)> handler)
+	{
+		std::shared_ptr<knob_disc_slot_t> slot = std::make_shared<knob_disc_slot_t>(knob.val, handler);
+		knobs_disc_m.lock();
+		knob_disc_slots.insert(knob.id, slot);
+		knobs_disc_m.unlock();
+
+		// The RTM replies with the current value, then sends every change.
+		if(proto_version >= PRIME_API_BIN_V6) {
+			CREATE_JSON_ROOT("PRIME_API_APP_KNOB_DISC_PUSH");
+			ADD_JSON_DATA("proc_id", knob.proc_id);
+			ADD_JSON_DATA("id", knob.id);
+			SEND_JSON();
 		}
 
-		cont_return_m.lock();
-		auto result = cont_return;
-		cont_return_m.unlock();
+		return slot;
+	}
 
-		return result;
+	void rtm_interface::knob_disc_pushed(unsigned int id, prime::api::disc_t val)
+	{
+		std::shared_ptr<knob_disc_slot_t> slot;
+		knobs_disc_m.lock();
+		auto slot_it = knob_disc_slots.find(id);
+		if(slot_it)
+			slot = *slot_it;
+		knobs_disc_m.unlock();
+
+		if(!slot)
+			return;
+
+		slot->val.store(val, std::memory_order_release);
+		slot->pushed.store(true, std::memory_order_release);
+		if(slot->handler)
+			slot->handler(val);
 	}
 
 	void rtm_interface::knob_disc_dereg(knob_disc_t knob)
 	{
+		knobs_disc_m.lock();
+		knob_disc_slots.erase(knob.id);
+		knobs_disc_m.unlock();
+
 		CREATE_JSON_ROOT("PRIME_API_APP_KNOB_DISC_DEREG");
 		boost::property_tree::ptree knob_node;
 		knob_node.put("proc_id", knob.proc_id);
@@ -654,8 +863,48 @@ namespace prime { namespace api { namespace app
 		SEND_JSON();
 	}
 
+	std::shared_ptr<const knob_cont_slot_t> rtm_interface::knob_cont_push(knob_cont_t knob, boost::function<void(prime::api::cont_t)> handler)
+	{
+		std::shared_ptr<knob_cont_slot_t> slot = std::make_shared<knob_cont_slot_t>(knob.val, handler);
+		knobs_cont_m.lock();
+		knob_cont_slots.insert(knob.id, slot);
+		knobs_cont_m.unlock();
+
+		// The RTM replies with the current value, then sends every change.
+		if(proto_version >= PRIME_API_BIN_V6) {
+			CREATE_JSON_ROOT("PRIME_API_APP_KNOB_CONT_PUSH");
+			ADD_JSON_DATA("proc_id", knob.proc_id);
+			ADD_JSON_DATA("id", knob.id);
+			SEND_JSON();
+		}
+
+		return slot;
+	}
+
+	void rtm_interface::knob_cont_pushed(unsigned int id, prime::api::cont_t val)
+	{
+		std::shared_ptr<knob_cont_slot_t> slot;
+		knobs_cont_m.lock();
+		auto slot_it = knob_cont_slots.find(id);
+		if(slot_it)
+			slot = *slot_it;
+		knobs_cont_m.unlock();
+
+		if(!slot)
+			return;
+
+		slot->val.store(val, std::memory_order_release);
+		slot->pushed.store(true, std::memory_order_release);
+		if(slot->handler)
+			slot->handler(val);
+	}
+
 	void rtm_interface::knob_cont_dereg(knob_cont_t knob)
 	{
+		knobs_cont_m.lock();
+		knob_cont_slots.erase(knob.id);
+		knobs_cont_m.unlock();
+
 		CREATE_JSON_ROOT("PRIME_API_APP_KNOB_CONT_DEREG");
 		boost::property_tree::ptree knob_node;
 		knob_node.put("proc_id", knob.proc_id);
@@ -676,10 +925,10 @@ namespace prime { namespace api { namespace app
 		ADD_JSON_DATA("min", min);
 		ADD_JSON_DATA("max", max);
 		ADD_JSON_DATA("weight", weight);
+		std::unique_lock<std::mutex> lock(mon_disc_reg_m);
 		SEND_JSON();
 		prime::util::send_message(ui_socket, json_string);
 
-		std::unique_lock<std::mutex> lock(mon_disc_reg_m);
 		mon_disc_reg_cv.wait(lock);
 
 		mon_disc_return_m.lock();
@@ -697,10 +946,10 @@ namespace prime { namespace api { namespace app
 		ADD_JSON_DATA("min", min);
 		ADD_JSON_DATA("max", max);
 		ADD_JSON_DATA("weight", weight);
+		std::unique_lock<std::mutex> lock(mon_cont_reg_m);
 		SEND_JSON();
 		prime::util::send_message(ui_socket, json_string);
 
-		std::unique_lock<std::mutex> lock(mon_cont_reg_m);
 		mon_cont_reg_cv.wait(lock);
 
 		mon_cont_return_m.lock();
@@ -823,6 +1072,12 @@ namespace prime { namespace api { namespace app
 		// Five fields: Type, ID, Val, PID, TS
 		char type = PRIME_API_APP_MON_DISC_SET;
 
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::app_disc_msg_t payload = {mon.id, mon.proc_id, val};
+			SEND_BIN(type, payload);
+			return;
+		}
+
 		std::stringstream ss;
 		ss << type << API_DELIMINATOR << mon.id << API_DELIMINATOR << val << API_DELIMINATOR << mon.proc_id << API_DELIMINATOR << util::get_timestamp();
 		std::string json_string = ss.str();
@@ -840,6 +1095,12 @@ namespace prime { namespace api { namespace app
 		// Five fields: Type, ID, Val, PID, TS
 		char type = PRIME_API_APP_MON_CONT_SET;
 
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::app_cont_msg_t payload = {mon.id, mon.proc_id, val};
+			SEND_BIN(type, payload);
+			return;
+		}
+
 		std::stringstream ss;
 		ss << type << API_DELIMINATOR << mon.id << API_DELIMINATOR << val << API_DELIMINATOR << mon.proc_id << API_DELIMINATOR << util::get_timestamp();
 		std::string json_string = ss.str();
@@ -1023,9 +1284,9 @@ namespace prime { namespace api { namespace app
 	{
 	}
 
-	void ui_interface::message_handler(std::vector<char> message)
+	void ui_interface::message_handler(const prime::uds::message_t& message)
 	{
-		std::string message_string(reinterpret_cast<char*>(message.data()));		// This is 4ms+ faster than the two lines below!
+		std::string message_string(message.data());		// This is 4ms+ faster than the two lines below!
 		//std::string message_string(message.begin(), message.end());
 		//boost::trim_right_if(message_string, boost::is_any_of(std::string("\0", 1)));
 		std::stringstream ss;
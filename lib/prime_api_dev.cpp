@@ -18,9 +18,11 @@
  */
 
 #include "prime_api_dev.h"
+#include "prime_api_bin.h"
 #include "uds.h"
 #include "util.h"
 #include <chrono>
+#include <cmath>
 #include <vector>
 #include <iostream>
 #include <iomanip>
@@ -60,8 +62,32 @@
 	prime::util::send_message(socket, json_string); \
     if(logger_en) {	prime::util::send_message(logger_socket, json_string); } }
 
+#define SEND_BIN(type, payload) \
+	SEND_BIN_TS(type, payload, prime::util::get_timestamp())
+
+#define SEND_BIN_TS(type, payload, ts) \
+	{ std::vector<char> bin_message = prime::api::bin::encode(type, payload, ts, proto_version); \
+	socket.send_message(bin_message); \
+	if(logger_en) {	logger_socket.send_message(bin_message); } }
+
 namespace prime { namespace api { namespace dev
 {
+	// Called with the monitor's registry locked. The sensor is only read once its last reading
+	// is at least one update interval old; until then that reading is returned as it was.
+	template<typename M, typename R>
+	static M& read_mon(std::pair<M, boost::function<R(void)>>& mon)
+	{
+		unsigned long long now = prime::util::get_timestamp();
+		if(!mon.first.update_us || now < mon.first.ts || now - mon.first.ts >= mon.first.update_us) {
+			R ret = mon.second();
+			mon.first.val = ret.val;
+			mon.first.min = ret.min;
+			mon.first.max = ret.max;
+			mon.first.ts = now;
+		}
+		return mon.first;
+	}
+
 	int parse_cli(std::string device_name, prime::uds::socket_addrs_t* api_addrs, prime::uds::socket_addrs_t* ui_addrs, prime::api::dev::dev_args_t* args, int argc, const char * argv[])
 	{
 		args::ArgumentParser parser(device_name + " Device.","PRiME Project\n");
@@ -70,6 +96,7 @@ namespace prime { namespace api { namespace dev
 		args::Group optional(parser, "All of these arguments are optional:", args::Group::Validators::DontCare);
 		//args::Flag arg_temp(optional, "temp", "Enable steady state temperature readings for each operating point", {'t', "temp"});
 		args::Flag arg_power(optional, "power", "Log power at 4Hz intervals", {'p', "power"});
+		args::ValueFlag<unsigned int> arg_power_sample(optional, "power_sample", "Sample power every this many microseconds for the energy & power statistics monitors (default 10000).", {"ps", "power_sample"});
 		
 		UTIL_ARGS_LOGGER_PARAMS();
 
@@ -92,6 +119,8 @@ namespace prime { namespace api { namespace dev
 
 		//args->temp = arg_temp;
 		args->power = arg_power;
+		if(arg_power_sample)
+			args->power_sample_us = args::get(arg_power_sample);
 
 		return 0;
 	}
@@ -366,17 +395,77 @@ namespace prime { namespace api { namespace dev
 
 	rtm_interface::~rtm_interface()
 	{
+		// Actuation and sampling threads send on our sockets, so stop them first.
+		stop();
 	}
 
-	void rtm_interface::message_handler(std::vector<char> message)
+	void rtm_interface::stop(void)
 	{
+		stop_actuation();
+
+		std::vector<unsigned int> sub_ids;
+		mon_subs_m.lock();
+		mon_subs_stopped = true;
+		for(auto& sub : mon_subs)
+			sub_ids.push_back(sub.first);
+		mon_subs_m.unlock();
 
+		for(auto sub_id : sub_ids)
+			mon_unsubscribe(sub_id);
+	}
 
-		if(message[0] != '{') { // Not json, process quickly
+	void rtm_interface::message_handler(const prime::uds::message_t& message)
+	{
+		if(prime::api::bin::is_bin(message)) { // Binary, fixed layout
+			prime::api::bin::dev_knob_disc_msg_t knob_disc_payload;
+			prime::api::bin::dev_knob_cont_msg_t knob_cont_payload;
+			prime::api::bin::dev_get_msg_t get_payload;
+			prime::api::bin::seq_msg_t<prime::api::bin::dev_get_msg_t> get_seq_payload;
+			uint32_t snapshot_seq;
+			std::vector<uint32_t> snapshot_disc_ids, snapshot_cont_ids;
+
+			switch((prime::api::rtm_dev_msg_t)prime::api::bin::get_type(message)) {
+				case PRIME_API_DEV_KNOB_DISC_SET:
+					if(prime::api::bin::decode(message, knob_disc_payload))
+						rtm_interface::knob_disc_set(knob_disc_payload.id, knob_disc_payload.val);
+					break;
+
+				case PRIME_API_DEV_KNOB_CONT_SET:
+					if(prime::api::bin::decode(message, knob_cont_payload))
+						rtm_interface::knob_cont_set(knob_cont_payload.id, knob_cont_payload.val);
+					break;
+
+				case PRIME_API_DEV_MON_DISC_GET:
+					if(prime::api::bin::decode(message, get_seq_payload))
+						rtm_interface::return_mon_disc_get(get_seq_payload.msg.id, get_seq_payload.seq);
+					else if(prime::api::bin::decode(message, get_payload))
+						rtm_interface::return_mon_disc_get(get_payload.id);
+					break;
+
+				case PRIME_API_DEV_MON_CONT_GET:
+					if(prime::api::bin::decode(message, get_seq_payload))
+						rtm_interface::return_mon_cont_get(get_seq_payload.msg.id, get_seq_payload.seq);
+					else if(prime::api::bin::decode(message, get_payload))
+						rtm_interface::return_mon_cont_get(get_payload.id);
+					break;
+
+				case PRIME_API_DEV_MON_SNAPSHOT_GET:
+					if(prime::api::bin::decode_snapshot(message, snapshot_seq, snapshot_disc_ids, snapshot_cont_ids))
+						rtm_interface::return_mon_snapshot(snapshot_seq, snapshot_disc_ids, snapshot_cont_ids);
+					break;
+
+				default:
+#ifdef DEBUG
+					std::cout << "Error: unknown binary message type: " << prime::api::bin::get_type(message) << std::endl;
+#endif
+					break;
+			}
+
+		} else if(message[0] != '{') { // Not json, process quickly
 			std::string delim = API_DELIMINATOR;
 			size_t position;
 			std::string id, val, type;
-			std::string message_string( (reinterpret_cast<char*>(message.data())) + 1 + delim.length());		// This is 4ms+ faster than the two lines below!
+			std::string message_string( (message.data()) + 1 + delim.length());		// This is 4ms+ faster than the two lines below!
 
 #ifdef DEBUG
 			std::string ts;
@@ -449,7 +538,7 @@ namespace prime { namespace api { namespace dev
 			}
 
 		} else {	// This is json, send it to the slow lane.
-			std::string message_string(reinterpret_cast<char*>(message.data()));		// This is 4ms+ faster than the two lines below!
+			std::string message_string(message.data());		// This is 4ms+ faster than the two lines below!
 			//std::string message_string(message.begin(), message.end());
 			//boost::trim_right_if(message_string, boost::is_any_of(std::string("\0", 1)));
 			std::stringstream ss;
@@ -469,10 +558,14 @@ namespace prime { namespace api { namespace dev
 			}
 			else if(!message_type.compare("PRIME_API_DEV_KNOB_DISC_REG")) {
 				boost::property_tree::ptree data_node = root.get_child("data");
+				// RTMs without binary support do not send a protocol version.
+				proto_version = prime::api::bin::negotiate(data_node.get<unsigned int>("proto", 0));
 				rtm_interface::return_knob_disc_reg();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_KNOB_CONT_REG")) {
 				boost::property_tree::ptree data_node = root.get_child("data");
+				// RTMs without binary support do not send a protocol version.
+				proto_version = prime::api::bin::negotiate(data_node.get<unsigned int>("proto", 0));
 				rtm_interface::return_knob_cont_reg();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_KNOB_DISC_SET")) {
@@ -499,10 +592,14 @@ namespace prime { namespace api { namespace dev
 			}
 			else if(!message_type.compare("PRIME_API_DEV_MON_DISC_REG")) {
 				boost::property_tree::ptree data_node = root.get_child("data");
+				// RTMs without binary support do not send a protocol version.
+				proto_version = prime::api::bin::negotiate(data_node.get<unsigned int>("proto", 0));
 				rtm_interface::return_mon_disc_reg();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_MON_CONT_REG")) {
 				boost::property_tree::ptree data_node = root.get_child("data");
+				// RTMs without binary support do not send a protocol version.
+				proto_version = prime::api::bin::negotiate(data_node.get<unsigned int>("proto", 0));
 				rtm_interface::return_mon_cont_reg();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_MON_DISC_GET")) {
@@ -520,6 +617,22 @@ namespace prime { namespace api { namespace dev
 			else if(!message_type.compare("PRIME_API_DEV_ARCH_GET")) {
 				rtm_interface::return_arch_get();
 			}
+			else if(!message_type.compare("PRIME_API_DEV_MON_SUBSCRIBE")) {
+				boost::property_tree::ptree data_node = root.get_child("data");
+				std::unique_ptr<mon_sub_t> sub(new mon_sub_t);
+				for(auto& id : data_node.get_child("disc_ids"))
+					sub->disc_ids.push_back(id.second.get_value<uint32_t>());
+				for(auto& id : data_node.get_child("cont_ids"))
+					sub->cont_ids.push_back(id.second.get_value<uint32_t>());
+				sub->period_us = data_node.get<unsigned int>("period_us");
+				sub->threshold = data_node.get<prime::api::cont_t>("threshold", 0);
+				sub->cpu = data_node.get<int>("cpu", -1);
+				rtm_interface::mon_subscribe(data_node.get<unsigned int>("sub_id"), std::move(sub));
+			}
+			else if(!message_type.compare("PRIME_API_DEV_MON_UNSUBSCRIBE")) {
+				boost::property_tree::ptree data_node = root.get_child("data");
+				rtm_interface::mon_unsubscribe(data_node.get<unsigned int>("sub_id"));
+			}
 
 			else {
 				std::cout << "UNKNOWN MESSAGE TYPE" << std::endl;
@@ -544,12 +657,16 @@ namespace prime { namespace api { namespace dev
 		knob.max = max;
 		knob.val = val;
 		knob.init = init;
-		knobs_disc.push_back(std::make_pair(knob, set_handler));
+		knobs_disc_m.lock();
+		knobs_disc.insert(id, std::make_pair(knob, set_handler));
+		knobs_disc_m.unlock();
 	}
 
 	void rtm_interface::remove_knob_disc(unsigned int id)
 	{
-		knobs_disc.erase(std::remove_if(knobs_disc.begin(), knobs_disc.end(), [id](const std::pair<knob_disc_t, boost::function<void(prime::api::disc_t)>> knob) {return knob.first.id == id;}), knobs_disc.end());
+		knobs_disc_m.lock();
+		knobs_disc.erase(id);
+		knobs_disc_m.unlock();
 	}
 
 	void rtm_interface::add_knob_cont(
@@ -569,12 +686,32 @@ namespace prime { namespace api { namespace dev
 		knob.max = max;
 		knob.val = val;
 		knob.init = init;
-		knobs_cont.push_back(std::make_pair(knob, set_handler));
+		knobs_cont_m.lock();
+		knobs_cont.insert(id, std::make_pair(knob, set_handler));
+		knobs_cont_m.unlock();
 	}
 
 	void rtm_interface::remove_knob_cont(unsigned int id)
 	{
-		knobs_cont.erase(std::remove_if(knobs_cont.begin(), knobs_cont.end(), [id](const std::pair<knob_cont_t, boost::function<void(prime::api::cont_t)>> knob) {return knob.first.id == id;}), knobs_cont.end());
+		knobs_cont_m.lock();
+		knobs_cont.erase(id);
+		knobs_cont_m.unlock();
+	}
+
+	std::vector<std::pair<knob_disc_t, boost::function<void(prime::api::disc_t)>>> rtm_interface::get_disc_knobs(void)
+	{
+		knobs_disc_m.lock();
+		std::vector<std::pair<knob_disc_t, boost::function<void(prime::api::disc_t)>>> knobs = knobs_disc.values();
+		knobs_disc_m.unlock();
+		return knobs;
+	}
+
+	std::vector<std::pair<knob_cont_t, boost::function<void(prime::api::cont_t)>>> rtm_interface::get_cont_knobs(void)
+	{
+		knobs_cont_m.lock();
+		std::vector<std::pair<knob_cont_t, boost::function<void(prime::api::cont_t)>>> knobs = knobs_cont.values();
+		knobs_cont_m.unlock();
+		return knobs;
 	}
 
 	void rtm_interface::add_mon_disc(
@@ -583,7 +720,8 @@ namespace prime { namespace api { namespace dev
 		prime::api::disc_t val,
 		prime::api::disc_t min,
 		prime::api::disc_t max,
-		boost::function<prime::api::dev::mon_disc_ret_t(void)> get_handler
+		boost::function<prime::api::dev::mon_disc_ret_t(void)> get_handler,
+		unsigned int update_us
 	)
 	{
 		mon_disc_t mon;
@@ -592,12 +730,17 @@ namespace prime { namespace api { namespace dev
 		mon.val = val;
 		mon.min = min;
 		mon.max = max;
-		mons_disc.push_back(std::make_pair(mon, get_handler));
+		mon.update_us = update_us;
+		mons_disc_m.lock();
+		mons_disc.insert(id, std::make_pair(mon, get_handler));
+		mons_disc_m.unlock();
 	}
 
 	void rtm_interface::remove_mon_disc(unsigned int id)
 	{
-		mons_disc.erase(std::remove_if(mons_disc.begin(), mons_disc.end(), [id](const std::pair<mon_disc_t, boost::function<prime::api::dev::mon_disc_ret_t(void)>> mon) {return mon.first.id == id;}), mons_disc.end());
+		mons_disc_m.lock();
+		mons_disc.erase(id);
+		mons_disc_m.unlock();
 	}
 
 	void rtm_interface::add_mon_cont(
@@ -606,7 +749,8 @@ namespace prime { namespace api { namespace dev
 		prime::api::cont_t val,
 		prime::api::cont_t min,
 		prime::api::cont_t max,
-		boost::function<prime::api::dev::mon_cont_ret_t(void)> get_handler
+		boost::function<prime::api::dev::mon_cont_ret_t(void)> get_handler,
+		unsigned int update_us
 	)
 	{
 		mon_cont_t mon;
@@ -615,12 +759,17 @@ namespace prime { namespace api { namespace dev
 		mon.val = val;
 		mon.min = min;
 		mon.max = max;
-		mons_cont.push_back(std::make_pair(mon, get_handler));
+		mon.update_us = update_us;
+		mons_cont_m.lock();
+		mons_cont.insert(id, std::make_pair(mon, get_handler));
+		mons_cont_m.unlock();
 	}
 
 	void rtm_interface::remove_mon_cont(unsigned int id)
 	{
-		mons_cont.erase(std::remove_if(mons_cont.begin(), mons_cont.end(), [id](const std::pair<mon_cont_t, boost::function<prime::api::dev::mon_cont_ret_t(void)>> mon) {return mon.first.id == id;}), mons_cont.end());
+		mons_cont_m.lock();
+		mons_cont.erase(id);
+		mons_cont_m.unlock();
 	}
 
 	void rtm_interface::return_knob_disc_size(void)
@@ -639,9 +788,12 @@ namespace prime { namespace api { namespace dev
 
 	void rtm_interface::return_knob_disc_reg(void)
 	{
+		std::vector<std::pair<unsigned int, prime::api::disc_t>> inits;
 		CREATE_JSON_ROOT("PRIME_API_DEV_RETURN_KNOB_DISC_REG");
+		root.put("proto", proto_version);
+		knobs_disc_m.lock();
 		for(auto knob : knobs_disc) {
-			knob.second(knob.first.val);
+			inits.push_back(std::make_pair(knob.first.id, knob.first.val));
 			boost::property_tree::ptree knob_node;
 			knob_node.put("id", knob.first.id);
 			knob_node.put("type", knob.first.type);
@@ -651,14 +803,22 @@ namespace prime { namespace api { namespace dev
 			knob_node.put("init", knob.first.init);
 			data_node.push_back(std::make_pair("", knob_node));
 		}
+		knobs_disc_m.unlock();
 		SEND_JSON();
+
+		// Knobs start from their registered values, applied like any other set.
+		for(auto& init : inits)
+			knob_disc_set(init.first, init.second);
 	}
 
 	void rtm_interface::return_knob_cont_reg(void)
 	{
+		std::vector<std::pair<unsigned int, prime::api::cont_t>> inits;
 		CREATE_JSON_ROOT("PRIME_API_DEV_RETURN_KNOB_CONT_REG");
+		root.put("proto", proto_version);
+		knobs_cont_m.lock();
 		for(auto knob : knobs_cont) {
-			knob.second(knob.first.val);
+			inits.push_back(std::make_pair(knob.first.id, knob.first.val));
 			boost::property_tree::ptree knob_node;
 			knob_node.put("id", knob.first.id);
 			knob_node.put("type", knob.first.type);
@@ -668,55 +828,186 @@ namespace prime { namespace api { namespace dev
 			knob_node.put("init", knob.first.init);
 			data_node.push_back(std::make_pair("", knob_node));
 		}
+		knobs_cont_m.unlock();
 		SEND_JSON();
+
+		// Knobs start from their registered values, applied like any other set.
+		for(auto& init : inits)
+			knob_cont_set(init.first, init.second);
 	}
 
 	void rtm_interface::knob_disc_set(unsigned int id, prime::api::disc_t val)
 	{
-		for(auto &knob : knobs_disc) {
-			if(knob.first.id == id) {
-				knob.first.val = val;
-				knob.second(val);
-			}
+		actuation_t actuation = {false, id, val, 0, std::chrono::steady_clock::now(), 0};
+
+		// A marker times an instant and every set counts, so it is applied on arrival rather
+		// than queued behind other sets or collapsed into the next one.
+		// Held while the handler runs, so stop_actuation() waits it out like a queued set.
+		boost::function<void(prime::api::disc_t)> marker_handler;
+		actuation_m.lock();
+		if(actuation_stopped) {
+			actuation_m.unlock();
+			return;
+		}
+		knobs_disc_m.lock();
+		auto knob = knobs_disc.find(id);
+		if(knob && knob->first.type == PRIME_MARKER) {
+			knob->first.val = val;
+			marker_handler = knob->second;
 		}
+		knobs_disc_m.unlock();
+		if(marker_handler) {
+			marker_handler(val);
+			actuation_m.unlock();
+			actuation_report(actuation, std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - actuation.queued).count());
+			return;
+		}
+		actuation_m.unlock();
+
+		actuation_queue(actuation);
 	}
 
 	void rtm_interface::knob_cont_set(unsigned int id, prime::api::cont_t val)
 	{
-		for(auto &knob : knobs_cont) {
-			if(knob.first.id == id) {
-				knob.first.val = val;
-				knob.second(val);
+		actuation_t actuation = {true, id, 0, val, std::chrono::steady_clock::now(), 0};
+		actuation_queue(actuation);
+	}
+
+	void rtm_interface::actuation_queue(actuation_t actuation)
+	{
+		uint64_t key = ((uint64_t)actuation.cont << 32) | actuation.id;
+
+		actuation_m.lock();
+		if(actuation_stopped) {
+			actuation_m.unlock();
+			return;
+		}
+		// The knob reads back the value it is set to straight away, though the handler runs later.
+		if(actuation.cont) {
+			knobs_cont_m.lock();
+			auto knob = knobs_cont.find(actuation.id);
+			if(knob)
+				knob->first.val = actuation.cont_val;
+			knobs_cont_m.unlock();
+		} else {
+			knobs_disc_m.lock();
+			auto knob = knobs_disc.find(actuation.id);
+			if(knob)
+				knob->first.val = actuation.disc_val;
+			knobs_disc_m.unlock();
+		}
+		auto pending = actuation_pending.find(key);
+		if(pending == actuation_pending.end()) {
+			actuation_pending[key] = actuation;
+			actuation_order.push_back(key);
+		} else {
+			// Keeps its place in the queue, but only the newest value is applied.
+			actuation.collapsed = pending->second.collapsed + 1;
+			pending->second = actuation;
+		}
+		if(actuation_thread.get_id() == boost::thread::id())
+			actuation_thread = boost::thread(&rtm_interface::actuation_loop, this);
+		actuation_m.unlock();
+		actuation_cv.notify_one();
+	}
+
+	void rtm_interface::stop_actuation(void)
+	{
+		actuation_m.lock();
+		actuation_stopped = true;
+		actuation_order.clear();
+		actuation_pending.clear();
+		actuation_m.unlock();
+		actuation_cv.notify_one();
+		if(actuation_thread.joinable())
+			actuation_thread.join();
+	}
+
+	void rtm_interface::actuation_loop(void)
+	{
+		std::unique_lock<std::mutex> lock(actuation_m);
+		while(1) {
+			while(!actuation_stopped && actuation_order.empty())
+				actuation_cv.wait(lock);
+			if(actuation_stopped)
+				break;
+
+			uint64_t key = actuation_order.front();
+			actuation_order.pop_front();
+			actuation_t actuation = actuation_pending[key];
+			actuation_pending.erase(key);
+			lock.unlock();
+
+			// The handler is copied out so the knob can be removed while it runs.
+			bool applied = false;
+			if(actuation.cont) {
+				boost::function<void(prime::api::cont_t)> set_handler;
+				knobs_cont_m.lock();
+				auto knob = knobs_cont.find(actuation.id);
+				if(knob)
+					set_handler = knob->second;
+				knobs_cont_m.unlock();
+				if(set_handler) {
+					set_handler(actuation.cont_val);
+					applied = true;
+				}
+			} else {
+				boost::function<void(prime::api::disc_t)> set_handler;
+				knobs_disc_m.lock();
+				auto knob = knobs_disc.find(actuation.id);
+				if(knob)
+					set_handler = knob->second;
+				knobs_disc_m.unlock();
+				if(set_handler) {
+					set_handler(actuation.disc_val);
+					applied = true;
+				}
 			}
+
+			if(applied) {
+				actuation_report(actuation, std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - actuation.queued).count());
+			}
+			lock.lock();
+		}
+	}
+
+	void rtm_interface::actuation_report(const actuation_t& actuation, unsigned int latency_us)
+	{
+		// Older RTMs and text-lane peers have no message for this.
+		if(proto_version < PRIME_API_BIN_V5)
+			return;
+
+		if(actuation.cont) {
+			prime::api::bin::dev_knob_cont_applied_msg_t payload = {actuation.id, actuation.cont_val, latency_us, actuation.collapsed};
+			SEND_BIN(PRIME_API_DEV_KNOB_CONT_APPLIED, payload);
+		} else {
+			prime::api::bin::dev_knob_disc_applied_msg_t payload = {actuation.id, actuation.disc_val, latency_us, actuation.collapsed};
+			SEND_BIN(PRIME_API_DEV_KNOB_DISC_APPLIED, payload);
 		}
 	}
 
 	prime::api::disc_t rtm_interface::mon_disc_get(unsigned int id)
 	{
+		prime::api::disc_t val = 0;
 		mons_disc_m.lock();
-		for(auto &mon : mons_disc) {
-			if(mon.first.id == id) {
-				prime::api::dev::mon_disc_ret_t vals = mon.second();
-				mon.first.val = vals.val;
-        			mons_disc_m.unlock();
-				return vals.val;
-			}
-		}
-        	mons_disc_m.unlock();
+		auto mon = mons_disc.find(id);
+		if(mon)
+			val = read_mon(*mon).val;
+		mons_disc_m.unlock();
+		return val;
 	}
 
 	prime::api::cont_t rtm_interface::mon_cont_get(unsigned int id)
 	{
+		prime::api::cont_t val = 0;
 		mons_cont_m.lock();
-		for(auto &mon : mons_cont) {
-			if(mon.first.id == id) {
-				prime::api::dev::mon_cont_ret_t vals = mon.second();
-				mon.first.val = vals.val;
-        			mons_cont_m.unlock();
-				return vals.val;
-			}
-		}
-        	mons_cont_m.unlock();
+		auto mon = mons_cont.find(id);
+		if(mon)
+			val = read_mon(*mon).val;
+		mons_cont_m.unlock();
+		return val;
 	}
 	void rtm_interface::return_mon_disc_size(void)
 	{
@@ -735,15 +1026,11 @@ namespace prime { namespace api { namespace dev
 	void rtm_interface::return_mon_disc_reg(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_RETURN_MON_DISC_REG");
+		root.put("proto", proto_version);
 		mons_disc_m.lock();
-		for(auto mon : mons_disc) {
-			prime::api::dev::mon_disc_ret_t mon_vals;
-			
+		for(auto& mon : mons_disc) {
 			// Get updated value and bounds
-			mon_vals = mon.second();
-			mon.first.val = mon_vals.val;
-			mon.first.min = mon_vals.min;
-			mon.first.max = mon_vals.max;
+			read_mon(mon);
 			
 			boost::property_tree::ptree mon_node;
 			mon_node.put("id", mon.first.id);
@@ -751,6 +1038,8 @@ namespace prime { namespace api { namespace dev
 			mon_node.put("val", mon.first.val);
 			mon_node.put("min", mon.first.min);
 			mon_node.put("max", mon.first.max);
+			mon_node.put("update_us", mon.first.update_us);
+			mon_node.put("ts", mon.first.ts);
 			data_node.push_back(std::make_pair("", mon_node));
 		}
 		mons_disc_m.unlock();
@@ -760,15 +1049,11 @@ namespace prime { namespace api { namespace dev
 	void rtm_interface::return_mon_cont_reg(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_RETURN_MON_CONT_REG");
+		root.put("proto", proto_version);
 		mons_cont_m.lock();
-		for(auto mon : mons_cont) {
-			prime::api::dev::mon_cont_ret_t mon_vals;
-			
+		for(auto& mon : mons_cont) {
 			// Get updated value and bounds
-			mon_vals = mon.second();
-			mon.first.val = mon_vals.val;
-			mon.first.min = mon_vals.min;
-			mon.first.max = mon_vals.max;
+			read_mon(mon);
 			
 			boost::property_tree::ptree mon_node;
 			mon_node.put("id", mon.first.id);
@@ -776,86 +1061,267 @@ namespace prime { namespace api { namespace dev
 			mon_node.put("val", mon.first.val);
 			mon_node.put("min", mon.first.min);
 			mon_node.put("max", mon.first.max);
+			mon_node.put("update_us", mon.first.update_us);
+			mon_node.put("ts", mon.first.ts);
 			data_node.push_back(std::make_pair("", mon_node));
 		}
 		mons_cont_m.unlock();
 		SEND_JSON();
 	}
 
-	void rtm_interface::return_mon_disc_get(unsigned int id)
+	void rtm_interface::return_mon_disc_get(unsigned int id, uint32_t seq)
 	{
+		char type = PRIME_API_DEV_RETURN_MON_DISC_GET;
+		prime::api::dev::mon_disc_t mon_vals;
+		std::stringstream ss;
+
 		mons_disc_m.lock();
-		for(auto mon : mons_disc) {
-			if(mon.first.id == id) {
-				char type = PRIME_API_DEV_RETURN_MON_DISC_GET;
-				prime::api::dev::mon_disc_ret_t mon_vals;
-				std::stringstream ss;
-				
-				// Get updated value and bounds
-				mon_vals = mon.second();
-				mon.first.val = mon_vals.val;
-				mon.first.min = mon_vals.min;
-				mon.first.max = mon_vals.max;
-				
-				mons_disc_m.unlock();
-
-				// Create message
-				ss << type << API_DELIMINATOR;
-				ss << std::to_string((unsigned int)id) << API_DELIMINATOR;
-				ss << std::to_string(mon.first.val) << API_DELIMINATOR;
-				ss << std::to_string(mon.first.min) << API_DELIMINATOR;
-				ss << std::to_string(mon.first.max) << API_DELIMINATOR;
-				ss << prime::util::get_timestamp();
-				std::string json_string = ss.str();
-
-				// Send the Message
-				prime::util::send_message(socket, json_string);
-				if(logger_en) {
-					prime::util::send_message(logger_socket, json_string);
-				}
+		auto mon = mons_disc.find(id);
+		if(!mon) {
+			mons_disc_m.unlock();
+			return;
+		}
 
-				return;
+		// Get updated value and bounds
+		mon_vals = read_mon(*mon);
+
+		mons_disc_m.unlock();
+
+		// Returns carry when the reading was taken rather than when they were sent.
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::dev_mon_disc_msg_t payload = {id, mon_vals.val, mon_vals.min, mon_vals.max};
+			if(seq) {
+				// Echo the sequence number of a V2 get.
+				prime::api::bin::seq_msg_t<prime::api::bin::dev_mon_disc_msg_t> seq_payload = {payload, seq};
+				SEND_BIN_TS(type, seq_payload, mon_vals.ts);
+			} else {
+				SEND_BIN_TS(type, payload, mon_vals.ts);
 			}
+			return;
+		}
+
+		// Create message
+		ss << type << API_DELIMINATOR;
+		ss << std::to_string((unsigned int)id) << API_DELIMINATOR;
+		ss << std::to_string(mon_vals.val) << API_DELIMINATOR;
+		ss << std::to_string(mon_vals.min) << API_DELIMINATOR;
+		ss << std::to_string(mon_vals.max) << API_DELIMINATOR;
+		ss << mon_vals.ts;
+		std::string json_string = ss.str();
+
+		// Send the Message
+		prime::util::send_message(socket, json_string);
+		if(logger_en) {
+			prime::util::send_message(logger_socket, json_string);
 		}
-		mons_disc_m.unlock();
 	}
 
-	void rtm_interface::return_mon_cont_get(unsigned int id)
+	void rtm_interface::return_mon_cont_get(unsigned int id, uint32_t seq)
 	{
+		char type = PRIME_API_DEV_RETURN_MON_CONT_GET;
+		prime::api::dev::mon_cont_t mon_vals;
+		std::stringstream ss;
+
 		mons_cont_m.lock();
-		for(auto mon : mons_cont) {
-			if(mon.first.id == id) {
-				char type = PRIME_API_DEV_RETURN_MON_CONT_GET;
-				prime::api::dev::mon_cont_ret_t mon_vals;
-				std::stringstream ss;
-				
-				// Get updated value and bounds
-				mon_vals = mon.second();
-				mon.first.val = mon_vals.val;
-				mon.first.min = mon_vals.min;
-				mon.first.max = mon_vals.max;
-				
-				mons_cont_m.unlock();
-
-				// Create message
-				ss << type << API_DELIMINATOR;
-				ss << std::to_string((unsigned int)id) << API_DELIMINATOR;
-				ss << std::to_string(mon.first.val) << API_DELIMINATOR;
-				ss << std::to_string(mon.first.min) << API_DELIMINATOR;
-				ss << std::to_string(mon.first.max) << API_DELIMINATOR;
-				ss << prime::util::get_timestamp();
-				std::string json_string = ss.str();
-
-				// Send the Message
-				prime::util::send_message(socket, json_string);
-				if(logger_en) {
-					prime::util::send_message(logger_socket, json_string);
-				}
+		auto mon = mons_cont.find(id);
+		if(!mon) {
+			mons_cont_m.unlock();
+			return;
+		}
+
+		// Get updated value and bounds
+		mon_vals = read_mon(*mon);
 
-				return;
+		mons_cont_m.unlock();
+
+		// Returns carry when the reading was taken rather than when they were sent.
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::dev_mon_cont_msg_t payload = {id, mon_vals.val, mon_vals.min, mon_vals.max};
+			if(seq) {
+				// Echo the sequence number of a V2 get.
+				prime::api::bin::seq_msg_t<prime::api::bin::dev_mon_cont_msg_t> seq_payload = {payload, seq};
+				SEND_BIN_TS(type, seq_payload, mon_vals.ts);
+			} else {
+				SEND_BIN_TS(type, payload, mon_vals.ts);
+			}
+			return;
+		}
+
+		// Create message
+		ss << type << API_DELIMINATOR;
+		ss << std::to_string((unsigned int)id) << API_DELIMINATOR;
+		ss << std::to_string(mon_vals.val) << API_DELIMINATOR;
+		ss << std::to_string(mon_vals.min) << API_DELIMINATOR;
+		ss << std::to_string(mon_vals.max) << API_DELIMINATOR;
+		ss << mon_vals.ts;
+		std::string json_string = ss.str();
+
+		// Send the Message
+		prime::util::send_message(socket, json_string);
+		if(logger_en) {
+			prime::util::send_message(logger_socket, json_string);
+		}
+	}
+
+	void rtm_interface::return_mon_snapshot(uint32_t seq, std::vector<uint32_t>& disc_ids, std::vector<uint32_t>& cont_ids)
+	{
+		std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>> disc_vals;
+		std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>> cont_vals;
+
+		// Read every requested monitor in one pass, stamped with the oldest reading.
+		unsigned long long ts = read_mon_snapshot(disc_ids, cont_ids, disc_vals, cont_vals);
+
+		std::vector<char> bin_message = encode_mon_snapshot(PRIME_API_DEV_RETURN_MON_SNAPSHOT, seq, disc_vals, cont_vals, ts);
+		socket.send_message(bin_message);
+		if(logger_en) {
+			logger_socket.send_message(bin_message);
+		}
+	}
+
+	unsigned long long rtm_interface::read_mon_snapshot(
+		std::vector<uint32_t>& disc_ids,
+		std::vector<uint32_t>& cont_ids,
+		std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+		std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals)
+	{
+		unsigned long long ts = prime::util::get_timestamp();
+
+		disc_vals.clear();
+		cont_vals.clear();
+		disc_vals.reserve(disc_ids.size());
+		mons_disc_m.lock();
+		for(auto id : disc_ids) {
+			auto mon = mons_disc.find(id);
+			if(mon) {
+				const mon_disc_t& disc_ret = read_mon(*mon);
+				disc_vals.push_back({{id, disc_ret.val, disc_ret.min, disc_ret.max}, disc_ret.ts});
+				ts = std::min(ts, disc_ret.ts);
+			}
+		}
+		mons_disc_m.unlock();
+
+		cont_vals.reserve(cont_ids.size());
+		mons_cont_m.lock();
+		for(auto id : cont_ids) {
+			auto mon = mons_cont.find(id);
+			if(mon) {
+				const mon_cont_t& cont_ret = read_mon(*mon);
+				cont_vals.push_back({{id, cont_ret.val, cont_ret.min, cont_ret.max}, cont_ret.ts});
+				ts = std::min(ts, cont_ret.ts);
 			}
 		}
 		mons_cont_m.unlock();
+		return ts;
+	}
+
+	// Peers before V7 take the bare records, with only the header's timestamp.
+	template<typename T>
+	static std::vector<T> strip_ts(const std::vector<prime::api::bin::ts_msg_t<T>>& vals)
+	{
+		std::vector<T> msgs;
+		msgs.reserve(vals.size());
+		for(auto& val : vals)
+			msgs.push_back(val.msg);
+		return msgs;
+	}
+
+	std::vector<char> rtm_interface::encode_mon_snapshot(
+		char type,
+		uint32_t seq,
+		const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+		const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals,
+		unsigned long long ts)
+	{
+		if(proto_version >= PRIME_API_BIN_V7)
+			return prime::api::bin::encode_snapshot(type, seq, disc_vals, cont_vals, ts, proto_version);
+		return prime::api::bin::encode_snapshot(type, seq, strip_ts(disc_vals), strip_ts(cont_vals), ts, proto_version);
+	}
+
+	void rtm_interface::mon_subscribe(unsigned int sub_id, std::unique_ptr<mon_sub_t> sub)
+	{
+		// Publishes are binary; an RTM that cannot read them does not subscribe.
+		if(proto_version < PRIME_API_BIN_V4 || sub->period_us == 0)
+			return;
+
+		// A repeated id replaces the old subscription.
+		mon_unsubscribe(sub_id);
+
+		mon_sub_t *sub_ptr = sub.get();
+		mon_subs_m.lock();
+		if(mon_subs_stopped) {
+			mon_subs_m.unlock();
+			return;
+		}
+		mon_subs[sub_id] = std::move(sub);
+		sub_ptr->thread = boost::thread(&rtm_interface::mon_sub_loop, this, sub_id, sub_ptr);
+		mon_subs_m.unlock();
+	}
+
+	void rtm_interface::mon_unsubscribe(unsigned int sub_id)
+	{
+		std::unique_ptr<mon_sub_t> sub;
+		mon_subs_m.lock();
+		auto sub_it = mon_subs.find(sub_id);
+		if(sub_it != mon_subs.end()) {
+			sub = std::move(sub_it->second);
+			mon_subs.erase(sub_it);
+		}
+		mon_subs_m.unlock();
+
+		if(sub) {
+			sub->thread.interrupt();
+			sub->thread.join();
+		}
+	}
+
+	void rtm_interface::mon_sub_loop(unsigned int sub_id, mon_sub_t *sub)
+	{
+		std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>> disc_vals, disc_last;
+		std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>> cont_vals, cont_last;
+		bool published = false;
+
+		if(sub->cpu >= 0) {
+			cpu_set_t cpuset;
+			CPU_ZERO(&cpuset);
+			CPU_SET(sub->cpu, &cpuset);
+			pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+		}
+
+		// Deadlines advance by whole periods, so the rate does not drift with the sampling time.
+		std::chrono::steady_clock::time_point next_sample = std::chrono::steady_clock::now();
+		try {
+			while(1) {
+				unsigned long long ts = read_mon_snapshot(sub->disc_ids, sub->cont_ids, disc_vals, cont_vals);
+
+				bool changed = !published || sub->threshold <= 0
+					|| disc_vals.size() != disc_last.size() || cont_vals.size() != cont_last.size();
+				for(std::size_t i = 0; !changed && i < disc_vals.size(); i++)
+					changed = std::abs((prime::api::cont_t)(disc_vals[i].msg.val - disc_last[i].msg.val)) > sub->threshold;
+				for(std::size_t i = 0; !changed && i < cont_vals.size(); i++)
+					changed = std::abs(cont_vals[i].msg.val - cont_last[i].msg.val) > sub->threshold;
+
+				if(changed) {
+					std::vector<char> bin_message = encode_mon_snapshot(PRIME_API_DEV_MON_PUBLISH, sub_id, disc_vals, cont_vals, ts);
+					socket.send_message(bin_message);
+					if(logger_en) {
+						logger_socket.send_message(bin_message);
+					}
+					disc_last.swap(disc_vals);
+					cont_last.swap(cont_vals);
+					published = true;
+				}
+
+				next_sample += std::chrono::microseconds(sub->period_us);
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				if(next_sample < now)
+					next_sample = now;		// Overran, don't burst to catch up
+				// Interruptible, so unsubscribing never waits out a long period.
+				boost::this_thread::sleep(boost::posix_time::microseconds(
+					std::chrono::duration_cast<std::chrono::microseconds>(next_sample - now).count()));
+			}
+		}
+		catch(boost::thread_interrupted&) {
+		}
 	}
 
 	void rtm_interface::return_arch_get(void)
@@ -1034,9 +1500,9 @@ namespace prime { namespace api { namespace dev
 	{
 	}
 
-	void ui_interface::message_handler(std::vector<char> message)
+	void ui_interface::message_handler(const prime::uds::message_t& message)
 	{
-		std::string message_string(reinterpret_cast<char*>(message.data()));		// This is 4ms+ faster than the two lines below!
+		std::string message_string(message.data());		// This is 4ms+ faster than the two lines below!
 		//std::string message_string(message.begin(), message.end());
 		//boost::trim_right_if(message_string, boost::is_any_of(std::string("\0", 1)));
 		std::stringstream ss;
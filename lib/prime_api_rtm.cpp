@@ -22,15 +22,19 @@
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/algorithm/string.hpp>
 #include <chrono>
+#include <future>
+#include <cmath>
 #include <vector>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <iomanip>
 #include <stdexcept>
+#include <algorithm>
 #include "uds.h"
 #include "util.h"
 #include "prime_api_rtm.h"
+#include "prime_api_bin.h"
 
 //#define DEBUG
 //#define API_DEBUG
@@ -66,17 +70,15 @@
     std::stringstream ss; \
     write_json(ss, root); \
     std::string json_string = ss.str(); \
-    std::shared_ptr<prime::uds> socket_ptr; \
-    app_sockets_m.lock(); \
-    for(auto app_socket : app_sockets) { \
-	if(app_socket.first == pid) { \
-	    socket_ptr = app_socket.second; \
-	} \
-    } \
-    app_sockets_m.unlock(); \
+    std::shared_ptr<prime::uds> socket_ptr = app_socket(pid); \
     prime::util::send_message(*socket_ptr.get(), json_string); \
     if(logger_en) {	prime::util::send_message(logger_socket, json_string); }  \
 
+#define SEND_BIN(type, payload) \
+    { std::vector<char> bin_message = prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version); \
+    socket.send_message(bin_message); \
+    if(logger_en) {	logger_socket.send_message(bin_message); } }
+
 
 namespace prime { namespace api { namespace rtm
 {
@@ -168,6 +170,9 @@ namespace prime { namespace api { namespace rtm
 
 		default_addrs(check_addrs(app_addrs)),
 		logger_en(app_addrs->logger_en),
+		shm_api(app_addrs->shm_api && !app_addrs->remote_api),
+		shm_busy_poll(app_addrs->shm_busy_poll),
+		shm_send_timeout_us(app_addrs->shm_send_timeout_us),
 		socket(
 			prime::uds::socket_layer_t::RTM_APP,
 			app_addrs,
@@ -734,13 +739,102 @@ namespace prime { namespace api { namespace rtm
 	{
 	}
 
-	void app_interface::message_handler(std::vector<char> message)
+	void app_interface::message_handler(const prime::uds::message_t& message)
 	{
-		if(message[0] != '{') { // Not json, process quickly
+		if(prime::api::bin::is_bin(message)) { // Binary, fixed layout
+			prime::api::bin::app_disc_msg_t disc_payload;
+			prime::api::bin::app_cont_msg_t cont_payload;
+			prime::api::bin::app_get_msg_t get_payload;
+			prime::api::bin::seq_msg_t<prime::api::bin::app_get_msg_t> get_seq_payload;
+
+			switch((prime::api::app_rtm_msg_t)prime::api::bin::get_type(message)) {
+				case PRIME_API_APP_KNOB_DISC_MIN:
+					if(prime::api::bin::decode(message, disc_payload))
+						knob_disc_min_change_handler(disc_payload.proc_id, disc_payload.id, disc_payload.val);
+					break;
+
+				case PRIME_API_APP_KNOB_DISC_MAX:
+					if(prime::api::bin::decode(message, disc_payload))
+						knob_disc_max_change_handler(disc_payload.proc_id, disc_payload.id, disc_payload.val);
+					break;
+
+				case PRIME_API_APP_KNOB_CONT_MIN:
+					if(prime::api::bin::decode(message, cont_payload))
+						knob_cont_min_change_handler(cont_payload.proc_id, cont_payload.id, cont_payload.val);
+					break;
+
+				case PRIME_API_APP_KNOB_CONT_MAX:
+					if(prime::api::bin::decode(message, cont_payload))
+						knob_cont_max_change_handler(cont_payload.proc_id, cont_payload.id, cont_payload.val);
+					break;
+
+				case PRIME_API_APP_KNOB_DISC_GET:
+					if(prime::api::bin::decode(message, get_seq_payload))
+						return_knob_disc_get(get_seq_payload.msg.proc_id, get_seq_payload.msg.id, get_seq_payload.seq);
+					else if(prime::api::bin::decode(message, get_payload))
+						return_knob_disc_get(get_payload.proc_id, get_payload.id);
+					break;
+
+				case PRIME_API_APP_KNOB_CONT_GET:
+					if(prime::api::bin::decode(message, get_seq_payload))
+						return_knob_cont_get(get_seq_payload.msg.proc_id, get_seq_payload.msg.id, get_seq_payload.seq);
+					else if(prime::api::bin::decode(message, get_payload))
+						return_knob_cont_get(get_payload.proc_id, get_payload.id);
+					break;
+
+				case PRIME_API_APP_MON_DISC_MIN:
+					if(prime::api::bin::decode(message, disc_payload))
+						mon_disc_min_change_handler(disc_payload.proc_id, disc_payload.id, disc_payload.val);
+					break;
+
+				case PRIME_API_APP_MON_DISC_MAX:
+					if(prime::api::bin::decode(message, disc_payload))
+						mon_disc_max_change_handler(disc_payload.proc_id, disc_payload.id, disc_payload.val);
+					break;
+
+				case PRIME_API_APP_MON_DISC_WEIGHT:
+					// Weights are always continuous on the wire
+					if(prime::api::bin::decode(message, cont_payload))
+						mon_disc_weight_change_handler(cont_payload.proc_id, cont_payload.id, (prime::api::disc_t)cont_payload.val);
+					break;
+
+				case PRIME_API_APP_MON_CONT_MIN:
+					if(prime::api::bin::decode(message, cont_payload))
+						mon_cont_min_change_handler(cont_payload.proc_id, cont_payload.id, cont_payload.val);
+					break;
+
+				case PRIME_API_APP_MON_CONT_MAX:
+					if(prime::api::bin::decode(message, cont_payload))
+						mon_cont_max_change_handler(cont_payload.proc_id, cont_payload.id, cont_payload.val);
+					break;
+
+				case PRIME_API_APP_MON_CONT_WEIGHT:
+					if(prime::api::bin::decode(message, cont_payload))
+						mon_cont_weight_change_handler(cont_payload.proc_id, cont_payload.id, cont_payload.val);
+					break;
+
+				case PRIME_API_APP_MON_DISC_SET:
+					if(prime::api::bin::decode(message, disc_payload))
+						mon_disc_val_change_handler(disc_payload.proc_id, disc_payload.id, disc_payload.val);
+					break;
+
+				case PRIME_API_APP_MON_CONT_SET:
+					if(prime::api::bin::decode(message, cont_payload))
+						mon_cont_val_change_handler(cont_payload.proc_id, cont_payload.id, cont_payload.val);
+					break;
+
+				default:
+#ifdef DEBUG
+					std::cout << "Error: unknown binary message type: " << prime::api::bin::get_type(message) << std::endl;
+#endif
+					break;
+			}
+
+		} else if(message[0] != '{') { // Not json, process quickly
 			std::string delim = API_DELIMINATOR;
 			size_t position;
 			std::string pid, id, val, type;
-			std::string message_string( (reinterpret_cast<char*>(message.data())) + 1 + delim.length());		// This is 4ms+ faster than the two lines below!
+			std::string message_string( (message.data()) + 1 + delim.length());		// This is 4ms+ faster than the two lines below!
 
 #ifdef DEBUG
 			std::string ts;
@@ -971,7 +1065,7 @@ namespace prime { namespace api { namespace rtm
 			}
 
 		} else {	// This is json, send it to the slow lane.
-			std::string message_string(reinterpret_cast<char*>(message.data()));		// This is 4ms+ faster than the two lines below!
+			std::string message_string(message.data());		// This is 4ms+ faster than the two lines below!
 			//std::string message_string(message.begin(), message.end());
 			//boost::trim_right_if(message_string, boost::is_any_of(std::string("\0", 1)));
 			std::stringstream ss;
@@ -988,15 +1082,20 @@ namespace prime { namespace api { namespace rtm
 					unsigned long int ur_id = data.get<unsigned long int>("ur_id");
 					std::string local_endpoint_address = std::string("/tmp/rtm.app.") + std::to_string(proc_id) + std::string(".uds");
 					std::string remote_endpoint_address = std::string("/tmp/app.rtm.") + std::to_string(proc_id) + std::string(".uds");
-					auto app_socket = std::make_pair(
-								proc_id,
-								std::shared_ptr<prime::uds>(new prime::uds(
+					std::shared_ptr<prime::uds> app_socket(new prime::uds(
 												local_endpoint_address,
 												remote_endpoint_address,
-												boost::bind(&app_interface::message_handler, this, _1))));
+												boost::bind(&app_interface::message_handler, this, _1),
+												shm_api,
+												shm_busy_poll,
+												shm_send_timeout_us));
+
+					// Applications without binary support do not send a protocol version.
+					unsigned int proto_version = prime::api::bin::negotiate(data.get<unsigned int>("proto", 0));
 
 					app_sockets_m.lock();
-					app_sockets.push_back(std::move(app_socket));
+					app_sockets.insert(proc_id, app_socket);
+					app_protos.insert(proc_id, proto_version);
 					app_sockets_m.unlock();
 					return_app_reg(proc_id);
 					app_reg_handler(proc_id, ur_id);
@@ -1004,6 +1103,9 @@ namespace prime { namespace api { namespace rtm
 				else if(!message_type.compare("PRIME_API_APP_DEREG")) {
 					pid_t proc_id = data.get<pid_t>("proc_id");
 					return_app_dereg(proc_id);
+					app_sockets_m.lock();
+					app_protos.erase(proc_id);
+					app_sockets_m.unlock();
 					app_dereg_handler(proc_id);
 				}
 				else if(!message_type.compare("PRIME_API_APP_KNOB_DISC_REG")) {
@@ -1016,7 +1118,7 @@ namespace prime { namespace api { namespace rtm
 					knob.max = ((data.get<std::string>("max") == "inf") ? prime::api::PRIME_DISC_MAX : data.get<prime::api::disc_t>("max"));
 					knob.val = data.get<prime::api::disc_t>("val");
 					knobs_disc_m.lock();
-					knobs_disc.push_back(knob);
+					knobs_disc.insert(knob.id, knob);
 					knobs_disc_m.unlock();
 					return_knob_disc_reg(knob);
 					knob_disc_reg_handler(proc_id, knob);
@@ -1031,7 +1133,7 @@ namespace prime { namespace api { namespace rtm
 					knob.max = ((data.get<std::string>("max") == "inf") ? prime::api::PRIME_CONT_MAX : data.get<prime::api::cont_t>("max"));
 					knob.val = data.get<prime::api::cont_t>("val");
 					knobs_cont_m.lock();
-					knobs_cont.push_back(knob);
+					knobs_cont.insert(knob.id, knob);
 					knobs_cont_m.unlock();
 					return_knob_cont_reg(knob);
 					knob_cont_reg_handler(proc_id, knob);
@@ -1043,8 +1145,29 @@ namespace prime { namespace api { namespace rtm
 					knob.id = knob_node.get<unsigned int>("id");
 					knob.type = (prime::api::app::knob_type_t)knob_node.get<unsigned int>("type");
 					knob.val = knob_node.get<prime::api::disc_t>("val");
+					knobs_disc_m.lock();
+					knobs_disc.erase(knob.id);
+					knobs_disc_push.erase(knob.id);
+					knobs_disc_m.unlock();
 					knob_disc_dereg_handler(knob);
 				}
+				else if(!message_type.compare("PRIME_API_APP_KNOB_DISC_PUSH")) {
+					pid_t proc_id = data.get<pid_t>("proc_id");
+					unsigned int id = data.get<unsigned int>("id");
+					prime::api::disc_t val = 0;
+					// Only an app that negotiated push can decode the pushed values.
+					if(app_proto(proc_id) >= PRIME_API_BIN_V6) {
+						knobs_disc_m.lock();
+						auto knob = knobs_disc.find(id);
+						if(knob) {
+							val = knob->val;
+							knobs_disc_push.insert(id);
+							// Push the current value, in case it changed since registration.
+							send_knob_disc(PRIME_API_APP_KNOB_DISC_PUSH, proc_id, id, val);
+						}
+						knobs_disc_m.unlock();
+					}
+				}
 				else if(!message_type.compare("PRIME_API_APP_KNOB_CONT_DEREG")) {
 					prime::api::app::knob_cont_t knob;
 					boost::property_tree::ptree knob_node = data.get_child("knob");
@@ -1052,8 +1175,29 @@ namespace prime { namespace api { namespace rtm
 					knob.id = knob_node.get<unsigned int>("id");
 					knob.type = (prime::api::app::knob_type_t)knob_node.get<unsigned int>("type");
 					knob.val = knob_node.get<prime::api::cont_t>("val");
+					knobs_cont_m.lock();
+					knobs_cont.erase(knob.id);
+					knobs_cont_push.erase(knob.id);
+					knobs_cont_m.unlock();
 					knob_cont_dereg_handler(knob);
 				}
+				else if(!message_type.compare("PRIME_API_APP_KNOB_CONT_PUSH")) {
+					pid_t proc_id = data.get<pid_t>("proc_id");
+					unsigned int id = data.get<unsigned int>("id");
+					prime::api::cont_t val = 0;
+					// Only an app that negotiated push can decode the pushed values.
+					if(app_proto(proc_id) >= PRIME_API_BIN_V6) {
+						knobs_cont_m.lock();
+						auto knob = knobs_cont.find(id);
+						if(knob) {
+							val = knob->val;
+							knobs_cont_push.insert(id);
+							// Push the current value, in case it changed since registration.
+							send_knob_cont(PRIME_API_APP_KNOB_CONT_PUSH, proc_id, id, val);
+						}
+						knobs_cont_m.unlock();
+					}
+				}
 				else if(!message_type.compare("PRIME_API_APP_KNOB_DISC_GET")) {
 					prime::api::app::knob_disc_t knob;
 					boost::property_tree::ptree knob_node = data.get_child("knob");
@@ -1156,29 +1300,58 @@ namespace prime { namespace api { namespace rtm
 	void app_interface::knob_disc_set(prime::api::app::knob_disc_t knob, prime::api::disc_t val)
 	{
 		knobs_disc_m.lock();
-		for(auto& knob_disc : knobs_disc) {
-			if(knob_disc.id == knob.id) {
-				knob_disc.val = val;
-			}
+		auto knob_disc = knobs_disc.find(knob.id);
+		if(knob_disc) {
+			// Sent under the lock so pushes for one knob can never overtake each other.
+			if(knob_disc->val != val && knobs_disc_push.count(knob.id))
+				send_knob_disc(PRIME_API_APP_KNOB_DISC_PUSH, knob_disc->proc_id, knob.id, val);
+			knob_disc->val = val;
 		}
 		knobs_disc_m.unlock();
 	}
 
 	void app_interface::knob_cont_set(prime::api::app::knob_cont_t knob, prime::api::cont_t val)
 	{
-		knobs_cont_m.unlock();
-		for(auto& knob_cont : knobs_cont) {
-			if(knob_cont.id == knob.id) {
-				knob_cont.val = val;
-			}
+		knobs_cont_m.lock();
+		auto knob_cont = knobs_cont.find(knob.id);
+		if(knob_cont) {
+			// Sent under the lock so pushes for one knob can never overtake each other.
+			if(knob_cont->val != val && knobs_cont_push.count(knob.id))
+				send_knob_cont(PRIME_API_APP_KNOB_CONT_PUSH, knob_cont->proc_id, knob.id, val);
+			knob_cont->val = val;
 		}
 		knobs_cont_m.unlock();
 	}
 
+	unsigned int app_interface::app_proto(pid_t proc_id)
+	{
+		unsigned int proto_version = 0;
+		app_sockets_m.lock();
+		auto app_proto = app_protos.find(proc_id);
+		if(app_proto) {
+			proto_version = *app_proto;
+		}
+		app_sockets_m.unlock();
+		return proto_version;
+	}
+
+	std::shared_ptr<prime::uds> app_interface::app_socket(pid_t proc_id)
+	{
+		std::shared_ptr<prime::uds> socket_ptr;
+		app_sockets_m.lock();
+		auto app_socket = app_sockets.find(proc_id);
+		if(app_socket) {
+			socket_ptr = *app_socket;
+		}
+		app_sockets_m.unlock();
+		return socket_ptr;
+	}
+
 	void app_interface::return_app_reg(pid_t proc_id)
 	{
 		CREATE_JSON_ROOT("PRIME_API_APP_RETURN_APP_REG");
 		ADD_JSON_DATA("proc_id", proc_id);
+		ADD_JSON_DATA("proto", app_proto(proc_id));
 		SEND_JSON_PID(proc_id);
 		prime::util::send_message(ui_socket, json_string);
 	}
@@ -1191,64 +1364,90 @@ namespace prime { namespace api { namespace rtm
 		prime::util::send_message(ui_socket, json_string);
 	}
 
-	void app_interface::return_knob_disc_get(pid_t proc_id, unsigned int id)
+	void app_interface::return_knob_disc_get(pid_t proc_id, unsigned int id, uint32_t seq)
 	{
-		char type = PRIME_API_APP_RETURN_KNOB_DISC_GET;
 		prime::api::disc_t val = 0;
-		bool found_knob = false;
 
 		knobs_disc_m.lock();
-		for(auto knob_disc : knobs_disc) {
-			if(knob_disc.id == id && knob_disc.proc_id == proc_id) {
-				val = knob_disc.val;
-				found_knob = true;
-			}
+		auto knob_disc = knobs_disc.find(id);
+		if(knob_disc && knob_disc->proc_id == proc_id) {
+			val = knob_disc->val;
 		}
 		knobs_disc_m.unlock();
 
+		send_knob_disc(PRIME_API_APP_RETURN_KNOB_DISC_GET, proc_id, id, val, seq);
+	}
+
+	void app_interface::send_knob_disc(char type, pid_t proc_id, unsigned int id, prime::api::disc_t val, uint32_t seq)
+	{
+		std::shared_ptr<prime::uds> socket_ptr = app_socket(proc_id);
+
+		// The app may have deregistered.
+		if(!socket_ptr)
+			return;
+
+		unsigned int proto_version = app_proto(proc_id);
+		if(proto_version >= PRIME_API_BIN_V1) {
+			// Echo the sequence number of a V2 get.
+			prime::api::bin::seq_msg_t<prime::api::bin::app_disc_msg_t> payload = {{id, proc_id, val}, seq};
+			std::vector<char> bin_message = seq ? prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version)
+												: prime::api::bin::encode(type, payload.msg, prime::util::get_timestamp(), proto_version);
+			socket_ptr->send_message(bin_message);
+			if(logger_en) {
+				logger_socket.send_message(bin_message);
+			}
+			return;
+		}
+
 		std::stringstream ss;
 		ss << type << API_DELIMINATOR << id << API_DELIMINATOR << val << API_DELIMINATOR << proc_id << API_DELIMINATOR << prime::util::get_timestamp();
 		std::string json_string = ss.str();
 
-        std::shared_ptr<prime::uds> socket_ptr;
-        app_sockets_m.lock();
-        for(auto app_socket : app_sockets) {
-            if(app_socket.first == proc_id) {
-                socket_ptr = app_socket.second;
-            }
-        }
-        app_sockets_m.unlock();
         prime::util::send_message(*socket_ptr.get(), json_string);
         if(logger_en) {
 			prime::util::send_message(logger_socket, json_string);
 		}
 	}
 
-	void app_interface::return_knob_cont_get(pid_t proc_id, unsigned int id)
+	void app_interface::return_knob_cont_get(pid_t proc_id, unsigned int id, uint32_t seq)
 	{
-		char type = PRIME_API_APP_RETURN_KNOB_CONT_GET;
 		prime::api::cont_t val = 0;
 
 		knobs_cont_m.lock();
-		for(auto knob_cont : knobs_cont) {
-			if(knob_cont.id == id && knob_cont.proc_id == proc_id) {
-				val = knob_cont.val;
-			}
+		auto knob_cont = knobs_cont.find(id);
+		if(knob_cont && knob_cont->proc_id == proc_id) {
+			val = knob_cont->val;
 		}
 		knobs_cont_m.unlock();
 
+		send_knob_cont(PRIME_API_APP_RETURN_KNOB_CONT_GET, proc_id, id, val, seq);
+	}
+
+	void app_interface::send_knob_cont(char type, pid_t proc_id, unsigned int id, prime::api::cont_t val, uint32_t seq)
+	{
+		std::shared_ptr<prime::uds> socket_ptr = app_socket(proc_id);
+
+		// The app may have deregistered.
+		if(!socket_ptr)
+			return;
+
+		unsigned int proto_version = app_proto(proc_id);
+		if(proto_version >= PRIME_API_BIN_V1) {
+			// Echo the sequence number of a V2 get.
+			prime::api::bin::seq_msg_t<prime::api::bin::app_cont_msg_t> payload = {{id, proc_id, val}, seq};
+			std::vector<char> bin_message = seq ? prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version)
+												: prime::api::bin::encode(type, payload.msg, prime::util::get_timestamp(), proto_version);
+			socket_ptr->send_message(bin_message);
+			if(logger_en) {
+				logger_socket.send_message(bin_message);
+			}
+			return;
+		}
+
 		std::stringstream ss;
 		ss << type << API_DELIMINATOR << id << API_DELIMINATOR << val << API_DELIMINATOR << proc_id << API_DELIMINATOR << prime::util::get_timestamp();
 		std::string json_string = ss.str();
 
-        std::shared_ptr<prime::uds> socket_ptr;
-        app_sockets_m.lock();
-        for(auto app_socket : app_sockets) {
-            if(app_socket.first == proc_id) {
-                socket_ptr = app_socket.second;
-            }
-        }
-        app_sockets_m.unlock();
         prime::util::send_message(*socket_ptr.get(), json_string);
         if(logger_en) {
 			prime::util::send_message(logger_socket, json_string);
@@ -1509,17 +1708,127 @@ namespace prime { namespace api { namespace rtm
 
 	dev_interface::~dev_interface()
 	{
+		std::vector<unsigned int> sub_ids;
+		mon_subs_m.lock();
+		for(auto& sub : mon_subs)
+			sub_ids.push_back(sub.first);
+		mon_subs_m.unlock();
+
+		for(auto sub_id : sub_ids)
+			mon_unsubscribe(sub_id);
 	}
 
-	void dev_interface::message_handler(std::vector<char> message)
+	void dev_interface::message_handler(const prime::uds::message_t& message)
 	{
-		if(message[0] != '{') { // Not json, process quickly
+		if(prime::api::bin::is_bin(message)) { // Binary, fixed layout
+			prime::api::bin::seq_msg_t<prime::api::bin::dev_mon_disc_msg_t> disc_payload;
+			prime::api::bin::seq_msg_t<prime::api::bin::dev_mon_cont_msg_t> cont_payload;
+			uint32_t snapshot_seq;
+			std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>> snapshot_disc;
+			std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>> snapshot_cont;
+			boost::function<void(
+				const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>&,
+				const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>&,
+				unsigned long long)> snapshot_handler;
+			std::shared_ptr<mon_sub_t> sub;
+			boost::function<void(prime::api::disc_t, prime::api::disc_t, prime::api::disc_t, unsigned long long)> disc_handler;
+			boost::function<void(prime::api::cont_t, prime::api::cont_t, prime::api::cont_t, unsigned long long)> cont_handler;
+			prime::api::bin::dev_knob_disc_applied_msg_t disc_applied;
+			prime::api::bin::dev_knob_cont_applied_msg_t cont_applied;
+			boost::function<void(unsigned int, prime::api::disc_t, unsigned int, unsigned int)> disc_applied_handler;
+			boost::function<void(unsigned int, prime::api::cont_t, unsigned int, unsigned int)> cont_applied_handler;
+
+			switch((prime::api::dev_rtm_msg_t)prime::api::bin::get_type(message)) {
+				case PRIME_API_DEV_RETURN_MON_DISC_GET:
+					if(!prime::api::bin::decode(message, disc_payload)) {
+						// V1 return, no sequence number.
+						if(!prime::api::bin::decode(message, disc_payload.msg))
+							break;
+						disc_payload.seq = 0;
+					}
+
+					disc_handler = mon_disc_gets.take(disc_payload.msg.id, disc_payload.seq);
+					if(disc_handler)
+						disc_handler(disc_payload.msg.val, disc_payload.msg.min, disc_payload.msg.max, prime::api::bin::get_ts(message));
+					break;
+
+				case PRIME_API_DEV_RETURN_MON_CONT_GET:
+					if(!prime::api::bin::decode(message, cont_payload)) {
+						// V1 return, no sequence number.
+						if(!prime::api::bin::decode(message, cont_payload.msg))
+							break;
+						cont_payload.seq = 0;
+					}
+
+					cont_handler = mon_cont_gets.take(cont_payload.msg.id, cont_payload.seq);
+					if(cont_handler)
+						cont_handler(cont_payload.msg.val, cont_payload.msg.min, cont_payload.msg.max, prime::api::bin::get_ts(message));
+					break;
+
+				case PRIME_API_DEV_RETURN_MON_SNAPSHOT:
+					if(!decode_mon_snapshot(message, snapshot_seq, snapshot_disc, snapshot_cont))
+						break;
+
+					snapshot_handler = mon_snapshot_gets.take(0, snapshot_seq);
+					if(snapshot_handler)
+						snapshot_handler(snapshot_disc, snapshot_cont, prime::api::bin::get_ts(message));
+					break;
+
+				case PRIME_API_DEV_MON_PUBLISH:
+					if(!decode_mon_snapshot(message, snapshot_seq, snapshot_disc, snapshot_cont))
+						break;
+
+					mon_subs_m.lock();
+					if(mon_subs.count(snapshot_seq))
+						sub = mon_subs[snapshot_seq];
+					mon_subs_m.unlock();
+
+					// Publishes still in flight after an unsubscribe are dropped.
+					if(sub) {
+						std::vector<prime::api::dev::mon_disc_t> mons_disc = sub->mons_disc;
+						std::vector<prime::api::dev::mon_cont_t> mons_cont = sub->mons_cont;
+						apply_mon_snapshot(mons_disc, mons_cont, snapshot_disc, snapshot_cont);
+						sub->handler(mons_disc, mons_cont, prime::api::bin::get_ts(message));
+					}
+					break;
+
+				case PRIME_API_DEV_KNOB_DISC_APPLIED:
+					if(!prime::api::bin::decode(message, disc_applied))
+						break;
+
+					knob_applied_m.lock();
+					disc_applied_handler = knob_disc_applied_handler;
+					knob_applied_m.unlock();
+					if(disc_applied_handler)
+						disc_applied_handler(disc_applied.id, disc_applied.val, disc_applied.latency_us, disc_applied.collapsed);
+					break;
+
+				case PRIME_API_DEV_KNOB_CONT_APPLIED:
+					if(!prime::api::bin::decode(message, cont_applied))
+						break;
+
+					knob_applied_m.lock();
+					cont_applied_handler = knob_cont_applied_handler;
+					knob_applied_m.unlock();
+					if(cont_applied_handler)
+						cont_applied_handler(cont_applied.id, cont_applied.val, cont_applied.latency_us, cont_applied.collapsed);
+					break;
+
+				default:
+#ifdef DEBUG
+					std::cout << "Error: unknown binary message type: " << prime::api::bin::get_type(message) << std::endl;
+#endif
+					break;
+			}
+
+		} else if(message[0] != '{') { // Not json, process quickly
 			std::string delim = API_DELIMINATOR;
 			size_t position;
-			std::string id, val, min, max, type;
-			std::string message_string( (reinterpret_cast<char*>(message.data())) + 1 + delim.length());
+			std::string id, val, min, max, type, ts;
+			std::string message_string( (message.data()) + 1 + delim.length());
+			boost::function<void(prime::api::disc_t, prime::api::disc_t, prime::api::disc_t, unsigned long long)> disc_handler;
+			boost::function<void(prime::api::cont_t, prime::api::cont_t, prime::api::cont_t, unsigned long long)> cont_handler;
 #ifdef DEBUG
-			std::string ts;
 			std::cout << "Message String: " <<  message_string << std::endl;
 #endif
 			switch((prime::api::rtm_dev_msg_t)message[0]) {
@@ -1537,18 +1846,14 @@ namespace prime { namespace api { namespace rtm
 					position = message_string.find(delim);
 					max = message_string.substr(0, position);
 					
-					disc_return_m.lock();
-					disc_return = std::stoul(val);
-					disc_max = std::stoul(max);
-					disc_min = std::stoul(min);
-					disc_return_m.unlock();
-
-					mon_disc_get_flag = true;
-					mon_disc_get_cv.notify_one();
-#ifdef DEBUG
 					message_string.erase(0, position+delim.length());
 					position = message_string.find(delim);
 					ts = message_string.substr(0, position);
+
+					disc_handler = mon_disc_gets.take(std::stoul(id), 0);
+					if(disc_handler)
+						disc_handler(std::stoul(val), std::stoul(min), std::stoul(max), std::stoull(ts));
+#ifdef DEBUG
 					std::cout << "PRIME_API_DEV_RETURN_MON_DISC_GET\tts: " << ts << "\tid: " << id << "\tval: " << val << "\n" << std::endl;
 #endif
 					break;
@@ -1567,18 +1872,14 @@ namespace prime { namespace api { namespace rtm
 					position = message_string.find(delim);
 					max = message_string.substr(0, position);
 
-					cont_return_m.lock();
-					cont_return = std::stof(val);
-					cont_min = std::stof(min);
-					cont_max = std::stof(max);
-					cont_return_m.unlock();
-
-					mon_cont_get_flag = true;
-					mon_cont_get_cv.notify_one();
-#ifdef DEBUG
 					message_string.erase(0, position+delim.length());
 					position = message_string.find(delim);
 					ts = message_string.substr(0, position);
+
+					cont_handler = mon_cont_gets.take(std::stoul(id), 0);
+					if(cont_handler)
+						cont_handler(std::stof(val), std::stof(min), std::stof(max), std::stoull(ts));
+#ifdef DEBUG
 					std::cout << "PRIME_API_DEV_RETURN_MON_CONT_GET\tts: " << ts << "\tid: " << id << "\tval: " << val << "\n" << std::endl;
 #endif
 					break;
@@ -1591,7 +1892,7 @@ namespace prime { namespace api { namespace rtm
 			}
 
 		} else {	// This is json, send it to the slow lane.
-			std::string message_string(reinterpret_cast<char*>(message.data()));		// This is 4ms+ faster than the two lines below!
+			std::string message_string(message.data());		// This is 4ms+ faster than the two lines below!
 			//std::string message_string(message.begin(), message.end());
 			//boost::trim_right_if(message_string, boost::is_any_of(std::string("\0", 1)));
 
@@ -1607,16 +1908,22 @@ namespace prime { namespace api { namespace rtm
 				unsigned_int_return_m.lock();
 				unsigned_int_return = data.get<unsigned int>("");
 				unsigned_int_return_m.unlock();
+				knob_disc_size_m.lock();
 				knob_disc_size_cv.notify_one();
+				knob_disc_size_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_KNOB_CONT_SIZE")) {
 				boost::property_tree::ptree data = root.get_child("data");
 				unsigned_int_return_m.lock();
 				unsigned_int_return = data.get<unsigned int>("");
 				unsigned_int_return_m.unlock();
+				knob_cont_size_m.lock();
 				knob_cont_size_cv.notify_one();
+				knob_cont_size_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_KNOB_DISC_REG")) {
+				// Devices without binary support do not return a protocol version.
+				proto_version = prime::api::bin::negotiate(root.get<unsigned int>("proto", 0));
 				boost::property_tree::ptree data = root.get_child("data");
 				for (const auto& pair : data.get_child("")) {
 					boost::property_tree::ptree knob_node = pair.second;
@@ -1631,9 +1938,13 @@ namespace prime { namespace api { namespace rtm
 					knobs_disc.push_back(knob);
 					knobs_disc_m.unlock();
 				}
+				knob_disc_reg_m.lock();
 				knob_disc_reg_cv.notify_one();
+				knob_disc_reg_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_KNOB_CONT_REG")) {
+				// Devices without binary support do not return a protocol version.
+				proto_version = prime::api::bin::negotiate(root.get<unsigned int>("proto", 0));
 				boost::property_tree::ptree data = root.get_child("data");
 				for (const auto& pair : data.get_child("")) {
 					boost::property_tree::ptree knob_node = pair.second;
@@ -1648,23 +1959,31 @@ namespace prime { namespace api { namespace rtm
 					knobs_cont.push_back(knob);
 					knobs_cont_m.unlock();
 				}
+				knob_cont_reg_m.lock();
 				knob_cont_reg_cv.notify_one();
+				knob_cont_reg_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_MON_DISC_SIZE")) {
 				boost::property_tree::ptree data = root.get_child("data");
 				unsigned_int_return_m.lock();
 				unsigned_int_return = data.get<unsigned int>("");
 				unsigned_int_return_m.unlock();
+				mon_disc_size_m.lock();
 				mon_disc_size_cv.notify_one();
+				mon_disc_size_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_MON_CONT_SIZE")) {
 				boost::property_tree::ptree data = root.get_child("data");
 				unsigned_int_return_m.lock();
 				unsigned_int_return = data.get<unsigned int>("");
 				unsigned_int_return_m.unlock();
+				mon_cont_size_m.lock();
 				mon_cont_size_cv.notify_one();
+				mon_cont_size_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_MON_DISC_REG")) {
+				// Devices without binary support do not return a protocol version.
+				proto_version = prime::api::bin::negotiate(root.get<unsigned int>("proto", 0));
 				boost::property_tree::ptree data = root.get_child("data");
 				for (const auto& pair : data.get_child("")) {
 					boost::property_tree::ptree mon_node = pair.second;
@@ -1674,13 +1993,20 @@ namespace prime { namespace api { namespace rtm
 					mon.val = mon_node.get<prime::api::disc_t>("val");
 					mon.min = mon_node.get<prime::api::disc_t>("min");
 					mon.max = mon_node.get<prime::api::disc_t>("max");
+					// Older devices do not declare update intervals or stamp readings.
+					mon.update_us = mon_node.get<unsigned int>("update_us", 0);
+					mon.ts = mon_node.get<unsigned long long>("ts", 0);
 					mons_disc_m.lock();
 					mons_disc.push_back(mon);
 					mons_disc_m.unlock();
 				}
+				mon_disc_reg_m.lock();
 				mon_disc_reg_cv.notify_one();
+				mon_disc_reg_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_MON_CONT_REG")) {
+				// Devices without binary support do not return a protocol version.
+				proto_version = prime::api::bin::negotiate(root.get<unsigned int>("proto", 0));
 				boost::property_tree::ptree data = root.get_child("data");
 				for (const auto& pair : data.get_child("")) {
 					boost::property_tree::ptree mon_node = pair.second;
@@ -1690,30 +2016,37 @@ namespace prime { namespace api { namespace rtm
 					mon.val = mon_node.get<prime::api::cont_t>("val");
 					mon.min = mon_node.get<prime::api::cont_t>("min");
 					mon.max = mon_node.get<prime::api::cont_t>("max");
+					// Older devices do not declare update intervals or stamp readings.
+					mon.update_us = mon_node.get<unsigned int>("update_us", 0);
+					mon.ts = mon_node.get<unsigned long long>("ts", 0);
 					mons_cont_m.lock();
 					mons_cont.push_back(mon);
 					mons_cont_m.unlock();
 				}
+				mon_cont_reg_m.lock();
 				mon_cont_reg_cv.notify_one();
+				mon_cont_reg_m.unlock();
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_MON_DISC_GET")) {
-				disc_return_m.lock();
-				disc_return = root.get<prime::api::disc_t>("val");
-				disc_return_m.unlock();
-				mon_disc_get_cv.notify_one();
+				boost::function<void(prime::api::disc_t, prime::api::disc_t, prime::api::disc_t, unsigned long long)> disc_handler = mon_disc_gets.take_oldest();
+				prime::api::disc_t val = root.get<prime::api::disc_t>("val");
+				if(disc_handler)
+					disc_handler(val, root.get<prime::api::disc_t>("min", val), root.get<prime::api::disc_t>("max", val), root.get<unsigned long long>("ts"));
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_MON_CONT_GET")) {
-				cont_return_m.lock();
-				cont_return = root.get<prime::api::cont_t>("val");
-				cont_return_m.unlock();
-				mon_cont_get_cv.notify_one();
+				boost::function<void(prime::api::cont_t, prime::api::cont_t, prime::api::cont_t, unsigned long long)> cont_handler = mon_cont_gets.take_oldest();
+				prime::api::cont_t val = root.get<prime::api::cont_t>("val");
+				if(cont_handler)
+					cont_handler(val, root.get<prime::api::cont_t>("min", val), root.get<prime::api::cont_t>("max", val), root.get<unsigned long long>("ts"));
 			}
 			else if(!message_type.compare("PRIME_API_DEV_RETURN_ARCH_GET")) {
 				boost::property_tree::ptree data = root.get_child("data");
 				dev_arch_return_m.lock();
 				boost::property_tree::read_json(data.get<std::string>(""), dev_architecture);
 				dev_arch_return_m.unlock();
+				dev_arch_get_m.lock();
 				dev_arch_get_cv.notify_one();
+				dev_arch_get_m.unlock();
 			}
 			else {
 				std::cout << "UNKNOWN MESSAGE TYPE (DEV > RTM): " << message_type << std::endl;
@@ -1724,9 +2057,9 @@ namespace prime { namespace api { namespace rtm
 	unsigned int dev_interface::knob_disc_size(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_KNOB_DISC_SIZE");
+		std::unique_lock<std::mutex> lock(knob_disc_size_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(knob_disc_size_m);
 		knob_disc_size_cv.wait(lock);
 
 		unsigned_int_return_m.lock();
@@ -1739,9 +2072,9 @@ namespace prime { namespace api { namespace rtm
 	unsigned int dev_interface::knob_cont_size(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_KNOB_CONT_SIZE");
+		std::unique_lock<std::mutex> lock(knob_cont_size_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(knob_cont_size_m);
 		knob_cont_size_cv.wait(lock);
 
 		unsigned_int_return_m.lock();
@@ -1754,9 +2087,10 @@ namespace prime { namespace api { namespace rtm
 	std::vector<prime::api::dev::knob_disc_t> dev_interface::knob_disc_reg(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_KNOB_DISC_REG");
+		ADD_JSON_DATA("proto", PRIME_API_BIN_VERSION);
+		std::unique_lock<std::mutex> lock(knob_disc_reg_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(knob_disc_reg_m);
 		knob_disc_reg_cv.wait(lock);
 
 		knobs_disc_m.lock();
@@ -1770,9 +2104,10 @@ namespace prime { namespace api { namespace rtm
 	std::vector<prime::api::dev::knob_cont_t> dev_interface::knob_cont_reg(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_KNOB_CONT_REG");
+		ADD_JSON_DATA("proto", PRIME_API_BIN_VERSION);
+		std::unique_lock<std::mutex> lock(knob_cont_reg_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(knob_cont_reg_m);
 		knob_cont_reg_cv.wait(lock);
 
 		knobs_cont_m.lock();
@@ -1827,6 +2162,14 @@ namespace prime { namespace api { namespace rtm
 	{
 		char type = (rtm_dev_msg_t)PRIME_API_DEV_KNOB_DISC_SET;
 
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::dev_knob_disc_msg_t payload = {knob.id, val};
+			std::vector<char> bin_message = prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version);
+			socket.send_message(bin_message);
+			logger_socket.send_message(bin_message);
+			return;
+		}
+
 		std::stringstream ss;
 		ss << type << API_DELIMINATOR << knob.id << API_DELIMINATOR << val << API_DELIMINATOR << prime::util::get_timestamp();
 		std::string json_string = ss.str();
@@ -1839,6 +2182,14 @@ namespace prime { namespace api { namespace rtm
 	{
 		char type = (rtm_dev_msg_t)PRIME_API_DEV_KNOB_CONT_SET;
 
+		if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::dev_knob_cont_msg_t payload = {knob.id, val};
+			std::vector<char> bin_message = prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version);
+			socket.send_message(bin_message);
+			logger_socket.send_message(bin_message);
+			return;
+		}
+
 		std::stringstream ss;
 		ss << type << API_DELIMINATOR << knob.id << API_DELIMINATOR << val << API_DELIMINATOR << prime::util::get_timestamp();
 		std::string json_string = ss.str();
@@ -1847,6 +2198,20 @@ namespace prime { namespace api { namespace rtm
 		prime::util::send_message(logger_socket, json_string);
 	}
 
+	void dev_interface::knob_disc_applied(boost::function<void(unsigned int, prime::api::disc_t, unsigned int, unsigned int)> handler)
+	{
+		knob_applied_m.lock();
+		knob_disc_applied_handler = handler;
+		knob_applied_m.unlock();
+	}
+
+	void dev_interface::knob_cont_applied(boost::function<void(unsigned int, prime::api::cont_t, unsigned int, unsigned int)> handler)
+	{
+		knob_applied_m.lock();
+		knob_cont_applied_handler = handler;
+		knob_applied_m.unlock();
+	}
+
 	void dev_interface::knob_disc_dereg(std::vector<prime::api::dev::knob_disc_t>& knobs)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_KNOB_DISC_DEREG");
@@ -1878,9 +2243,9 @@ namespace prime { namespace api { namespace rtm
 	unsigned int dev_interface::mon_disc_size(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_MON_DISC_SIZE");
+		std::unique_lock<std::mutex> lock(mon_disc_size_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(mon_disc_size_m);
 		mon_disc_size_cv.wait(lock);
 
 		unsigned_int_return_m.lock();
@@ -1893,9 +2258,9 @@ namespace prime { namespace api { namespace rtm
 	unsigned int dev_interface::mon_cont_size(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_MON_CONT_SIZE");
+		std::unique_lock<std::mutex> lock(mon_cont_size_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(mon_cont_size_m);
 		mon_cont_size_cv.wait(lock);
 
 		unsigned_int_return_m.lock();
@@ -1908,9 +2273,10 @@ namespace prime { namespace api { namespace rtm
 	std::vector<prime::api::dev::mon_disc_t> dev_interface::mon_disc_reg(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_MON_DISC_REG");
+		ADD_JSON_DATA("proto", PRIME_API_BIN_VERSION);
+		std::unique_lock<std::mutex> lock(mon_disc_reg_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(mon_disc_reg_m);
 		mon_disc_reg_cv.wait(lock);
 
 		mons_disc_m.lock();
@@ -1924,9 +2290,10 @@ namespace prime { namespace api { namespace rtm
 	std::vector<prime::api::dev::mon_cont_t> dev_interface::mon_cont_reg(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_MON_CONT_REG");
+		ADD_JSON_DATA("proto", PRIME_API_BIN_VERSION);
+		std::unique_lock<std::mutex> lock(mon_cont_reg_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(mon_cont_reg_m);
 		mon_cont_reg_cv.wait(lock);
 
 		mons_cont_m.lock();
@@ -1949,56 +2316,368 @@ namespace prime { namespace api { namespace rtm
 
 	prime::api::disc_t dev_interface::mon_disc_get(prime::api::dev::mon_disc_t& mon)
 	{
-		char type = (rtm_dev_msg_t)PRIME_API_DEV_MON_DISC_GET;
+		std::promise<prime::api::dev::mon_disc_t> result;
+		std::future<prime::api::dev::mon_disc_t> updated = result.get_future();
+		mon_disc_get(mon, [&result](prime::api::dev::mon_disc_t mon) { result.set_value(mon); });
+		mon = updated.get();
+		return mon.val;
+	}
 
-		std::stringstream ss;
-		ss << type << API_DELIMINATOR << mon.id << API_DELIMINATOR << prime::util::get_timestamp();
-		std::string json_string = ss.str();
+	void dev_interface::mon_disc_get(prime::api::dev::mon_disc_t mon, boost::function<void(prime::api::dev::mon_disc_t)> handler)
+	{
+		char type = (rtm_dev_msg_t)PRIME_API_DEV_MON_DISC_GET;
 
-		mon_disc_get_flag = false;
-		prime::util::send_message(socket, json_string);
-		prime::util::send_message(logger_socket, json_string);
+		uint32_t seq = mon_disc_gets.add(mon.id,
+			[mon, handler](prime::api::disc_t val, prime::api::disc_t min, prime::api::disc_t max, unsigned long long ts) mutable {
+				mon.val = val;
+				mon.min = min;
+				mon.max = max;
+				mon.ts = ts;
+				handler(mon);
+			});
+
+		if(proto_version >= PRIME_API_BIN_V2) {
+			prime::api::bin::seq_msg_t<prime::api::bin::dev_get_msg_t> payload = {{mon.id}, seq};
+			std::vector<char> bin_message = prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version);
+			socket.send_message(bin_message);
+			logger_socket.send_message(bin_message);
+		} else if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::dev_get_msg_t payload = {mon.id};
+			std::vector<char> bin_message = prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version);
+			socket.send_message(bin_message);
+			logger_socket.send_message(bin_message);
+		} else {
+			std::stringstream ss;
+			ss << type << API_DELIMINATOR << mon.id << API_DELIMINATOR << prime::util::get_timestamp();
+			std::string json_string = ss.str();
 
-		std::unique_lock<std::mutex> lock(mon_disc_get_m);
-		while(!mon_disc_get_flag){
-			mon_disc_get_cv.wait(lock);
+			prime::util::send_message(socket, json_string);
+			prime::util::send_message(logger_socket, json_string);
 		}
+	}
 
-		disc_return_m.lock();
-		auto result = disc_return;
-		mon.val = disc_return;
-		mon.min = disc_min;
-		mon.max = disc_max;
-		disc_return_m.unlock();
 
-		return result;
+	prime::api::cont_t dev_interface::mon_cont_get(prime::api::dev::mon_cont_t& mon)
+	{
+		std::promise<prime::api::dev::mon_cont_t> result;
+		std::future<prime::api::dev::mon_cont_t> updated = result.get_future();
+		mon_cont_get(mon, [&result](prime::api::dev::mon_cont_t mon) { result.set_value(mon); });
+		mon = updated.get();
+		return mon.val;
 	}
 
-	prime::api::cont_t dev_interface::mon_cont_get(prime::api::dev::mon_cont_t& mon)
+	void dev_interface::mon_cont_get(prime::api::dev::mon_cont_t mon, boost::function<void(prime::api::dev::mon_cont_t)> handler)
 	{
 		char type = (rtm_dev_msg_t)PRIME_API_DEV_MON_CONT_GET;
 
-		std::stringstream ss;
-		ss << type << API_DELIMINATOR << mon.id << API_DELIMINATOR << prime::util::get_timestamp();
-		std::string json_string = ss.str();
+		uint32_t seq = mon_cont_gets.add(mon.id,
+			[mon, handler](prime::api::cont_t val, prime::api::cont_t min, prime::api::cont_t max, unsigned long long ts) mutable {
+				mon.val = val;
+				mon.min = min;
+				mon.max = max;
+				mon.ts = ts;
+				handler(mon);
+			});
+
+		if(proto_version >= PRIME_API_BIN_V2) {
+			prime::api::bin::seq_msg_t<prime::api::bin::dev_get_msg_t> payload = {{mon.id}, seq};
+			std::vector<char> bin_message = prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version);
+			socket.send_message(bin_message);
+			logger_socket.send_message(bin_message);
+		} else if(proto_version >= PRIME_API_BIN_V1) {
+			prime::api::bin::dev_get_msg_t payload = {mon.id};
+			std::vector<char> bin_message = prime::api::bin::encode(type, payload, prime::util::get_timestamp(), proto_version);
+			socket.send_message(bin_message);
+			logger_socket.send_message(bin_message);
+		} else {
+			std::stringstream ss;
+			ss << type << API_DELIMINATOR << mon.id << API_DELIMINATOR << prime::util::get_timestamp();
+			std::string json_string = ss.str();
 
-		mon_cont_get_flag = false;
-		prime::util::send_message(socket, json_string);
-		prime::util::send_message(logger_socket, json_string);
+			prime::util::send_message(socket, json_string);
+			prime::util::send_message(logger_socket, json_string);
+		}
+	}
+
+	unsigned long long dev_interface::mon_snapshot_get(std::vector<prime::api::dev::mon_disc_t>& mons_disc, std::vector<prime::api::dev::mon_cont_t>& mons_cont)
+	{
+		std::promise<unsigned long long> result;
+		std::future<unsigned long long> ts = result.get_future();
+		mon_snapshot_get(mons_disc, mons_cont,
+			[&result, &mons_disc, &mons_cont](std::vector<prime::api::dev::mon_disc_t> disc, std::vector<prime::api::dev::mon_cont_t> cont, unsigned long long ts) {
+				mons_disc = disc;
+				mons_cont = cont;
+				result.set_value(ts);
+			});
+		return ts.get();
+	}
+
+	unsigned long long dev_interface::mon_snapshot_get(std::vector<prime::api::dev::mon_disc_t>& mons_disc)
+	{
+		std::vector<prime::api::dev::mon_cont_t> mons_cont;
+		return mon_snapshot_get(mons_disc, mons_cont);
+	}
+
+	unsigned long long dev_interface::mon_snapshot_get(std::vector<prime::api::dev::mon_cont_t>& mons_cont)
+	{
+		std::vector<prime::api::dev::mon_disc_t> mons_disc;
+		return mon_snapshot_get(mons_disc, mons_cont);
+	}
 
-		std::unique_lock<std::mutex> lock(mon_cont_get_m);
-		while(!mon_cont_get_flag){
-			mon_cont_get_cv.wait(lock);
+	void dev_interface::mon_snapshot_get(
+		std::vector<prime::api::dev::mon_disc_t> mons_disc,
+		std::vector<prime::api::dev::mon_cont_t> mons_cont,
+		boost::function<void(std::vector<prime::api::dev::mon_disc_t>, std::vector<prime::api::dev::mon_cont_t>, unsigned long long)> handler)
+	{
+		if(proto_version < PRIME_API_BIN_V3 || mons_disc.size() + mons_cont.size() > PRIME_API_BIN_SNAPSHOT_MAX) {
+			mon_snapshot_fallback(mons_disc, mons_cont, handler);
+			return;
 		}
 
-		cont_return_m.lock();
-		auto result = cont_return;
-		mon.val = cont_return;
-		mon.min = cont_min;
-		mon.max = cont_max;
-		cont_return_m.unlock();
+		std::vector<uint32_t> disc_ids, cont_ids;
+		for(auto& mon : mons_disc)
+			disc_ids.push_back(mon.id);
+		for(auto& mon : mons_cont)
+			cont_ids.push_back(mon.id);
+
+		uint32_t seq = mon_snapshot_gets.add(0,
+			[mons_disc, mons_cont, handler](
+				const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+				const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals,
+				unsigned long long ts) mutable {
+				apply_mon_snapshot(mons_disc, mons_cont, disc_vals, cont_vals);
+				handler(mons_disc, mons_cont, ts);
+			});
+
+		// The logger records the device's return, which carries every reading.
+		std::vector<char> bin_message = prime::api::bin::encode_snapshot(PRIME_API_DEV_MON_SNAPSHOT_GET, seq, disc_ids, cont_ids, prime::util::get_timestamp(), proto_version);
+		socket.send_message(bin_message);
+	}
 
-		return result;
+	bool dev_interface::decode_mon_snapshot(
+		const prime::uds::message_t& message,
+		uint32_t& seq,
+		std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+		std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals)
+	{
+		if(proto_version >= PRIME_API_BIN_V7)
+			return prime::api::bin::decode_snapshot(message, seq, disc_vals, cont_vals);
+
+		// Before V7 the records are bare; each takes the header's timestamp, the oldest reading.
+		std::vector<prime::api::bin::dev_mon_disc_msg_t> disc_msgs;
+		std::vector<prime::api::bin::dev_mon_cont_msg_t> cont_msgs;
+		if(!prime::api::bin::decode_snapshot(message, seq, disc_msgs, cont_msgs))
+			return false;
+
+		uint64_t ts = prime::api::bin::get_ts(message);
+		disc_vals.clear();
+		for(auto& msg : disc_msgs)
+			disc_vals.push_back({msg, ts});
+		cont_vals.clear();
+		for(auto& msg : cont_msgs)
+			cont_vals.push_back({msg, ts});
+		return true;
+	}
+
+	void dev_interface::apply_mon_snapshot(
+		std::vector<prime::api::dev::mon_disc_t>& mons_disc,
+		std::vector<prime::api::dev::mon_cont_t>& mons_cont,
+		const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_disc_msg_t>>& disc_vals,
+		const std::vector<prime::api::bin::ts_msg_t<prime::api::bin::dev_mon_cont_msg_t>>& cont_vals)
+	{
+		// Returns are in request order, less any monitors the device did not have.
+		auto disc_val = disc_vals.begin();
+		for(auto& mon : mons_disc) {
+			if(disc_val != disc_vals.end() && disc_val->msg.id == mon.id) {
+				mon.val = disc_val->msg.val;
+				mon.min = disc_val->msg.min;
+				mon.max = disc_val->msg.max;
+				mon.ts = disc_val->ts;
+				disc_val++;
+			}
+		}
+		auto cont_val = cont_vals.begin();
+		for(auto& mon : mons_cont) {
+			if(cont_val != cont_vals.end() && cont_val->msg.id == mon.id) {
+				mon.val = cont_val->msg.val;
+				mon.min = cont_val->msg.min;
+				mon.max = cont_val->msg.max;
+				mon.ts = cont_val->ts;
+				cont_val++;
+			}
+		}
+	}
+
+	unsigned int dev_interface::mon_subscribe(
+		std::vector<prime::api::dev::mon_disc_t> mons_disc,
+		std::vector<prime::api::dev::mon_cont_t> mons_cont,
+		unsigned int period_us,
+		boost::function<void(std::vector<prime::api::dev::mon_disc_t>, std::vector<prime::api::dev::mon_cont_t>, unsigned long long)> handler,
+		prime::api::cont_t threshold,
+		int cpu)
+	{
+		if(period_us == 0)
+			return 0;
+
+		std::shared_ptr<mon_sub_t> sub = std::make_shared<mon_sub_t>();
+		sub->mons_disc = mons_disc;
+		sub->mons_cont = mons_cont;
+		sub->handler = handler;
+		sub->period_us = period_us;
+		sub->threshold = threshold;
+
+		bool poll = (proto_version < PRIME_API_BIN_V4 || mons_disc.size() + mons_cont.size() > PRIME_API_BIN_SNAPSHOT_MAX);
+
+		mon_subs_m.lock();
+		unsigned int sub_id = ++next_sub_id;
+		mon_subs[sub_id] = sub;
+		if(poll)
+			sub->poll_thread = boost::thread(&dev_interface::mon_sub_poll, this, sub);
+		mon_subs_m.unlock();
+
+		if(poll)
+			return sub_id;
+
+		CREATE_JSON_ROOT("PRIME_API_DEV_MON_SUBSCRIBE");
+		boost::property_tree::ptree disc_ids, cont_ids;
+		for(auto& mon : mons_disc) {
+			boost::property_tree::ptree id_node;
+			id_node.put("", mon.id);
+			disc_ids.push_back(std::make_pair("", id_node));
+		}
+		for(auto& mon : mons_cont) {
+			boost::property_tree::ptree id_node;
+			id_node.put("", mon.id);
+			cont_ids.push_back(std::make_pair("", id_node));
+		}
+		ADD_JSON_DATA("sub_id", sub_id);
+		ADD_JSON_DATA("period_us", period_us);
+		ADD_JSON_DATA("threshold", threshold);
+		ADD_JSON_DATA("cpu", cpu);
+		data_node.add_child("disc_ids", disc_ids);
+		data_node.add_child("cont_ids", cont_ids);
+		SEND_JSON();
+
+		return sub_id;
+	}
+
+	void dev_interface::mon_unsubscribe(unsigned int sub_id)
+	{
+		std::shared_ptr<mon_sub_t> sub;
+		mon_subs_m.lock();
+		auto sub_it = mon_subs.find(sub_id);
+		if(sub_it != mon_subs.end()) {
+			sub = sub_it->second;
+			mon_subs.erase(sub_it);
+		}
+		mon_subs_m.unlock();
+
+		if(!sub)
+			return;
+
+		if(sub->poll_thread.joinable()) {
+			sub->poll_thread.interrupt();
+			sub->poll_thread.join();
+			return;
+		}
+
+		CREATE_JSON_ROOT("PRIME_API_DEV_MON_UNSUBSCRIBE");
+		ADD_JSON_DATA("sub_id", sub_id);
+		SEND_JSON();
+	}
+
+	// Devices without subscription support: take the snapshots from here on the same schedule.
+	void dev_interface::mon_sub_poll(std::shared_ptr<mon_sub_t> sub)
+	{
+		std::vector<prime::api::dev::mon_disc_t> mons_disc, disc_last;
+		std::vector<prime::api::dev::mon_cont_t> mons_cont, cont_last;
+		bool published = false;
+
+		std::chrono::steady_clock::time_point next_sample = std::chrono::steady_clock::now();
+		try {
+			while(1) {
+				mons_disc = sub->mons_disc;
+				mons_cont = sub->mons_cont;
+				unsigned long long ts = mon_snapshot_get(mons_disc, mons_cont);
+
+				bool changed = !published || sub->threshold <= 0;
+				for(std::size_t i = 0; !changed && i < mons_disc.size(); i++)
+					changed = std::abs((prime::api::cont_t)(mons_disc[i].val - disc_last[i].val)) > sub->threshold;
+				for(std::size_t i = 0; !changed && i < mons_cont.size(); i++)
+					changed = std::abs(mons_cont[i].val - cont_last[i].val) > sub->threshold;
+
+				if(changed) {
+					sub->handler(mons_disc, mons_cont, ts);
+					disc_last = mons_disc;
+					cont_last = mons_cont;
+					published = true;
+				}
+
+				next_sample += std::chrono::microseconds(sub->period_us);
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				if(next_sample < now)
+					next_sample = now;
+				boost::this_thread::sleep(boost::posix_time::microseconds(
+					std::chrono::duration_cast<std::chrono::microseconds>(next_sample - now).count()));
+			}
+		}
+		catch(boost::thread_interrupted&) {
+		}
+	}
+
+	// Devices without snapshot support: issue every get at once and collect the returns.
+	void dev_interface::mon_snapshot_fallback(
+		std::vector<prime::api::dev::mon_disc_t> mons_disc,
+		std::vector<prime::api::dev::mon_cont_t> mons_cont,
+		boost::function<void(std::vector<prime::api::dev::mon_disc_t>, std::vector<prime::api::dev::mon_cont_t>, unsigned long long)> handler)
+	{
+		struct snapshot_t {
+			std::mutex m;
+			std::vector<prime::api::dev::mon_disc_t> mons_disc;
+			std::vector<prime::api::dev::mon_cont_t> mons_cont;
+			std::size_t remaining;
+		};
+		std::shared_ptr<snapshot_t> snapshot = std::make_shared<snapshot_t>();
+		snapshot->mons_disc = mons_disc;
+		snapshot->mons_cont = mons_cont;
+		snapshot->remaining = mons_disc.size() + mons_cont.size();
+
+		if(snapshot->remaining == 0) {
+			handler(mons_disc, mons_cont, prime::util::get_timestamp());
+			return;
+		}
+
+		// Only the last return to arrive reads the snapshot, so the mutex is released first.
+		// Stamped with the oldest reading, as the device stamps a snapshot.
+		auto finish = [snapshot, handler](void) {
+			unsigned long long ts = prime::util::get_timestamp();
+			for(auto& mon : snapshot->mons_disc)
+				ts = std::min(ts, mon.ts);
+			for(auto& mon : snapshot->mons_cont)
+				ts = std::min(ts, mon.ts);
+			handler(snapshot->mons_disc, snapshot->mons_cont, ts);
+		};
+
+		for(std::size_t i = 0; i < mons_disc.size(); i++) {
+			mon_disc_get(mons_disc[i], [snapshot, finish, i](prime::api::dev::mon_disc_t mon) {
+				snapshot->m.lock();
+				snapshot->mons_disc[i] = mon;
+				bool last = (--snapshot->remaining == 0);
+				snapshot->m.unlock();
+				if(last)
+					finish();
+			});
+		}
+		for(std::size_t i = 0; i < mons_cont.size(); i++) {
+			mon_cont_get(mons_cont[i], [snapshot, finish, i](prime::api::dev::mon_cont_t mon) {
+				snapshot->m.lock();
+				snapshot->mons_cont[i] = mon;
+				bool last = (--snapshot->remaining == 0);
+				snapshot->m.unlock();
+				if(last)
+					finish();
+			});
+		}
 	}
 
 	void dev_interface::mon_disc_dereg(std::vector<prime::api::dev::mon_disc_t>& mons)
@@ -2032,9 +2711,9 @@ namespace prime { namespace api { namespace rtm
 	boost::property_tree::ptree dev_interface::dev_arch_get(void)
 	{
 		CREATE_JSON_ROOT("PRIME_API_DEV_ARCH_GET");
+		std::unique_lock<std::mutex> lock(dev_arch_get_m);
 		SEND_JSON();
 
-		std::unique_lock<std::mutex> lock(dev_arch_get_m);
 		dev_arch_get_cv.wait(lock);
 
 		dev_arch_return_m.lock();
@@ -2148,9 +2827,9 @@ namespace prime { namespace api { namespace rtm
 	{
 	}
 
-	void ui_interface::message_handler(std::vector<char> message)
+	void ui_interface::message_handler(const prime::uds::message_t& message)
 	{
-		std::string message_string(reinterpret_cast<char*>(message.data()));		// This is 4ms+ faster than the two lines below!
+		std::string message_string(message.data());		// This is 4ms+ faster than the two lines below!
 		//std::string message_string(message.begin(), message.end());
 		//boost::trim_right_if(message_string, boost::is_any_of(std::string("\0", 1)));
 		std::stringstream ss;
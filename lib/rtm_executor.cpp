@@ -0,0 +1,188 @@
+/* This file is part of the PRiME Framework.
+ *
+ * The PRiME Framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The PRiME Framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the PRiME Framework.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech, Graeme Bragg & James Bantock
+ */
+
+#include "rtm_executor.h"
+
+namespace prime { namespace api { namespace rtm
+{
+	executor_t::executor_t() : stopping(false)
+	{
+	}
+
+	executor_t::~executor_t()
+	{
+		stop();
+	}
+
+	void executor_t::start(unsigned int num_threads)
+	{
+		stop();
+		exec_m.lock();
+		stopping = false;
+		exec_m.unlock();
+		for(unsigned int i = 0; i < (num_threads ? num_threads : 1); i++)
+			threads.push_back(boost::thread(&executor_t::run, this));
+	}
+
+	void executor_t::stop(void)
+	{
+		exec_m.lock();
+		stopping = true;
+		exec_m.unlock();
+		exec_cv.notify_all();
+
+		for(auto& thread : threads) {
+			if(thread.joinable())
+				thread.join();
+		}
+		threads.clear();
+
+		exec_m.lock();
+		queue.clear();
+		latest.clear();
+		timers.clear();
+		exec_m.unlock();
+	}
+
+	void executor_t::post(task_t task)
+	{
+		exec_m.lock();
+		queue.push_back(item_t{false, 0, task});
+		exec_m.unlock();
+		exec_cv.notify_one();
+	}
+
+	void executor_t::post_latest(uint64_t key, task_t task)
+	{
+		exec_m.lock();
+		bool wake = false;
+		latest_t& entry = latest[key];
+		entry.task = task;
+		if(entry.running) {
+			entry.again = true;
+		} else if(!entry.queued) {
+			queue.push_back(item_t{true, key, task_t()});
+			entry.queued = true;
+			wake = true;
+		}
+		exec_m.unlock();
+		if(wake)
+			exec_cv.notify_one();
+	}
+
+	void executor_t::every(unsigned int period_us, task_t task)
+	{
+		std::chrono::microseconds period(period_us ? period_us : 1);
+		exec_m.lock();
+		timers.push_back(periodic_t{steady_t::now() + period, period, task, false});
+		exec_m.unlock();
+		exec_cv.notify_one();
+	}
+
+	uint64_t executor_t::mon_key(pid_t proc_id, unsigned int id)
+	{
+		return ((uint64_t)(uint32_t)proc_id << 32) | id;
+	}
+
+	void executor_t::run(void)
+	{
+		std::unique_lock<std::mutex> lock(exec_m);
+		while(!stopping) {
+			if(run_timer(lock))
+				continue;
+			if(!queue.empty()) {
+				run_item(lock);
+				continue;
+			}
+
+			// Nothing to do until the next deadline or post.
+			bool timed = false;
+			steady_t::time_point next;
+			for(auto& timer : timers) {
+				if(!timer.running && (!timed || timer.due < next)) {
+					next = timer.due;
+					timed = true;
+				}
+			}
+			if(timed)
+				exec_cv.wait_until(lock, next);
+			else
+				exec_cv.wait(lock);
+		}
+	}
+
+	bool executor_t::run_timer(std::unique_lock<std::mutex> &lock)
+	{
+		steady_t::time_point now = steady_t::now();
+		periodic_t *due = nullptr;
+		for(auto& timer : timers) {
+			if(!timer.running && timer.due <= now && (!due || timer.due < due->due))
+				due = &timer;
+		}
+		if(!due)
+			return false;
+
+		// List elements stay put while the lock is released.
+		due->running = true;
+		task_t task = due->task;
+		lock.unlock();
+		task();
+		lock.lock();
+		due->running = false;
+
+		now = steady_t::now();
+		due->due += due->period;
+		if(due->due <= now)
+			due->due += due->period * ((now - due->due) / due->period + 1);
+		return true;
+	}
+
+	void executor_t::run_item(std::unique_lock<std::mutex> &lock)
+	{
+		item_t item = queue.front();
+		queue.pop_front();
+
+		if(!item.keyed) {
+			lock.unlock();
+			item.task();
+			lock.lock();
+			return;
+		}
+
+		latest_t& entry = latest[item.key];
+		entry.queued = false;
+		task_t task;
+		task.swap(entry.task);
+		entry.running = true;
+		lock.unlock();
+		task();
+		lock.lock();
+
+		// Entries are only erased here, by the thread running them, so the reference still holds.
+		entry.running = false;
+		if(entry.again) {
+			entry.again = false;
+			queue.push_back(item_t{true, item.key, task_t()});
+			entry.queued = true;
+			exec_cv.notify_one();
+		} else {
+			latest.erase(item.key);
+		}
+	}
+} } }
@@ -0,0 +1,287 @@
+/* This file is part of the PRiME Framework.
+ *
+ * The PRiME Framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The PRiME Framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the PRiME Framework.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Graeme Bragg & James Bantock
+ */
+
+#include "shm_ring.h"
+#include <algorithm>
+#include <new>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SHM_RING_MAGIC		0x50524d32		// "PRM2"
+#define SHM_RING_WRAP		0xFFFFFFFF		// Record length marking a jump back to the start of the ring
+#define SHM_RING_ALIGN		8
+
+namespace prime
+{
+	static inline std::size_t record_size(std::size_t size)
+	{
+		// Length word, payload and NUL terminator, padded to keep length words aligned.
+		return (sizeof(uint32_t) + size + 1 + SHM_RING_ALIGN - 1) & ~(std::size_t)(SHM_RING_ALIGN - 1);
+	}
+
+	static inline void futex_wait(std::atomic<uint32_t> *addr, uint32_t val, unsigned int timeout_us)
+	{
+		struct timespec ts;
+		ts.tv_sec = timeout_us / 1000000;
+		ts.tv_nsec = (timeout_us % 1000000) * 1000;
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT, val, &ts, NULL, 0);
+	}
+
+	static inline void futex_wake(std::atomic<uint32_t> *addr)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+
+	shm_ring::shm_ring() :
+		owner(false),
+		map_size(0),
+		hdr(NULL),
+		ring(NULL)
+	{ }
+
+	shm_ring::~shm_ring()
+	{
+		close();
+	}
+
+	std::string shm_ring::shm_name(std::string endpoint)
+	{
+		// POSIX shm names are a single path component: "/tmp/rtm.app.uds" -> "/prime.tmp.rtm.app.uds"
+		std::replace(endpoint.begin(), endpoint.end(), '/', '.');
+		return "/prime" + endpoint;
+	}
+
+	bool shm_ring::create(std::string endpoint)
+	{
+		close();
+		name = shm_name(endpoint);
+		::shm_unlink(name.c_str());
+
+		int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if(fd < 0)
+			return false;
+
+		std::size_t hdr_size = (sizeof(ring_hdr_t) + 63) & ~(std::size_t)63;
+		map_size = hdr_size + SHM_RING_CAPACITY;
+		if(::ftruncate(fd, map_size) < 0) {
+			::close(fd);
+			::shm_unlink(name.c_str());
+			return false;
+		}
+
+		void *map = ::mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(map == MAP_FAILED) {
+			::shm_unlink(name.c_str());
+			return false;
+		}
+
+		// Fresh pages are zeroed, so the atomics start at 0. Publish the magic last.
+		hdr = new (map) ring_hdr_t;
+		hdr->capacity = SHM_RING_CAPACITY;
+		hdr->owner_pid = ::getpid();
+		hdr->closed = 0;
+		hdr->head = 0;
+		hdr->tail = 0;
+		hdr->wake_seq = 0;
+		hdr->consumer_waiting = 0;
+
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+		int err = pthread_mutex_init(&hdr->producer_lock, &attr);
+		pthread_mutexattr_destroy(&attr);
+		if(err) {
+			::munmap(map, map_size);
+			::shm_unlink(name.c_str());
+			hdr = NULL;
+			return false;
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		hdr->magic = SHM_RING_MAGIC;
+
+		ring = reinterpret_cast<char*>(map) + hdr_size;
+		owner = true;
+		return true;
+	}
+
+	bool shm_ring::open(std::string endpoint)
+	{
+		close();
+		name = shm_name(endpoint);
+
+		int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+		if(fd < 0)
+			return false;
+
+		struct stat st;
+		std::size_t hdr_size = (sizeof(ring_hdr_t) + 63) & ~(std::size_t)63;
+		if(::fstat(fd, &st) < 0 || (std::size_t)st.st_size < hdr_size + SHM_RING_CAPACITY) {
+			::close(fd);
+			return false;
+		}
+
+		map_size = st.st_size;
+		void *map = ::mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(map == MAP_FAILED)
+			return false;
+
+		hdr = reinterpret_cast<ring_hdr_t*>(map);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		// A ring left behind by an owner that died without closing it is never read.
+		if(hdr->magic != SHM_RING_MAGIC || hdr->capacity != SHM_RING_CAPACITY || hdr->closed
+			|| !is_owner_alive()) {
+			::munmap(map, map_size);
+			hdr = NULL;
+			return false;
+		}
+
+		ring = reinterpret_cast<char*>(map) + hdr_size;
+		owner = false;
+		return true;
+	}
+
+	void shm_ring::close(void)
+	{
+		if(hdr == NULL)
+			return;
+
+		if(owner) {
+			hdr->closed = 1;
+			futex_wake(&hdr->wake_seq);
+			::shm_unlink(name.c_str());
+		}
+		::munmap(hdr, map_size);
+		hdr = NULL;
+		ring = NULL;
+		owner = false;
+	}
+
+	bool shm_ring::is_closed(void)
+	{
+		return hdr == NULL || hdr->closed.load(std::memory_order_relaxed);
+	}
+
+	bool shm_ring::is_owner_alive(void)
+	{
+		return hdr != NULL && !(::kill(hdr->owner_pid, 0) < 0 && errno == ESRCH);
+	}
+
+	bool shm_ring::push(const char *data, std::size_t size)
+	{
+		std::size_t rec = record_size(size);
+		if(hdr == NULL || rec > SHM_RING_CAPACITY / 2 || hdr->closed.load(std::memory_order_relaxed))
+			return false;
+
+		// Contended only if two senders share the endpoint. A producer that died holding the
+		// lock cannot have published a partial record, as head only moves once one is complete.
+		int err = pthread_mutex_lock(&hdr->producer_lock);
+		if(err == EOWNERDEAD)
+			pthread_mutex_consistent(&hdr->producer_lock);
+		else if(err)
+			return false;
+
+		uint64_t head = hdr->head.load(std::memory_order_relaxed);
+		uint64_t tail = hdr->tail.load(std::memory_order_acquire);
+		std::size_t pos = head & (SHM_RING_CAPACITY - 1);
+		std::size_t pad = (SHM_RING_CAPACITY - pos < rec) ? SHM_RING_CAPACITY - pos : 0;
+
+		if(head + pad + rec - tail > SHM_RING_CAPACITY) {
+			pthread_mutex_unlock(&hdr->producer_lock);
+			return false;
+		}
+
+		if(pad) {
+			uint32_t wrap = SHM_RING_WRAP;
+			memcpy(ring + pos, &wrap, sizeof(uint32_t));
+			head += pad;
+			pos = 0;
+		}
+
+		uint32_t len = size;
+		memcpy(ring + pos, &len, sizeof(uint32_t));
+		memcpy(ring + pos + sizeof(uint32_t), data, size);
+		ring[pos + sizeof(uint32_t) + size] = '\0';
+
+		hdr->head.store(head + rec, std::memory_order_seq_cst);
+		pthread_mutex_unlock(&hdr->producer_lock);
+
+		if(hdr->consumer_waiting.load(std::memory_order_seq_cst)) {
+			hdr->wake_seq.fetch_add(1, std::memory_order_seq_cst);
+			futex_wake(&hdr->wake_seq);
+		}
+		return true;
+	}
+
+	std::size_t shm_ring::consume(const boost::function<void(const char*, std::size_t)> &handler)
+	{
+		std::size_t count = 0;
+		uint64_t tail = hdr->tail.load(std::memory_order_relaxed);
+		uint64_t head = hdr->head.load(std::memory_order_acquire);
+
+		while(tail != head) {
+			std::size_t pos = tail & (SHM_RING_CAPACITY - 1);
+			uint32_t len;
+			memcpy(&len, ring + pos, sizeof(uint32_t));
+
+			if(len == SHM_RING_WRAP) {
+				tail += SHM_RING_CAPACITY - pos;
+				continue;
+			}
+
+			handler(ring + pos + sizeof(uint32_t), len);
+			tail += record_size(len);
+			hdr->tail.store(tail, std::memory_order_release);
+			count++;
+		}
+		hdr->tail.store(tail, std::memory_order_release);
+		return count;
+	}
+
+	void shm_ring::wait(unsigned int timeout_us)
+	{
+		uint32_t seq = hdr->wake_seq.load(std::memory_order_seq_cst);
+		hdr->consumer_waiting.store(1, std::memory_order_seq_cst);
+
+		// Re-check after announcing ourselves, so a push racing with us is never missed.
+		if(hdr->head.load(std::memory_order_seq_cst) == hdr->tail.load(std::memory_order_relaxed) && !hdr->closed) {
+			futex_wait(&hdr->wake_seq, seq, timeout_us);
+		}
+		hdr->consumer_waiting.store(0, std::memory_order_relaxed);
+	}
+
+	void shm_ring::wake(void)
+	{
+		if(hdr == NULL)
+			return;
+		hdr->wake_seq.fetch_add(1, std::memory_order_seq_cst);
+		futex_wake(&hdr->wake_seq);
+	}
+}
@@ -18,6 +18,13 @@
  */
 
 #include "uds.h"
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <sched.h>
 // #define DEBUG_UDS
 #define DEBUG
 
@@ -30,12 +37,14 @@ namespace prime
 	uds::uds(
 		prime::uds::socket_layer_t socket_layer,
 		prime::uds::socket_addrs_t *socket_addrs,
-		boost::function<void(std::vector<char>)> handler
+		boost::function<void(const prime::uds::message_t&)> handler
 		) :
 		handler(handler),
 		read_queue(),
 		read_queue_mutex(),
-		io_service(),
+		io_service(get_io_service()),
+		strand(io_service),
+		batch_timer(io_service),
 		udp_resolver(io_service),
 		udp_query("127.0.0.1", "5000", boost::asio::ip::udp::resolver::query::numeric_service),
 		//udp_remote_endpoint(boost::asio::ip::address_v4::loopback(), 5000),
@@ -129,6 +138,7 @@ namespace prime
 						uds_socket.open();
 						uds_socket.bind(local_endpoint);
 					}
+					batch_us = socket_addrs->logger_batch_us;
 					break;
 
 			case prime::uds::socket_layer_t::UI:
@@ -162,6 +172,20 @@ namespace prime
 
 		}
 
+		// Rings are only used between point-to-point peers on the same host; never for the
+		// RTM server socket that every application registers through, nor the logger/UI.
+		switch(socket_layer) {
+			case prime::uds::socket_layer_t::APP_RTM:
+			case prime::uds::socket_layer_t::RTM_DEV:
+			case prime::uds::socket_layer_t::DEV_RTM:
+					shm = socket_addrs->shm_api && local;
+					shm_busy_poll = socket_addrs->shm_busy_poll;
+					shm_send_timeout_us = socket_addrs->shm_send_timeout_us;
+					break;
+			default:
+					break;
+		}
+
 		// Check if we have a handler
 		if(handler == NULL) {
 			async_receive();
@@ -169,7 +193,7 @@ namespace prime
 			async_receive_int();
 		}
 
-		io_service_thread = boost::thread(boost::bind(&boost::asio::io_service::run, &io_service));
+		shm_init();
 	}
 
 
@@ -181,7 +205,9 @@ namespace prime
 			local(true),
 			read_queue(),
 			read_queue_mutex(),
-			io_service(),
+			io_service(get_io_service()),
+			strand(io_service),
+			batch_timer(io_service),
 			udp_resolver(io_service),
 			udp_query("127.0.0.1", "5000", boost::asio::ip::udp::resolver::query::numeric_service),
 			udp_remote_endpoint(boost::asio::ip::address_v4::loopback(), 5000),
@@ -195,18 +221,21 @@ namespace prime
 		uds_socket.open();
 		uds_socket.bind(local_endpoint);
 		async_receive();
-		io_service_thread = boost::thread(
-		boost::bind(&boost::asio::io_service::run, &io_service));
 	}
 
 	uds::uds(
 		std::string local_filename,
 		std::string remote_filename,
-		boost::function<void(std::vector<char>)> handler
+		boost::function<void(const prime::uds::message_t&)> handler,
+		bool shm,
+		bool shm_busy_poll,
+		unsigned int shm_send_timeout_us
 		) :
 			local(true),
 			handler(handler),
-			io_service(),
+			io_service(get_io_service()),
+			strand(io_service),
+			batch_timer(io_service),
 			udp_resolver(io_service),
 			udp_query("127.0.0.1", "5000", boost::asio::ip::udp::resolver::query::numeric_service),
 			udp_remote_endpoint(boost::asio::ip::address_v4::loopback(), 5000),
@@ -214,14 +243,16 @@ namespace prime
 			udp_socket(io_service),
 			local_endpoint(local_filename),
 			remote_endpoint(remote_filename),
-			uds_socket(io_service)
+			uds_socket(io_service),
+			shm(shm),
+			shm_busy_poll(shm_busy_poll),
+			shm_send_timeout_us(shm_send_timeout_us)
 	{
 		::unlink(local_filename.c_str());
 		uds_socket.open();
 		uds_socket.bind(local_endpoint);
 		async_receive_int();
-		io_service_thread = boost::thread(
-		boost::bind(&boost::asio::io_service::run, &io_service));
+		shm_init();
 	}
 
 	// Network Client: define only the destination address and port
@@ -232,7 +263,9 @@ namespace prime
 			local(false),
 			layer(0),
 			server(0),
-			io_service(),
+			io_service(get_io_service()),
+			strand(io_service),
+			batch_timer(io_service),
 			udp_resolver(io_service),
 			uds_socket(io_service),
 			udp_query(remote_address, std::to_string(remote_port), boost::asio::ip::udp::resolver::query::numeric_service),
@@ -244,20 +277,20 @@ namespace prime
 		// Accomodate IPv4 and IPv6.
 		udp_socket.open(udp_remote_endpoint.protocol());
 		async_receive();
-		io_service_thread = boost::thread(
-		boost::bind(&boost::asio::io_service::run, &io_service));
 	}
 
 	uds::uds(
 		std::string remote_address,
 		unsigned int remote_port,
-		boost::function<void(std::vector<char>)> handler
+		boost::function<void(const prime::uds::message_t&)> handler
 		) :
 			local(false),
 			layer(0),
 			server(0),
 			handler(handler),
-			io_service(),
+			io_service(get_io_service()),
+			strand(io_service),
+			batch_timer(io_service),
 			udp_resolver(io_service),
 			uds_socket(io_service),
 			udp_query(remote_address, std::to_string(remote_port), boost::asio::ip::udp::resolver::query::numeric_service),
@@ -268,8 +301,6 @@ namespace prime
 		// Accomodate IPv4 and IPv6.
 		udp_socket.open(udp_remote_endpoint.protocol());
 		async_receive_int();
-		io_service_thread = boost::thread(
-		boost::bind(&boost::asio::io_service::run, &io_service));
 	}
 
 
@@ -280,7 +311,9 @@ namespace prime
 			local(false),
 			layer(0),
 			server(1),
-			io_service(),
+			io_service(get_io_service()),
+			strand(io_service),
+			batch_timer(io_service),
 			udp_resolver(io_service),
 			uds_socket(io_service),
 			udp_query("::0", std::to_string(5000), boost::asio::ip::udp::resolver::query::numeric_service),
@@ -301,19 +334,19 @@ namespace prime
 		}
 		udp_socket.bind(udp_local_endpoint);
 		async_receive();
-		io_service_thread = boost::thread(
-		boost::bind(&boost::asio::io_service::run, &io_service));
 	}
 
 	uds::uds(
 		unsigned int local_port,
-		boost::function<void(std::vector<char>)> handler
+		boost::function<void(const prime::uds::message_t&)> handler
 		) :
 			local(false),
 			layer(0),
 			server(1),
 			handler(handler),
-			io_service(),
+			io_service(get_io_service()),
+			strand(io_service),
+			batch_timer(io_service),
 			udp_resolver(io_service),
 			uds_socket(io_service),
 			udp_query("::0", std::to_string(5000), boost::asio::ip::udp::resolver::query::numeric_service),
@@ -334,21 +367,175 @@ namespace prime
 		}
 		udp_socket.bind(udp_local_endpoint);
 		async_receive_int();
-		io_service_thread = boost::thread(
-		boost::bind(&boost::asio::io_service::run, &io_service));
 	}
 
 	uds::~uds()
 	{
-		if(local) {
-			uds_socket.shutdown(boost::asio::local::datagram_protocol::socket::shutdown_both);
-			uds_socket.close();
-		} else {
-			//udp_socket.shutdown(boost::asio::ip::udp::socket::shutdown_both);
-			udp_socket.close();
+		if(shm_rx) {
+			shm_running = false;
+			shm_rx->wake();
+			shm_rx_thread.join();
+		}
+
+		// The pool outlives this socket, so close it from its own strand and wait for every
+		// handler still referring to it to drain before the members go away.
+		closing = true;
+		op_begin();
+		strand.post(
+			[this]()
+			{
+				// Anything still waiting to be coalesced or flushed goes out before the socket closes.
+				std::vector<std::vector<char>> queue;
+				boost::system::error_code ec;
+				batch_timer.cancel(ec);
+				tx_m.lock();
+				if(tx_batch_count) {
+					queue_batch();
+				}
+				queue.swap(tx_queue);
+				tx_m.unlock();
+				for(auto& packet : queue) {
+					tx_backlog.push_back(std::move(packet));
+				}
+				// Closing aborts a pending write, so send what is left first.
+				drain_backlog(100);
+
+				if(local) {
+					uds_socket.shutdown(boost::asio::local::datagram_protocol::socket::shutdown_both, ec);
+					uds_socket.close(ec);
+				} else {
+					//udp_socket.shutdown(boost::asio::ip::udp::socket::shutdown_both);
+					udp_socket.close(ec);
+				}
+				op_end();
+			}
+		);
+
+		std::unique_lock<std::mutex> lock(pending_m);
+		pending_cv.wait(lock, [this]() { return pending_ops == 0; });
+	}
+
+	/* ------------------------------------- Shared I/O Pool ------------------------------------ */
+	namespace
+	{
+		struct io_pool_t
+		{
+			std::mutex m;
+			boost::asio::io_service io_service;
+			std::unique_ptr<boost::asio::io_service::work> work;
+			boost::thread_group threads;
+			unsigned int thread_count = 0;			// 0 = one per hardware thread, at least two
+			std::vector<unsigned int> cpus;
+			bool started = false;
+			unsigned int running = 0;				// Threads started
+			unsigned int in_handlers = 0;			// Threads inside a socket's receive handler
+
+			~io_pool_t()
+			{
+				work.reset();
+				io_service.stop();
+				threads.join_all();
+			}
+		};
+
+		io_pool_t& io_pool(void)
+		{
+			static io_pool_t pool;
+			return pool;
+		}
+
+		void io_pool_run(boost::asio::io_service *io_service, int cpu)
+		{
+			if(cpu >= 0) {
+				cpu_set_t cpu_set;
+				CPU_ZERO(&cpu_set);
+				CPU_SET(cpu, &cpu_set);
+				pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+			}
+			io_service->run();
+		}
+
+		// Called with pool.m held.
+		void io_pool_add_thread(io_pool_t &pool)
+		{
+			int cpu = pool.cpus.empty() ? -1 : (int)pool.cpus[pool.running % pool.cpus.size()];
+			pool.threads.create_thread(boost::bind(&io_pool_run, &pool.io_service, cpu));
+			pool.running++;
+		}
+
+		// Handlers may block on replies that arrive on another socket (e.g. an RTM reading a
+		// device monitor from an app handler). A strand keeps each socket's handlers on one
+		// thread at a time, so starting a thread whenever every one is inside a handler means
+		// there is always one left to deliver the reply: a socket whose handlers block ends up
+		// with a thread of its own, as if each socket had one, and the others share the rest.
+		void io_pool_handler_begin(void)
+		{
+			io_pool_t &pool = io_pool();
+			pool.m.lock();
+			if(++pool.in_handlers >= pool.running) {
+				io_pool_add_thread(pool);
+			}
+			pool.m.unlock();
+		}
+
+		void io_pool_handler_end(void)
+		{
+			io_pool_t &pool = io_pool();
+			pool.m.lock();
+			pool.in_handlers--;
+			pool.m.unlock();
 		}
-		io_service.stop();
-		io_service_thread.join();
+	}
+
+	bool uds::set_io_threads(unsigned int threads, std::vector<unsigned int> cpus)
+	{
+		bool ret = false;
+		io_pool_t &pool = io_pool();
+		pool.m.lock();
+		if(!pool.started) {
+			pool.thread_count = threads;
+			pool.cpus = cpus;
+			ret = true;
+		}
+		pool.m.unlock();
+		return ret;
+	}
+
+	boost::asio::io_service& uds::get_io_service(void)
+	{
+		io_pool_t &pool = io_pool();
+		pool.m.lock();
+		if(!pool.started) {
+			// The pool grows beyond this if handlers block; see io_pool_handler_begin.
+			unsigned int count = pool.thread_count;
+			if(count == 0) {
+				count = std::max(2u, boost::thread::hardware_concurrency());
+			}
+
+			pool.work.reset(new boost::asio::io_service::work(pool.io_service));
+			for(unsigned int i = 0; i < count; i++) {
+				io_pool_add_thread(pool);
+			}
+			pool.started = true;
+		}
+		pool.m.unlock();
+		return pool.io_service;
+	}
+
+	void uds::op_begin(void)
+	{
+		pending_m.lock();
+		pending_ops++;
+		pending_m.unlock();
+	}
+
+	void uds::op_end(void)
+	{
+		pending_m.lock();
+		if(--pending_ops == 0) {
+			pending_cv.notify_all();
+		}
+		pending_m.unlock();
 	}
 
 	std::string uds::get_endpoints(void)
@@ -368,15 +555,66 @@ namespace prime
 	void uds::set_remote_endpoint(std::string remote_filename)
 	{
 		remote_endpoint.path(remote_filename);
+
+		if(shm) {
+			shm_tx_m.lock();
+			shm_tx_failed = false;
+			shm_tx_retry = std::chrono::steady_clock::time_point();
+			shm_open_tx();
+			shm_tx_m.unlock();
+		}
 	}
 
 	void uds::send_message(std::vector<char> &message)
+	{
+		send_message(message.data(), message.size());
+	}
+
+	void uds::send_message(const char *data, std::size_t size)
 	{
 #ifdef DEBUG_UDS
 		unsigned int time = prime::util::get_timestamp();
 #endif
 
-		async_write(message);
+		if(shm_send(data, size))
+			return;
+
+		tx_m.lock();
+		if(batch_us) {
+			// Close off the current batch if this message would overflow it.
+			if(tx_batch_count && tx_batch.size() + sizeof(uint32_t) + size > UDS_MAX_BATCH) {
+				queue_batch();
+			}
+			if(!tx_batch_count) {
+				tx_batch.push_back((char)UDS_BATCH_MAGIC);
+			}
+			uint32_t len = size;
+			tx_batch.insert(tx_batch.end(), (const char*)&len, (const char*)&len + sizeof(uint32_t));
+			tx_batch.insert(tx_batch.end(), data, data + size);
+			tx_batch_count++;
+
+			if(!batch_timer_armed) {
+				batch_timer_armed = true;
+				op_begin();
+				strand.post(
+					[this]()
+					{
+						batch_timer.expires_from_now(boost::posix_time::microseconds(batch_us));
+						batch_timer.async_wait(strand.wrap(boost::bind(&uds::handle_batch_timer, this, boost::asio::placeholders::error)));
+					}
+				);
+			}
+		} else {
+			tx_queue.emplace_back(data, data + size);
+		}
+
+		// One flush per burst: everything queued before it runs goes out in one system call.
+		if(!tx_queue.empty() && !tx_flush_pending) {
+			tx_flush_pending = true;
+			op_begin();
+			strand.post(boost::bind(&uds::handle_flush, this));
+		}
+		tx_m.unlock();
 
 #ifdef DEBUG_UDS
 		if(sender_endpoint == "/tmp/dev.rtm.uds"){
@@ -388,86 +626,124 @@ namespace prime
 
 	void uds::send_message_blocking(std::vector<char> &message)
 	{
+		if(shm_send(message.data(), message.size()))
+			return;
 		sync_write(message);
 	}
 
 	bool uds::get_message(std::vector<char> &message)
 	{
-		bool result;
+		std::pair<char*, std::size_t> received;
 		read_queue_mutex.lock();
-		if(!read_queue.empty()) {
-			message = read_queue.front();
-			read_queue.pop();
-			result = true;
-		} else {
-			result = false;
+		if(read_queue.empty()) {
+			read_queue_mutex.unlock();
+			return false;
 		}
+		received = read_queue.front();
+		read_queue.pop();
 		read_queue_mutex.unlock();
 
-		return result;
+		// Reuses the capacity of the caller's vector, so a recycled vector costs no allocation.
+		message.assign(received.first, received.first + received.second);
+		release_slab(received.first);
+
+		return true;
+	}
+
+	char* uds::acquire_slab(void)
+	{
+		char *slab;
+		rx_slabs_m.lock();
+		if(rx_free_slabs.empty()) {
+			// Allocate the initial pool, or grow by one if every slab is held by a consumer.
+			unsigned int count = rx_slabs.empty() ? UDS_RX_SLABS : 1;
+			for(unsigned int i = 0; i < count; i++) {
+				rx_slabs.push_back(std::unique_ptr<char[]>(new char[UDS_MAX_DATAGRAM + 1]));
+				rx_free_slabs.push_back(rx_slabs.back().get());
+			}
+		}
+		slab = rx_free_slabs.back();
+		rx_free_slabs.pop_back();
+		rx_slabs_m.unlock();
+		return slab;
+	}
+
+	void uds::release_slab(char *slab)
+	{
+		rx_slabs_m.lock();
+		rx_free_slabs.push_back(slab);
+		rx_slabs_m.unlock();
 	}
 
 	void uds::async_receive()
 	{
-		// Set buffer to match IP stack
-		receive_buffer = std::vector<char>(65535);
+		char *slab = acquire_slab();
+		op_begin();
 		if(local) {
 			uds_socket.async_receive_from(
-				boost::asio::buffer(receive_buffer),
+				boost::asio::buffer(slab, UDS_MAX_DATAGRAM),
 				sender_endpoint,
-				boost::bind(
+				strand.wrap(boost::bind(
 					&uds::handle_receive,
 					this,
+					slab,
 					boost::asio::placeholders::error,
 					boost::asio::placeholders::bytes_transferred
-				)
+				))
 			);
 		} else {
 			if(server) {
 				udp_socket.async_receive_from(
-					boost::asio::buffer(receive_buffer),
+					boost::asio::buffer(slab, UDS_MAX_DATAGRAM),
 					udp_remote_endpoint,
-					boost::bind(
+					strand.wrap(boost::bind(
 						&uds::handle_receive,
 						this,
+						slab,
 						boost::asio::placeholders::error,
 						boost::asio::placeholders::bytes_transferred
-					)
+					))
 				);
 
 			} else {
-				boost::asio::ip::udp::endpoint udp_endpoint;
 				udp_socket.async_receive_from(
-					boost::asio::buffer(receive_buffer),
-					udp_endpoint,
-					boost::bind(
+					boost::asio::buffer(slab, UDS_MAX_DATAGRAM),
+					udp_sender_endpoint,
+					strand.wrap(boost::bind(
 						&uds::handle_receive,
 						this,
+						slab,
 						boost::asio::placeholders::error,
 						boost::asio::placeholders::bytes_transferred
-					)
+					))
 				);
 			}
 		}
 	}
 
 	void uds::handle_receive(
+		char *slab,
 		const boost::system::error_code& error,
 		std::size_t bytes_transferred)
 	{
-		(void)bytes_transferred;
-
-		std::vector<char> copied_buffer = receive_buffer;
-		async_receive();
+		if(!closing) {
+			async_receive();
+		}
 
-		if(error) {
+		// Empty datagrams also arrive while the socket is shut down; there is nothing to deliver.
+		if(error || bytes_transferred == 0) {
 //			std::cerr << "Error receiving packet: " << error << std::endl;
+			release_slab(slab);
+			op_end();
 			return;
 		}
 
+		// The slab stays with the queue until get_message hands it back.
+		slab[bytes_transferred] = '\0';
 		read_queue_mutex.lock();
-		read_queue.push(copied_buffer);
+		read_queue.push(std::make_pair(slab, bytes_transferred));
 		read_queue_mutex.unlock();
+		op_end();
 	}
 
 	void uds::async_receive_int()
@@ -475,19 +751,20 @@ namespace prime
 #ifdef DEBUG_UDS
 		unsigned int time = prime::util::get_timestamp();
 #endif
-		receive_buffer = std::vector<char>(65535); //Expanded to 10k to cope with Odroid architecture to deal with #31.
-		//Further expanded to 65535 when IP added.
+		char *slab = acquire_slab();
+		op_begin();
 
 		if(local) {
 			uds_socket.async_receive_from(
-				boost::asio::buffer(receive_buffer),
+				boost::asio::buffer(slab, UDS_MAX_DATAGRAM),
 				sender_endpoint,
-				boost::bind(
+				strand.wrap(boost::bind(
 					&uds::handle_receive_int,
 					this,
+					slab,
 					boost::asio::placeholders::error,
 					boost::asio::placeholders::bytes_transferred
-				)
+				))
 			);
 #ifdef DEBUG_UDS
 			if(sender_endpoint == "/tmp/rtm.dev.uds"){
@@ -498,51 +775,170 @@ namespace prime
 		} else {
 			if(server) {
 				udp_socket.async_receive_from(
-					boost::asio::buffer(receive_buffer),
+					boost::asio::buffer(slab, UDS_MAX_DATAGRAM),
 					udp_remote_endpoint,
-					boost::bind(
+					strand.wrap(boost::bind(
 						&uds::handle_receive_int,
 						this,
+						slab,
 						boost::asio::placeholders::error,
 						boost::asio::placeholders::bytes_transferred
-					)
+					))
 				);
 
 			} else {
-				boost::asio::ip::udp::endpoint udp_endpoint;
 				udp_socket.async_receive_from(
-					boost::asio::buffer(receive_buffer),
-					udp_endpoint,
-					boost::bind(
+					boost::asio::buffer(slab, UDS_MAX_DATAGRAM),
+					udp_sender_endpoint,
+					strand.wrap(boost::bind(
 						&uds::handle_receive_int,
 						this,
+						slab,
 						boost::asio::placeholders::error,
 						boost::asio::placeholders::bytes_transferred
-					)
+					))
 				);
-#ifdef DEBUG
-				if(udp_endpoint != udp_remote_endpoint) {
-					std::cout << "\nUDS Client: remote endpoints do not match." << std::endl;
-				}
-#endif
 			}
 		}
 	}
 
 	void uds::handle_receive_int(
+		char *slab,
 		const boost::system::error_code& error,
 		std::size_t bytes_transferred)
 	{
-		(void)bytes_transferred;
-		std::vector<char> copied_buffer = receive_buffer;
-		async_receive_int();
+		if(!closing) {
+			async_receive_int();
+		}
 
-		if(error) {
+		// Empty datagrams also arrive while the socket is shut down; there is nothing to deliver.
+		if(error || bytes_transferred == 0) {
 //			std::cerr << "Error receiving packet: " << error << std::endl;
+			release_slab(slab);
+			op_end();
+			return;
+		}
+
+#ifdef DEBUG
+		if(!local && !server && udp_sender_endpoint != udp_remote_endpoint) {
+			std::cout << "\nUDS Client: remote endpoints do not match." << std::endl;
+		}
+#endif
+
+		// Hand the handler a view of exactly what arrived, then recycle the slab.
+		slab[bytes_transferred] = '\0';
+		io_pool_handler_begin();
+		handler_m.lock();
+		handler(prime::uds::message_t(slab, bytes_transferred));
+		handler_m.unlock();
+		io_pool_handler_end();
+		release_slab(slab);
+		op_end();
+	}
+
+	/* ----------------------------------- Shared-Memory Lane ---------------------------------- */
+	void uds::shm_init(void)
+	{
+		if(!shm)
 			return;
+
+		// Peers without a ring, or that we cannot attach to, are still reached over the socket.
+		shm_rx.reset(new prime::shm_ring());
+		if(shm_rx->create(local_endpoint.path())) {
+			shm_running = true;
+			shm_rx_thread = boost::thread(boost::bind(&uds::shm_rx_loop, this));
+		} else {
+			shm_rx.reset();
 		}
 
-		handler(copied_buffer);
+		shm_tx.reset(new prime::shm_ring());
+		shm_tx_m.lock();
+		shm_open_tx();
+		shm_tx_m.unlock();
+	}
+
+	// Called with shm_tx_m held.
+	void uds::shm_open_tx(void)
+	{
+		// The peer may not have started yet, so retry at most every 100 ms rather than on every send.
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if(now < shm_tx_retry)
+			return;
+		shm_tx_retry = now + std::chrono::milliseconds(100);
+		shm_tx->open(remote_endpoint.path());
+	}
+
+	bool uds::shm_send(const char *data, std::size_t size)
+	{
+		bool sent = false;
+		if(!shm || size > UDS_MAX_DATAGRAM)
+			return false;
+
+		shm_tx_m.lock();
+		if(shm_tx_failed) {
+			shm_tx_m.unlock();
+			return false;
+		}
+		if(!shm_tx->is_open() || shm_tx->is_closed()) {
+			shm_open_tx();
+		}
+		if(shm_tx->is_open()) {
+			// A full ring means the peer is behind. Wait for it: a message sent over the socket
+			// now would overtake those still in the ring. A peer that has closed its ring, or
+			// died, never drains it, and nothing queued there will be read anyway.
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::chrono::steady_clock::time_point spin_until = start + std::chrono::milliseconds(1);
+			std::chrono::steady_clock::time_point give_up = start + std::chrono::microseconds(shm_send_timeout_us);
+			while(!(sent = shm_tx->push(data, size)) && !shm_tx->is_closed()) {
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				if(!shm_tx->is_owner_alive()) {
+					shm_tx->close();
+					break;
+				} else if(now >= give_up) {
+					// Nor does a live peer whose receive thread is blocked, perhaps sending to us
+					// while our own handler sends to it. Waiting longer would hang both sides and
+					// every sender on this socket, so give up on the ring for good.
+					std::cout << "UDS: Shared-memory ring to " << remote_endpoint.path() << " not drained in "
+						<< shm_send_timeout_us << " us, using the socket" << std::endl;
+					shm_tx->close();
+					shm_tx_failed = true;
+					break;
+				} else if(now < spin_until) {
+					boost::this_thread::yield();
+				} else {
+					boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+				}
+			}
+		}
+		shm_tx_m.unlock();
+		return sent;
+	}
+
+	void uds::shm_rx_loop(void)
+	{
+		boost::function<void(const char*, std::size_t)> deliver = boost::bind(&uds::shm_deliver, this, _1, _2);
+		while(shm_running) {
+			if(!shm_rx->consume(deliver) && !shm_busy_poll) {
+				shm_rx->wait(100000);
+			}
+		}
+	}
+
+	void uds::shm_deliver(const char *data, std::size_t size)
+	{
+		if(handler == NULL) {
+			// Queued messages outlive the ring record, so take a copy in a receive slab.
+			char *slab = acquire_slab();
+			memcpy(slab, data, size);
+			slab[size] = '\0';
+			read_queue_mutex.lock();
+			read_queue.push(std::make_pair(slab, size));
+			read_queue_mutex.unlock();
+		} else {
+			handler_m.lock();
+			handler(prime::uds::message_t(data, size));
+			handler_m.unlock();
+		}
 	}
 
 
@@ -561,51 +957,144 @@ namespace prime
 		}
 	}
 
-	void uds::async_write(std::vector<char> packet)
+	// Called with tx_m held. Moves the current batch onto the send queue.
+	void uds::queue_batch(void)
 	{
+		if(tx_batch_count == 1) {
+			// Nothing to coalesce with, so send the message as it was given.
+			tx_queue.emplace_back(tx_batch.begin() + 1 + sizeof(uint32_t), tx_batch.end());
+		} else {
+			tx_queue.push_back(std::move(tx_batch));
+		}
+		tx_batch.clear();
+		tx_batch_count = 0;
+	}
+
+	void uds::handle_batch_timer(const boost::system::error_code& error)
+	{
+		(void)error;
+		std::vector<std::vector<char>> queue;
+		tx_m.lock();
+		batch_timer_armed = false;
+		if(tx_batch_count) {
+			queue_batch();
+		}
+		queue.swap(tx_queue);
+		tx_m.unlock();
+
+		write_queue(queue);
+		op_end();
+	}
+
+	void uds::handle_flush(void)
+	{
+		std::vector<std::vector<char>> queue;
+		tx_m.lock();
+		queue.swap(tx_queue);
+		tx_flush_pending = false;
+		tx_m.unlock();
+
+		write_queue(queue);
+		op_end();
+	}
+
+	// Runs on the strand. Hands the whole queue to the kernel with sendmmsg, behind anything
+	// it could not take earlier, so datagrams always leave in the order they were queued.
+	void uds::write_queue(std::vector<std::vector<char>> &queue)
+	{
+		for(auto& packet : queue) {
+			tx_backlog.push_back(std::move(packet));
+		}
+		queue.clear();
+
+		// Already waiting for room; handle_writable sends the lot.
+		if(tx_backlog_waiting || tx_backlog.empty())
+			return;
+
+		if(send_backlog() == 0)
+			return;
+
+		// Wait on the reactor for room rather than block the pool.
+		tx_backlog_waiting = true;
+		op_begin();
 		if(local) {
-			io_service.post(
-				[this, packet]()
-				{
-					uds_socket.async_send_to(
-						boost::asio::buffer(packet),
-						remote_endpoint,
-						boost::bind(
-							&uds::handle_write,
-							this,
-							boost::asio::placeholders::error,
-							boost::asio::placeholders::bytes_transferred
-						)
-					);
-				}
-			);
+			uds_socket.async_send_to(boost::asio::null_buffers(), remote_endpoint,
+				strand.wrap(boost::bind(&uds::handle_writable, this, boost::asio::placeholders::error)));
 		} else {
-			io_service.post(
-				[this, packet]()
-				{
-					udp_socket.async_send_to(
-						boost::asio::buffer(packet),
-						udp_remote_endpoint,
-						boost::bind(
-							&uds::handle_write,
-							this,
-							boost::asio::placeholders::error,
-							boost::asio::placeholders::bytes_transferred
-						)
-					);
-				}
-			);
+			udp_socket.async_send_to(boost::asio::null_buffers(), udp_remote_endpoint,
+				strand.wrap(boost::bind(&uds::handle_writable, this, boost::asio::placeholders::error)));
 		}
 	}
 
-	void uds::handle_write(
-		const boost::system::error_code& error,
-		std::size_t bytes_transferred
-		)
+	// Runs on the strand. Sends what it can of the backlog without blocking and returns how many are left.
+	std::size_t uds::send_backlog(void)
 	{
-		(void)bytes_transferred;
-		if(error) {
-//			std::cerr << "Error writing packet: " << error << std::endl;
+		int fd;
+		struct sockaddr *name;
+		socklen_t name_len;
+		if(local) {
+			fd = uds_socket.native_handle();
+			name = remote_endpoint.data();
+			name_len = remote_endpoint.size();
+		} else {
+			fd = udp_socket.native_handle();
+			name = udp_remote_endpoint.data();
+			name_len = udp_remote_endpoint.size();
+		}
+
+		std::vector<struct iovec> iovs(tx_backlog.size());
+		std::vector<struct mmsghdr> msgs(tx_backlog.size());
+		for(std::size_t i = 0; i < tx_backlog.size(); i++) {
+			iovs[i].iov_base = tx_backlog[i].data();
+			iovs[i].iov_len = tx_backlog[i].size();
+			memset(&msgs[i], 0, sizeof(struct mmsghdr));
+			msgs[i].msg_hdr.msg_name = name;
+			msgs[i].msg_hdr.msg_namelen = name_len;
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		std::size_t sent = 0;
+		while(sent < tx_backlog.size()) {
+			int ret = ::sendmmsg(fd, &msgs[sent], tx_backlog.size() - sent, MSG_DONTWAIT);
+			if(ret > 0) {
+				sent += ret;
+			} else if(ret < 0 && errno == EINTR) {
+				continue;
+			} else if(ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+				break;
+			} else {
+				// The first remaining datagram cannot be delivered (e.g. no peer bound); drop it as a failed write would.
+				sent++;
+			}
+		}
+
+		tx_backlog.erase(tx_backlog.begin(), tx_backlog.begin() + sent);
+		return tx_backlog.size();
+	}
+
+	void uds::handle_writable(const boost::system::error_code& error)
+	{
+		tx_backlog_waiting = false;
+		// Cancelled by close(), which drains the backlog itself.
+		if(!error) {
+			std::vector<std::vector<char>> none;
+			write_queue(none);
+		}
+		op_end();
+	}
+
+	// Runs on the strand while closing. Waits up to timeout_ms for room for each datagram left.
+	void uds::drain_backlog(unsigned int timeout_ms)
+	{
+		struct pollfd pfd;
+		pfd.fd = local ? uds_socket.native_handle() : udp_socket.native_handle();
+		pfd.events = POLLOUT;
+		while(send_backlog() > 0) {
+			if(::poll(&pfd, 1, timeout_ms) <= 0) {
+				tx_backlog.clear();
+				break;
+			}
 		}
 	}
 }
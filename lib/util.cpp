@@ -27,13 +27,12 @@
 
 namespace prime { namespace util
 {
-	void send_message(prime::uds& sock, std::string message)
+	void send_message(prime::uds& sock, const std::string &message)
 	{
 #ifdef DEBUG_API
 		std::cout << message << std::endl;
 #endif
-		std::vector<char> raw(message.begin(), message.end());
-		sock.send_message(raw);
+		sock.send_message(message.data(), message.size());
 	}
 
 	unsigned long long get_timestamp()
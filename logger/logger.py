@@ -36,6 +36,7 @@ import signal
 import threading
 import argparse
 import numpy
+import struct
 
 try:
     import queue
@@ -64,9 +65,9 @@ app_knob_types = ["PRIME_PAR", "PRIME_PREC", "PRIME_DEV_SEL", "PRIME_ITR", "PRIM
 app_mon_types = ["PRIME_PERF", "PRIME_ACC", "PRIME_ERR", "PRIME_POW"]
 
 # Available types of device-level knob
-dev_knob_types = ["PRIME_VOLT", "PRIME_FREQ", "PRIME_EN", "PRIME_PMC_CNT", "PRIME_GOVERNOR", "PRIME_FREQ_EN"]
+dev_knob_types = ["PRIME_VOLT", "PRIME_FREQ", "PRIME_EN", "PRIME_PMC_CNT", "PRIME_GOVERNOR", "PRIME_FREQ_EN", "PRIME_WINDOW", "PRIME_PERCENTILE", "PRIME_MARKER"]
 #Available types of device-level monitor
-dev_mon_types = ["PRIME_POW", "PRIME_TEMP", "PRIME_CYCLES", "PRIME_PMC"]
+dev_mon_types = ["PRIME_POW", "PRIME_TEMP", "PRIME_CYCLES", "PRIME_PMC", "PRIME_ENERGY", "PRIME_ENERGY_SINCE", "PRIME_POW_MEAN", "PRIME_POW_MIN", "PRIME_POW_MAX", "PRIME_POW_PCTL"]
 
 apps = {}
 devs = {}
@@ -92,12 +93,60 @@ fast_msg_dict= {
 				"d": "PRIME_API_APP_MON_CONT_WEIGHT",
 				"e": "PRIME_API_APP_MON_DISC_SET",
 				"f": "PRIME_API_APP_MON_CONT_SET",
+				"A": "PRIME_API_APP_KNOB_DISC_PUSH",
+				"B": "PRIME_API_APP_KNOB_CONT_PUSH",
 				"g": "PRIME_API_DEV_KNOB_DISC_SET",
 				"h": "PRIME_API_DEV_KNOB_CONT_SET",
 				"i": "PRIME_API_DEV_MON_DISC_GET",
 				"j": "PRIME_API_DEV_MON_CONT_GET",
 				"k": "PRIME_API_DEV_RETURN_MON_DISC_GET",
-				"l": "PRIME_API_DEV_RETURN_MON_CONT_GET"
+				"l": "PRIME_API_DEV_RETURN_MON_CONT_GET",
+				"m": "PRIME_API_DEV_MON_SNAPSHOT_GET",
+				"n": "PRIME_API_DEV_RETURN_MON_SNAPSHOT",
+				"o": "PRIME_API_DEV_MON_PUBLISH",
+				"p": "PRIME_API_DEV_KNOB_DISC_APPLIED",
+				"q": "PRIME_API_DEV_KNOB_CONT_APPLIED"
+				}
+
+#Binary lane decoding: packed header, then a fixed payload per type (see prime_api_bin.h)
+API_BIN_MAGIC = 0xB1
+API_BIN_HDR = struct.Struct("<BBcBQ")
+API_BATCH_MAGIC = 0xB2
+API_BATCH_LEN = struct.Struct("<I")
+#Snapshot return or publish: seq, disc count, cont count, then that many "k" and "l" payloads
+#From version 7 each payload is followed by the time of its reading
+API_SNAPSHOT_HDR = struct.Struct("<IHH")
+API_SNAPSHOT_TS = struct.Struct("<Q")
+API_SNAPSHOT_TS_VERSION = 7
+API_SNAPSHOT_TYPES = ["n", "o"]
+
+bin_payload_dict = {
+				"0": ("app", struct.Struct("<Iii")),
+				"1": ("app", struct.Struct("<Iif")),
+				"2": ("app", struct.Struct("<Iii")),
+				"3": ("app", struct.Struct("<Iii")),
+				"4": ("app", struct.Struct("<Iif")),
+				"5": ("app", struct.Struct("<Iif")),
+				"6": ("app_get", struct.Struct("<Ii")),
+				"7": ("app_get", struct.Struct("<Ii")),
+				"8": ("app", struct.Struct("<Iii")),
+				"9": ("app", struct.Struct("<Iii")),
+				"a": ("app", struct.Struct("<Iif")),
+				"b": ("app", struct.Struct("<Iif")),
+				"c": ("app", struct.Struct("<Iif")),
+				"d": ("app", struct.Struct("<Iif")),
+				"e": ("app", struct.Struct("<Iii")),
+				"f": ("app", struct.Struct("<Iif")),
+				"A": ("app", struct.Struct("<Iii")),
+				"B": ("app", struct.Struct("<Iif")),
+				"g": ("dev", struct.Struct("<Ii")),
+				"h": ("dev", struct.Struct("<If")),
+				"i": ("dev", struct.Struct("<I")),
+				"j": ("dev", struct.Struct("<I")),
+				"k": ("dev", struct.Struct("<Iiii")),
+				"l": ("dev", struct.Struct("<Ifff")),
+				"p": ("applied", struct.Struct("<IiII")),
+				"q": ("applied", struct.Struct("<IfII"))
 				}
 
 visualiser_en = False
@@ -466,6 +515,23 @@ def parse_message(msg, msg_src):
 		#no fields sent
 		pass
 	
+	elif msg_type == "PRIME_API_DEV_MON_SUBSCRIBE":
+		try:
+			print_str += str("sub_id:" + str(msg["data"]["sub_id"]) + ",")
+			print_str += str("period_us:" + str(msg["data"]["period_us"]) + ",")
+			print_str += str("threshold:" + str(msg["data"]["threshold"]) + ",")
+			#empty id lists are written as ""
+			for mon_id in list(msg["data"]["disc_ids"]) + list(msg["data"]["cont_ids"]):
+				print_str += str("id:" + str(mon_id) + ",")
+		except KeyError:
+			return "\"Required Field Not Present\","
+	
+	elif msg_type == "PRIME_API_DEV_MON_UNSUBSCRIBE":
+		try:
+			print_str += str("sub_id:" + str(msg["data"]["sub_id"]) + ",")
+		except KeyError:
+			return "\"Required Field Not Present\","
+	
 	
 	# old def parse_message_rtm_app(msg):
 	elif msg_type == "PRIME_API_APP_RETURN_APP_REG":
@@ -798,6 +864,14 @@ def parse_message(msg, msg_src):
 			print_str += str("id:" + str(knob_id) + ",")
 			print_str += str("type:" + str(knob_type) + ",")
 	
+	elif msg_type in ["PRIME_API_APP_KNOB_DISC_PUSH", \
+						"PRIME_API_APP_KNOB_CONT_PUSH"]:
+		try:
+			print_str += str("proc_id:" + str(msg["data"]["proc_id"]) + ",")
+			print_str += str("id:" + str(msg["data"]["id"]) + ",")
+		except KeyError:
+			return "\"Required Field Not Present\","
+	
 	elif msg_type == "PRIME_API_APP_MON_DISC_REG":
 		try:
 			mon = msg["data"]
@@ -1251,6 +1325,65 @@ def parse_message_fast(msg, msg_src):
 					raise ValueError('Message not in json or fast format')
 				
 
+############################################################################
+# Parse Binary Messages
+############################################################################
+def parse_message_bin(data, msg_src):
+	#decode the header and payload, then reuse the fast lane field layout
+	#returns a list of lines, as a snapshot holds one reading per monitor
+	try:
+		magic, version, msg_type, reserved, msg_ts = API_BIN_HDR.unpack_from(data)
+		msg_type = msg_type.decode("ascii")
+		if msg_type in API_SNAPSHOT_TYPES:
+			return parse_snapshot_bin(data, version, msg_ts, msg_src)
+		layout, payload = bin_payload_dict[msg_type]
+		fields = payload.unpack_from(data, API_BIN_HDR.size)
+	except (struct.error, KeyError, UnicodeDecodeError):
+		raise ValueError('Message not in binary format')
+
+	if layout == "app":
+		# ID, PID, Val on the wire; ID, Val, PID in the fast lane
+		fields = [fields[0], fields[2], fields[1]]
+	elif layout == "applied":
+		# No fast lane equivalent
+		return [parse_applied_bin(msg_type, fields, msg_ts, msg_src)]
+	split_msg = [msg_type] + [str(field) for field in fields] + [str(msg_ts)]
+
+	return [parse_message_fast(API_DELIMINATOR.join(split_msg), msg_src)]
+
+def parse_applied_bin(msg_type, fields, msg_ts, msg_src):
+	msg_id, msg_val, latency_us, collapsed = fields
+	print_str = str("api:" + fast_msg_dict[msg_type] + ",")
+	print_str += str("ts:" + str(msg_ts) + ",")
+	print_str += str("id:" + str(msg_id) + ",")
+	print_str += str("val:" + str(msg_val) + ",")
+	print_str += str("latency_us:" + str(latency_us) + ",")
+	print_str += str("collapsed:" + str(collapsed) + ",")
+	try:
+		km_type = devs[msg_src].knobs[msg_id].type
+	except KeyError:
+		km_type = "ERROR: Unknown Type"
+	print_str += str("type:" + km_type + ",")
+	return print_str
+
+def parse_snapshot_bin(data, version, msg_ts, msg_src):
+	#log each reading as a monitor get return, with its own timestamp if it has one
+	seq, disc_count, cont_count = API_SNAPSHOT_HDR.unpack_from(data, API_BIN_HDR.size)
+	offset = API_BIN_HDR.size + API_SNAPSHOT_HDR.size
+	lines = []
+	for msg_type, count in (("k", disc_count), ("l", cont_count)):
+		payload = bin_payload_dict[msg_type][1]
+		for rec in range(count):
+			fields = payload.unpack_from(data, offset)
+			offset += payload.size
+			rec_ts = msg_ts
+			if version >= API_SNAPSHOT_TS_VERSION:
+				rec_ts, = API_SNAPSHOT_TS.unpack_from(data, offset)
+				offset += API_SNAPSHOT_TS.size
+			split_msg = [msg_type] + [str(field) for field in fields] + [str(rec_ts)]
+			lines.append(parse_message_fast(API_DELIMINATOR.join(split_msg), msg_src))
+	return lines
+
 ############################################################################
 # Main Utility functions
 ############################################################################
@@ -1272,7 +1405,6 @@ def message_process(rec_q):
 	while True:
 		data, msg_src, remote = rec_q.get()
 		
-		data_string = data.decode("utf-8")
 		print_str = str()
 		
 		if remote:
@@ -1280,6 +1412,18 @@ def message_process(rec_q):
 		else:
 			print_str += str("source:UDS,")
 		
+		if len(data) and data[0] == API_BIN_MAGIC:
+			try:
+				lines = parse_message_bin(data, msg_src)
+			except ValueError:
+				print("Error: malformed binary message")
+				continue
+			for line in lines:
+				print(print_str + line)
+			continue
+		
+		data_string = data.decode("utf-8")
+		
 		try:
 			json_msg = json.loads(data_string)
 		except ValueError: #not json
@@ -1315,7 +1459,16 @@ def message_process(rec_q):
 def socket_process(rec_q, sock, remote):
 	while True:
 		data, address = sock.recvfrom(65535)
-		rec_q.put((data, str(address[0]), remote))
+		if len(data) and data[0] == API_BATCH_MAGIC:
+			#coalesced datagram: [length][message] records
+			offset = 1
+			while offset + API_BATCH_LEN.size <= len(data):
+				msg_len, = API_BATCH_LEN.unpack_from(data, offset)
+				offset += API_BATCH_LEN.size
+				rec_q.put((data[offset:offset + msg_len], str(address[0]), remote))
+				offset += msg_len
+		else:
+			rec_q.put((data, str(address[0]), remote))
 
 		
 ############################################################################
@@ -18,16 +18,158 @@
  */
  
 #include <iostream>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "codegen.hpp"
 
 //#define DEBUG
 
+#define QTABLE_MAGIC		0x50525154		// "PRQT"
+#define QTABLE_VERSION		1
+
 namespace prime  { namespace codegen
 	{
 		
 		qlearn_sc::qlearn_sc() {}
 		
-		qlearn_sc::qlearn_sc(unsigned int frame_time, int row, unsigned int length) 
+		qtable_store::qtable_store() :
+			hdr(NULL),
+			table(NULL),
+			map_size(0)
+		{ }
+		
+		qtable_store::~qtable_store()
+		{
+			close();
+		}
+		
+		std::string qtable_store::default_dir(void)
+		{
+			return "/tmp/prime-qtables-" + std::to_string(::geteuid());
+		}
+		
+		bool qtable_store::private_dir(std::string dir)
+		{
+			if(::mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST)
+				return false;
+			struct stat st;
+			return ::lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode)
+				&& st.st_uid == ::geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+		}
+		
+		bool qtable_store::load(std::string path)
+		{
+			close();
+			int fd = ::open(path.c_str(), O_RDWR | O_NOFOLLOW);
+			if(fd < 0)
+				return false;
+			
+			struct stat st;
+			if(::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || (std::size_t)st.st_size < sizeof(qtable_hdr_t)) {
+				::close(fd);
+				return false;
+			}
+			
+			std::size_t size = st.st_size;
+			void *map = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+			if(map == MAP_FAILED)
+				return false;
+			
+			qtable_hdr_t *saved = reinterpret_cast<qtable_hdr_t*>(map);
+			if(saved->magic != QTABLE_MAGIC || saved->version != QTABLE_VERSION || saved->cols != COL
+				|| saved->rows <= 0 || saved->length == 0
+				|| size != sizeof(qtable_hdr_t) + (std::size_t)saved->rows * COL * sizeof(int)) {
+				::munmap(map, size);
+				return false;
+			}
+			
+			hdr = saved;
+			table = reinterpret_cast<int*>(hdr + 1);
+			map_size = size;
+			this->path = path;
+			return true;
+		}
+		
+		void qtable_store::create(std::string path, int rows, unsigned int length,
+			unsigned int min_cycle, unsigned int max_cycle)
+		{
+			close();
+			std::size_t size = sizeof(qtable_hdr_t) + (std::size_t)rows * COL * sizeof(int);
+			
+			// A fresh file of our own, never one already at path: mkstemp creates it exclusively, 0600.
+			std::vector<char> tmp_name(path.begin(), path.end());
+			const char suffix[] = ".XXXXXX";
+			tmp_name.insert(tmp_name.end(), suffix, suffix + sizeof(suffix));
+			int fd = path.empty() ? -1 : ::mkstemp(tmp_name.data());
+			if(fd >= 0) {
+				void *map = MAP_FAILED;
+				if(::ftruncate(fd, size) == 0)
+					map = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				::close(fd);
+				if(map != MAP_FAILED) {
+					hdr = reinterpret_cast<qtable_hdr_t*>(map);
+					map_size = size;
+					this->path = path;
+					tmp_path = tmp_name.data();
+				} else {
+					::unlink(tmp_name.data());
+				}
+			}
+			if(hdr == NULL) {
+				heap.assign(size / sizeof(uint32_t), 0);
+				hdr = reinterpret_cast<qtable_hdr_t*>(heap.data());
+			}
+			
+			table = reinterpret_cast<int*>(hdr + 1);
+			hdr->version = QTABLE_VERSION;
+			hdr->cols = COL;
+			hdr->rows = rows;
+			hdr->length = length;
+			hdr->min_cycle = min_cycle;
+			hdr->max_cycle = max_cycle;
+			hdr->sigma = SIGMA_DEFAULT;
+			hdr->avgwl = 0;
+			hdr->reserved = 0;
+			// Not loadable until save(), so a run that dies early leaves nothing to resume from.
+			hdr->magic = 0;
+		}
+		
+		void qtable_store::save(int sigma, unsigned int avgwl)
+		{
+			if(hdr == NULL)
+				return;
+			hdr->sigma = sigma;
+			hdr->avgwl = avgwl;
+			hdr->magic = QTABLE_MAGIC;
+			if(map_size)
+				::msync(hdr, map_size, MS_SYNC);
+			// Atomic, so a reader sees the old table or the new one, never part of either.
+			if(!tmp_path.empty() && ::rename(tmp_path.c_str(), path.c_str()) == 0)
+				tmp_path.clear();
+		}
+		
+		void qtable_store::close(void)
+		{
+			if(map_size)
+				::munmap(hdr, map_size);
+			// Never saved, so nothing to resume from.
+			if(!tmp_path.empty())
+				::unlink(tmp_path.c_str());
+			path.clear();
+			tmp_path.clear();
+			heap.clear();
+			heap.shrink_to_fit();
+			hdr = NULL;
+			table = NULL;
+			map_size = 0;
+		}
+		
+		qlearn_sc::qlearn_sc(unsigned int frame_time, qtable_store *table) 
 		{
 			e_dl_Env = 1 ;
 			e_actwl_Env;
@@ -37,21 +179,21 @@ namespace prime  { namespace codegen
 			c_actwl_Cnt = 0 ; 
 			c_freq_Cnt = FREQ4 ; 
 			c_prdwl_Cnt = 0 ; 
-			c_avgwl_Cnt = 0 ; 
-			c_sigma_Cnt = SIGMA_DEFAULT ; 
+			c_avgwl_Cnt = table->get_avgwl() ; 
+			c_sigma_Cnt = table->get_sigma() ; 
 			c_random_Cnt = 100 ; 
 			c_rowNum_Cnt = 0 ; 
 			c_reward_penalty_Cnt = 0 ; 
 			c_qTable_value_Cnt = 0 ; 
 			priority_Cnt = 5; 
-			rowNum = row;
-			dlength = length;
-			c_qTable_Cnt =  (int**)malloc(rowNum*sizeof(int*));
-			for (int i0 = 0; i0 < rowNum; i0++) { 
-				c_qTable_Cnt[i0] = (int*)malloc(dlength*sizeof(int));
-			}
+			rowNum = table->get_rows();
+			dlength = table->get_length();
+			c_qTable_Cnt = table;
+			first_run = true;
 			
-			Cnt_init();
+			// A saved table carries on exploring from where its last run stopped.
+			if(c_sigma_Cnt == SIGMA_DEFAULT)
+				Cnt_init();
 		}
 		
 		qlearn_sc::~qlearn_sc() {}
@@ -64,7 +206,7 @@ namespace prime  { namespace codegen
 			for (; i0 < rowNum; i0++) { 
 				int i1 = 0; 
 				for (; i1 < COL; i1++) { 
-					std::cout << c_qTable_Cnt[i0][i1] << ",";
+					std::cout << c_qTable_Cnt->row(i0)[i1] << ",";
 				} 
 				
 				std::cout << std::endl;
@@ -82,6 +224,11 @@ namespace prime  { namespace codegen
 			//std::cout << "cycle_count," << cycle_count << ", d_t," << d_t << ", freq," << c_freq_Cnt << ", c_dl_Cnt," << c_dl_Cnt << std::endl;
 		}
 		
+		void qlearn_sc::save()
+		{
+			c_qTable_Cnt->save(c_sigma_Cnt, c_avgwl_Cnt);
+		}
+		
 		void qlearn_sc::random_max255(unsigned int *randomvar)
 		{
 			*randomvar = rand();
@@ -177,7 +324,7 @@ namespace prime  { namespace codegen
 			for (; i0 < rowNum; i0++) { 
 				int i1 = 0; 
 				for (; i1 < COL; i1++) { 
-					c_qTable_Cnt[i0][i1] = 1; 
+					c_qTable_Cnt->row(i0)[i1] = 1; 
 				} 
 			} 
 		} 
@@ -200,7 +347,7 @@ namespace prime  { namespace codegen
 		{
 			
 			int temp = 0;
-			if (c_sigma_Cnt != SIGMA_DEFAULT) { //First time the rtm is executed skip this bit and assign a random frequency 
+			if (!first_run) { //First time the rtm is executed skip this bit, the last frequency was not chosen by this controller
 
 				c_avgwl_Cnt = ((LAMBDA * c_actwl_Cnt) + ((100-LAMBDA) * c_avgwl_Cnt)) / 100;
 				//c_rowNum_Cnt = min(ROW - 1,max(0,c_actwl_Cnt / LENGTH - 1));
@@ -238,79 +385,79 @@ namespace prime  { namespace codegen
 				if ((0 < c_freq_Cnt) && (c_freq_Cnt <= FREQ1))
 				{
 					//Luis uses EWMA strategy to calculate the reward giving more weight to the previous values (0.6) than the actual one 0.4
-					c_qTable_Cnt[c_rowNum_Cnt][0] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][0]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[0] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[0]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ1 < c_freq_Cnt) && (c_freq_Cnt <= FREQ2))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((2) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][2-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((2) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[2-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ2 < c_freq_Cnt) && (c_freq_Cnt <= FREQ3))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((3) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][3-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((3) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[3-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ3 < c_freq_Cnt) && (c_freq_Cnt <= FREQ4))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((4) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][4-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((4) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[4-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ4 < c_freq_Cnt) && (c_freq_Cnt <= FREQ5))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((5) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][5-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((5) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[5-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ5 < c_freq_Cnt) && (c_freq_Cnt <= FREQ6))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((6) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][6-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((6) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[6-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ6 < c_freq_Cnt) && (c_freq_Cnt <= FREQ7))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((7) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][7-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((7) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[7-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ7 < c_freq_Cnt) && (c_freq_Cnt <= FREQ8))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((8) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][8-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((8) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[8-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ8 < c_freq_Cnt) && (c_freq_Cnt <= FREQ9))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((9) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][9-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((9) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[9-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ9 < c_freq_Cnt) && (c_freq_Cnt <= FREQ10))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((10) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][10-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((10) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[10-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ10 < c_freq_Cnt) && (c_freq_Cnt <= FREQ11))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((11) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][11-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((11) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[11-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ11 < c_freq_Cnt) && (c_freq_Cnt <= FREQ12))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((12) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][12-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((12) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[12-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ12 < c_freq_Cnt) && (c_freq_Cnt <= FREQ13))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((13) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][13-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((13) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[13-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ13 < c_freq_Cnt) && (c_freq_Cnt <= FREQ14))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((14) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][14-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((14) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[14-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ14 < c_freq_Cnt) && (c_freq_Cnt <= FREQ15))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((15) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][15-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((15) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[15-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ15 < c_freq_Cnt) && (c_freq_Cnt <= FREQ16))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((16) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][16-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((16) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[16-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ16 < c_freq_Cnt) && (c_freq_Cnt <= FREQ17))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((17) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][17-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((17) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[17-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else if ((FREQ17 < c_freq_Cnt) && (c_freq_Cnt <= FREQ18))
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((18) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][18-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((18) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[18-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 				else
 				{
-					c_qTable_Cnt[c_rowNum_Cnt][((19) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt[c_rowNum_Cnt][19-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
+					c_qTable_Cnt->row(c_rowNum_Cnt)[((19) - 1)] = (((((100) - LEARNING_RATE) * c_qTable_Cnt->row(c_rowNum_Cnt)[19-1]) + (LEARNING_RATE * c_reward_penalty_Cnt)) / 100);
 				}
 			} //MA
 			
@@ -330,75 +477,75 @@ namespace prime  { namespace codegen
 			{
 				c_freq_Cnt = Env_random_frequency(); //MA
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == (0)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == (0)))
 			{
 				c_freq_Cnt = FREQ1;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((2) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((2) - 1)))
 			{
 				c_freq_Cnt = FREQ2;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((3) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((3) - 1)))
 			{
 				c_freq_Cnt = FREQ3;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((4) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((4) - 1)))
 			{
 				c_freq_Cnt = FREQ4;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((5) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((5) - 1)))
 			{
 				c_freq_Cnt = FREQ5;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((6) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((6) - 1)))
 			{
 				c_freq_Cnt = FREQ6;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((7) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((7) - 1)))
 			{
 				c_freq_Cnt = FREQ7;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((8) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((8) - 1)))
 			{
 				c_freq_Cnt = FREQ8;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((9) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((9) - 1)))
 			{
 				c_freq_Cnt = FREQ9;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((10) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((10) - 1)))
 			{
 				c_freq_Cnt = FREQ10;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((11) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((11) - 1)))
 			{
 				c_freq_Cnt = FREQ11;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((12) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((12) - 1)))
 			{
 				c_freq_Cnt = FREQ12;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((13) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((13) - 1)))
 			{
 				c_freq_Cnt = FREQ13;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((14) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((14) - 1)))
 			{
 				c_freq_Cnt = FREQ14;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((15) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((15) - 1)))
 			{
 				c_freq_Cnt = FREQ15;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((16) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((16) - 1)))
 			{
 				c_freq_Cnt = FREQ16;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((17) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((17) - 1)))
 			{
 				c_freq_Cnt = FREQ17;
 			}
-			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt[c_rowNum_Cnt]) == ((18) - 1)))
+			else if ((c_random_Cnt <= c_sigma_Cnt) && (MAXROW(c_qTable_Cnt->row(c_rowNum_Cnt)) == ((18) - 1)))
 			{
 				c_freq_Cnt = FREQ18;
 			}
@@ -407,6 +554,7 @@ namespace prime  { namespace codegen
 				c_freq_Cnt = FREQ19;
 			}
 			c_sigma_Cnt = (c_sigma_Cnt + 1);
+			first_run = false;
 
 #ifdef DEBUG			
 			std::cout << "c_avgwl_Cnt, " << c_avgwl_Cnt << " ,c_actwl_Cnt, " << c_actwl_Cnt << ", reward, " << c_reward_penalty_Cnt<< ", row_real_value, " << temp <<", row_pred_value, " << c_rowNum_Cnt << ", freq, "<< c_freq_Cnt << ",decode time," << decode_time  << ",wl/freq, "<< (c_actwl_Cnt) / c_freq_Cnt<< std::endl;
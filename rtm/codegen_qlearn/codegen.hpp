@@ -20,6 +20,11 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 namespace prime { namespace codegen
 {
 	typedef int BOOL;
@@ -57,15 +62,87 @@ namespace prime { namespace codegen
 	#define min(a,b) (((int)(a)<=(int)(b))?(int)(a):(int)(b)) // MA
 	#define max(a,b) (((int)(a)>=(int)(b))?(int)(a):(int)(b)) // MA
 
+	/* Q-table of a qlearn_sc, with the row binning it was built with.
+	 *
+	 * The table is kept in a file per application: a header then rows of COL
+	 * ints. A new table is created in a private temporary file next to it and
+	 * mapped, so the controller updates the file in place; save() records the
+	 * exploration state, flushes it, and the first save renames it over the
+	 * table's path. Until then a saved table there, possibly mapped by another
+	 * run, is left alone. load() maps a table saved by an earlier run so the
+	 * controller resumes from it. If the file cannot be made, the table is
+	 * kept in memory and not saved.
+	 *
+	 * The RTM runs privileged, so tables live in a directory only it can write:
+	 * private_dir() creates one, or checks an existing one is.
+	 */
+	class qtable_store
+	{
+	public:
+		qtable_store();
+		~qtable_store();
+
+		qtable_store(const qtable_store&) = delete;
+		qtable_store& operator=(const qtable_store&) = delete;
+
+		// Per-user directory under /tmp for the tables.
+		static std::string default_dir(void);
+		// Create dir 0700 if missing. False unless it is a directory, not a link, owned by us
+		// and writable by no one else.
+		static bool private_dir(std::string dir);
+
+		// Map a saved table. False if there is none or it is not a table.
+		bool load(std::string path);
+		// A new table; its values are set by the controller.
+		void create(std::string path, int rows, unsigned int length,
+			unsigned int min_cycle, unsigned int max_cycle);
+		void save(int sigma, unsigned int avgwl);
+		void close(void);
+		bool is_open(void) { return hdr != NULL; }
+
+		int *row(int r) { return table + (std::size_t)r * COL; }
+		int get_rows(void) { return hdr->rows; }
+		unsigned int get_length(void) { return hdr->length; }
+		unsigned int get_min_cycle(void) { return hdr->min_cycle; }
+		unsigned int get_max_cycle(void) { return hdr->max_cycle; }
+		// SIGMA_DEFAULT until a controller has saved to it.
+		int get_sigma(void) { return hdr->sigma; }
+		unsigned int get_avgwl(void) { return hdr->avgwl; }
+
+	private:
+		struct qtable_hdr_t
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t cols;
+			int32_t rows;
+			uint32_t length;		// Cycles per row
+			uint32_t min_cycle;
+			uint32_t max_cycle;
+			int32_t sigma;
+			uint32_t avgwl;
+			uint32_t reserved;
+		};
+
+		qtable_hdr_t *hdr;
+		int *table;
+		std::size_t map_size;		// 0 when the table is in memory
+		std::vector<uint32_t> heap;
+		std::string path;
+		std::string tmp_path;		// Set until a created table is first saved
+	};
+
 	class qlearn_sc
 	{
 	public:
 		qlearn_sc();
-		qlearn_sc(unsigned int frame_time, int row, unsigned int length);
+		// The table outlives the controller. One saved by an earlier run is used as it is.
+		qlearn_sc(unsigned int frame_time, qtable_store *table);
 		~qlearn_sc();	
 		//void run(unsigned int& freq_return, unsigned int cycle_count);
 		void run(unsigned int& freq_return, unsigned int cycle_count, float d_t);
 		void printTable();
+		void save();
 		
 	private:
 		int e_dl_Env;
@@ -79,7 +156,8 @@ namespace prime { namespace codegen
 		unsigned int c_prdwl_Cnt; 
 		unsigned int c_avgwl_Cnt; 
 		unsigned int dlength; 
-		int ** c_qTable_Cnt;
+		qtable_store *c_qTable_Cnt;
+		bool first_run;
 		
 	//	int  c_qTable_Cnt[ROW][COL]; //int  c_qTable_Cnt [ROW][COL]; //MC 
 		int  c_sigma_Cnt; 
@@ -32,6 +32,7 @@
 #include "util.h"
 #include "rtm_arch_utils.h"
 #include "prime_api_rtm.h"
+#include "rtm_executor.h"
 #include "codegen.hpp"
 
 //#define DEBUGAPI
@@ -48,6 +49,7 @@ namespace prime
 			double frame_time = 0.040;
 			int ondemand = false;
 			int max_cpu_cycle_training = 2000;
+			std::string qtable_dir = prime::codegen::qtable_store::default_dir();
 		};
 
 		static int parse_cli(std::string rtm_name, prime::uds::socket_addrs_t* rtm_app_addrs,
@@ -97,7 +99,16 @@ namespace prime
 		prime::api::dev::mon_cont_t power_mon;
 
 		boost::thread rtm_thread;
+		// Runs the control loop off the app socket's receive thread.
+		prime::api::rtm::executor_t executor;
 		prime::codegen::qlearn_sc controller;
+		// Guards the controller and its table between the loop and app (de)registration.
+		std::mutex controller_m;
+		prime::codegen::qtable_store qtable;
+		std::string qtable_dir;
+		std::string qtable_path;
+		pid_t qtable_proc_id = 0;
+		bool table_ready = false;
 		unsigned int ondemand;
 		double frame_time;
 		int max_cpu_cycle_training;
@@ -147,6 +158,7 @@ namespace prime
 		void dereg_dev();
 		void qlearn_rtm(unsigned int cc);
 		void filter_cpu_cycle(unsigned int cc);
+		void save_qtable(void);
 	};
 
 	rtm::rtm(
@@ -185,6 +197,7 @@ namespace prime
 				boost::bind(&rtm::ui_rtm_stop_handler, this),
 				rtm_ui_addrs
 			),
+		qtable_dir(rtm_args->qtable_dir),
 		ondemand(rtm_args->ondemand),
 		frame_time(rtm_args->frame_time),
 #ifdef NOTRAIN
@@ -194,6 +207,7 @@ namespace prime
 #endif
 	{
 		reg_dev();
+		executor.start();
 		ui_api.return_ui_rtm_start();
 
 		std::unique_lock<std::mutex> stop_lock(ui_rtm_stop_m);
@@ -205,6 +219,10 @@ namespace prime
 
 	void rtm::ui_rtm_stop_handler(void)
 	{
+		executor.stop();
+		controller_m.lock();
+		save_qtable();
+		controller_m.unlock();
 		dereg_dev();
 		ui_rtm_stop_cv.notify_one();
 	}
@@ -218,16 +236,14 @@ namespace prime
 		mons_cont = dev_api.mon_cont_reg();
 		boost::property_tree::ptree dev_arch = dev_api.dev_arch_get();
 
-		std::vector<unsigned int> fu_ids;
-		std::vector<unsigned int> su_ids;
+		prime::util::arch_index_t arch_index(dev_arch, knobs_disc, knobs_cont, mons_disc, mons_cont);
 
 		//get all functional units ids
-		fu_ids = prime::util::get_func_unit_ids(dev_arch);
+		const std::vector<unsigned int>& fu_ids = arch_index.func_unit_ids();
 
 		/**********************GET FREQUENCY KNOB*************************/
 		//get all discrete knobs for 3nd functional unit (a15)
-		std::vector<prime::api::dev::knob_disc_t> knobs_A15;
-		knobs_A15 = prime::util::get_disc_knob_func_unit(dev_arch, knobs_disc, fu_ids.at(2));
+		auto knobs_A15 = arch_index.disc_knobs_func_unit(fu_ids.at(2));
 
 		//search for freq knob in A15
 		for(auto knob : knobs_A15){
@@ -240,7 +256,7 @@ namespace prime
 		/**********************GET CYCLE COUNTERS*************************/
 		//get all cycle count monitors
 		std::vector<prime::api::dev::mon_disc_t> cycle_count_mons;
-		cycle_count_mons = prime::util::get_all_disc_mon(mons_disc,prime::api::dev::PRIME_CYCLES);
+		cycle_count_mons = arch_index.disc_mons(prime::api::dev::PRIME_CYCLES).to_vector();
 
 		//connect monitors to use on control loop
 		cycle_count_4_mon = cycle_count_mons.at(4);
@@ -288,12 +304,27 @@ namespace prime
 		}
 
 		// Reset RTM training stuff
+		controller_m.lock();
+		save_qtable();
 		max_cpu_cycle = 0;
 		min_cpu_cycle = 4294967295;
 		frame_count = 0;
 		frame_time=0;
 		perf_cont = 0;
 
+		// Resume from the table of this application's last run, skipping training, if there is one.
+		qtable_proc_id = proc_id;
+		qtable_path = qtable_dir.empty() ? "" : qtable_dir + "/codegen_qlearn." + std::to_string(ur_id) + ".qtable";
+		if(!qtable_path.empty() && qtable.load(qtable_path))
+		{
+			max_cpu_cycle = qtable.get_max_cycle();
+			min_cpu_cycle = qtable.get_min_cycle();
+#ifdef DEBUG
+			std::cout << "RTM: Loaded Q-table " << qtable_path << " rowNum: " << qtable.get_rows() << " length: " << qtable.get_length() << std::endl;
+#endif
+		}
+		controller_m.unlock();
+
 
 		//Set the frequency if it is passed to the RTM
 		if(freqChoice != 0){
@@ -329,7 +360,12 @@ namespace prime
 #ifdef DEBUG
 		std::cout << "Decoded frames: " << decoded_frame_counter <<std::endl;
 #endif
-		controller.printTable();
+		controller_m.lock();
+		if(table_ready)
+			controller.printTable();
+		if(proc_id == qtable_proc_id)
+			save_qtable();
+		controller_m.unlock();
 
 		decoded_frame_counter = 0;
 		//controller.printTable();
@@ -681,7 +717,9 @@ namespace prime
 		for(auto& app_mon : app_mons_cont){
 			if((app_mon.id == id) && (app_mon.proc_id == proc_id) && (app_mon.id == perf_mon_id)){
 				app_mon.val = val;
-				run_rtm_loop(app_mon.val);
+				// Frames arriving while the loop runs collapse into one run on the newest.
+				executor.post_latest(prime::api::rtm::executor_t::mon_key(proc_id, id),
+					boost::bind(&rtm::run_rtm_loop, this, (float)app_mon.val));
 			}
 		}
 		app_mons_cont_m.unlock();
@@ -689,12 +727,23 @@ namespace prime
 
 	void rtm::run_rtm_loop(float d_t)
 	{
+				std::lock_guard<std::mutex> controller_lock(controller_m);
+				// Frames posted before the application deregistered.
+				if(qtable_proc_id == 0)
+					return;
 
+				if(!table_ready && qtable.is_open())
+				{
+					controller = prime::codegen::qlearn_sc((unsigned int)((perf_cont / 1000) * 1000000), &qtable);
+					table_ready = true;
+				}
 #ifdef NOTRAIN
 				//Static table size
-				if(frame_count == 0)
+				if(!table_ready)
 				{
-					controller = prime::codegen::qlearn_sc((unsigned int)((perf_cont / 1000) * 1000000), 60, 2056664);
+					qtable.create(qtable_path, 60, 2056664, 0, 0);
+					controller = prime::codegen::qlearn_sc((unsigned int)((perf_cont / 1000) * 1000000), &qtable);
+					table_ready = true;
 				}
 #endif
 
@@ -720,7 +769,7 @@ namespace prime
 
 					if(frame_count % frame_rate == 0)
 					{
-						if(frame_count < max_cpu_cycle_training)
+						if(!table_ready && frame_count < max_cpu_cycle_training)
 						{
 
 							//Find the maximum cycle count within the first max_cpu_cycle_training frames
@@ -736,14 +785,16 @@ namespace prime
 							}
 						}
 #ifndef NOTRAIN
-						// Build a table each time.
-						else if(frame_count == max_cpu_cycle_training)
+						// Build a table for applications without a saved one.
+						else if(!table_ready)
 						{
 							unsigned int length = (unsigned int)((max_cpu_cycle - min_cpu_cycle)/numberOfRows);
 							//Calculate the number of rows based on the max_cpu_cycle collected in max_cpu_cycle_training
 							int rowNum = (max_cpu_cycle / length) * 3;
 							//0.040 should be replace by the value comming from arguments/app monitor
-							controller = prime::codegen::qlearn_sc((unsigned int)((perf_cont / 1000) * 1000000), rowNum, length);
+							qtable.create(qtable_path, rowNum, length, min_cpu_cycle, max_cpu_cycle);
+							controller = prime::codegen::qlearn_sc((unsigned int)((perf_cont / 1000) * 1000000), &qtable);
+							table_ready = true;
 #ifdef DEBUG
 							std::cout << "min: " << min_cpu_cycle << " max: " << max_cpu_cycle << " rowNum: " << rowNum << " length: " << length << std::endl;
 #endif
@@ -751,7 +802,7 @@ namespace prime
 
 						}
 #endif
-						else if(frame_count > max_cpu_cycle_training){
+						else {
 							//RTM starts here!
 							average_time = average_time/frame_rate;
 							cycle_count_5 = (unsigned int) dev_api.mon_disc_get(cycle_count_5_mon) / frame_rate;
@@ -801,6 +852,16 @@ namespace prime
 
 	}
 
+	// Called with controller_m held.
+	void rtm::save_qtable(void)
+	{
+		if(table_ready)
+			controller.save();
+		qtable.close();
+		table_ready = false;
+		qtable_proc_id = 0;
+	}
+
 	void rtm::filter_cpu_cycle(unsigned int cc)
 	{
 		if(currentCycle == 0 || (cc <= 60000000 && cc >= 20000000))
@@ -821,6 +882,7 @@ namespace prime
 		args::Flag ondemand_gov(optional, "ondemand", "Use Ondemand rather than the Q-Learning algorithm - useful for assessing performance", {'o', "ondemand"});
 		//args::ValueFlag<float> frame_time(optional, "frame_time", "Target frame time", {'f', "frametime"});
 		args::ValueFlag<int> max_cpu_cycle_training(optional, "max_cpu_cycle_training", "Number of performance monitor updates to carry out for training", {'t', "traintime"});
+		args::ValueFlag<std::string> qtable_dir(optional, "qtable_dir", "Directory the Q-table of each application is kept in, which only this user may write; created if missing. Empty to not keep them (default /tmp/prime-qtables-<uid>).", {'q', "qtables"});
 
 		UTIL_ARGS_LOGGER_PARAMS();
 
@@ -849,8 +911,18 @@ namespace prime
 			args->max_cpu_cycle_training = args::get(max_cpu_cycle_training);
 		}
 
+		if(qtable_dir) {
+			args->qtable_dir = args::get(qtable_dir);
+		}
+
 		args->ondemand = ondemand_gov;
 
+		// Checked before any app can register, as apps' tables are opened there.
+		if(!args->qtable_dir.empty() && !prime::codegen::qtable_store::private_dir(args->qtable_dir)) {
+			std::cout << "RTM: Q-table directory " << args->qtable_dir << " is not private to this user, Q-tables will not be kept" << std::endl;
+			args->qtable_dir.clear();
+		}
+
 		return 0;
 	}
 }
@@ -22,6 +22,8 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <utility>
 #include <boost/property_tree/ptree.hpp>
 #include "util.h"
 #include "prime_api_t.h"
@@ -29,44 +31,176 @@
 
 namespace prime { namespace util
 {
-	void print_architecture(boost::property_tree::ptree dev_arch);
+	// A contiguous run of an arch_index_t's knobs or monitors, valid until the index is rebuilt.
+	template<typename T>
+	class arch_span_t
+	{
+	public:
+		arch_span_t() : first(nullptr), last(nullptr) {}
+		arch_span_t(const T *first, const T *last) : first(first), last(last) {}
+
+		const T* begin(void) const { return first; }
+		const T* end(void) const { return last; }
+		std::size_t size(void) const { return last - first; }
+		bool empty(void) const { return first == last; }
+		const T& operator[](std::size_t idx) const { return first[idx]; }
+		std::vector<T> to_vector(void) const { return std::vector<T>(first, last); }
+
+	private:
+		const T *first;
+		const T *last;
+	};
+
+	/* The device architecture compiled once, with the registered knobs and monitors, into
+	 * flat arrays.
+	 *
+	 * Each level of the architecture, a functional unit's own knobs and monitors or one
+	 * of its sub units, holds a contiguous range of each array, grouped by type within
+	 * it. A second copy of each array is grouped by type alone. Every query is a table
+	 * lookup returning a span, so RTMs can ask inside their loops instead of walking the
+	 * property tree each time.
+	 *
+	 * Spans by type alone keep registration order. Spans of a level are in registration
+	 * order within each type. Build again after the device re-registers.
+	 */
+	class arch_index_t
+	{
+	public:
+		arch_index_t() {}
+		arch_index_t(
+			const boost::property_tree::ptree& dev_arch,
+			const std::vector<prime::api::dev::knob_disc_t>& knobs_disc,
+			const std::vector<prime::api::dev::knob_cont_t>& knobs_cont,
+			const std::vector<prime::api::dev::mon_disc_t>& mons_disc,
+			const std::vector<prime::api::dev::mon_cont_t>& mons_cont
+		);
+
+		void build(
+			const boost::property_tree::ptree& dev_arch,
+			const std::vector<prime::api::dev::knob_disc_t>& knobs_disc,
+			const std::vector<prime::api::dev::knob_cont_t>& knobs_cont,
+			const std::vector<prime::api::dev::mon_disc_t>& mons_disc,
+			const std::vector<prime::api::dev::mon_cont_t>& mons_cont
+		);
+
+		// In architecture order
+		const std::vector<unsigned int>& func_unit_ids(void) const { return fu_ids; }
+		const std::vector<unsigned int>& sub_unit_ids(unsigned int func_unit_id) const;
+		// Ids the architecture lists at a level, monitors then knobs
+		const std::vector<unsigned int>& mons_knobs_ids_func_unit(unsigned int func_unit_id) const;
+		const std::vector<unsigned int>& mons_knobs_ids_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id) const;
+
+		arch_span_t<prime::api::dev::mon_disc_t> disc_mons(prime::api::dev::mon_type_t type) const { return mons_disc.of_type(type); }
+		arch_span_t<prime::api::dev::mon_cont_t> cont_mons(prime::api::dev::mon_type_t type) const { return mons_cont.of_type(type); }
+		arch_span_t<prime::api::dev::knob_disc_t> disc_knobs(prime::api::dev::knob_type_t type) const { return knobs_disc.of_type(type); }
+		arch_span_t<prime::api::dev::knob_cont_t> cont_knobs(prime::api::dev::knob_type_t type) const { return knobs_cont.of_type(type); }
+
+		// Listed directly under the functional unit, not under its sub units
+		arch_span_t<prime::api::dev::mon_disc_t> disc_mons_func_unit(unsigned int func_unit_id) const { return mons_disc.at_level(fu_level(func_unit_id)); }
+		arch_span_t<prime::api::dev::mon_cont_t> cont_mons_func_unit(unsigned int func_unit_id) const { return mons_cont.at_level(fu_level(func_unit_id)); }
+		arch_span_t<prime::api::dev::knob_disc_t> disc_knobs_func_unit(unsigned int func_unit_id) const { return knobs_disc.at_level(fu_level(func_unit_id)); }
+		arch_span_t<prime::api::dev::knob_cont_t> cont_knobs_func_unit(unsigned int func_unit_id) const { return knobs_cont.at_level(fu_level(func_unit_id)); }
+		arch_span_t<prime::api::dev::mon_disc_t> disc_mons_func_unit(unsigned int func_unit_id, prime::api::dev::mon_type_t type) const { return mons_disc.at_level(fu_level(func_unit_id), type); }
+		arch_span_t<prime::api::dev::mon_cont_t> cont_mons_func_unit(unsigned int func_unit_id, prime::api::dev::mon_type_t type) const { return mons_cont.at_level(fu_level(func_unit_id), type); }
+		arch_span_t<prime::api::dev::knob_disc_t> disc_knobs_func_unit(unsigned int func_unit_id, prime::api::dev::knob_type_t type) const { return knobs_disc.at_level(fu_level(func_unit_id), type); }
+		arch_span_t<prime::api::dev::knob_cont_t> cont_knobs_func_unit(unsigned int func_unit_id, prime::api::dev::knob_type_t type) const { return knobs_cont.at_level(fu_level(func_unit_id), type); }
+
+		arch_span_t<prime::api::dev::mon_disc_t> disc_mons_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id) const { return mons_disc.at_level(sub_level(func_unit_id, sub_unit_id)); }
+		arch_span_t<prime::api::dev::mon_cont_t> cont_mons_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id) const { return mons_cont.at_level(sub_level(func_unit_id, sub_unit_id)); }
+		arch_span_t<prime::api::dev::knob_disc_t> disc_knobs_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id) const { return knobs_disc.at_level(sub_level(func_unit_id, sub_unit_id)); }
+		arch_span_t<prime::api::dev::knob_cont_t> cont_knobs_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id) const { return knobs_cont.at_level(sub_level(func_unit_id, sub_unit_id)); }
+		arch_span_t<prime::api::dev::mon_disc_t> disc_mons_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id, prime::api::dev::mon_type_t type) const { return mons_disc.at_level(sub_level(func_unit_id, sub_unit_id), type); }
+		arch_span_t<prime::api::dev::mon_cont_t> cont_mons_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id, prime::api::dev::mon_type_t type) const { return mons_cont.at_level(sub_level(func_unit_id, sub_unit_id), type); }
+		arch_span_t<prime::api::dev::knob_disc_t> disc_knobs_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id, prime::api::dev::knob_type_t type) const { return knobs_disc.at_level(sub_level(func_unit_id, sub_unit_id), type); }
+		arch_span_t<prime::api::dev::knob_cont_t> cont_knobs_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id, prime::api::dev::knob_type_t type) const { return knobs_cont.at_level(sub_level(func_unit_id, sub_unit_id), type); }
+
+	private:
+		// One kind of knob or monitor, in both groupings.
+		template<typename T, typename type_t>
+		class table_t
+		{
+		public:
+			// levels maps an id to the level the architecture lists it at.
+			void build(const std::vector<T>& items, const std::unordered_map<unsigned int, int>& levels, std::size_t num_levels);
+			arch_span_t<T> of_type(type_t type) const;
+			arch_span_t<T> at_level(int level) const;
+			arch_span_t<T> at_level(int level, type_t type) const;
+
+		private:
+			typedef std::pair<uint32_t, uint32_t> range_t;
+			std::vector<T> by_level;
+			std::vector<T> by_type;
+			std::size_t num_types = 0;
+			std::vector<range_t> level_ranges;
+			std::vector<range_t> level_type_ranges;		// level * num_types + type
+			std::vector<range_t> type_ranges;
+
+			static arch_span_t<T> span(const std::vector<T>& items, range_t range);
+		};
+
+		struct level_t {
+			int unit;
+			std::vector<unsigned int> ids;
+		};
+
+		std::vector<unsigned int> fu_ids;
+		std::vector<std::vector<unsigned int>> su_ids;		// Per unit
+		std::vector<level_t> levels;
+		std::vector<int> fu_levels;							// Per unit
+		std::unordered_map<unsigned int, int> units;		// By functional unit id
+		std::unordered_map<unsigned int, int> sub_levels;	// By functional unit id << 8 | sub unit id
+
+		table_t<prime::api::dev::knob_disc_t, prime::api::dev::knob_type_t> knobs_disc;
+		table_t<prime::api::dev::knob_cont_t, prime::api::dev::knob_type_t> knobs_cont;
+		table_t<prime::api::dev::mon_disc_t, prime::api::dev::mon_type_t> mons_disc;
+		table_t<prime::api::dev::mon_cont_t, prime::api::dev::mon_type_t> mons_cont;
+
+		int fu_level(unsigned int func_unit_id) const;
+		int sub_level(unsigned int func_unit_id, unsigned int sub_unit_id) const;
+	};
+
+	void print_architecture(const boost::property_tree::ptree& dev_arch);
 
 	//Get all the discrete monitors of a specific type
-	std::vector<prime::api::dev::mon_disc_t> get_all_disc_mon(std::vector<prime::api::dev::mon_disc_t> mons_disc, prime::api::dev::mon_type_t type);
+	std::vector<prime::api::dev::mon_disc_t> get_all_disc_mon(const std::vector<prime::api::dev::mon_disc_t>& mons_disc, prime::api::dev::mon_type_t type);
 	//Get all the continuous monitors of a specific type
-	std::vector<prime::api::dev::mon_cont_t> get_all_cont_mon(std::vector<prime::api::dev::mon_cont_t> mons_cont, prime::api::dev::mon_type_t type);
+	std::vector<prime::api::dev::mon_cont_t> get_all_cont_mon(const std::vector<prime::api::dev::mon_cont_t>& mons_cont, prime::api::dev::mon_type_t type);
 	//Get all the discrete knobs of a specific type
-	std::vector<prime::api::dev::knob_disc_t> get_all_disc_knob(std::vector<prime::api::dev::knob_disc_t> knobs_disc, prime::api::dev::knob_type_t type);
+	std::vector<prime::api::dev::knob_disc_t> get_all_disc_knob(const std::vector<prime::api::dev::knob_disc_t>& knobs_disc, prime::api::dev::knob_type_t type);
 	//Get all the continuous knobs of a specific type
-	std::vector<prime::api::dev::knob_cont_t> get_all_cont_knob(std::vector<prime::api::dev::knob_cont_t> knobs_cont, prime::api::dev::knob_type_t type);
+	std::vector<prime::api::dev::knob_cont_t> get_all_cont_knob(const std::vector<prime::api::dev::knob_cont_t>& knobs_cont, prime::api::dev::knob_type_t type);
+
+	// Legacy: the helpers below compile the whole architecture on every call and copy the
+	// result. They are kept for out-of-tree RTMs; new code should build one arch_index_t
+	// and query its spans.
 
 	//Get all the ids of the functional units
-	std::vector<unsigned int> get_func_unit_ids(boost::property_tree::ptree dev_arch);
+	std::vector<unsigned int> get_func_unit_ids(const boost::property_tree::ptree& dev_arch);
 	//Get all the ids of the knobs and monitors of a functional unit
-	std::vector<unsigned int> get_mons_knobs_ids_func_unit(boost::property_tree::ptree dev_arch, unsigned int func_unit_id);
+	std::vector<unsigned int> get_mons_knobs_ids_func_unit(const boost::property_tree::ptree& dev_arch, unsigned int func_unit_id);
 
 	//Get all the discrete monitors of a functional unit
-	std::vector<prime::api::dev::mon_disc_t> get_disc_mon_func_unit(boost::property_tree::ptree dev_arch, std::vector<prime::api::dev::mon_disc_t> mons_disc, unsigned int func_unit_id);
+	std::vector<prime::api::dev::mon_disc_t> get_disc_mon_func_unit(const boost::property_tree::ptree& dev_arch, const std::vector<prime::api::dev::mon_disc_t>& mons_disc, unsigned int func_unit_id);
 	//Get all the continuous monitors of a functional unit
-	std::vector<prime::api::dev::mon_cont_t> get_cont_mon_func_unit(boost::property_tree::ptree dev_arch, std::vector<prime::api::dev::mon_cont_t> mons_cont, unsigned int func_unit_id);
+	std::vector<prime::api::dev::mon_cont_t> get_cont_mon_func_unit(const boost::property_tree::ptree& dev_arch, const std::vector<prime::api::dev::mon_cont_t>& mons_cont, unsigned int func_unit_id);
 	//Get all the discrete knobs of a functional unit
-	std::vector<prime::api::dev::knob_disc_t> get_disc_knob_func_unit(boost::property_tree::ptree dev_arch, std::vector<prime::api::dev::knob_disc_t> knobs_disc, unsigned int func_unit_id);
+	std::vector<prime::api::dev::knob_disc_t> get_disc_knob_func_unit(const boost::property_tree::ptree& dev_arch, const std::vector<prime::api::dev::knob_disc_t>& knobs_disc, unsigned int func_unit_id);
 	//Get all the continuous knobs of a functional unit
-	std::vector<prime::api::dev::knob_cont_t> get_cont_knob_func_unit(boost::property_tree::ptree dev_arch, std::vector<prime::api::dev::knob_cont_t> knobs_cont, unsigned int func_unit_id);
+	std::vector<prime::api::dev::knob_cont_t> get_cont_knob_func_unit(const boost::property_tree::ptree& dev_arch, const std::vector<prime::api::dev::knob_cont_t>& knobs_cont, unsigned int func_unit_id);
 
 	//Get all the ids of the sub units in a functional unit
-	std::vector<unsigned int> get_sub_unit_ids(boost::property_tree::ptree dev_arch, unsigned int func_unit_id);
+	std::vector<unsigned int> get_sub_unit_ids(const boost::property_tree::ptree& dev_arch, unsigned int func_unit_id);
 	//Get all the ids of the knobs and monitors of a sub unit in a functional unit
-	std::vector<unsigned int> get_mons_knobs_ids_sub_unit(boost::property_tree::ptree dev_arch, unsigned int func_unit_id, unsigned int sub_unit_id);
+	std::vector<unsigned int> get_mons_knobs_ids_sub_unit(const boost::property_tree::ptree& dev_arch, unsigned int func_unit_id, unsigned int sub_unit_id);
 
     //Get all the discrete monitors of a sub unit in a functional unit
-	std::vector<prime::api::dev::mon_disc_t> get_disc_mon_sub_unit(boost::property_tree::ptree dev_arch, std::vector<prime::api::dev::mon_disc_t> mons_disc, unsigned int func_unit_id, unsigned int sub_unit_id);
+	std::vector<prime::api::dev::mon_disc_t> get_disc_mon_sub_unit(const boost::property_tree::ptree& dev_arch, const std::vector<prime::api::dev::mon_disc_t>& mons_disc, unsigned int func_unit_id, unsigned int sub_unit_id);
     //Get all the continuous monitors of a sub unit in a functional unit
-	std::vector<prime::api::dev::mon_cont_t> get_cont_mon_sub_unit(boost::property_tree::ptree dev_arch, std::vector<prime::api::dev::mon_cont_t> mons_cont, unsigned int func_unit_id, unsigned int sub_unit_id);
+	std::vector<prime::api::dev::mon_cont_t> get_cont_mon_sub_unit(const boost::property_tree::ptree& dev_arch, const std::vector<prime::api::dev::mon_cont_t>& mons_cont, unsigned int func_unit_id, unsigned int sub_unit_id);
 	//Get all the discrete knobs of a sub unit in a functional unit
-	std::vector<prime::api::dev::knob_disc_t> get_disc_knob_sub_unit(boost::property_tree::ptree dev_arch, std::vector<prime::api::dev::knob_disc_t> knobs_disc, unsigned int func_unit_id, unsigned int sub_unit_id);
+	std::vector<prime::api::dev::knob_disc_t> get_disc_knob_sub_unit(const boost::property_tree::ptree& dev_arch, const std::vector<prime::api::dev::knob_disc_t>& knobs_disc, unsigned int func_unit_id, unsigned int sub_unit_id);
 	//Get all the continuous knobs of a sub unit in a functional unit
-	std::vector<prime::api::dev::knob_cont_t> get_cont_knob_sub_unit(boost::property_tree::ptree dev_arch, std::vector<prime::api::dev::knob_cont_t> knobs_cont, unsigned int func_unit_id, unsigned int sub_unit_id);
+	std::vector<prime::api::dev::knob_cont_t> get_cont_knob_sub_unit(const boost::property_tree::ptree& dev_arch, const std::vector<prime::api::dev::knob_cont_t>& knobs_cont, unsigned int func_unit_id, unsigned int sub_unit_id);
 
 } }
 #endif
@@ -31,32 +31,61 @@
 #include <string>
 #include <chrono>
 #include <vector>
-#include <deque>
 #include <mutex>
 #include <limits>
-#include <gsl/gsl_multifit.h> // -lgsl -lgslcblas
+#include <gsl/gsl_blas.h> // -lgsl -lgslcblas
+#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_errno.h>
+#include "samples.h"
 
 //#define DEBUG_MODEL
 
+// Ridge added to the normal equations, relative to their mean diagonal, so
+// knobs that never moved still give a solvable system.
+#define MODEL_RIDGE				1e-9
+// Initial coefficient covariance of the online estimator, a weak prior on zero coefficients.
+#define MODEL_RLS_DELTA			1e4
+// Weight of past prediction errors in the RMS error when the model is not online.
+#define MODEL_ERROR_DECAY		0.98
+
 namespace prime { namespace model
 {
 	class LinearModel
 	{
 	public:
-		LinearModel(unsigned int id, unsigned int predictors);
+		/* forgetting > 0 makes the model online: each sample updates a recursive
+		 * least squares estimate, past samples weighted down by forgetting per
+		 * sample (1 weighs them all equally). After the first train() the
+		 * coefficients follow that estimate sample by sample, and train() only
+		 * publishes it. With forgetting = 0 train() solves the batch problem
+		 * over the kept samples.
+		 *
+		 * Samples are kept in the given slot of a store shared with other
+		 * models, which also sets the number of predictors.
+		 */
+		LinearModel(unsigned int id, SampleStore &samples, unsigned int slot, double forgetting = 0);
 		~LinearModel();
 		bool trained;
 
 		double get_rms_error(void);
 		unsigned int get_id(void);
+		unsigned int get_slot(void);
 		unsigned int get_num_samples(void);
 		unsigned int get_num_predictors(void);
+		// Intercept first, then one per predictor; empty until trained.
+		const std::vector<double> &get_coefficients(void);
 		void set_num_predictors(unsigned int);
 		void clear_samples();
 
-		void add_sample(double y, std::vector<double> x);
+		bool is_online(void);
+
+		// x holds one value per predictor.
+		void add_sample(double y, const double *x);
+		// Keeps the previous coefficients, or stays untrained, if the samples cannot be solved.
 		void train(void);
-		int predict(std::vector<double> x, double *pred_val);
+		int predict(const std::vector<double> &x, double *pred_val);
+		// count candidates at once, column-major: predictor j of candidate i is x[j * stride + i].
+		int predict(const double *x, unsigned int stride, unsigned int count, double *pred_vals);
 		double calc_rms_error(void);
 
 	private:
@@ -64,12 +93,31 @@ namespace prime { namespace model
 		unsigned int num_predictors;
 		double rms_error;
 
-		std::deque<double> y_vals;
-		std::deque<std::vector<double> > x_vals;
+		SampleStore *samples;
+		unsigned int slot;
 
 		//std::mutex coefficients_m;
 		std::vector<double> coefficients;
 
+		// Batch normal equations, sized with the estimator.
+		std::vector<double> normal;			// X'X, then its Cholesky factor
+		std::vector<double> normal_rhs;		// X'y
+		std::vector<double> solution;
+
+		// Online estimator, all sized on reset so updates do not allocate.
+		double forgetting;
+		std::vector<double> estimate;
+		std::vector<double> covariance;		// (predictors+1)^2, row major
+		std::vector<double> regressor;		// 1, x
+		std::vector<double> gain;
+
+		// Exponentially weighted squared error of predictions made before each sample.
+		double sq_error_sum;
+		double error_weight;
+
+		void reset_estimator(void);
+		void update_estimator(double y);
+		void update_error(double y);
 	};
 } }
 
@@ -35,14 +35,26 @@
 #include <mutex>
 #include <map>
 #include <limits.h>
+#include <limits>
 #include <cmath>
+#include <algorithm>
 
 #include "prime_api_rtm.h"
 #include "util.h"
 #include "model.h"
+#include "samples.h"
 
 //#define DEBUG_RTM
 
+// Largest discrete knob lattice searched exhaustively. Bigger ones, or any
+// continuous knob, are solved as a linear program over the knob ranges.
+#define LRGD_MAX_LATTICE	65536
+// Knob settings scored per pass of the exhaustive search.
+#define LRGD_BATCH_SIZE		256
+
+// Forgetting factor of the online models, about a 50 sample memory. 0 trains them in batches instead.
+#define LRGD_FORGETTING		0.98
+
 namespace prime
 {
 	class regression
@@ -88,19 +100,29 @@ namespace prime
 		std::vector<prime::api::dev::knob_cont_t> const &dev_knobs_cont;
 
 		//std::mutex models_m;
+		model::SampleStore samples;
 		std::vector<model::LinearModel> models;
 		//std::map<unsigned int, model::LinearModel> models;
 		unsigned int min_samples;
 		bool stop_training;
 
+		// Current knob values in model predictor order, reused between samples.
+		std::vector<double> curr_knob_vals;
+
 		//functions
+		void gather_knob_vals(void);
         void train_model(model::LinearModel &model);
 		void update_model(model::LinearModel &model, unsigned int num_pred, bool reset);
 		model::LinearModel* get_model_ptr(unsigned int mon_id);
-		bool check_bool_vector_nand(std::vector<bool> check_vector);
 
-		std::vector<double> dydx(model::LinearModel* y, std::vector<double> x, std::vector<double> dx);
-		int gradient_decent(model::LinearModel *opt_model, model::LinearModel *app_model, double app_min, std::vector<double> &knob_vals);
+		// Knob ranges in model predictor order, refreshed for each optimisation.
+		std::vector<double> knob_mins;
+		std::vector<double> knob_maxs;
+		std::vector<bool> knob_discrete;
+		void gather_knob_bounds(void);
+
+		int optimise_lattice(model::LinearModel *opt_model, model::LinearModel *bounding_model, double bound, std::vector<double> &knob_vals);
+		int optimise_relaxed(model::LinearModel *opt_model, model::LinearModel *bounding_model, double bound, std::vector<double> &knob_vals);
 
 	};
 }
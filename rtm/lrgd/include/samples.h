@@ -0,0 +1,88 @@
+/* This file is part of LRGD, an example RTM for the PRiME Framework.
+ *
+ * LRGD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LRGD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LRGD.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech
+ */
+
+/*---------------------------------------------------------------------------
+   samples.h - Regression Sample Store Header
+  ---------------------------------------------------------------------------
+   Author: Charles Leech
+   Email: cl19g10 [at] ecs.soton.ac.uk
+  ---------------------------------------------------------------------------*/
+#ifndef SAMPLES_H
+#define SAMPLES_H
+
+#include <vector>
+
+// Samples kept per model; the oldest is overwritten for each new one past this.
+#define MODEL_MAX_SAMPLES		256
+
+namespace prime { namespace model
+{
+	/* Training samples of every model, in one allocation.
+	 *
+	 * Each model owns a slot: a ring of samples stored column by column. The
+	 * first column is all ones for the intercept, then one column per
+	 * predictor, then the responses. The columns of a slot are a column-major
+	 * design matrix, so a solver or a batched predict reads them in place.
+	 * Rows are in slot order, not arrival order; a least squares fit does not
+	 * depend on it.
+	 *
+	 * Memory only grows when a slot is added or the number of predictors
+	 * changes, and changing the number of predictors drops every sample.
+	 */
+	class SampleStore
+	{
+	public:
+		explicit SampleStore(unsigned int capacity = MODEL_MAX_SAMPLES);
+
+		unsigned int add_slot(void);
+		void remove_slot(unsigned int slot);
+
+		unsigned int get_num_predictors(void);
+		void set_num_predictors(unsigned int num);
+
+		void clear(unsigned int slot);
+		// x holds one value per predictor.
+		void add(unsigned int slot, double y, const double *x);
+		unsigned int get_num_samples(unsigned int slot);
+
+		// Column j of the design matrix (0 is the intercept) starts at
+		// design(slot) + j * get_stride(); get_num_samples(slot) rows are valid.
+		const double *design(unsigned int slot);
+		const double *response(unsigned int slot);
+		unsigned int get_stride(void);
+
+	private:
+		struct slot_t {
+			bool used;
+			unsigned int head;		// Next row written
+			unsigned int count;
+		};
+
+		unsigned int capacity;
+		unsigned int num_predictors;
+		std::vector<slot_t> slots;
+		std::vector<double> data;
+
+		unsigned int num_columns(void);
+		double *column(unsigned int slot, unsigned int col);
+		void layout(void);
+	};
+} }
+
+#endif // SAMPLES_H
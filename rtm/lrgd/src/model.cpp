@@ -27,13 +27,18 @@
    https://www.gnu.org/software/gsl/manual/html_node/Multi_002dparameter-fitting.html
    https://rosettacode.org/wiki/Multiple_regression#C
   ---------------------------------------------------------------------------*/
+#include <algorithm>
+#include <cmath>
 #include "model.h"
 
 namespace prime { namespace model
 {
-	LinearModel::LinearModel(unsigned int id, unsigned int predictors) :
-		trained(false), id(id), num_predictors(predictors), rms_error(-1)
-	{}
+	LinearModel::LinearModel(unsigned int id, SampleStore &samples, unsigned int slot, double forgetting) :
+		trained(false), id(id), num_predictors(samples.get_num_predictors()), rms_error(-1),
+		samples(&samples), slot(slot), forgetting(forgetting), sq_error_sum(0), error_weight(0)
+	{
+		reset_estimator();
+	}
 
 	LinearModel::~LinearModel(){}
 
@@ -41,73 +46,181 @@ namespace prime { namespace model
 
 	double LinearModel::get_rms_error(void) { return rms_error;	}
 
-	unsigned int LinearModel::get_num_samples(void) { return y_vals.size(); }
+	unsigned int LinearModel::get_slot(void) { return slot; }
+
+	unsigned int LinearModel::get_num_samples(void) { return samples->get_num_samples(slot); }
 
 	unsigned int LinearModel::get_num_predictors(void) { return num_predictors; }
 
-	void LinearModel::set_num_predictors(unsigned int num) { num_predictors = num; }
+	const std::vector<double> &LinearModel::get_coefficients(void) { return coefficients; }
+
+	void LinearModel::set_num_predictors(unsigned int num)
+	{
+		num_predictors = num;
+		reset_estimator();
+	}
+
+	bool LinearModel::is_online(void) { return forgetting > 0; }
 
-	void LinearModel::add_sample(double y, std::vector<double> x)
+	void LinearModel::add_sample(double y, const double *x)
 	{
-		if(y_vals.size() > 255)
+		if(samples->get_num_predictors() != num_predictors)
+			return;
+		samples->add(slot, y, x);
+
+		std::copy(x, x + num_predictors, regressor.begin() + 1);
+		update_error(y);
+		if(is_online())
 		{
-			y_vals.erase(y_vals.begin(), y_vals.begin()+64);
-			x_vals.erase(x_vals.begin(), x_vals.begin()+64);
+			update_estimator(y);
+			if(trained)
+				std::copy(estimate.begin(), estimate.end(), coefficients.begin());
 		}
-		y_vals.push_back(y);
-		x_vals.push_back(x);
 	}
 
 	void LinearModel::clear_samples()
 	{
-		y_vals.clear();
-		x_vals.clear();
+		samples->clear(slot);
 		coefficients.clear();
+		trained = false;
 		rms_error = -1;
+		reset_estimator();
+	}
+
+	void LinearModel::reset_estimator(void)
+	{
+		unsigned int num_coeffs = num_predictors + 1;
+		normal.assign(num_coeffs * num_coeffs, 0);
+		normal_rhs.assign(num_coeffs, 0);
+		solution.assign(num_coeffs, 0);
+		estimate.assign(num_coeffs, 0);
+		covariance.assign(num_coeffs * num_coeffs, 0);
+		for(unsigned int i = 0; i < num_coeffs; i++)
+			covariance[i * num_coeffs + i] = MODEL_RLS_DELTA;
+		regressor.assign(num_coeffs, 1.0);
+		gain.assign(num_coeffs, 0);
+		sq_error_sum = 0;
+		error_weight = 0;
+	}
+
+	//recursive least squares update with the sample in regressor, O(predictors^2)
+	void LinearModel::update_estimator(double y)
+	{
+		unsigned int n = num_predictors + 1;
+		double *P = covariance.data();
+		const double *phi = regressor.data();
+
+		// gain = P.phi / (forgetting + phi'.P.phi), held unscaled in gain until the division
+		double denom = forgetting;
+		double error = y;
+		for(unsigned int i = 0; i < n; i++)
+		{
+			double sum = 0;
+			for(unsigned int j = 0; j < n; j++)
+				sum += P[i * n + j] * phi[j];
+			gain[i] = sum;
+			denom += phi[i] * sum;
+			error -= estimate[i] * phi[i];
+		}
+
+		// P = (P - P.phi.phi'.P / denom) / forgetting. While the knobs sit still P
+		// only grows, so stop discounting once it is as uncertain as the prior.
+		double trace = 0;
+		for(unsigned int i = 0; i < n; i++)
+			trace += P[i * n + i] - gain[i] * gain[i] / denom;
+		double scale = (trace < MODEL_RLS_DELTA * n) ? 1 / forgetting : 1;
+		for(unsigned int i = 0; i < n; i++)
+		{
+			// Both halves from the upper triangle so rounding cannot make P asymmetric.
+			for(unsigned int j = i; j < n; j++)
+			{
+				double val = (P[i * n + j] - gain[i] * gain[j] / denom) * scale;
+				P[i * n + j] = val;
+				P[j * n + i] = val;
+			}
+		}
+
+		for(unsigned int i = 0; i < n; i++)
+			estimate[i] += gain[i] / denom * error;
+	}
+
+	//error of the current coefficients on a sample they have not seen yet
+	void LinearModel::update_error(double y)
+	{
+		if(coefficients.size() != num_predictors + 1)
+			return;
+
+		double error = y;
+		for(unsigned int i = 0; i < coefficients.size(); i++)
+			error -= coefficients[i] * regressor[i];
+
+		double decay = is_online() ? forgetting : MODEL_ERROR_DECAY;
+		sq_error_sum = sq_error_sum * decay + error * error;
+		error_weight = error_weight * decay + 1;
+		rms_error = std::sqrt(sq_error_sum / error_weight);
 	}
 
 	//train model when enough samples are collected
 	void LinearModel::train(void)
 	{
-		unsigned int num_samples = y_vals.size();
+		// Online, the estimate is already fitted; training publishes it.
+		if(is_online())
+		{
+			coefficients = estimate;
+			trained = true;
+			return;
+		}
+
+		unsigned int num_samples = samples->get_num_samples(slot);
+		unsigned int num_coeffs = num_predictors + 1;
+		if(!num_samples || samples->get_num_predictors() != num_predictors)
+			return;
 #ifdef DEBUG_MODEL
 		//printf("MODEL: Training LR model\n");
 		//printf("MODEL: Number of predictors = %d\n", num_predictors);
 		//printf("MODEL: Number of samples = %d\n", num_samples);
 #endif // DEBUG_MODEL
 
-		gsl_matrix *X = gsl_matrix_alloc (num_samples, num_predictors+1); //allocate predictor matrix
-		gsl_vector *Y = gsl_vector_alloc (num_samples); //allocate response vector
-		gsl_vector *C = gsl_vector_alloc (num_predictors+1); //allocate coefficient vector
-		gsl_matrix *COV = gsl_matrix_alloc (num_predictors+1, num_predictors+1); //allocate covariance matrix
-		gsl_multifit_linear_workspace *work = gsl_multifit_linear_alloc (num_samples, num_predictors+1);
+		// The store's columns are X' row by row, so the solve reads the samples in place.
+		gsl_matrix_const_view Xt = gsl_matrix_const_view_array_with_tda(
+			samples->design(slot), num_coeffs, num_samples, samples->get_stride());
+		gsl_vector_const_view Y = gsl_vector_const_view_array(samples->response(slot), num_samples);
+		gsl_matrix_view XtX = gsl_matrix_view_array(normal.data(), num_coeffs, num_coeffs);
+		gsl_vector_view XtY = gsl_vector_view_array(normal_rhs.data(), num_coeffs);
+		gsl_vector_view C = gsl_vector_view_array(solution.data(), num_coeffs);
+
+		gsl_blas_dsyrk(CblasLower, CblasNoTrans, 1.0, &Xt.matrix, 0.0, &XtX.matrix);
+		gsl_blas_dgemv(CblasNoTrans, 1.0, &Xt.matrix, &Y.vector, 0.0, &XtY.vector);
 
-		for(unsigned int n = 0;  n < num_samples; n++)
+		double trace = 0;
+		for(unsigned int i = 0; i < num_coeffs; i++)
+			trace += normal[i * num_coeffs + i];
+		double ridge = MODEL_RIDGE * trace / num_coeffs;
+		for(unsigned int i = 0; i < num_coeffs; i++)
+		{
+			normal[i * num_coeffs + i] += ridge;
+			for(unsigned int j = 0; j < i; j++)
+				normal[j * num_coeffs + i] = normal[i * num_coeffs + j];
+		}
+
+		// Samples that do not span every predictor, e.g. a knob that never moved, can leave the
+		// matrix short of positive definite. GSL's default handler would abort the RTM for
+		// that, so check the status instead and keep the coefficients already fitted.
+		gsl_error_handler_t *handler = gsl_set_error_handler_off();
+		int status = gsl_linalg_cholesky_decomp(&XtX.matrix);
+		if(status == GSL_SUCCESS)
+			status = gsl_linalg_cholesky_solve(&XtX.matrix, &XtY.vector, &C.vector);
+		gsl_set_error_handler(handler);
+		if(status != GSL_SUCCESS)
 		{
-			gsl_matrix_set (X, n, 0, 1.0);
-			for(unsigned int j = 0;  j < num_predictors; j++)
-			{
-#ifdef DEBUG_MODEL
-				//printf("MODEL: x[%d] = %f\n", j, x_vals[n][j]);
-#endif // DEBUG_MODEL
-				gsl_matrix_set (X, n, j+1, x_vals[n][j]);  // set predictor vector values
-			}
 #ifdef DEBUG_MODEL
-			//printf("MODEL:y = %f\n", y_vals[n]);
+			std::cout << "MODEL: Linear model " << id << " not retrained: " << gsl_strerror(status) << std::endl;
 #endif // DEBUG_MODEL
-			gsl_vector_set (Y, n, y_vals[n]);  // set response vector values
+			return;
 		}
 
-		double chisq;
-		gsl_multifit_linear (X, Y, C, COV, &chisq, work);
-
-
 		//coefficients_m.lock();
-		coefficients.clear();
-		for(unsigned int j = 0;  j < num_predictors + 1; j++)
-		{
-			coefficients.push_back(gsl_vector_get(C,j));
-		}
+		coefficients = solution;
 		//coefficients_m.unlock();
 
 #ifdef DEBUG_MODEL
@@ -119,18 +232,12 @@ namespace prime { namespace model
 		std::cout << std::endl;
 #endif // DEBUG_MODEL
 
-		gsl_matrix_free (X);
-		gsl_vector_free (Y);
-		gsl_vector_free (C);
-		gsl_matrix_free (COV);
-		gsl_multifit_linear_free (work);
-
 		//enhancement: added test to calc rms_error
 		trained = true;
 		return;
 	}
 
-	int LinearModel::predict(std::vector<double> x, double *pred_val)
+	int LinearModel::predict(const std::vector<double> &x, double *pred_val)
 	{
 		if(coefficients.size() != x.size()+1)
 			return -1;
@@ -142,9 +249,26 @@ namespace prime { namespace model
 		return 0;
 	}
 
+	int LinearModel::predict(const double *x, unsigned int stride, unsigned int count, double *pred_vals)
+	{
+		if(coefficients.size() != num_predictors + 1)
+			return -1;
+
+		// One predictor at a time over every candidate, so the inner loop runs along a column.
+		std::fill(pred_vals, pred_vals + count, coefficients[0]);
+		for(unsigned int j = 0; j < num_predictors; j++)
+		{
+			const double c = coefficients[j + 1];
+			const double *col = x + (std::size_t)j * stride;
+			for(unsigned int i = 0; i < count; i++)
+				pred_vals[i] += c * col[i];
+		}
+		return 0;
+	}
+
+	//kept up to date by add_sample
 	double LinearModel::calc_rms_error(void)
 	{
-		//TODO: calcuate rms error
 		return rms_error;
 	}
 } }
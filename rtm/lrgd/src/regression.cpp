@@ -55,33 +55,44 @@ namespace prime
 
 	void regression::add_app_model(unsigned int mon_id)
 	{
-		models.push_back(model::LinearModel(mon_id, num_knobs));
+		models.push_back(model::LinearModel(mon_id, samples, samples.add_slot(), LRGD_FORGETTING));
 		num_monitors++;
     }
 
 	void regression::add_dev_model(unsigned int mon_id)//, prime::api::dev::mon_type_t mon_type)
 	{
-		models.push_back(model::LinearModel(mon_id, num_knobs));
+		models.push_back(model::LinearModel(mon_id, samples, samples.add_slot(), LRGD_FORGETTING));
 		num_monitors++;
     }
 
 	void regression::remove_app_model(unsigned int mon_id)
 	{
 		models.erase(std::remove_if(models.begin(), models.end(),
-				[=](model::LinearModel model){return model.get_id() == mon_id;}),
+				[=](model::LinearModel &model){
+					if(model.get_id() != mon_id)
+						return false;
+					samples.remove_slot(model.get_slot());
+					return true;
+				}),
 			models.end());
     }
 
 	void regression::remove_dev_model(unsigned int mon_id)//, prime::api::dev::mon_type_t mon_type)
 	{
 		models.erase(std::remove_if(models.begin(), models.end(),
-				[=](model::LinearModel model){return model.get_id() == mon_id;}),
+				[=](model::LinearModel &model){
+					if(model.get_id() != mon_id)
+						return false;
+					samples.remove_slot(model.get_slot());
+					return true;
+				}),
 			models.end());
     }
 
 	void regression::add_knob(void)
 	{
 		num_knobs++;
+		samples.set_num_predictors(num_knobs);
 		for(auto &model : models)
 			update_model(model, num_knobs, true);
     }
@@ -103,22 +114,19 @@ namespace prime
 		{
 			if(model.get_id() == mon_id)
 			{
-				std::vector<double> knob_vals;
-				for(auto knob : app_knobs_disc){ knob_vals.push_back((double)knob.val);	}
-				for(auto knob : app_knobs_cont){ knob_vals.push_back((double)knob.val);	}
-				for(auto knob : dev_knobs_disc){ knob_vals.push_back((double)knob.val);	}
-				for(auto knob : dev_knobs_cont){ knob_vals.push_back((double)knob.val);	}
+				gather_knob_vals();
 
 #ifdef DEBUG_RTM
 				if(mon_id){
 					std::cout << "LRGD: Knob vals: ";
-					for(auto kv : knob_vals)
+					for(auto kv : curr_knob_vals)
 						std::cout << kv << ", ";
 					std::cout <<  std::endl;
 				}
 #endif //DEBUG_RTM
 				//models_m.lock();
-				model.add_sample((double)mon_val, knob_vals);
+				if(curr_knob_vals.size() == model.get_num_predictors())
+					model.add_sample((double)mon_val, curr_knob_vals.data());
 				//models_m.unlock();
 
 				int curr_samples = model.get_num_samples();
@@ -126,7 +134,12 @@ namespace prime
 				if(mon_id)
 					std::cout << "LRGD: Current number of samples = " << curr_samples << std::endl;
 #endif //DEBUG_RTM
-				if((!(curr_samples % min_samples) && curr_samples > 0) && !stop_training){
+				if(model.is_online()){
+					// Updated by every sample; only the first fit needs publishing.
+					if(!model.trained && curr_samples >= (int)min_samples && !stop_training)
+						train_model(model);
+				}
+				else if((!(curr_samples % min_samples) && curr_samples > 0) && !stop_training){
 					train_model(model);
 				}
 				return;
@@ -134,6 +147,16 @@ namespace prime
 		}
     }
 
+	//clear() keeps the capacity, so this only allocates when a knob is added
+	void regression::gather_knob_vals(void)
+	{
+		curr_knob_vals.clear();
+		for(auto& knob : app_knobs_disc){ curr_knob_vals.push_back((double)knob.val);	}
+		for(auto& knob : app_knobs_cont){ curr_knob_vals.push_back((double)knob.val);	}
+		for(auto& knob : dev_knobs_disc){ curr_knob_vals.push_back((double)knob.val);	}
+		for(auto& knob : dev_knobs_cont){ curr_knob_vals.push_back((double)knob.val);	}
+	}
+
     void regression::train_model(model::LinearModel &model)
 	{
         auto start_time = util::get_timestamp();
@@ -152,15 +175,6 @@ namespace prime
 	//call when mon val updated by app
 	void regression::check_app_mon_cont_bounds(prime::api::app::mon_cont_t app_mon)	{}
 
-	//test whether all elements are false
-	bool regression::check_bool_vector_nand(std::vector<bool> check_vector)
-	{
-		bool check_sum = true;
-		for(auto elem : check_vector)
-			check_sum &= elem;
-		return !check_sum;
-	}
-
 	model::LinearModel* regression::get_model_ptr(unsigned int mon_id)
 	{
 		for(auto &model : models)
@@ -192,432 +206,179 @@ namespace prime
 			return -1;
 		}
 
-		//do gradient decent
-#ifdef DEBUG_RTM
-		std::cout << "LRGD: Performing gradient descent..." << std::endl;
-#endif //DEBUG_RTM
-		return gradient_decent(opt_model, bounding_model, bound_mon_min, knob_vals);
-	}
-
-	//find rate of change of app mon wrt knobs
-	//r-code: c(fy(x+dx[,1])-fy(x),fy(x+dx[,2])-fy(x))/diag(dx)
-	std::vector<double> regression::dydx(model::LinearModel* y, std::vector<double> x, std::vector<double> dx)
-	{
-		if(y->get_num_predictors() != x.size()){
+		if(opt_model->get_num_predictors() != num_knobs || bounding_model->get_num_predictors() != num_knobs){
 			std::cout << "LRGD: INFO: Number of model predictors does not match number of knobs" << std::endl;
+			return -1;
 		}
 
-		std::vector<double> fy;
-		std::vector<double> x_dx(x);
-		double fy_dx, fy_x;
-		for(unsigned int i = 0; i < x.size(); i++)
-		{
-			x_dx[i] = x[i] - dx[i];
-
-			y->predict(x, &fy_x);
-			y->predict(x_dx, &fy_dx);
-
-			//fy.push_back((fy_dx - fy_x)/dx[i]);  //fy(x+dx[,1])-fy(x)
-			fy.push_back((fy_x - fy_dx)/dx[i]);  //fy(x+dx[,1])-fy(x)
+		gather_knob_bounds();
+		unsigned long long lattice_size = 1;
+		for(unsigned int j = 0; j < num_knobs && lattice_size <= LRGD_MAX_LATTICE; j++){
+			if(!knob_discrete[j])
+				lattice_size = LRGD_MAX_LATTICE + 1;
+			else
+				lattice_size *= (unsigned long long)(knob_maxs[j] - knob_mins[j] + 1);
+		}
 
+		int ret;
+		if(lattice_size <= LRGD_MAX_LATTICE){
 #ifdef DEBUG_RTM
-			std::cout << "LRGD: x[" << i << "] = " << x[i] << ", x_dx[" << i << "] = " << x_dx[i] << std::endl;
-			std::cout << "LRGD: fy_dx = " << fy_dx << ", fy_x = " << fy_x << std::endl;
-			std::cout << "LRGD: fy[" << i << "] = " << fy[i] << std::endl << std::endl;
-#endif // DEBUG_RTM
-
-			x_dx[i] += dx[i];
-		}
-		if(fy.size() != x.size()){
-			std::cout << "LRGD: INFO: number of dydx predicted values does not match number of knobs" << std::endl;
+			std::cout << "LRGD: Searching " << lattice_size << " knob settings..." << std::endl;
+#endif //DEBUG_RTM
+			ret = optimise_lattice(opt_model, bounding_model, bound_mon_min, knob_vals);
+		} else {
+#ifdef DEBUG_RTM
+			std::cout << "LRGD: Solving relaxed knob settings..." << std::endl;
+#endif //DEBUG_RTM
+			ret = optimise_relaxed(opt_model, bounding_model, bound_mon_min, knob_vals);
 		}
-		return fy;
-	}
-
-	//gradient decent loop - return a set of knob values that meet the bounds of an app monitor and optimise a device monitor
-	//knobs set in regression class
-	int regression::gradient_decent(model::LinearModel *opt_model, model::LinearModel *bounding_model, double bound, std::vector<double> &knob_vals)
-	{
-		std::vector<double> knob_mins;
-		std::vector<double> knob_maxs;
 
-		for(auto knob : app_knobs_disc){
-			knob_mins.push_back(knob.min);
-			knob_maxs.push_back(knob.max);
-		}
-		for(auto knob : app_knobs_cont){
-			knob_mins.push_back(knob.min);
-			knob_maxs.push_back(knob.max);
-		}
-		for(auto knob : dev_knobs_disc){
-			knob_mins.push_back(knob.min);
-			knob_maxs.push_back(knob.max);
-		}
-		for(auto knob : dev_knobs_cont){
-			knob_mins.push_back(knob.min);
-			knob_maxs.push_back(knob.max);
-		}
-		//initialise knob values to their minimum
-		knob_vals = std::vector<double>(knob_maxs);// x = c(0,0);
-
-		double app_kv_max, app_kv;
-		bounding_model->predict(knob_maxs, &app_kv_max);
-		bounding_model->predict(knob_mins, &app_kv);
-		std::vector<double> alpha(knob_vals.size(),100); // a=(pred_perf(x+1)-pred_perf(x))/2;
-		double beta = 0.5;
 		double opt_mon_val, bound_mon_val;
-
-		std::vector<double> prev_dpdx (knob_vals.size(),1);
-		std::vector<double> dpdx (knob_vals.size(),0);
-		std::vector<double> xn(knob_vals.size(), 0);
-		std::vector<bool> kv_done(knob_vals.size(), false);
-
-		std::vector<double> dx (knob_vals.size(), 1.0); // dx= matrix(c(1e-3,0,0,1e-3),nrow=2,ncol=2);
-		for(unsigned int dx_idx = 0; dx_idx < dx.size(); dx_idx++)
-		{
-			dx[dx_idx] = (knob_maxs[dx_idx] - knob_mins[dx_idx])/1e3; //emulating dx= matrix(c(1e-3,0,0,1e-3),nrow=2,ncol=2);
+		opt_model->predict(knob_vals, &opt_mon_val);
+		bounding_model->predict(knob_vals, &bound_mon_val);
+		std::cout << "LRGD: Optimised Monitor Value = " << opt_mon_val << ", Bounding Monitor Value = " << bound_mon_val << std::endl;
+		std::cout << "LRGD: Optimal Knob Values: ";
+		int idx = 0;
+		for(auto val : knob_vals){
+			std::cout << "x[" <<idx << "]: " << val << ", ";
+			idx++;
 		}
+		std::cout << std::endl;
+		return ret;
+	}
 
-		std::vector<double> bound_mon_steps, opt_mon_steps;//, alpha_steps; //y1_lst=NULL, pwr_lst=NULL
-		std::vector<std::vector<double> > knob_vals_steps; //xc_lst=NULL; xf_lst=NULL;
+	void regression::gather_knob_bounds(void)
+	{
+		knob_mins.clear();
+		knob_maxs.clear();
+		knob_discrete.clear();
+		for(auto& knob : app_knobs_disc){ knob_mins.push_back(knob.min); knob_maxs.push_back(knob.max); knob_discrete.push_back(true); }
+		for(auto& knob : app_knobs_cont){ knob_mins.push_back(knob.min); knob_maxs.push_back(knob.max); knob_discrete.push_back(false); }
+		for(auto& knob : dev_knobs_disc){ knob_mins.push_back(knob.min); knob_maxs.push_back(knob.max); knob_discrete.push_back(true); }
+		for(auto& knob : dev_knobs_cont){ knob_mins.push_back(knob.min); knob_maxs.push_back(knob.max); knob_discrete.push_back(false); }
+	}
 
-		while(check_bool_vector_nand(kv_done))
+	//score every discrete knob setting, a batch at a time - exact, at most LRGD_MAX_LATTICE candidates
+	int regression::optimise_lattice(model::LinearModel *opt_model, model::LinearModel *bounding_model, double bound, std::vector<double> &knob_vals)
+	{
+		std::vector<double> candidates((std::size_t)num_knobs * LRGD_BATCH_SIZE);
+		std::vector<double> opt_vals(LRGD_BATCH_SIZE), bound_vals(LRGD_BATCH_SIZE);
+		std::vector<double> setting(knob_mins);
+		std::vector<double> best_feasible, best_bound;
+		double best_opt = std::numeric_limits<double>::max();
+		double max_bound = -std::numeric_limits<double>::max();
+		double max_bound_opt = 0;
+		bool done = false;
+
+		auto copy_candidate = [&](unsigned int i, std::vector<double> &dest){
+			dest.resize(num_knobs);
+			for(unsigned int j = 0; j < num_knobs; j++)
+				dest[j] = candidates[(std::size_t)j * LRGD_BATCH_SIZE + i];
+		};
+
+		while(!done)
 		{
-			//dpdx = dydx(bounding_model, knob_vals, dx); //dpdx = dydx(pred_perf,x,dx)
-			dpdx = dydx(opt_model, knob_vals, dx); //dpdx = dydx(pred_pwr,x,dx)
-
-#ifdef DEBUG_RTM
-			std::cout << "LRGD: alpha: ";
-			for(auto a_xn : alpha){
-				std::cout << a_xn << ", ";
-			}
-			std::cout << std::endl;
-			std::cout << "LRGD: dpdx: ";
-			for(auto idx : dpdx){
-				std::cout << idx << ", "; // print(dpdx)
+			//fill a batch column by column, counting through the lattice with the first knob fastest
+			unsigned int count = 0;
+			for(; count < LRGD_BATCH_SIZE && !done; count++){
+				for(unsigned int j = 0; j < num_knobs; j++)
+					candidates[(std::size_t)j * LRGD_BATCH_SIZE + count] = setting[j];
+				unsigned int j = 0;
+				for(; j < num_knobs; j++){
+					if(++setting[j] <= knob_maxs[j])
+						break;
+					setting[j] = knob_mins[j];
+				}
+				done = (j == num_knobs);
 			}
-			std::cout << std::endl;
-#endif // DEBUG_RTM
 
-			if(bounding_model->predict(knob_vals, &bound_mon_val))
-				std::cout << "LRGD: Bound model prediction error" << std::endl;
-#ifdef DEBUG_RTM
-			else
-				std::cout << "LRGD: Max bounding_model value = " << bound_mon_val << std::endl;
-#endif // DEBUG_RTM
+			opt_model->predict(candidates.data(), LRGD_BATCH_SIZE, count, opt_vals.data());
+			bounding_model->predict(candidates.data(), LRGD_BATCH_SIZE, count, bound_vals.data());
 
-			if(bound_mon_val < bound)
-				break; // Max knobs still doesn't meet bound - nothing can be done!
-
-			while(check_bool_vector_nand(kv_done))
-			{
-					for(unsigned int kvs_idx = 0; kvs_idx < knob_vals.size(); kvs_idx++)
-					{
-						//xn = x+dpdx*alpha
-						//xn[kvs_idx] = knob_vals[kvs_idx] + (dpdx[kvs_idx] * alpha);
-						// all(xn>0&xn<1) // check knob's val is in its bounds
-						//knob_bounds_met = knob_bounds_met && ((knob_mins[kvs_idx] <= xn[kvs_idx]) && (knob_maxs[kvs_idx] >= xn[kvs_idx]));
-						if(!kv_done[kvs_idx])
-						{
-							xn[kvs_idx] = knob_vals[kvs_idx] - abs(dpdx[kvs_idx] * alpha[kvs_idx]); // increment knob x
-
-							while((knob_mins[kvs_idx] > xn[kvs_idx]) || (knob_maxs[kvs_idx] < xn[kvs_idx])) //check knob bound
-							{
-								alpha[kvs_idx] = alpha[kvs_idx] * beta;	//if outside bounds, reduce step size
-								xn[kvs_idx] = knob_vals[kvs_idx] - abs(dpdx[kvs_idx] * alpha[kvs_idx]); //and reduce xn
-							}
-
-							if(xn[kvs_idx] - knob_vals[kvs_idx] == 0) //if alpha has not diminished
-							{
-								kv_done[kvs_idx] = true;
-#ifdef DEBUG_RTM
-								std::cout << "LRGD: kvs_idx " << kvs_idx << " done." << std::endl;
-#endif // DEBUG_RTM
-							}
-						}
+			for(unsigned int i = 0; i < count; i++){
+				if(bound_vals[i] >= bound){
+					if(opt_vals[i] < best_opt){
+						best_opt = opt_vals[i];
+						copy_candidate(i, best_feasible);
 					}
-#ifdef DEBUG_RTM
-				std::cout << "LRGD: xn: ";
-				for(unsigned int kvs_idx = 0; kvs_idx < knob_vals.size(); kvs_idx++){
-					std::cout << xn[kvs_idx] << ", "; //print(xn)
-				}
-				std::cout << std::endl;
-#endif // DEBUG_RTM
-
-				if(bounding_model->predict(xn, &bound_mon_val)){
-					std::cout << "LRGD: INFO: Cannot make model prediction." << std::endl;
 				}
-				if(bound_mon_val > bound){
-					knob_vals = xn;
-					break;
+				else if(best_feasible.empty() &&
+					(bound_vals[i] > max_bound || (bound_vals[i] == max_bound && opt_vals[i] < max_bound_opt))){
+					max_bound = bound_vals[i];
+					max_bound_opt = opt_vals[i];
+					copy_candidate(i, best_bound);
 				}
-				for(auto& a_xn : alpha){
-					a_xn = a_xn * beta; //shrink step size
-				}
-#ifdef DEBUG_RTM
-					std::cout << "LRGD: bound_mon_val = " << bound_mon_val << std::endl;
-					std::cout << "LRGD: bound = " << bound << std::endl;
-					for(auto& a_xn : alpha) std::cout << "LRGD: alpha = " << a_xn << std::endl;
-#endif // DEBUG_RTM
-			}
-			for(unsigned int idx = 0; idx < prev_dpdx.size(); idx++)
-			{
-				if((prev_dpdx[idx] * dpdx[idx]) < 0)
-					alpha[idx] = alpha[idx] * beta; //shrink step size
 			}
-			prev_dpdx = dpdx;
 		}
-//		if(!bound_mon_steps.size()){
-//#ifdef DEBUG_RTM
-//			if(opt_model->predict(xn, &bound_mon_val)){
-//				std::cout << "LRGD: INFO: Cannot make model prediction." << std::endl;
-//			}
-//			std::cout << "LRGD: Optimisation Result not Found - setting maximum knob values." << std::endl;
-//			std::cout << "LRGD: Optimised Monitor Value = " << opt_mon_val << ", Bounding Monitor Value = " << bound_mon_val << std::endl;
-//			std::cout << "LRGD: Optimal Knob Values: ";
-//			int idx = 0;
-//			for(auto val : knob_vals){
-//				std::cout << "x[" << idx << "]: " << val << ", ";
-//				idx++;
-//			}
-//			std::cout << std::endl;
-//#endif // DEBUG_RTM
-//			return -1;
-//		}
-//		else{
-//#ifdef DEBUG_RTM
-			//std::cout << "LRGD: Optimisation Result Found:" << std::endl;
-			std::cout << "LRGD: Optimised Monitor Value = " << opt_mon_val << ", Bounding Monitor Value = " << bound_mon_val << std::endl;
-			std::cout << "LRGD: Optimal Knob Values: ";
-			int idx = 0;
-			for(auto val : knob_vals){
-				std::cout << "x[" <<idx << "]: " << val << ", ";
-				idx++;
-			}
-			std::cout << std::endl;
-			return 0;
-//#endif // DEBUG_RTM
-//		}
+
+		if(best_feasible.size()){
+			knob_vals = best_feasible;
+		} else {
+			// No setting meets the bound - get as close to it as the knobs allow.
+			std::cout << "LRGD: INFO: No knob setting meets the bound, using the closest." << std::endl;
+			knob_vals = best_bound;
+		}
+		return 0;
 	}
 
-	//gradient ascent loop - return a set of knob values that meet the bounds of an app monitor and optimise a device monitor
-	//knobs set in regression class
-//	int regression::gradient_ascent(model::LinearModel *opt_model, model::LinearModel *bounding_model, double bound, std::vector<double> &knob_vals)
-//	{
-//		std::vector<double> knob_mins;
-//		std::vector<double> knob_maxs;
-//
-//		for(auto knob : app_knobs_disc){
-//			knob_mins.push_back(knob.min);
-//			knob_maxs.push_back(knob.max);
-//		}
-//		for(auto knob : app_knobs_cont){
-//			knob_mins.push_back(knob.min);
-//			knob_maxs.push_back(knob.max);
-//		}
-//		for(auto knob : dev_knobs_disc){
-//			knob_mins.push_back(knob.min);
-//			knob_maxs.push_back(knob.max);
-//		}
-//		for(auto knob : dev_knobs_cont){
-//			knob_mins.push_back(knob.min);
-//			knob_maxs.push_back(knob.max);
-//		}
-//		//initialise knob values to their minimum
-//		knob_vals = std::vector<double>(knob_mins);// x = c(0,0);
-//
-//		double app_kv_max, app_kv;
-//		bounding_model->predict(knob_maxs, &app_kv_max);
-//		bounding_model->predict(knob_vals, &app_kv);
-//		std::vector<double> alpha(knob_vals.size(),(app_kv_max - app_kv)/10); // a=(pred_perf(x+1)-pred_perf(x))/2;
-//		double beta = 0.5;
-//		double conv = 1e-3; // conv=c(1e-3,1e-3);
-//		double opt_mon_val, bound_mon_val;
-//		bool done = false;
-//
-//		std::vector<double> prev_dpdx (knob_vals.size(),1);
-//		std::vector<double> dpdx (knob_vals.size(),0);
-//		std::vector<double> xn(knob_vals.size(), 0);
-//
-//		std::vector<double> dx (knob_vals.size(), 1.0); // dx= matrix(c(1e-3,0,0,1e-3),nrow=2,ncol=2);
-//		for(unsigned int dx_idx = 0; dx_idx < dx.size(); dx_idx++)
-//		{
-//			dx[dx_idx] = (knob_maxs[dx_idx] - knob_mins[dx_idx])/1e3; //emulating dx= matrix(c(1e-3,0,0,1e-3),nrow=2,ncol=2);
-//#ifdef DEBUG_RTM
-////			std::cout << "dx[" << dx_idx << "]: " << dx[dx_idx] << ", ";
-//#endif // DEBUG_RTM
-//		}
-//#ifdef DEBUG_RTM
-//		std::cout << std::endl;
-//#endif // DEBUG_RTM
-//
-//		std::vector<double> bound_mon_steps, opt_mon_steps;//, alpha_steps; //y1_lst=NULL, pwr_lst=NULL
-//		std::vector<std::vector<double> > knob_vals_steps; //xc_lst=NULL; xf_lst=NULL;
-//
-//		while(1)
-//		{
-//			dpdx = dydx(bounding_model, knob_vals, dx); //dpdx = dydx(pred_perf,x,dx)
-//			//dpdx = dydx(opt_model, knob_vals, dx); //dpdx = dydx(pred_pwr,x,dx)
-//
-//			for(auto idx : dpdx){
-//				if(idx < 0){
-//					std::cout << "LRGD: INFO: Negative gradient in model" << std::endl;
-//					std::cout << "LRGD: INFO: Retraining model and waiting for more training samples to improve the model." << std::endl;
-//					update_model(*bounding_model, num_knobs, true);
-//					return -1;
-//				}
-//			}
-//
-//#ifdef DEBUG_RTM
-//			std::cout << "LRGD: alpha = " << alpha[0] << std::endl;
-//			std::cout << "LRGD: dpdx: ";
-//			for(auto idx : dpdx){
-//				std::cout << idx << ", "; // print(dpdx)
-//			}
-//			std::cout << std::endl;
-//#endif // DEBUG_RTM
-//
-//			if(opt_model->predict(knob_vals, &opt_mon_val))
-//				std::cout << "LRGD: Opt model prediction error" << std::endl;
-//			if(bounding_model->predict(knob_vals, &bound_mon_val))
-//				std::cout << "LRGD: Bound model prediction error" << std::endl;
-//
-//			while(1)
-//			{
-//				//bool knob_bounds_met = false;
-//				//while(!knob_bounds_met)
-//				//{
-//					//knob_bounds_met = true;
-//					for(unsigned int kvs_idx = 0; kvs_idx < knob_vals.size(); kvs_idx++)
-//					{
-//						//xn = x+dpdx*alpha
-//						//xn[kvs_idx] = knob_vals[kvs_idx] + (dpdx[kvs_idx] * alpha);
-//						// all(xn>0&xn<1) // check knob's val is in its bounds
-//						//knob_bounds_met = knob_bounds_met && ((knob_mins[kvs_idx] <= xn[kvs_idx]) && (knob_maxs[kvs_idx] >= xn[kvs_idx]));
-//						if(xn[kvs_idx] - knob_vals[kvs_idx]) //if alpha has not diminished
-//						{
-//							xn[kvs_idx] = knob_vals[kvs_idx] + (dpdx[kvs_idx] * alpha[kvs_idx]); // increment knob x
-//
-//							while((knob_mins[kvs_idx] > xn[kvs_idx]) && (knob_maxs[kvs_idx] < xn[kvs_idx])) //check knob bound
-//							{
-//								alpha[kvs_idx] = alpha[kvs_idx] * beta;	//if outside bounds, reduce step size
-//								xn[kvs_idx] = knob_vals[kvs_idx] + (dpdx[kvs_idx] * alpha[kvs_idx]); //and reduce xn
-//							}
-//						}
-//					}
-//					//if(!knob_bounds_met){
-//					//	alpha = alpha * beta; //shrink learning rate if xn is out of range
-//					//}
-//				//}
-//#ifdef DEBUG_RTM
-//				for(unsigned int kvs_idx = 0; kvs_idx < knob_vals.size(); kvs_idx++){
-//					std::cout << "LRGD: xn[" << kvs_idx << "] = " << xn[kvs_idx] << std::endl; //print(xn)
-//				}
-//#endif // DEBUG_RTM
-//				bool knobs_conv = true;
-//				for(unsigned int kvs_idx = 0; kvs_idx < knob_vals.size(); kvs_idx++)
-//				{
-//					//all(abs(xn-x)<conv)
-//					knobs_conv = knobs_conv && (std::fabs(xn[kvs_idx] - knob_vals[kvs_idx]) < conv);
-//				}
-//				if(knobs_conv){
-//#ifdef DEBUG_RTM
-//					std::cout << "LRGD: Convergence criterion met" << std::endl;
-//#endif // DEBUG_RTM
-//					done = true;
-//					break; //all delta x within convergence threshold - finished
-//				}
-//				if(bounding_model->predict(xn, &bound_mon_val))
-//					std::cout << "LRGD: INFO: Cannot make model prediction." << std::endl;
-//
-//				if(bound_mon_val > bound){
-//					//alpha = alpha * beta;
-//					for(auto& a_xn : alpha){
-//						a_xn = a_xn * beta; //shrink learning rate if perf is greater than perf_req (make step towards it but don't overshoot)
-//					}
-//#ifdef DEBUG_RTM
-//					std::cout << "LRGD: bound_mon_val = " << bound_mon_val << std::endl;
-//					std::cout << "LRGD: bound = " << bound << std::endl;
-//					for(a_xn : alpha) std::cout << "LRGD: alpha = " << a_xn << std::endl;
-//#endif // DEBUG_RTM
-//				}
-//				else {
-//					//alpha_steps.push_back(alpha);
-//
-//					opt_model->predict(knob_vals, &opt_mon_val);
-//					opt_mon_steps.push_back(opt_mon_val); // pwr_lst=c(pwr_lst,pwr)
-//
-//					bounding_model->predict(knob_vals, &bound_mon_val);
-//					bound_mon_steps.push_back(bound_mon_val); // perf_lst=c(perf_lst,perf)
-//
-//					knob_vals_steps.push_back(knob_vals); // xf_lst = c(xf_lst, x[1]);	xc_lst = c(xc_lst, x[2]);
-//					knob_vals = xn;
-//#ifdef DEBUG_RTM
-//					std::cout << "LRGD: Opt Mon Val   = " << opt_mon_val << std::endl;
-//					std::cout << "LRGD: Bound Mon Val = " << bound_mon_val << std::endl;
-//					std::cout << "LRGD: knob vals: ";
-//					for(auto val : knob_vals)
-//					{
-//						std::cout << val << ", ";
-//					}
-//					std::cout << std::endl;
-//#endif // DEBUG_RTM
-//					break;
-//				}
-//			}
-//			double vec_sum = 0;
-//			for(unsigned int idx = 0; idx < prev_dpdx.size(); idx++){
-//				vec_sum += prev_dpdx[idx] * dpdx[idx];
-//			}
-//			if(vec_sum < 0) {
-//				//alpha = alpha * beta;
-//				for(auto& a_xn : alpha){
-//					a_xn = a_xn * beta;
-//				}
-//			}
-//			prev_dpdx = dpdx;
-//			if(done)
-//				break;
-//		}
-//		if(!bound_mon_steps.size()){
-//#ifdef DEBUG_RTM
-//			std::cout << "LRGD: Optimisation Result not Found - setting minimum knob values." << std::endl;
-//			std::cout << "LRGD: Optimised Monitor Value = " << opt_mon_val << ", Bounding Monitor Value = " << bound_mon_val << std::endl;
-//			knob_vals = knob_mins;
-//#endif // DEBUG_RTM
-//			return -1;
-//		}
-//		else{
-////#ifdef DEBUG_RTM
-//			//std::cout << "LRGD: Optimisation Result Found:" << std::endl;
-//			std::cout << "LRGD: Optimised Monitor Value = " << opt_mon_val << ", Bounding Monitor Value = " << bound_mon_val << std::endl;
-//
-//			int idx = 0;
-//			std::cout << "LRGD: Optimal Knob Values: ";
-//			for(auto val : knob_vals){
-//				std::cout << "x[" <<idx << "]: " << val << ", ";
-//				idx++;
-//			}
-//			std::cout << std::endl;
-//			return 0;
-////#endif // DEBUG_RTM
-//		}
-//	}
-//
+	/* Linear program over the knob ranges: minimise c.x subject to b.x >= bound.
+	 * Each knob starts at whichever end of its range costs least. While the
+	 * bound is not met, knobs move towards the end that raises b.x, cheapest
+	 * cost per unit of bound first, and only the last one moved stops short.
+	 * Discrete knobs stop at the next whole value that meets the bound.
+	 * O(knobs log knobs).
+	 */
+	int regression::optimise_relaxed(model::LinearModel *opt_model, model::LinearModel *bounding_model, double bound, std::vector<double> &knob_vals)
+	{
+		const std::vector<double> &c = opt_model->get_coefficients();
+		const std::vector<double> &b = bounding_model->get_coefficients();
+
+		knob_vals.resize(num_knobs);
+		double bound_val = b[0];
+		std::vector<unsigned int> moves;
+		for(unsigned int j = 0; j < num_knobs; j++){
+			if(c[j + 1] > 0 || (c[j + 1] == 0 && b[j + 1] < 0))
+				knob_vals[j] = knob_mins[j];
+			else
+				knob_vals[j] = knob_maxs[j];
+			bound_val += b[j + 1] * knob_vals[j];
+			// Moving raises the bound and, as the knob started at its cheapest end, costs.
+			if((b[j + 1] > 0 && knob_vals[j] < knob_maxs[j]) || (b[j + 1] < 0 && knob_vals[j] > knob_mins[j]))
+				moves.push_back(j);
+		}
+
+		std::sort(moves.begin(), moves.end(), [&](unsigned int x, unsigned int y){
+			return c[x + 1] / b[x + 1] < c[y + 1] / b[y + 1];
+		});
+
+		for(auto j : moves){
+			if(bound_val >= bound)
+				break;
+			double gain = std::fabs(b[j + 1]);
+			double range = knob_maxs[j] - knob_mins[j];
+			double step = std::min((bound - bound_val) / gain, range);
+			if(knob_discrete[j])
+				step = std::min(std::ceil(step), range);
+			knob_vals[j] += (b[j + 1] > 0) ? step : -step;
+			bound_val += gain * step;
+		}
+
+		if(bound_val < bound){
+			// Every knob is at the end that raises the bound - nothing more can be done.
+			std::cout << "LRGD: INFO: No knob setting meets the bound, using the closest." << std::endl;
+		}
+		return 0;
+	}
 
 	int regression::predict_mon(unsigned int mon_id, double *pred_val)
 	{
-		for(auto model : models)
+		for(auto &model : models)
 		{
 			if(model.get_id() == mon_id)
 			{
-				std::vector<double> knob_vals;
-				for(auto knob : app_knobs_disc){ knob_vals.push_back(knob.val);	}
-				for(auto knob : app_knobs_cont){ knob_vals.push_back(knob.val);	}
-				for(auto knob : dev_knobs_disc){ knob_vals.push_back(knob.val);	}
-				for(auto knob : dev_knobs_cont){ knob_vals.push_back(knob.val);	}
+				gather_knob_vals();
 
-				if(model.predict(knob_vals, pred_val)){
+				if(model.predict(curr_knob_vals, pred_val)){
 					return -1;
 				} else {
 					return 0;
@@ -32,6 +32,7 @@
 #include "uds.h"
 #include "util.h"
 #include "prime_api_rtm.h"
+#include "rtm_executor.h"
 #include "rtm_arch_utils.h"
 #include "args/args.hxx"
 #include "regression.h"
@@ -114,9 +115,14 @@ namespace prime
 		std::mutex ui_rtm_stop_m;
 		std::condition_variable ui_rtm_stop_cv;
 
+		// Guards rtm_lr, the app_knobs_*_par vectors it reads by reference, and
+		// app_models_trained. Taken before any of the app knob or monitor mutexes.
+		std::mutex rtm_lr_m;
 		prime::regression rtm_lr;
 		std::mutex avg_power_m, knobs_set_m;
 		boost::thread power_log_thread;
+		// Model updates and optimisation run here, not on the app socket's receive thread.
+		prime::api::rtm::executor_t executor;
 		bool knobs_set, mon_set;
 
 		//**** Functions ****//
@@ -153,6 +159,9 @@ namespace prime
 		void per_app_mon_power_logger(void);
 		void global_power_logger(void);
 
+		void app_mon_cont_update(pid_t proc_id, unsigned int id);
+		void opt_app_mon_disc(pid_t proc_id, unsigned int id, bool min);
+		void opt_app_mon_cont(pid_t proc_id, unsigned int id, bool min);
 		void opt_app_mon_disc_min(prime::api::app::mon_disc_t &app_mon);
 		void opt_app_mon_disc_max(prime::api::app::mon_disc_t &app_mon);
 		void opt_app_mon_cont_min(prime::api::app::mon_cont_t &app_mon);
@@ -202,12 +211,15 @@ namespace prime
 		prime::util::rtm_set_affinity(getpid(), std::vector<unsigned int>{0});
 
 		reg_dev();
+		rtm_lr_m.lock();
 		for(auto &dmp : dev_mons_power)
 		{
 			rtm_lr.add_dev_model(dmp.id);
 			std::cout << "RTM: Created device model for cont monitor ID: " << dmp.id << std::endl;
 		}
+		rtm_lr_m.unlock();
 
+		executor.start();
 		ui_api.return_ui_rtm_start();
 
 		//power_log_thread = boost::thread(&rtm::per_app_mon_power_logger, this);
@@ -229,6 +241,7 @@ namespace prime
 	void rtm::ui_rtm_stop_handler(void)
 	{
 		power_log_thread.interrupt();
+		executor.stop();
 		dereg_dev();
 		std::cout << "RTM: Device deregistered" << std::endl;
 		ui_rtm_stop_cv.notify_one();
@@ -257,37 +270,34 @@ namespace prime
 
 		std::cout << "RTM: Filtering out frequency knobs" << std::endl;
 		boost::property_tree::ptree arch = dev_api.dev_arch_get();
-		auto num_fu = util::get_func_unit_ids(arch);
+		util::arch_index_t arch_index(arch, dev_knobs_disc, dev_knobs_cont, dev_mons_disc, dev_mons_cont);
 
-		for(auto fu_id : num_fu){
-			auto dev_knobs_fu = util::get_disc_knob_func_unit(arch, dev_knobs_disc, fu_id);
-			if(util::get_all_disc_knob(dev_knobs_fu, api::dev::PRIME_GOVERNOR).size())
+		for(auto fu_id : arch_index.func_unit_ids()){
+			if(!arch_index.disc_knobs_func_unit(fu_id, api::dev::PRIME_GOVERNOR).empty())
 			{
-				for(auto ddk : dev_knobs_fu){
-					if(ddk.type == api::dev::PRIME_FREQ){
-						if(fu_id < 3){
-							dev_knobs_freq.push_back(ddk);
-							rtm_lr.add_knob();
-						}
-						cpu_knobs_freq.push_back(ddk);
-						std::cout << "RTM: Found PRIME_FREQ knob under PRIME_GOVERNOR" << std::endl;
+				for(auto ddk : arch_index.disc_knobs_func_unit(fu_id, api::dev::PRIME_FREQ)){
+					if(fu_id < 3){
+						rtm_lr_m.lock();
+						dev_knobs_freq.push_back(ddk);
+						rtm_lr.add_knob();
+						rtm_lr_m.unlock();
 					}
+					cpu_knobs_freq.push_back(ddk);
+					std::cout << "RTM: Found PRIME_FREQ knob under PRIME_GOVERNOR" << std::endl;
 				}
 			}
-			else if(util::get_all_disc_knob(dev_knobs_fu, api::dev::PRIME_FREQ_EN).size())
+			else if(!arch_index.disc_knobs_func_unit(fu_id, api::dev::PRIME_FREQ_EN).empty())
 			{
-				for(auto ddk : dev_knobs_fu){
-					if(ddk.type == api::dev::PRIME_FREQ){
-						//dev_knobs_freq.push_back(ddk);
-						gpu_knobs_freq.push_back(ddk);
-						std::cout << "RTM: Found PRIME_FREQ knob under PRIME_FREQ_EN" << std::endl;
-					}
+				for(auto ddk : arch_index.disc_knobs_func_unit(fu_id, api::dev::PRIME_FREQ)){
+					//dev_knobs_freq.push_back(ddk);
+					gpu_knobs_freq.push_back(ddk);
+					std::cout << "RTM: Found PRIME_FREQ knob under PRIME_FREQ_EN" << std::endl;
 				}
 			}
 		}
 
-		dev_knobs_gov = util::get_all_disc_knob(dev_knobs_disc, api::dev::PRIME_GOVERNOR);
-		dev_knobs_freq_en = util::get_all_disc_knob(dev_knobs_disc, api::dev::PRIME_FREQ_EN);
+		dev_knobs_gov = arch_index.disc_knobs(api::dev::PRIME_GOVERNOR).to_vector();
+		dev_knobs_freq_en = arch_index.disc_knobs(api::dev::PRIME_FREQ_EN).to_vector();
 
 		std::cout << "RTM: Setting Frequency Governors knobs to userspace" << std::endl;
 		std::cout << "RTM: Number of Governor knobs: " << dev_knobs_gov.size() << std::endl;
@@ -322,11 +332,12 @@ namespace prime
 			while(app_mons_pow_log.size()) //log power if there is any app monitors to log it for
 			{
 				avg_power_m.lock();
+				dev_api.mon_snapshot_get(dev_mons_power); //read them so they are sent to the logger
 				for(auto &app_log : app_mons_pow_log)
 				{
 					for(unsigned int dmp_idx = 0; dmp_idx < dev_mons_power.size(); dmp_idx++)
 					{
-						app_log.dev_pow_vals[dmp_idx] += dev_api.mon_cont_get(dev_mons_power[dmp_idx]); //read them so they are sent to the logger
+						app_log.dev_pow_vals[dmp_idx] += dev_mons_power[dmp_idx].val;
 					}
 					//increment number of pow logs for app
 					app_log.log_count++;
@@ -377,6 +388,7 @@ namespace prime
 //						std::cout << "Predicting power monitor ID: " << dev_mons_power[dmp_idx].id << ", val: " << pred_mon << std::endl;
 //					}
 //				}
+				rtm_lr_m.lock();
 				rtm_lr.add_data(dev_mons_power[0].id, avg_powers[0]);
 #ifdef DEBUG_RTM
 				double pred_mon;
@@ -384,14 +396,16 @@ namespace prime
 //					std::cout << "Power monitor update: ID = " << dev_mons_power[0].id << ", val = " << avg_powers[0] << ", prediction = " << pred_mon << std::endl;
 				}
 #endif // DEBUG_RTM
+				rtm_lr_m.unlock();
 
 				log_time = std::chrono::high_resolution_clock::now();
 			}
 
 			avg_power_m.lock();
+			dev_api.mon_snapshot_get(dev_mons_power);
 			for(unsigned int dmp_idx = 0; dmp_idx < dev_mons_power.size(); dmp_idx++)
 			{
-				dev_pow_vals[dmp_idx] += dev_api.mon_cont_get(dev_mons_power[dmp_idx]);
+				dev_pow_vals[dmp_idx] += dev_mons_power[dmp_idx].val;
 			}
 			log_count++;
 			avg_power_m.unlock();
@@ -413,15 +427,19 @@ namespace prime
 	void rtm::app_reg_handler(pid_t proc_id, unsigned long int ur_id)
 	{
 		// Add registered app to vector of applications
+		rtm_lr_m.lock();
 		apps_m.lock();
 		apps.push_back(proc_id);
 
 		prime::api::app::knob_disc_t app_affinity_knob = {proc_id, app_api.get_unique_knob_id(),
 			 (prime::api::app::knob_type_t)prime::api::app::PRIME_AFF, 1, NUM_CORES, 8};
+		app_knobs_disc_m.lock();
 		app_knobs_disc_par.push_back(app_affinity_knob);
+		app_knobs_disc_m.unlock();
 		rtm_lr.add_knob();
 
 		apps_m.unlock();
+		rtm_lr_m.unlock();
 	}
 
 	void rtm::app_dereg_handler(pid_t proc_id)
@@ -439,6 +457,7 @@ namespace prime
 	void rtm::knob_disc_reg_handler(pid_t proc_id, prime::api::app::knob_disc_t knob)
 	{
 		// Add discrete application knob to vector of discrete knobs
+		rtm_lr_m.lock();
 		app_knobs_disc_m.lock();
 		if(knob.max == prime::api::PRIME_DISC_MAX) {
 			knob.max = knob.val;
@@ -456,20 +475,25 @@ namespace prime
 			app_api.knob_disc_set(knob, knob.min);
 		}
 		app_knobs_disc_m.unlock();
+		rtm_lr_m.unlock();
 	}
 
 	void rtm::knob_cont_reg_handler(pid_t proc_id, prime::api::app::knob_cont_t knob)
 	{
 		// Add continuous application knob to vector of continuous knobs
+		rtm_lr_m.lock();
 		app_knobs_cont_m.lock();
 		app_knobs_cont.push_back(knob);
 
 		//TODO: test without if statement
 		if(knob.type == prime::api::app::PRIME_PAR)
+		{
 			app_knobs_cont_par.push_back(knob);
-            rtm_lr.add_knob();
+			rtm_lr.add_knob();
+		}
 
 		app_knobs_cont_m.unlock();
+		rtm_lr_m.unlock();
 	}
 
 	void rtm::knob_disc_dereg_handler(prime::api::app::knob_disc_t knob)
@@ -569,6 +593,7 @@ namespace prime
 	void rtm::mon_disc_reg_handler(pid_t proc_id, prime::api::app::mon_disc_t mon)
 	{
 		//Called when a discrete monitor is registered
+		rtm_lr_m.lock();
 		app_mons_disc_m.lock();
 		app_mons_disc.push_back(mon);
 
@@ -581,11 +606,13 @@ namespace prime
 //		avg_power_m.unlock();
 
 		app_mons_disc_m.unlock();
+		rtm_lr_m.unlock();
 	}
 
 	void rtm::mon_cont_reg_handler(pid_t proc_id, prime::api::app::mon_cont_t mon)
 	{
 		//Called when a continuous monitor is registered
+		rtm_lr_m.lock();
 		app_mons_cont_m.lock();
 		app_mons_cont.push_back(mon);
 
@@ -598,11 +625,13 @@ namespace prime
 //		avg_power_m.unlock();
 
 		app_mons_cont_m.unlock();
+		rtm_lr_m.unlock();
 	}
 
 	void rtm::mon_disc_dereg_handler(prime::api::app::mon_disc_t mon)
 	{
 		// Remove application monitor from vector of discrete application
+		rtm_lr_m.lock();
 		app_mons_disc_m.lock();
 		app_mons_disc.erase(
 			std::remove_if(
@@ -613,12 +642,14 @@ namespace prime
 
 		rtm_lr.remove_app_model(mon.id);
 
-		app_mons_cont_m.unlock();
+		app_mons_disc_m.unlock();
+		rtm_lr_m.unlock();
 	}
 
 	void rtm::mon_cont_dereg_handler(prime::api::app::mon_cont_t mon)
 	{
 		// Remove application monitor from vector of continuous application
+		rtm_lr_m.lock();
 		app_mons_cont_m.lock();
 		app_mons_cont.erase(
 			std::remove_if(
@@ -630,6 +661,7 @@ namespace prime
 		rtm_lr.remove_app_model(mon.id);
 
 		app_mons_cont_m.unlock();
+		rtm_lr_m.unlock();
 	}
 
 /* ================================================================================== */
@@ -656,10 +688,10 @@ namespace prime
 			{
 				app_mon.min = min;
 				std::cout << "RTM: Application discrete monitor minimum updated. ID: " << id << ", min: " << min << std::endl;
-				opt_app_mon_disc_min(app_mon);
 			}
 		}
 		app_mons_disc_m.unlock();
+		executor.post(boost::bind(&rtm::opt_app_mon_disc, this, proc_id, id, true));
 	}
 
 	void rtm::mon_disc_max_change_handler(pid_t proc_id, unsigned int id, prime::api::disc_t max)
@@ -671,10 +703,10 @@ namespace prime
 			{
 				app_mon.max = max;
 				std::cout << "RTM: Application discrete monitor maximum updated. ID: " << id << ", max: " << max << std::endl;
-				opt_app_mon_disc_max(app_mon);
 			}
 		}
 		app_mons_disc_m.unlock();
+		executor.post(boost::bind(&rtm::opt_app_mon_disc, this, proc_id, id, false));
 
 	}
 
@@ -715,10 +747,10 @@ namespace prime
 				app_mon.min = min;
 
 				std::cout << "RTM: Application continuous monitor minimum updated. ID: " << id << ", min: " << min << std::endl;
-				opt_app_mon_cont_min(app_mon);
 			}
 		}
 		app_mons_cont_m.unlock();
+		executor.post(boost::bind(&rtm::opt_app_mon_cont, this, proc_id, id, true));
 	}
 
 	void rtm::mon_cont_max_change_handler(pid_t proc_id, unsigned int id, prime::api::cont_t max)
@@ -730,10 +762,10 @@ namespace prime
 				app_mon.max = max;
 
 				std::cout << "RTM: Application continuous monitor maximum updated. ID: " << id << ", max: " << max << std::endl;
-				opt_app_mon_cont_max(app_mon);
 			}
 		}
 		app_mons_cont_m.unlock();
+		executor.post(boost::bind(&rtm::opt_app_mon_cont, this, proc_id, id, false));
 
 	}
 
@@ -755,45 +787,40 @@ namespace prime
 	{
 		app_mons_cont_m.lock();
 		//Update monitor value in rtm's copy of app_mons_cont
-		prime::api::app::mon_cont_t *app_mon_ref;
+		bool found = false;
 		for(auto& app_mon : app_mons_cont){
 			if((app_mon.id == id) && (app_mon.proc_id == proc_id)){
 				app_mon.val = val;
-				app_mon_ref = &app_mon;
+				found = true;
 				break;
 			}
 		}
-
-//		//Get a reference to the power log for this app monitor
-//		mon_pow_log *this_pow_log;
-//		for(auto& app_log : app_mons_pow_log){
-//			if((app_log.mon_id == id)){
-//				this_pow_log = &app_log;
-//				break;
-//			}
-//		}
 		app_mons_cont_m.unlock();
 
-		if(app_mon_ref == nullptr){
+		if(!found){
 			std::cout << "RTM: Error: app cont mon not found. ID: " << id << std::endl;
+			return;
 		}
+		// Updates that arrive while the model is busy collapse into the newest.
+		executor.post_latest(prime::api::rtm::executor_t::mon_key(proc_id, id),
+			boost::bind(&rtm::app_mon_cont_update, this, proc_id, id));
+	}
 
-//		//Collect average power measurements for last period
-//		avg_power_m.lock();
-//		std::vector<prime::api::cont_t> avg_powers(this_pow_log.dev_pow_vals->begin(), this_pow_log.dev_pow_vals->end());
-//		std::transform(avg_powers.begin(), avg_powers.end(), avg_powers.begin(), _1 / dev_mons_power_count);
-//
-//		//reset logging variables
-//		std::fill(this_pow_log.dev_pow_vals->begin(), this_pow_log.dev_pow_vals->end(), 0);
-//		this_pow_log.log_count = 0;
-//
-//		avg_power_m.unlock();
-//
-//		//Need to update to target power models within app monitor models (needs heirarchical models)
-//		for(auto& dcm : dev_cont_mon){
-//			rtm_lr.add_data(dcm->id, avg_powers->val);
-//		}
-
+	void rtm::app_mon_cont_update(pid_t proc_id, unsigned int id)
+	{
+		prime::api::app::mon_cont_t app_mon;
+		bool found = false;
+		app_mons_cont_m.lock();
+		for(auto& mon : app_mons_cont){
+			if((mon.id == id) && (mon.proc_id == proc_id)){
+				app_mon = mon;
+				found = true;
+				break;
+			}
+		}
+		app_mons_cont_m.unlock();
+		if(!found)
+			return;
 
 		//Only record sample if it occured after knobs were changed and more 1 monitor update occured
 		knobs_set_m.lock();
@@ -809,32 +836,82 @@ namespace prime
 		}
 		knobs_set_m.unlock();
 
+		std::unique_lock<std::mutex> lr_lock(rtm_lr_m);
 		//Update app model with new data from monitor
-		rtm_lr.add_data(app_mon_ref->id, app_mon_ref->val);
+		rtm_lr.add_data(app_mon.id, app_mon.val);
 		//randomise knobs if model is not trained
 		double pred_mon;
-		if(rtm_lr.predict_mon(app_mon_ref->id, &pred_mon)) {
-			if(app_mon_ref->type == prime::api::app::PRIME_PERF)
+		if(rtm_lr.predict_mon(app_mon.id, &pred_mon)) {
+			if(app_mon.type == prime::api::app::PRIME_PERF)
 				randomise_model_knobs();
 		} else {
 #ifdef DEBUG_RTM
-			std::cout << "RTM: cont monitor update: ID: " << app_mon_ref->id << ", val: " << app_mon_ref->val << ", prediction: " << pred_mon << std::endl;
+			std::cout << "RTM: cont monitor update: ID: " << app_mon.id << ", val: " << app_mon.val << ", prediction: " << pred_mon << std::endl;
 #endif // DEBUG_RTM
 
 			//Optimise once after model trained for the first time.
 			for(auto& amt_id : app_models_trained){
-				if(amt_id == app_mon_ref->id){
+				if(amt_id == app_mon.id){
 					return;
 				}
 			}
-			if(app_mon_ref->type == prime::api::app::PRIME_PERF)
+			if(app_mon.type == prime::api::app::PRIME_PERF)
 			{
-				opt_app_mon_cont_min(*app_mon_ref);
-				app_models_trained.push_back(app_mon_ref->id);
+				opt_app_mon_cont_min(app_mon);
+				app_models_trained.push_back(app_mon.id);
+			}
+		}
+	}
+
+	void rtm::opt_app_mon_disc(pid_t proc_id, unsigned int id, bool min)
+	{
+		prime::api::app::mon_disc_t app_mon;
+		bool found = false;
+		app_mons_disc_m.lock();
+		for(auto& mon : app_mons_disc){
+			if((mon.id == id) && (mon.proc_id == proc_id)){
+				app_mon = mon;
+				found = true;
+				break;
+			}
+		}
+		app_mons_disc_m.unlock();
+		if(!found)
+			return;
+
+		rtm_lr_m.lock();
+		if(min)
+			opt_app_mon_disc_min(app_mon);
+		else
+			opt_app_mon_disc_max(app_mon);
+		rtm_lr_m.unlock();
+	}
+
+	void rtm::opt_app_mon_cont(pid_t proc_id, unsigned int id, bool min)
+	{
+		prime::api::app::mon_cont_t app_mon;
+		bool found = false;
+		app_mons_cont_m.lock();
+		for(auto& mon : app_mons_cont){
+			if((mon.id == id) && (mon.proc_id == proc_id)){
+				app_mon = mon;
+				found = true;
+				break;
 			}
 		}
+		app_mons_cont_m.unlock();
+		if(!found)
+			return;
+
+		rtm_lr_m.lock();
+		if(min)
+			opt_app_mon_cont_min(app_mon);
+		else
+			opt_app_mon_cont_max(app_mon);
+		rtm_lr_m.unlock();
 	}
 
+	// The optimisers, randomise_model_knobs and set_model_knobs run with rtm_lr_m held.
 	void rtm::opt_app_mon_disc_min(prime::api::app::mon_disc_t &app_mon)
 	{
 
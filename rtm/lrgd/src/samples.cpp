@@ -0,0 +1,116 @@
+/* This file is part of LRGD, an example RTM for the PRiME Framework.
+ *
+ * LRGD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LRGD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LRGD.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright 2017, 2018 University of Southampton
+ *		written by Charles Leech
+ */
+
+/*---------------------------------------------------------------------------
+   samples.cpp - Regression Sample Store Code
+  ---------------------------------------------------------------------------
+   Author: Charles Leech
+   Email: cl19g10 [at] ecs.soton.ac.uk
+  ---------------------------------------------------------------------------*/
+#include <algorithm>
+#include "samples.h"
+
+namespace prime { namespace model
+{
+	SampleStore::SampleStore(unsigned int capacity) :
+		capacity(capacity ? capacity : 1), num_predictors(0)
+	{}
+
+	unsigned int SampleStore::num_columns(void) { return num_predictors + 2; }
+
+	double *SampleStore::column(unsigned int slot, unsigned int col)
+	{
+		return &data[((std::size_t)slot * num_columns() + col) * capacity];
+	}
+
+	//size the data for every slot and empty them all
+	void SampleStore::layout(void)
+	{
+		data.assign((std::size_t)slots.size() * num_columns() * capacity, 0);
+		for(unsigned int slot = 0; slot < slots.size(); slot++)
+			clear(slot);
+	}
+
+	unsigned int SampleStore::add_slot(void)
+	{
+		for(unsigned int slot = 0; slot < slots.size(); slot++)
+		{
+			if(!slots[slot].used)
+			{
+				clear(slot);
+				slots[slot].used = true;
+				return slot;
+			}
+		}
+
+		slots.push_back(slot_t{true, 0, 0});
+		data.resize((std::size_t)slots.size() * num_columns() * capacity, 0);
+		clear(slots.size() - 1);
+		return slots.size() - 1;
+	}
+
+	void SampleStore::remove_slot(unsigned int slot)
+	{
+		if(slot < slots.size())
+			slots[slot].used = false;
+	}
+
+	unsigned int SampleStore::get_num_predictors(void) { return num_predictors; }
+
+	void SampleStore::set_num_predictors(unsigned int num)
+	{
+		num_predictors = num;
+		layout();
+	}
+
+	void SampleStore::clear(unsigned int slot)
+	{
+		if(slot >= slots.size())
+			return;
+		slots[slot].head = 0;
+		slots[slot].count = 0;
+		double *ones = column(slot, 0);
+		std::fill(ones, ones + capacity, 1.0);
+	}
+
+	void SampleStore::add(unsigned int slot, double y, const double *x)
+	{
+		if(slot >= slots.size())
+			return;
+		slot_t &s = slots[slot];
+		for(unsigned int j = 0; j < num_predictors; j++)
+			column(slot, j + 1)[s.head] = x[j];
+		column(slot, num_predictors + 1)[s.head] = y;
+
+		s.head = (s.head + 1) % capacity;
+		if(s.count < capacity)
+			s.count++;
+	}
+
+	unsigned int SampleStore::get_num_samples(unsigned int slot)
+	{
+		return (slot < slots.size()) ? slots[slot].count : 0;
+	}
+
+	const double *SampleStore::design(unsigned int slot) { return column(slot, 0); }
+
+	const double *SampleStore::response(unsigned int slot) { return column(slot, num_predictors + 1); }
+
+	unsigned int SampleStore::get_stride(void) { return capacity; }
+} }
@@ -283,45 +283,39 @@ namespace prime
 		}
 
 
-		auto num_fu = util::get_func_unit_ids(arch);
+		util::arch_index_t arch_index(arch, dev_knobs_disc, dev_knobs_cont, dev_mons_disc, dev_mons_cont);
 
-		for(auto fu_id : num_fu){
-			auto dev_knobs_fu = util::get_disc_knob_func_unit(arch, dev_knobs_disc, fu_id);
-			if(util::get_all_disc_knob(dev_knobs_fu, api::dev::PRIME_GOVERNOR).size())
+		for(auto fu_id : arch_index.func_unit_ids()){
+			auto dev_knobs_freq_fu = arch_index.disc_knobs_func_unit(fu_id, api::dev::PRIME_FREQ);
+			if(!arch_index.disc_knobs_func_unit(fu_id, api::dev::PRIME_GOVERNOR).empty())
 			{
-				for(auto ddk : dev_knobs_fu){
-					if(ddk.type == api::dev::PRIME_FREQ){
-						dev_knobs_freq.push_back(ddk);
-						cpu_knobs_freq.push_back(ddk);
-						std::cout << "RTM: Found PRIME_FREQ knob under PRIME_GOVERNOR" << std::endl;
-						if(fu_id == 2)
-							gpu_knobs_freq.push_back(ddk);
-					}
+				for(auto ddk : dev_knobs_freq_fu){
+					dev_knobs_freq.push_back(ddk);
+					cpu_knobs_freq.push_back(ddk);
+					std::cout << "RTM: Found PRIME_FREQ knob under PRIME_GOVERNOR" << std::endl;
+					if(fu_id == 2)
+						gpu_knobs_freq.push_back(ddk);
 				}
 			}
-			else if(util::get_all_disc_knob(dev_knobs_fu, api::dev::PRIME_FREQ_EN).size())
+			else if(!arch_index.disc_knobs_func_unit(fu_id, api::dev::PRIME_FREQ_EN).empty())
 			{
-				for(auto ddk : dev_knobs_fu){
-					if(ddk.type == api::dev::PRIME_FREQ){
-						dev_knobs_freq.push_back(ddk);
-						gpu_knobs_freq.push_back(ddk);
-						std::cout << "RTM: Found PRIME_FREQ knob under PRIME_FREQ_EN" << std::endl;
-					}
+				for(auto ddk : dev_knobs_freq_fu){
+					dev_knobs_freq.push_back(ddk);
+					gpu_knobs_freq.push_back(ddk);
+					std::cout << "RTM: Found PRIME_FREQ knob under PRIME_FREQ_EN" << std::endl;
 				}
 			}
 			else
 			{
-				for(auto ddk : dev_knobs_fu){
-					if(ddk.type == api::dev::PRIME_FREQ){
-						dev_knobs_freq.push_back(ddk);
-						std::cout << "RTM: Found PRIME_FREQ knob" << std::endl;
-					}
+				for(auto ddk : dev_knobs_freq_fu){
+					dev_knobs_freq.push_back(ddk);
+					std::cout << "RTM: Found PRIME_FREQ knob" << std::endl;
 				}
 			}
 		}
 
-		dev_knobs_gov = util::get_all_disc_knob(dev_knobs_disc, api::dev::PRIME_GOVERNOR);
-		dev_knobs_freq_en = util::get_all_disc_knob(dev_knobs_disc, api::dev::PRIME_FREQ_EN);
+		dev_knobs_gov = arch_index.disc_knobs(api::dev::PRIME_GOVERNOR).to_vector();
+		dev_knobs_freq_en = arch_index.disc_knobs(api::dev::PRIME_FREQ_EN).to_vector();
 
 		std::cout << "RTM: Setting Frequency Governors knobs to userspace" << std::endl;
 		std::cout << "RTM: Number of Governor knobs: " << dev_knobs_gov.size() << std::endl;
@@ -361,12 +355,13 @@ namespace prime
 		while(1)
 		{
 			loop_check_temp = true;
+			dev_mons_temp_m.lock();
+			dev_api.mon_snapshot_get(dev_mons_temp);
+			dev_mons_temp_m.unlock();
 			for(int i = 0; i < num_temp_mons; i++)
 			{
 				//check that temp reached steady state for each sensor
-				dev_mons_temp_m.lock();
-				curr_temp[i] = dev_api.mon_cont_get(dev_mons_temp[i]);
-				dev_mons_temp_m.unlock();
+				curr_temp[i] = dev_mons_temp[i].val;
 				temp_stable[i] = abs(curr_temp[i] - prev_temp[i]) < TEMPERATURE_STABILITY_THRESHOLD ? true : false;
 				//print out for debug
 				//std::cout << "RTM: temp_mon " << i << " stable? " << temp_stable[i] << " diff = " << curr_temp[i] - prev_temp[i] << std::endl;
@@ -509,9 +504,7 @@ namespace prime
 			if(power_en)
 			{
 				dev_mons_pow_m.lock();
-				for(auto dcm : dev_mons_power){
-					dev_api.mon_cont_get(dcm); //read them so they are sent to the logger
-				}
+				dev_api.mon_snapshot_get(dev_mons_power); //read them so they are sent to the logger
 				dev_mons_pow_m.unlock();
 			}
 
@@ -15,6 +15,7 @@
  *		written by Charles Leech
  */
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -25,7 +26,7 @@
 
 namespace prime { namespace util
 {
-	void print_architecture(boost::property_tree::ptree dev_arch)
+	void print_architecture(const boost::property_tree::ptree& dev_arch)
 	{
 		std::cout << "Device Name: " << dev_arch.get_child("device").get<std::string>("descriptor") << std::endl;
 
@@ -125,13 +126,218 @@ namespace prime { namespace util
 		return;
     }
 
+	/* ------------------------------------ Architecture Index ------------------------------------ */
+	arch_index_t::arch_index_t(
+		const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::knob_disc_t>& knobs_disc,
+		const std::vector<prime::api::dev::knob_cont_t>& knobs_cont,
+		const std::vector<prime::api::dev::mon_disc_t>& mons_disc,
+		const std::vector<prime::api::dev::mon_cont_t>& mons_cont)
+	{
+		build(dev_arch, knobs_disc, knobs_cont, mons_disc, mons_cont);
+	}
+
+	void arch_index_t::build(
+		const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::knob_disc_t>& knobs_disc,
+		const std::vector<prime::api::dev::knob_cont_t>& knobs_cont,
+		const std::vector<prime::api::dev::mon_disc_t>& mons_disc,
+		const std::vector<prime::api::dev::mon_cont_t>& mons_cont)
+	{
+		std::unordered_map<unsigned int, int> knob_levels, mon_levels;
+
+		fu_ids.clear();
+		su_ids.clear();
+		levels.clear();
+		fu_levels.clear();
+		units.clear();
+		sub_levels.clear();
+
+		// Lists a level's knobs or monitors under the sub unit id they are numbered with.
+		auto add_entries = [this](const boost::property_tree::ptree& list, unsigned int fu_id, unsigned int su_id,
+			std::unordered_map<unsigned int, int>& level_of)
+		{
+			for(auto& entry : list) {
+				if(entry.first == "id")
+					continue;
+				unsigned int id = prime::util::set_id(fu_id, su_id, 0, entry.second.get<unsigned int>("id"));
+				level_of[id] = levels.size() - 1;
+				levels.back().ids.push_back(id);
+			}
+		};
+
+		// One pass over the tree, in file order.
+		auto func_units = dev_arch.get_child_optional("device.functional_units");
+		if(func_units) {
+			for(auto& func_unit_item : *func_units) {
+				const boost::property_tree::ptree& func_unit = func_unit_item.second;
+				unsigned int fu_id = func_unit.get<unsigned int>("id");
+				int unit = fu_ids.size();
+				fu_ids.push_back(fu_id);
+				su_ids.emplace_back();
+				units[fu_id] = unit;
+
+				// The unit's own knobs and monitors are numbered with their list's id.
+				fu_levels.push_back(levels.size());
+				levels.push_back(level_t{unit, {}});
+				auto mons = func_unit.get_child_optional("mons");
+				if(mons)
+					add_entries(*mons, fu_id, mons->get<unsigned int>("id", 0), mon_levels);
+				auto knobs = func_unit.get_child_optional("knobs");
+				if(knobs)
+					add_entries(*knobs, fu_id, knobs->get<unsigned int>("id", 0), knob_levels);
+
+				// Sub units, numbered with their own id.
+				for(auto& sub_unit_item : func_unit) {
+					if(sub_unit_item.first == "id" || sub_unit_item.first == "knobs" || sub_unit_item.first == "mons")
+						continue;
+					const boost::property_tree::ptree& sub_unit = sub_unit_item.second;
+					auto su_id = sub_unit.get_optional<unsigned int>("id");
+					if(!su_id)
+						continue;		// A property of the unit, not a sub unit
+
+					su_ids.back().push_back(*su_id);
+					sub_levels[(fu_id << 8) | *su_id] = levels.size();
+					levels.push_back(level_t{unit, {}});
+					auto sub_mons = sub_unit.get_child_optional("mons");
+					if(sub_mons)
+						add_entries(*sub_mons, fu_id, *su_id, mon_levels);
+					auto sub_knobs = sub_unit.get_child_optional("knobs");
+					if(sub_knobs)
+						add_entries(*sub_knobs, fu_id, *su_id, knob_levels);
+				}
+			}
+		}
+
+		this->knobs_disc.build(knobs_disc, knob_levels, levels.size());
+		this->knobs_cont.build(knobs_cont, knob_levels, levels.size());
+		this->mons_disc.build(mons_disc, mon_levels, levels.size());
+		this->mons_cont.build(mons_cont, mon_levels, levels.size());
+	}
+
+	const std::vector<unsigned int>& arch_index_t::sub_unit_ids(unsigned int func_unit_id) const
+	{
+		static const std::vector<unsigned int> none;
+		auto unit = units.find(func_unit_id);
+		return (unit == units.end()) ? none : su_ids[unit->second];
+	}
+
+	const std::vector<unsigned int>& arch_index_t::mons_knobs_ids_func_unit(unsigned int func_unit_id) const
+	{
+		static const std::vector<unsigned int> none;
+		int level = fu_level(func_unit_id);
+		return (level < 0) ? none : levels[level].ids;
+	}
+
+	const std::vector<unsigned int>& arch_index_t::mons_knobs_ids_sub_unit(unsigned int func_unit_id, unsigned int sub_unit_id) const
+	{
+		static const std::vector<unsigned int> none;
+		int level = sub_level(func_unit_id, sub_unit_id);
+		return (level < 0) ? none : levels[level].ids;
+	}
+
+	int arch_index_t::fu_level(unsigned int func_unit_id) const
+	{
+		auto unit = units.find(func_unit_id);
+		return (unit == units.end()) ? -1 : fu_levels[unit->second];
+	}
+
+	int arch_index_t::sub_level(unsigned int func_unit_id, unsigned int sub_unit_id) const
+	{
+		auto level = sub_levels.find((func_unit_id << 8) | sub_unit_id);
+		return (level == sub_levels.end()) ? -1 : level->second;
+	}
+
+	template<typename T, typename type_t>
+	void arch_index_t::table_t<T, type_t>::build(const std::vector<T>& items, const std::unordered_map<unsigned int, int>& levels, std::size_t num_levels)
+	{
+		num_types = 0;
+		for(auto& item : items)
+			num_types = std::max<std::size_t>(num_types, (std::size_t)item.type + 1);
+
+		// Stable sorts, so registration order holds within each group.
+		by_type = items;
+		std::stable_sort(by_type.begin(), by_type.end(), [](const T& a, const T& b) { return a.type < b.type; });
+		type_ranges.assign(num_types, range_t(0, 0));
+		for(std::size_t i = 0; i < by_type.size(); i++) {
+			range_t& range = type_ranges[by_type[i].type];
+			if(range.first == range.second)
+				range.first = i;
+			range.second = i + 1;
+		}
+
+		// Anything the architecture does not list belongs to no level.
+		std::vector<std::pair<int, T>> placed;
+		placed.reserve(items.size());
+		for(auto& item : items) {
+			auto level = levels.find(item.id);
+			if(level != levels.end())
+				placed.push_back(std::make_pair(level->second, item));
+		}
+		std::stable_sort(placed.begin(), placed.end(), [](const std::pair<int, T>& a, const std::pair<int, T>& b) {
+			return (a.first != b.first) ? a.first < b.first : a.second.type < b.second.type;
+		});
+
+		by_level.clear();
+		by_level.reserve(placed.size());
+		level_ranges.assign(num_levels, range_t(0, 0));
+		level_type_ranges.assign(num_levels * num_types, range_t(0, 0));
+		for(std::size_t i = 0; i < placed.size(); i++) {
+			by_level.push_back(placed[i].second);
+			range_t& range = level_ranges[placed[i].first];
+			range_t& type_range = level_type_ranges[placed[i].first * num_types + placed[i].second.type];
+			if(range.first == range.second)
+				range.first = i;
+			range.second = i + 1;
+			if(type_range.first == type_range.second)
+				type_range.first = i;
+			type_range.second = i + 1;
+		}
+	}
+
+	template<typename T, typename type_t>
+	arch_span_t<T> arch_index_t::table_t<T, type_t>::of_type(type_t type) const
+	{
+		if((std::size_t)type >= num_types)
+			return arch_span_t<T>();
+		return span(by_type, type_ranges[type]);
+	}
+
+	template<typename T, typename type_t>
+	arch_span_t<T> arch_index_t::table_t<T, type_t>::at_level(int level) const
+	{
+		if(level < 0 || (std::size_t)level >= level_ranges.size())
+			return arch_span_t<T>();
+		return span(by_level, level_ranges[level]);
+	}
+
+	template<typename T, typename type_t>
+	arch_span_t<T> arch_index_t::table_t<T, type_t>::at_level(int level, type_t type) const
+	{
+		if(level < 0 || (std::size_t)level >= level_ranges.size() || (std::size_t)type >= num_types)
+			return arch_span_t<T>();
+		return span(by_level, level_type_ranges[level * num_types + type]);
+	}
+
+	template<typename T, typename type_t>
+	arch_span_t<T> arch_index_t::table_t<T, type_t>::span(const std::vector<T>& items, range_t range)
+	{
+		return arch_span_t<T>(items.data() + range.first, items.data() + range.second);
+	}
+
+	template class arch_index_t::table_t<prime::api::dev::knob_disc_t, prime::api::dev::knob_type_t>;
+	template class arch_index_t::table_t<prime::api::dev::knob_cont_t, prime::api::dev::knob_type_t>;
+	template class arch_index_t::table_t<prime::api::dev::mon_disc_t, prime::api::dev::mon_type_t>;
+	template class arch_index_t::table_t<prime::api::dev::mon_cont_t, prime::api::dev::mon_type_t>;
+
+	/* ------------------------------------ Type Helpers ------------------------------------ */
 	//returns a vector with all discrete monitors of a given type
-	std::vector<prime::api::dev::mon_disc_t> get_all_disc_mon(std::vector<prime::api::dev::mon_disc_t> mons_disc, prime::api::dev::mon_type_t type)
+	std::vector<prime::api::dev::mon_disc_t> get_all_disc_mon(const std::vector<prime::api::dev::mon_disc_t>& mons_disc, prime::api::dev::mon_type_t type)
 	{
 		std::vector<prime::api::dev::mon_disc_t> type_mons;
 
 		// Iterate to match IDs of known discrete monitors
-		for(auto mon : mons_disc){
+		for(auto& mon : mons_disc){
 			if(mon.type == type){
 				type_mons.push_back(mon);
 			}
@@ -140,12 +346,12 @@ namespace prime { namespace util
 	}
 
 	//returns a vector with all continuous monitors of a given type
-	std::vector<prime::api::dev::mon_cont_t> get_all_cont_mon(std::vector<prime::api::dev::mon_cont_t> mons_cont, prime::api::dev::mon_type_t type)
+	std::vector<prime::api::dev::mon_cont_t> get_all_cont_mon(const std::vector<prime::api::dev::mon_cont_t>& mons_cont, prime::api::dev::mon_type_t type)
 	{
 		std::vector<prime::api::dev::mon_cont_t> type_mons;
 
 		// Iterate to match IDs of known continuous monitors
-		for(auto mon : mons_cont){
+		for(auto& mon : mons_cont){
 			if(mon.type == type){
 				type_mons.push_back(mon);
 			}
@@ -154,50 +360,28 @@ namespace prime { namespace util
 	}
 
 	//returns a vector with all discrete knobs of a given type
-	std::vector<prime::api::dev::knob_disc_t> get_all_disc_knob(std::vector<prime::api::dev::knob_disc_t> knobs_disc, prime::api::dev::knob_type_t type)
+	std::vector<prime::api::dev::knob_disc_t> get_all_disc_knob(const std::vector<prime::api::dev::knob_disc_t>& knobs_disc, prime::api::dev::knob_type_t type)
 	{
 		std::vector<prime::api::dev::knob_disc_t> type_knobs;
 
-		std::string type_str;
-		switch(type){
-			case prime::api::dev::PRIME_VOLT:	type_str = "PRIME_VOLT"; break;
-			case prime::api::dev::PRIME_FREQ:	type_str = "PRIME_FREQ"; break;
-			case prime::api::dev::PRIME_EN:		type_str = "PRIME_EN"; break;
-			case prime::api::dev::PRIME_PMC_CNT:type_str = "PRIME_PMC_CNT"; break;
-		}
-
 		// Iterate to match IDs of known discrete knob
-		for(auto knob : knobs_disc){
+		for(auto& knob : knobs_disc){
 			if(knob.type == type){
 				type_knobs.push_back(knob);
-#ifdef DEBUG
-				std::cout << type_str << std::endl;
-#endif // DEBUG
 			}
 		}
 		return type_knobs;
 	}
 
 	//returns a vector with all continuous knobs of a given type
-	std::vector<prime::api::dev::knob_cont_t> get_all_cont_knob(std::vector<prime::api::dev::knob_cont_t> knobs_cont, prime::api::dev::knob_type_t type)
+	std::vector<prime::api::dev::knob_cont_t> get_all_cont_knob(const std::vector<prime::api::dev::knob_cont_t>& knobs_cont, prime::api::dev::knob_type_t type)
 	{
 		std::vector<prime::api::dev::knob_cont_t> type_knobs;
 
-		std::string type_str;
-		switch(type){
-			case prime::api::dev::PRIME_VOLT:	type_str = "PRIME_VOLT"; break;
-			case prime::api::dev::PRIME_FREQ:	type_str = "PRIME_FREQ"; break;
-			case prime::api::dev::PRIME_EN:		type_str = "PRIME_EN"; break;
-			case prime::api::dev::PRIME_PMC_CNT:type_str = "PRIME_PMC_CNT"; break;
-		}
-
 		// Iterate to match IDs of known continuous knob
-		for(auto knob : knobs_cont){
+		for(auto& knob : knobs_cont){
 			if(knob.type == type){
 				type_knobs.push_back(knob);
-#ifdef DEBUG
-				std::cout << type_str << std::endl;
-#endif // DEBUG
 			}
 		}
 		return type_knobs;
@@ -207,172 +391,43 @@ namespace prime { namespace util
 	functions for functional units
 	*/
 	//return vector with functional units ids
-	std::vector<unsigned int> get_func_unit_ids(boost::property_tree::ptree dev_arch)
+	std::vector<unsigned int> get_func_unit_ids(const boost::property_tree::ptree& dev_arch)
 	{
-		std::vector<unsigned int> func_unit_ids;
-
-		//Parse Functional Units
-		boost::property_tree::ptree funcUnitItemList;
-		try{
-			funcUnitItemList = dev_arch.get_child("device.functional_units");
-		}catch(boost::property_tree::ptree_bad_path &){
-			std::cerr << "No Functional Units" << std::endl;
-		}
-
-		for(auto funcUnitItem : funcUnitItemList)
-		{
-			boost::property_tree::ptree funcUnit = funcUnitItem.second;
-#ifdef DEBUG
-			std::cout << funcUnitItem.first << ": " << funcUnit.get<unsigned int>("id") << std::endl;
-#endif // DEBUG
-			func_unit_ids.push_back(funcUnit.get<unsigned int>("id"));
-		}
-		return func_unit_ids;
+		return arch_index_t(dev_arch, {}, {}, {}, {}).func_unit_ids();
 	}
 
 	//return vector with all ids from knobs and monitors for a given functional unit
-	std::vector<unsigned int> get_mons_knobs_ids_func_unit(boost::property_tree::ptree dev_arch, unsigned int func_unit_id)
+	std::vector<unsigned int> get_mons_knobs_ids_func_unit(const boost::property_tree::ptree& dev_arch, unsigned int func_unit_id)
 	{
-		std::vector<unsigned int> ids;
-
-		//Parse Functional Units
-        boost::property_tree::ptree funcUnitItemList;
-        try{
-            funcUnitItemList = dev_arch.get_child("device.functional_units");
-        }catch(boost::property_tree::ptree_bad_path &){
-            // std::cerr << "No Functional Units" << std::endl;
-            return ids;
-        }
-
-		boost::property_tree::ptree funcUnit;
-		for(auto funcUnitItem : funcUnitItemList)
-		{
-			if(dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + ".id") == func_unit_id)
-			{
-				funcUnit = funcUnitItem.second;
-
-				//Parse MONITORS
-				boost::property_tree::ptree funcUnitMonList;
-				try{
-					funcUnitMonList = funcUnit.get_child("mons");
-				}catch(boost::property_tree::ptree_bad_path &){
-					// std::cerr << "No Monitors Found" << std::endl;
-					// return ids;
-				}
-
-				for(auto funcUnitMon : funcUnitMonList)
-				{
-					if(funcUnitMon.first != "id"){
-						unsigned int su_id = dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + ".mons.id");
-						unsigned int mon_id = dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + ".mons." + funcUnitMon.first + ".id");
-
-						ids.push_back(prime::util::set_id(func_unit_id, su_id, 0, mon_id));
-#ifdef DEBUG
-						std::cout << "device.functional_units." << funcUnitItem.first << ".mons." + funcUnitMon.first + ".id" << std::endl;
-#endif // DEBUG
-					}
-				}
-
-				//Parse KNOBS
-				try{
-					funcUnitMonList = funcUnit.get_child("knobs");
-				}catch(boost::property_tree::ptree_bad_path &){
-					// std::cerr << "No Knobs Found" << std::endl;
-					return ids;
-				}
-
-				for(auto funcUnitMon : funcUnitMonList)
-				{
-					if(funcUnitMon.first != "id"){
-						unsigned int su_id = dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + ".knobs.id");
-						unsigned int mon_id = dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + ".knobs." + funcUnitMon.first + ".id");
-
-						ids.push_back(prime::util::set_id(func_unit_id, su_id, 0, mon_id));
-#ifdef DEBUG
-						std::cout << "device.functional_units." << funcUnitItem.first << ".knobs." + funcUnitMon.first + ".id" << std::endl;
-#endif // DEBUG
-					}
-				}
-
-				return ids;
-			}
-		}
+		return arch_index_t(dev_arch, {}, {}, {}, {}).mons_knobs_ids_func_unit(func_unit_id);
 	}
 
 	//return vector with all discrete monitors from functional unit
-	std::vector<prime::api::dev::mon_disc_t> get_disc_mon_func_unit(boost::property_tree::ptree dev_arch,
-        std::vector<prime::api::dev::mon_disc_t> mons_disc, unsigned int func_unit_id)
-    {
-		std::vector<prime::api::dev::mon_disc_t> fu_disc_mon;
-
-		std::vector<unsigned int> mons_knobs_ids = get_mons_knobs_ids_func_unit(dev_arch, func_unit_id);
-
-		//search for monitors
-		for(auto id : mons_knobs_ids){
-			for(auto mon : mons_disc){
-				if(mon.id == id){
-					fu_disc_mon.push_back(mon);
-				}
-			}
-		}
-		return fu_disc_mon;
+	std::vector<prime::api::dev::mon_disc_t> get_disc_mon_func_unit(const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::mon_disc_t>& mons_disc, unsigned int func_unit_id)
+	{
+		return arch_index_t(dev_arch, {}, {}, mons_disc, {}).disc_mons_func_unit(func_unit_id).to_vector();
 	}
 
 	//return vector with all continuous monitors from functional unit
-	std::vector<prime::api::dev::mon_cont_t> get_cont_mon_func_unit(boost::property_tree::ptree dev_arch,
-        std::vector<prime::api::dev::mon_cont_t> mons_cont, unsigned int func_unit_id)
+	std::vector<prime::api::dev::mon_cont_t> get_cont_mon_func_unit(const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::mon_cont_t>& mons_cont, unsigned int func_unit_id)
 	{
-		std::vector<prime::api::dev::mon_cont_t> fu_cont_mon;
-
-		std::vector<unsigned int> mons_knobs_ids = get_mons_knobs_ids_func_unit(dev_arch, func_unit_id);
-
-		//search for monitors
-		for(auto id : mons_knobs_ids){
-			for(auto mon : mons_cont){
-				if(mon.id == id){
-					fu_cont_mon.push_back(mon);
-				}
-			}
-		}
-		return fu_cont_mon;
+		return arch_index_t(dev_arch, {}, {}, {}, mons_cont).cont_mons_func_unit(func_unit_id).to_vector();
 	}
 
 	//return vector with all discrete knobs from functional unit
-	std::vector<prime::api::dev::knob_disc_t> get_disc_knob_func_unit(boost::property_tree::ptree dev_arch,
-        std::vector<prime::api::dev::knob_disc_t> knobs_disc, unsigned int func_unit_id)
-    {
-		std::vector<prime::api::dev::knob_disc_t> fu_disc_knob;
-
-		std::vector<unsigned int> mons_knobs_ids = get_mons_knobs_ids_func_unit(dev_arch, func_unit_id);
-
-		//search for monitors
-		for(auto id : mons_knobs_ids){
-			for(auto knob : knobs_disc){
-				if(knob.id == id){
-					fu_disc_knob.push_back(knob);
-				}
-			}
-		}
-		return fu_disc_knob;
+	std::vector<prime::api::dev::knob_disc_t> get_disc_knob_func_unit(const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::knob_disc_t>& knobs_disc, unsigned int func_unit_id)
+	{
+		return arch_index_t(dev_arch, knobs_disc, {}, {}, {}).disc_knobs_func_unit(func_unit_id).to_vector();
 	}
 
 	//return vector with all continuous knobs from functional unit
-	std::vector<prime::api::dev::knob_cont_t> get_cont_knob_func_unit(boost::property_tree::ptree dev_arch,
-        std::vector<prime::api::dev::knob_cont_t> knobs_cont, unsigned int func_unit_id)
-    {
-		std::vector<prime::api::dev::knob_cont_t> fu_cont_knob;
-
-		std::vector<unsigned int> mons_knobs_ids = get_mons_knobs_ids_func_unit(dev_arch, func_unit_id);
-
-		//search for monitors
-		for(auto id : mons_knobs_ids){
-			for(auto knob : knobs_cont){
-				if(knob.id == id){
-					fu_cont_knob.push_back(knob);
-				}
-			}
-		}
-		return fu_cont_knob;
+	std::vector<prime::api::dev::knob_cont_t> get_cont_knob_func_unit(const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::knob_cont_t>& knobs_cont, unsigned int func_unit_id)
+	{
+		return arch_index_t(dev_arch, {}, knobs_cont, {}, {}).cont_knobs_func_unit(func_unit_id).to_vector();
 	}
 
 
@@ -380,184 +435,42 @@ namespace prime { namespace util
 	functions for sub-units
 	*/
 	//return vector with sub units ids from a given functional unit
-	std::vector<unsigned int> get_sub_unit_ids(boost::property_tree::ptree dev_arch, unsigned int func_unit_id)
+	std::vector<unsigned int> get_sub_unit_ids(const boost::property_tree::ptree& dev_arch, unsigned int func_unit_id)
 	{
-		std::vector<unsigned int> ids;
-
-		//Parse Functional Units
-		boost::property_tree::ptree funcUnitItemList;
-		try{
-			funcUnitItemList = dev_arch.get_child("device.functional_units");
-		}catch(boost::property_tree::ptree_bad_path &){
-			return ids;
-		}
-
-		boost::property_tree::ptree funcUnit;
-		for(auto funcUnitItem : funcUnitItemList)
-		{
-			if(dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + ".id") == func_unit_id){
-				funcUnit = funcUnitItem.second;
-
-				//Parse sub unit
-				for(auto funcUnitSecondLevelItem : funcUnit)
-				{
-					//get anything besides id, knobs or mons
-					if(funcUnitSecondLevelItem.first != "id" && funcUnitSecondLevelItem.first != "knobs" && funcUnitSecondLevelItem.first != "mons"){
-						// std::cout << "device.functional_units." << funcUnitItem.first << "." << funcUnitSecondLevelItem.first << ".id"<< std::endl;
-						ids.push_back(dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + "." + funcUnitSecondLevelItem.first + ".id"));
-					}
-				}
-				return ids;
-			}
-		}
+		return arch_index_t(dev_arch, {}, {}, {}, {}).sub_unit_ids(func_unit_id);
 	}
 
-	//return vector with all ids from knobs and monitors for a given functional unit
-	std::vector<unsigned int> get_mons_knobs_ids_sub_unit(boost::property_tree::ptree dev_arch, unsigned int func_unit_id, unsigned int sub_unit_id)
+	//return vector with all ids from knobs and monitors for a given sub unit
+	std::vector<unsigned int> get_mons_knobs_ids_sub_unit(const boost::property_tree::ptree& dev_arch, unsigned int func_unit_id, unsigned int sub_unit_id)
 	{
-		std::vector<unsigned int> ids;
-
-		//Parse Functional Units
-		boost::property_tree::ptree funcUnitItemList;
-		try{
-			funcUnitItemList = dev_arch.get_child("device.functional_units");
-		}catch(boost::property_tree::ptree_bad_path &){
-			return ids;
-		}
-
-		boost::property_tree::ptree funcUnit;
-		for(auto funcUnitItem : funcUnitItemList)
-		{
-			if(dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + ".id") == func_unit_id){
-				funcUnit = funcUnitItem.second;
-
-				//Parse sub unit
-				for(auto funcUnitSecondLevelItem : funcUnit)
-				{
-					//get anything besides id, knobs or mons
-					if(funcUnitSecondLevelItem.first != "id" && funcUnitSecondLevelItem.first != "knobs" && funcUnitSecondLevelItem.first != "mons"){
-						if(dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + "." + funcUnitSecondLevelItem.first + ".id") == sub_unit_id){
-
-							//Parse Second-Level MONITORS
-							boost::property_tree::ptree funcUnitSecondLevelMonList;
-							boost::property_tree::ptree funcUnitSecondLevel = funcUnitSecondLevelItem.second;
-							try{
-								funcUnitSecondLevelMonList = funcUnitSecondLevel.get_child("mons");
-							}catch(boost::property_tree::ptree_bad_path &){
-								// std::cerr << "\t\t" << "No Second-level Monitors Found" << std::endl;
-							}
-							for(auto funcUnitSecondLevelMon : funcUnitSecondLevelMonList)
-							{
-								if(funcUnitSecondLevelMon.first != "id"){
-									unsigned int mon_id = dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + "." + funcUnitSecondLevelItem.first + ".mons." + funcUnitSecondLevelMon.first + ".id");
-									// std::cout << "device.functional_units." << funcUnitItem.first << "." << funcUnitSecondLevelItem.first << ".mons." << funcUnitSecondLevelMon.first << ".id" << std::endl;
-
-									ids.push_back(prime::util::set_id(func_unit_id, sub_unit_id, 0, mon_id));
-								}
-							}
-
-							//Parse Second-Level KNOBS
-							boost::property_tree::ptree funcUnitSecondLevelKnobList;
-							try{
-								funcUnitSecondLevelKnobList = funcUnitSecondLevel.get_child("knobs");
-							}catch(boost::property_tree::ptree_bad_path &){
-								// std::cerr << "\t\t" << "No Second-level Knobs Found" << std::endl;
-								return ids;
-							}
-							for(auto funcUnitSecondLevelKnob : funcUnitSecondLevelKnobList)
-							{
-								if(funcUnitSecondLevelKnob.first != "id"){
-									unsigned int knob_id = dev_arch.get<unsigned int>("device.functional_units." + funcUnitItem.first + "." + funcUnitSecondLevelItem.first + ".knobs." + funcUnitSecondLevelKnob.first + ".id");
-									// std::cout << "device.functional_units." << funcUnitItem.first << "." << funcUnitSecondLevelItem.first << ".knobs." << funcUnitSecondLevelMon.first << ".id" << std::endl;
-
-									ids.push_back(prime::util::set_id(func_unit_id, sub_unit_id, 0, knob_id));
-								}
-							}
-							return ids;
-						}
-					}
-				}
-			}
-		}
+		return arch_index_t(dev_arch, {}, {}, {}, {}).mons_knobs_ids_sub_unit(func_unit_id, sub_unit_id);
 	}
 
 	//return vector with all discrete monitors from sub unit
-	std::vector<prime::api::dev::mon_disc_t> get_disc_mon_sub_unit(boost::property_tree::ptree dev_arch,
-        std::vector<prime::api::dev::mon_disc_t> mons_disc, unsigned int func_unit_id, unsigned int sub_unit_id)
+	std::vector<prime::api::dev::mon_disc_t> get_disc_mon_sub_unit(const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::mon_disc_t>& mons_disc, unsigned int func_unit_id, unsigned int sub_unit_id)
 	{
-		std::vector<prime::api::dev::mon_disc_t> su_mon_disc;
-
-		//get all mons and knobs for this su
-		std::vector<unsigned int> mons_knobs_ids = get_mons_knobs_ids_sub_unit(dev_arch, func_unit_id, sub_unit_id);
-
-		//search for discrete monitors
-		for(auto mon_knob_id : mons_knobs_ids){
-			for(auto mon : mons_disc){
-				if(mon.id == mon_knob_id){
-					su_mon_disc.push_back(mon);
-				}
-			}
-		}
-		return su_mon_disc;
+		return arch_index_t(dev_arch, {}, {}, mons_disc, {}).disc_mons_sub_unit(func_unit_id, sub_unit_id).to_vector();
 	}
 
 	//return vector with all continuous monitors from sub unit
-	std::vector<prime::api::dev::mon_cont_t> get_cont_mon_sub_unit(boost::property_tree::ptree dev_arch,
-        std::vector<prime::api::dev::mon_cont_t> mons_cont, unsigned int func_unit_id, unsigned int sub_unit_id)
+	std::vector<prime::api::dev::mon_cont_t> get_cont_mon_sub_unit(const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::mon_cont_t>& mons_cont, unsigned int func_unit_id, unsigned int sub_unit_id)
 	{
-		std::vector<prime::api::dev::mon_cont_t> su_mon_cont;
-
-		//get all mons and knobs for this su
-		std::vector<unsigned int> mons_knobs_ids = get_mons_knobs_ids_sub_unit(dev_arch, func_unit_id, sub_unit_id);
-
-		//search for discrete monitors
-		for(auto id : mons_knobs_ids){
-			for(auto mon : mons_cont){
-				if(mon.id == id){
-					su_mon_cont.push_back(mon);
-				}
-			}
-		}
-		return su_mon_cont;
+		return arch_index_t(dev_arch, {}, {}, {}, mons_cont).cont_mons_sub_unit(func_unit_id, sub_unit_id).to_vector();
 	}
 
 	//return vector with all discrete knobs from sub unit
-	std::vector<prime::api::dev::knob_disc_t> get_disc_knob_sub_unit(boost::property_tree::ptree dev_arch,
-        std::vector<prime::api::dev::knob_disc_t> knobs_disc, unsigned int func_unit_id, unsigned int sub_unit_id)
+	std::vector<prime::api::dev::knob_disc_t> get_disc_knob_sub_unit(const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::knob_disc_t>& knobs_disc, unsigned int func_unit_id, unsigned int sub_unit_id)
 	{
-		std::vector<prime::api::dev::knob_disc_t> su_knobs_disc;
-
-		//get all mons and knobs for this su
-		std::vector<unsigned int> mons_knobs_ids = get_mons_knobs_ids_sub_unit(dev_arch, func_unit_id, sub_unit_id);
-
-		//search for discrete monitors
-		for(auto id : mons_knobs_ids){
-			for(auto knob : knobs_disc){
-				if(knob.id == id){
-					su_knobs_disc.push_back(knob);
-				}
-			}
-		}
-		return su_knobs_disc;
+		return arch_index_t(dev_arch, knobs_disc, {}, {}, {}).disc_knobs_sub_unit(func_unit_id, sub_unit_id).to_vector();
 	}
 
 	//return vector with all continuous knobs from sub unit
-	std::vector<prime::api::dev::knob_cont_t> get_cont_knob_sub_unit(boost::property_tree::ptree dev_arch,
-        std::vector<prime::api::dev::knob_cont_t> knobs_cont, unsigned int func_unit_id, unsigned int sub_unit_id)
+	std::vector<prime::api::dev::knob_cont_t> get_cont_knob_sub_unit(const boost::property_tree::ptree& dev_arch,
+		const std::vector<prime::api::dev::knob_cont_t>& knobs_cont, unsigned int func_unit_id, unsigned int sub_unit_id)
 	{
-		std::vector<prime::api::dev::knob_cont_t> su_knobs_cont;
-
-		//get all mons and knobs for this su
-		std::vector<unsigned int> mons_knobs_ids = get_mons_knobs_ids_sub_unit(dev_arch, func_unit_id, sub_unit_id);
-
-		//search for discrete monitors
-		for(auto id : mons_knobs_ids){
-			for(auto knob : knobs_cont){
-				if(knob.id == id){
-					su_knobs_cont.push_back(knob);
-				}
-			}
-		}
-		return su_knobs_cont;
+		return arch_index_t(dev_arch, {}, knobs_cont, {}, {}).cont_knobs_sub_unit(func_unit_id, sub_unit_id).to_vector();
 	}
 } }
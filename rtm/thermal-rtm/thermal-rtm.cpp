@@ -445,25 +445,17 @@ namespace prime
 			//end for DPTM
 		/* ================================================================================== */
 
-		std::vector<unsigned int> funcUnitIds;
-		std::vector<unsigned int> subUnitIds;
-		std::vector<prime::api::dev::mon_disc_t> su_disc_mons;
-		std::vector<prime::api::dev::mon_cont_t> su_cont_mons;
+		// Compiled once; the spans below point into it.
+		prime::util::arch_index_t arch_index(dev_arch, knobs_disc, knobs_cont, mons_disc, mons_cont);
 
 		//get all cycle_count monitors for all sub units
-		//get all fu ids
-		funcUnitIds = prime::util::get_func_unit_ids(dev_arch);
-
 		//get all sub units from all func units
-		for(auto fu : funcUnitIds){
-			subUnitIds = prime::util::get_sub_unit_ids(dev_arch, fu);
-			for(auto su : subUnitIds){
-				su_disc_mons = prime::util::get_disc_mon_sub_unit(dev_arch, mons_disc, fu, su);
-				for(auto mon : su_disc_mons){
+		for(auto fu : arch_index.func_unit_ids()){
+			for(auto su : arch_index.sub_unit_ids(fu)){
+				for(auto& mon : arch_index.disc_mons_sub_unit(fu, su)){
 						std::cout << "disc mon: id: " << mon.id << ", type: " << mon.type << std::endl;
 				}
-				su_cont_mons = prime::util::get_cont_mon_sub_unit(dev_arch, mons_cont, fu, su);
-				for(auto mon : su_cont_mons){
+				for(auto& mon : arch_index.cont_mons_sub_unit(fu, su)){
 						std::cout << "cont mon: id: " << mon.id << ", type: " << mon.type << std::endl;
 				}
 			}
@@ -931,13 +923,17 @@ namespace prime
 
 	int rtm::compute_max_freq(int Current_Freq_L, int Current_Freq_B, int freq_changed, int *Max_Freq_L, int *Max_Freq_B){
 
+		// Temperature and power from one snapshot, so the model sees coherent readings.
+		std::vector<prime::api::dev::mon_cont_t> read_mons = {temp_mons[0], power_mons[1], power_mons[2], power_mons[3], power_mons[4]};
+		dev_api.mon_snapshot_get(read_mons);
+
 		// temp = (int) dev_api.mon_cont_get(temp_mons[2]);
-		temp = (int) dev_api.mon_cont_get(temp_mons[0]);
+		temp = (int) read_mons[0].val;
 
-			power_l = dev_api.mon_cont_get(power_mons[1]);
-			power_b = dev_api.mon_cont_get(power_mons[2]);
-			power_gpu = dev_api.mon_cont_get(power_mons[3]);
-			power_mem = dev_api.mon_cont_get(power_mons[4]);
+			power_l = read_mons[1].val;
+			power_b = read_mons[2].val;
+			power_gpu = read_mons[3].val;
+			power_mem = read_mons[4].val;
 
 			New_Freq_L = 12;
 			New_Freq_B = 18;
@@ -1236,9 +1232,11 @@ namespace prime
 				freq_reset = false;
 
 
-				unsigned int L2Cache_RR_4 = (unsigned int) dev_api.mon_disc_get(L2Cache_RR_4_mon);
+				std::vector<prime::api::dev::mon_disc_t> pmc_mons = {L2Cache_RR_4_mon, Instructions_4_mon};
+				dev_api.mon_snapshot_get(pmc_mons);
+				unsigned int L2Cache_RR_4 = (unsigned int) pmc_mons[0].val;
 
-				unsigned int Instructions_4 = (unsigned int) dev_api.mon_disc_get(Instructions_4_mon);
+				unsigned int Instructions_4 = (unsigned int) pmc_mons[1].val;
 
 				double MRPI_4=(double) L2Cache_RR_4/Instructions_4;
 
@@ -1339,8 +1337,10 @@ namespace prime
 			// IPS_New = Instructions_Big/MRPI_SAMPLE_PERIOD;
 
 			//
-			unsigned int L2Cache_RR_4 = (unsigned int) dev_api.mon_disc_get(L2Cache_RR_4_mon);
-			unsigned int Instructions_4 = (unsigned int) dev_api.mon_disc_get(Instructions_4_mon);
+			std::vector<prime::api::dev::mon_disc_t> pmc_mons = {L2Cache_RR_4_mon, Instructions_4_mon};
+			dev_api.mon_snapshot_get(pmc_mons);
+			unsigned int L2Cache_RR_4 = (unsigned int) pmc_mons[0].val;
+			unsigned int Instructions_4 = (unsigned int) pmc_mons[1].val;
 			
 			double actual_MRPI=(double) L2Cache_RR_4/Instructions_4;
 			//IPS_New = Instructions_4/MRPI_SAMPLE_PERIOD;